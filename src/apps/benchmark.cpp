@@ -0,0 +1,1257 @@
+
+// By downloading, copying, installing or using the software you agree to this license.
+// If you do not agree to this license, do not download, install,
+// copy or use the software.
+
+
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//                        (3-clause BSD License)
+
+// Copyright (C) 2015, 
+// 	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+// 	  Johan Massich (mailsik@gmail.com),
+// 	  Gerard Bahi (zomeck@gmail.com),
+// 	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+// Third party copyrights are property of their respective owners.
+
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+
+//   * Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+
+//   * Neither the names of the copyright holders nor the names of the contributors
+//     may be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall copyright holders or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+
+
+// our own code
+#include <common/segmentation.h>
+#include <common/colorConversion.h>
+#include <common/simd.h>
+#include <common/parallel.h>
+#include <common/imageProcessing.h>
+#include <common/smartOptimisation.h>
+#include <common/SuperFormula.h>
+#include <common/trafficSignDetector.h>
+#include <tests/unit/testFixtures.h>
+
+// stl library
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+// OpenCV library
+#include <opencv2/opencv.hpp>
+
+// Micro benchmarks of the different stages of the pipeline.
+// Usage: ./benchmark stage [imageFileName.extension]
+
+namespace {
+
+  // Frame sizes of the dashcam input we need to sustain
+  const cv::Size frame_sizes[] = { cv::Size(1920, 1080), cv::Size(3840, 2160) };
+
+  // Read the input image and resize it to the requested frame size
+  cv::Mat load_frame(const std::string& input_filename, const cv::Size& frame_size) {
+    cv::Mat input_image = cv::imread(input_filename);
+    if (!input_image.data)
+      return input_image;
+    cv::Mat frame;
+    cv::resize(input_image, frame, frame_size, 0, 0, cv::INTER_LINEAR);
+    return frame;
+  }
+
+  // Average time in ms of a function over some repetitions, after one warm up run
+  template<typename Function> double time_ms(Function function, const int repetitions = 10) {
+    function();
+    std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; i++)
+      function();
+    const std::chrono::duration<double> elapsed_seconds = std::chrono::steady_clock::now() - start;
+    return elapsed_seconds.count() * 1000.0 / repetitions;
+  }
+
+  /*
+   * Colour conversion and segmentation -- multi pass vs fused kernel
+   */
+  int benchmark_segmentation(const std::string& input_filename) {
+
+    // Memory traffic in bytes per pixel of each pass of the multi pass pipeline
+    // convert_rgb_to_ihls: clone (3 + 3) + conversion (3 + 3)
+    // rgb_to_log_rb: two zero initialised float images (8) + conversion (3 + 8)
+    // seg_norm_hue: 3 + 1 / seg_log_chromatic: 8 + 1
+    // two clones (2 + 2) and two bitwise_or (3 + 3)
+    const double multi_pass_bytes_per_pixel = 12.0 + 19.0 + 4.0 + 9.0 + 4.0 + 6.0;
+    // seg_fused_rgb: read the BGR pixel and write the mask
+    const double fused_bytes_per_pixel = 3.0 + 1.0;
+
+    for (const cv::Size& frame_size : frame_sizes) {
+      cv::Mat frame = load_frame(input_filename, frame_size);
+      if (!frame.data) {
+        std::cout << "Error to read the image " << input_filename << std::endl;
+        return -1;
+      }
+
+      cv::Mat ihls_image, nhs_image_seg, log_image_seg, merge_image_seg;
+      std::vector< cv::Mat > log_image;
+      const double multi_pass_ms = time_ms([&]() {
+          colorconversion::convert_rgb_to_ihls(frame, ihls_image);
+          colorconversion::rgb_to_log_rb(frame, log_image);
+          segmentation::seg_norm_hue(ihls_image, nhs_image_seg, 0);
+          segmentation::seg_log_chromatic(log_image, log_image_seg);
+          cv::bitwise_or(nhs_image_seg, log_image_seg, merge_image_seg);
+        });
+
+      cv::Mat fused_image_seg;
+      const double fused_ms = time_ms([&]() {
+          segmentation::seg_fused_rgb(frame, fused_image_seg, 0);
+        });
+
+      const double mega_pixels = frame_size.area() / 1e6;
+      std::cout << std::fixed << std::setprecision(2)
+                << frame_size.width << "x" << frame_size.height << "\n"
+                << "  multi pass: " << multi_pass_ms << " ms, ~" << multi_pass_bytes_per_pixel * mega_pixels << " MB/frame\n"
+                << "  fused:      " << fused_ms << " ms, ~" << fused_bytes_per_pixel * mega_pixels << " MB/frame\n"
+                << "  identical masks: " << (cv::countNonZero(merge_image_seg != fused_image_seg) == 0 ? "yes" : "no") << std::endl;
+    }
+
+    return 0;
+  }
+
+  /*
+   * RGB to IHLS conversion -- reference vs vectorized kernels at each supported level
+   */
+  int benchmark_ihls(const std::string& input_filename) {
+
+    std::cout << "Detected SIMD level: " << simd::level_name(simd::detected_level()) << std::endl;
+
+    for (const cv::Size& frame_size : frame_sizes) {
+      cv::Mat frame = load_frame(input_filename, frame_size);
+      if (!frame.data) {
+        std::cout << "Error to read the image " << input_filename << std::endl;
+        return -1;
+      }
+
+      cv::Mat reference_ihls;
+      const double reference_ms = time_ms([&]() {
+          colorconversion::convert_rgb_to_ihls(frame, reference_ihls);
+        });
+
+      std::cout << std::fixed << std::setprecision(2)
+                << frame_size.width << "x" << frame_size.height << "\n"
+                << "  reference: " << reference_ms << " ms" << std::endl;
+
+      for (int level = simd::LEVEL_SCALAR; level <= simd::detected_level(); level++) {
+        cv::Mat simd_ihls;
+        const double simd_ms = time_ms([&]() {
+            colorconversion::convert_rgb_to_ihls_simd(frame, simd_ihls, static_cast<simd::Level> (level));
+          });
+
+        // Largest difference over the three channels
+        cv::Mat diff;
+        cv::absdiff(reference_ihls, simd_ihls, diff);
+        double max_diff = 0.0;
+        cv::minMaxLoc(diff.reshape(1), NULL, &max_diff);
+
+        std::cout << "  " << std::setw(9) << std::left << simd::level_name(static_cast<simd::Level> (level)) << std::right << ": "
+                  << simd_ms << " ms, speed-up x" << reference_ms / simd_ms
+                  << ", max difference " << max_diff << std::endl;
+      }
+    }
+
+    return 0;
+  }
+
+  /*
+   * Log chromatic stage -- std::log per pixel vs lookup table vs threshold bits
+   */
+  int benchmark_log_chromatic(const std::string& input_filename) {
+
+    for (const cv::Size& frame_size : frame_sizes) {
+      cv::Mat frame = load_frame(input_filename, frame_size);
+      if (!frame.data) {
+        std::cout << "Error to read the image " << input_filename << std::endl;
+        return -1;
+      }
+
+      // Previous implementation, two logarithms per pixel
+      cv::Mat log_r(frame.size(), CV_32F), log_b(frame.size(), CV_32F), reference_seg;
+      const double log_ms = time_ms([&]() {
+          for (int i = 0; i < frame.rows; i++) {
+            const uchar* bgr = frame.ptr<uchar>(i);
+            float* r = log_r.ptr<float>(i);
+            float* b = log_b.ptr<float>(i);
+            for (int j = 0; j < frame.cols; j++, bgr += 3) {
+              const float division = 1.0f / static_cast<float> (bgr[1] == 0 ? 1 : bgr[1]);
+              r[j] = std::log(static_cast<float> (bgr[2]) * division);
+              b[j] = std::log(static_cast<float> (bgr[0]) * division);
+            }
+          }
+          segmentation::seg_log_chromatic(std::vector< cv::Mat >{ log_r, log_b }, reference_seg);
+        });
+
+      std::cout << std::fixed << std::setprecision(2)
+                << frame_size.width << "x" << frame_size.height << "\n"
+                << "  std::log + threshold:     " << log_ms << " ms" << std::endl;
+
+      for (int level = simd::LEVEL_SCALAR; level <= simd::detected_level(); level++) {
+        std::vector< cv::Mat > log_image;
+        cv::Mat table_seg, bits_seg;
+        const double table_ms = time_ms([&]() {
+            colorconversion::rgb_to_log_rb(frame, log_image, static_cast<simd::Level> (level));
+            segmentation::seg_log_chromatic(log_image, table_seg);
+          });
+        const double bits_ms = time_ms([&]() {
+            segmentation::seg_log_chromatic_rgb(frame, bits_seg, static_cast<simd::Level> (level));
+          });
+
+        const bool identical = (cv::countNonZero(reference_seg != table_seg) == 0) && (cv::countNonZero(reference_seg != bits_seg) == 0);
+        std::cout << "  " << std::setw(9) << std::left << simd::level_name(static_cast<simd::Level> (level)) << std::right
+                  << " table + threshold: " << table_ms << " ms, threshold bits: " << bits_ms << " ms"
+                  << ", identical masks: " << (identical ? "yes" : "no") << std::endl;
+      }
+    }
+
+    return 0;
+  }
+
+  /*
+   * Normalised hue segmentation -- IHLS conversion and thresholds vs trig-free predicate
+   */
+  int benchmark_hue(const std::string& input_filename) {
+
+    for (const cv::Size& frame_size : frame_sizes) {
+      cv::Mat frame = load_frame(input_filename, frame_size);
+      if (!frame.data) {
+        std::cout << "Error to read the image " << input_filename << std::endl;
+        return -1;
+      }
+
+      cv::Mat ihls_image, reference_seg;
+      const double ihls_ms = time_ms([&]() {
+          colorconversion::convert_rgb_to_ihls(frame, ihls_image);
+          segmentation::seg_norm_hue(ihls_image, reference_seg, 0);
+        });
+
+      cv::Mat predicate_seg;
+      const double predicate_ms = time_ms([&]() {
+          segmentation::seg_norm_hue_rgb(frame, predicate_seg, 0);
+        });
+
+      std::cout << std::fixed << std::setprecision(2)
+                << frame_size.width << "x" << frame_size.height << "\n"
+                << "  ihls + thresholds: " << ihls_ms << " ms\n"
+                << "  predicate:         " << predicate_ms << " ms\n"
+                << "  identical masks: " << (cv::countNonZero(reference_seg != predicate_seg) == 0 ? "yes" : "no") << std::endl;
+    }
+
+    return 0;
+  }
+
+  /*
+   * Normalised hue segmentation -- IHLS conversion and thresholds vs saturation first cascade
+   */
+  int benchmark_cascade(const std::string& input_filename) {
+
+    for (const cv::Size& frame_size : frame_sizes) {
+      cv::Mat frame = load_frame(input_filename, frame_size);
+      if (!frame.data) {
+        std::cout << "Error to read the image " << input_filename << std::endl;
+        return -1;
+      }
+
+      cv::Mat ihls_image, reference_seg;
+      const double ihls_ms = time_ms([&]() {
+          colorconversion::convert_rgb_to_ihls(frame, ihls_image);
+          segmentation::seg_norm_hue(ihls_image, reference_seg, 0);
+        });
+
+      std::cout << std::fixed << std::setprecision(2)
+                << frame_size.width << "x" << frame_size.height << "\n"
+                << "  ihls + thresholds: " << ihls_ms << " ms" << std::endl;
+
+      for (int level = simd::LEVEL_SCALAR; level <= simd::detected_level(); level++) {
+        cv::Mat cascade_seg;
+        const double cascade_ms = time_ms([&]() {
+            segmentation::seg_norm_hue_cascade(frame, cascade_seg, 0, R_HUE_MAX, R_HUE_MIN, R_SAT_MIN, NULL, static_cast<simd::Level> (level));
+          });
+
+        segmentation::CascadeStats stats;
+        segmentation::seg_norm_hue_cascade(frame, cascade_seg, 0, R_HUE_MAX, R_HUE_MIN, R_SAT_MIN, &stats, static_cast<simd::Level> (level));
+
+        std::cout << "  cascade " << std::setw(9) << std::left << simd::level_name(static_cast<simd::Level> (level)) << std::right << ": "
+                  << cascade_ms << " ms, rejected by saturation " << 100.0 * stats.saturation_rejection_rate()
+                  << "%, then by hue " << 100.0 * stats.hue_rejection_rate() << "%"
+                  << ", identical masks: " << (cv::countNonZero(reference_seg != cascade_seg) == 0 ? "yes" : "no") << std::endl;
+      }
+    }
+
+    return 0;
+  }
+
+  /*
+   * Scaling of the full-frame stages with the number of threads
+   */
+  int benchmark_scaling(const std::string& input_filename) {
+
+    const int max_threads = std::max(1, static_cast<int> (std::thread::hardware_concurrency()));
+
+    for (const cv::Size& frame_size : frame_sizes) {
+      cv::Mat frame = load_frame(input_filename, frame_size);
+      if (!frame.data) {
+        std::cout << "Error to read the image " << input_filename << std::endl;
+        return -1;
+      }
+
+      std::cout << frame_size.width << "x" << frame_size.height << "\n"
+                << "  threads  ihls(ms)  fused seg(ms)  filter(ms)  voting(ms)  speed-up  identical" << std::endl;
+
+      // Serial references
+      cv::Mat ihls_reference, seg_reference, bin_reference;
+      cv::Point2f center_reference;
+      double serial_total_ms = 0.0;
+
+      for (int n_threads = 1; n_threads <= max_threads; n_threads++) {
+        parallel::set_num_threads(n_threads);
+
+        cv::Mat ihls_image, seg_image, bin_image;
+        cv::Point2f center;
+        const double ihls_ms = time_ms([&]() { colorconversion::convert_rgb_to_ihls(frame, ihls_image); });
+        const double seg_ms = time_ms([&]() { segmentation::seg_fused_rgb(frame, seg_image); });
+        const double filter_ms = time_ms([&]() { imageprocessing::filter_image(seg_image, bin_image); });
+        // Voting on the whole frame for a mid-size octagon
+        const double voting_ms = time_ms([&]() { center = initopt::radial_symmetry_detector(frame, 32, 8); }, 3);
+        const double total_ms = ihls_ms + seg_ms + filter_ms + voting_ms;
+
+        if (n_threads == 1) {
+          ihls_reference = ihls_image;
+          seg_reference = seg_image;
+          bin_reference = bin_image;
+          center_reference = center;
+          serial_total_ms = total_ms;
+        }
+        const bool identical = (cv::countNonZero((ihls_reference != ihls_image).reshape(1)) == 0) &&
+          (cv::countNonZero(seg_reference != seg_image) == 0) &&
+          (cv::countNonZero(bin_reference != bin_image) == 0) &&
+          (center_reference == center);
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << "  " << std::setw(7) << n_threads << std::setw(10) << ihls_ms << std::setw(15) << seg_ms
+                  << std::setw(12) << filter_ms << std::setw(12) << voting_ms << std::setw(9) << "x" << serial_total_ms / total_ms
+                  << "  " << (identical ? "yes" : "no") << std::endl;
+      }
+    }
+
+    parallel::set_num_threads(0);
+    return 0;
+  }
+
+  /*
+   * Radius derivatives of the supershape -- finite differences vs closed form
+   */
+  int benchmark_supershape(const std::string&) {
+
+    // Octagon as fitted on octogonal0017
+    RationalSuperShape2D RS(0.88557, 0.869246, 7.0, 9.0, 9.0, 8.0, 1.0);
+    const int n_points = 100000;
+
+    // The sum keeps the compiler from removing the evaluations
+    double finite_differences_sum = 0.0, closed_form_sum = 0.0;
+    const double finite_differences_ms = time_ms([&]() {
+        for (int i = 0; i < n_points; i++) {
+          const double tht = 2.0 * PI * i / n_points;
+          finite_differences_sum += RS.radius(tht) + RS.DrDa(tht) + RS.DrDb(tht) + RS.DrDn1(tht)
+            + RS.DrDn2(tht) + RS.DrDn3(tht) + RS.DrDtheta(tht);
+        }
+      }, 3);
+    const double closed_form_ms = time_ms([&]() {
+        for (int i = 0; i < n_points; i++) {
+          const double tht = 2.0 * PI * i / n_points;
+          double drda, drdb, drdn1, drdn2, drdn3, drdtht;
+          closed_form_sum += RS.RadiusAndDerivatives(tht, drda, drdb, drdn1, drdn2, drdn3, drdtht)
+            + drda + drdb + drdn1 + drdn2 + drdn3 + drdtht;
+        }
+      }, 3);
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "radius and 6 partial derivatives per point\n"
+              << "  finite differences: " << finite_differences_ms * 1e6 / n_points << " ns\n"
+              << "  closed form:        " << closed_form_ms * 1e6 / n_points << " ns, speed-up x"
+              << finite_differences_ms / closed_form_ms << "\n"
+              << std::scientific << std::setprecision(3)
+              << "  relative difference of the sums: " << std::fabs(closed_form_sum - finite_differences_sum) / std::fabs(finite_differences_sum)
+              << std::endl;
+
+    return 0;
+  }
+
+  /*
+   * 8D chi-square of a contour -- XiSquare<8> vs the batched evaluation
+   */
+  int benchmark_xisquare(const std::string&) {
+
+    // Noisy octagon of 600 points, shifted and rotated
+    std::vector< Vector2d, aligned_allocator< Vector2d> > data;
+    fixtures::noisy_contour(RationalSuperShape2D(0.88557, 0.869246, 7.0, 9.0, 9.0, 8.0, 1.0).Parameters, 600, data);
+    supershape::PointBatch batch;
+    batch.assign(data);
+
+    const RationalSuperShape2D RS(1.0, 1.0, 2.0, 2.0, 2.0, 8.0, 1.0, 0.15, 0.0, 0.0, 0.0, 0.0);
+    Matrix<double,8,8> alpha;
+    Matrix<double,8,1> beta;
+    const int n_calls = 200;
+
+    double reference_chi = 0.0;
+    const double reference_ms = time_ms([&]() {
+        for (int i = 0; i < n_calls; i++)
+          reference_chi = RS.XiSquare<8>(data, alpha, beta, 1, true);
+      }, 3);
+
+    std::cout << std::fixed << std::setprecision(2)
+              << data.size() << " points, hessian and gradient update\n"
+              << "  XiSquare<8>:  " << reference_ms * 1e3 / n_calls << " us" << std::endl;
+
+    double chi = 0.0;
+    const double batch_ms = time_ms([&]() {
+        for (int i = 0; i < n_calls; i++)
+          chi = supershape::xi_square_batch<8>(RS.Parameters, batch, alpha, beta, 1, true);
+      }, 3);
+    std::cout << std::fixed << std::setprecision(2)
+              << "  batched:      " << batch_ms * 1e3 / n_calls << " us, speed-up x" << reference_ms / batch_ms
+              << std::scientific << std::setprecision(3)
+              << ", relative difference " << std::fabs(chi - reference_chi) / reference_chi << std::endl;
+
+    return 0;
+  }
+
+  /*
+   * Per-sign fitting latency on a still sequence -- independent frames vs warm started video mode
+   */
+  int benchmark_warm_start(const std::string& input_filename) {
+
+    cv::Mat frame = cv::imread(input_filename);
+    if (!frame.data) {
+      std::cout << "Error to read the image " << input_filename << std::endl;
+      return -1;
+    }
+
+    // Sum of the hypothesis timings of the last frame, i.e. the fitting time of all its signs
+    const auto fitting_ms = [](const detection::TrafficSignDetector& detector) {
+      double total_ms = detector.regions_ms();
+      for (const detection::FitTiming& timing : detector.fit_timings())
+        total_ms += timing.mass_center_ms + timing.optimisation_ms;
+      return total_ms;
+    };
+
+    const int n_frames = 20;
+    for (int video_mode = 0; video_mode < 2; video_mode++) {
+      detection::TrafficSignDetector detector;
+      detector.set_video_mode(video_mode != 0);
+      std::vector< detection::Detection > detections;
+
+      // The first frame has no previous sign and always runs the full search
+      detector.detect(frame, detections);
+      double total_fitting_ms = 0.0;
+      size_t n_signs = 0, n_warm_started = 0;
+      const double frame_ms = time_ms([&]() {
+          detector.detect(frame, detections);
+          total_fitting_ms += fitting_ms(detector);
+          n_signs += detections.size();
+          for (const detection::Detection& detection : detections)
+            n_warm_started += detection.warm_started;
+        }, n_frames);
+
+      std::cout << std::fixed << std::setprecision(2)
+                << (video_mode ? "video mode:  " : "independent: ") << frame_ms << " ms/frame, "
+                << (n_signs ? total_fitting_ms / n_signs : 0.0) << " ms/sign of fitting, "
+                << n_warm_started << "/" << n_signs << " signs warm started" << std::endl;
+    }
+
+    return 0;
+  }
+
+  /*
+   * Levenberg-Marquardt iterations of the sign type hypotheses on the images next to the input image --
+   * exhaustive search vs branch and bound
+   */
+  int benchmark_bound(const std::string& input_filename) {
+
+    const std::string directory = input_filename.substr(0, input_filename.find_last_of('/') + 1);
+    std::vector< std::string > filenames;
+    cv::glob(directory + "*.jpg", filenames);
+    if (filenames.empty()) {
+      std::cout << "No image in " << directory << std::endl;
+      return -1;
+    }
+
+    detection::TrafficSignDetector exhaustive, bounded;
+    bounded.set_branch_and_bound(true);
+    std::vector< detection::Detection > exhaustive_detections, bounded_detections;
+    long exhaustive_iterations = 0, bounded_iterations = 0;
+    int n_hypotheses = 0, n_abandoned = 0, n_signs = 0, n_same_type = 0;
+    double exhaustive_ms = 0.0, bounded_ms = 0.0;
+    for (const std::string& filename : filenames) {
+      const cv::Mat image = cv::imread(filename);
+      if (!image.data)
+        continue;
+
+      exhaustive_ms += time_ms([&]() { exhaustive.detect(image, exhaustive_detections); }, 1);
+      bounded_ms += time_ms([&]() { bounded.detect(image, bounded_detections); }, 1);
+
+      for (const detection::FitTiming& timing : exhaustive.fit_timings())
+        exhaustive_iterations += timing.iterations;
+      for (const detection::FitTiming& timing : bounded.fit_timings()) {
+        bounded_iterations += timing.iterations;
+        n_abandoned += timing.abandoned;
+      }
+      n_hypotheses += static_cast<int> (bounded.fit_timings().size());
+      n_signs += static_cast<int> (bounded_detections.size());
+      for (size_t k = 0; k < bounded_detections.size() && k < exhaustive_detections.size(); k++)
+        n_same_type += bounded_detections[k].sign_type == exhaustive_detections[k].sign_type;
+    }
+
+    std::cout << std::fixed << std::setprecision(2)
+              << filenames.size() << " images, " << n_signs << " candidates, " << n_hypotheses << " hypotheses\n"
+              << "  exhaustive:       " << exhaustive_iterations << " iterations, " << exhaustive_ms << " ms\n"
+              << "  branch and bound: " << bounded_iterations << " iterations, " << bounded_ms << " ms, "
+              << n_abandoned << " hypotheses abandoned\n"
+              << "  iterations saved: " << exhaustive_iterations - bounded_iterations << " ("
+              << 100.0 * (exhaustive_iterations - bounded_iterations) / std::max(exhaustive_iterations, 1L) << " %)\n"
+              << "  same sign type:   " << n_same_type << "/" << n_signs << std::endl;
+
+    return 0;
+  }
+
+  /*
+   * Shape pre-classifier on the images next to the input image -- recall of the sign type of the exhaustive
+   * search among the top k ranked sign types, and detection time for each k
+   */
+  int benchmark_preclassifier(const std::string& input_filename) {
+
+    const std::string directory = input_filename.substr(0, input_filename.find_last_of('/') + 1);
+    std::vector< std::string > filenames;
+    cv::glob(directory + "*.jpg", filenames);
+    std::vector< cv::Mat > images;
+    for (const std::string& filename : filenames) {
+      const cv::Mat image = cv::imread(filename);
+      if (image.data)
+        images.push_back(image);
+    }
+    if (images.empty()) {
+      std::cout << "No image in " << directory << std::endl;
+      return -1;
+    }
+
+    // Reference -- every sign type fitted without bound
+    detection::TrafficSignDetector exhaustive;
+    exhaustive.set_top_k(NB_SIGN_TYPES);
+    exhaustive.set_branch_and_bound(false);
+    std::vector< detection::Detection > detections;
+    std::vector< int > reference_types, rank_of_reference;
+    double ranking_ms = 0.0, exhaustive_ms = 0.0;
+    for (const cv::Mat& image : images) {
+      exhaustive_ms += time_ms([&]() { exhaustive.detect(image, detections); }, 1);
+      ranking_ms += exhaustive.ranking_ms();
+      const std::vector< int >& rankings = exhaustive.sign_type_rankings();
+      for (size_t contour_idx = 0; contour_idx < detections.size(); contour_idx++) {
+        reference_types.push_back(detections[contour_idx].sign_type);
+        const std::vector< int >::const_iterator begin = rankings.begin() + contour_idx * NB_SIGN_TYPES;
+        rank_of_reference.push_back(static_cast<int> (std::find(begin, begin + NB_SIGN_TYPES, detections[contour_idx].sign_type) - begin));
+      }
+    }
+    const size_t n_candidates = reference_types.size();
+
+    std::cout << std::fixed << std::setprecision(3)
+              << images.size() << " images, " << n_candidates << " candidates, ranking "
+              << (n_candidates ? 1e3 * ranking_ms / n_candidates : 0.0) << " us/candidate\n"
+              << "  exhaustive: " << exhaustive_ms << " ms" << std::endl;
+
+    for (int top_k = 1; top_k <= NB_SIGN_TYPES; top_k++) {
+      detection::TrafficSignDetector detector;
+      detector.set_top_k(top_k);
+      double detect_ms = 0.0;
+      size_t n_same_type = 0, candidate_idx = 0;
+      for (const cv::Mat& image : images) {
+        detect_ms += time_ms([&]() { detector.detect(image, detections); }, 1);
+        for (size_t contour_idx = 0; contour_idx < detections.size() && candidate_idx < n_candidates; contour_idx++, candidate_idx++)
+          n_same_type += detections[contour_idx].sign_type == reference_types[candidate_idx];
+      }
+      const size_t n_recalled = std::count_if(rank_of_reference.begin(), rank_of_reference.end(),
+                                              [top_k](const int rank) { return rank < top_k; });
+      std::cout << "  top " << top_k << ": recall " << n_recalled << "/" << n_candidates
+                << ", same sign type " << n_same_type << "/" << n_candidates
+                << ", " << detect_ms << " ms, speed-up x" << exhaustive_ms / detect_ms << std::endl;
+    }
+
+    return 0;
+  }
+
+  // Normalised candidates of a frame and their distortion correction, as in the detector
+  struct Candidates {
+    explicit Candidates(const cv::Mat& frame) {
+      cv::Mat seg_image, bin_image;
+      std::vector< std::vector< cv::Point > > distorted_contours;
+      std::vector< std::vector< cv::Point2f > > undistorted_contours;
+      segmentation::seg_fused_rgb(frame, seg_image, 0);
+      imageprocessing::filter_image(seg_image, bin_image);
+      imageprocessing::contours_extraction(bin_image, distorted_contours);
+      for (size_t contour_idx = 0; contour_idx < distorted_contours.size(); contour_idx++) {
+        translation_matrix.push_back(cv::Mat::eye(3, 3, CV_32F));
+        rotation_matrix.push_back(cv::Mat::eye(3, 3, CV_32F));
+        scaling_matrix.push_back(cv::Mat::eye(3, 3, CV_32F));
+      }
+      imageprocessing::correction_distortion(distorted_contours, undistorted_contours, translation_matrix, rotation_matrix, scaling_matrix);
+      factor_vector.resize(undistorted_contours.size());
+      initopt::normalise_all_contours(undistorted_contours, normalised_contours, factor_vector);
+    }
+
+    std::vector< std::vector< cv::Point2f > > normalised_contours;
+    std::vector< cv::Mat > translation_matrix, rotation_matrix, scaling_matrix;
+    std::vector< double > factor_vector;
+  };
+
+  /*
+   * Distortion correction of the candidates -- full frame warp per sign type vs ROI warp per contour
+   */
+  int benchmark_warp(const std::string& input_filename) {
+
+    for (const cv::Size& frame_size : frame_sizes) {
+      cv::Mat frame = load_frame(input_filename, frame_size);
+      if (!frame.data) {
+        std::cout << "Error to read the image " << input_filename << std::endl;
+        return -1;
+      }
+
+      const Candidates candidates(frame);
+      const std::vector< std::vector< cv::Point2f > >& normalised_contours = candidates.normalised_contours;
+      const std::vector< cv::Mat >& translation_matrix = candidates.translation_matrix;
+      const std::vector< cv::Mat >& rotation_matrix = candidates.rotation_matrix;
+      const std::vector< cv::Mat >& scaling_matrix = candidates.scaling_matrix;
+      const std::vector< double >& factor_vector = candidates.factor_vector;
+      const size_t n_contours = normalised_contours.size();
+
+      // Reference -- the whole frame is warped for each of the sign types of each contour
+      std::vector< initopt::ContourRegion > regions(n_contours);
+      for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++)
+        initopt::warp_contour_region(frame, translation_matrix[contour_idx], rotation_matrix[contour_idx], scaling_matrix[contour_idx],
+                                     normalised_contours[contour_idx], factor_vector[contour_idx], regions[contour_idx]);
+      std::vector< cv::Mat > full_frame_rois(n_contours);
+      const double full_frame_ms = time_ms([&]() {
+          for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++)
+            for (int sign_type = 0; sign_type < NB_SIGN_TYPES; sign_type++) {
+              const initopt::ContourRegion& region = regions[contour_idx];
+              cv::Mat warp_image;
+              cv::warpPerspective(frame, warp_image, translation_matrix[contour_idx].inv() * rotation_matrix[contour_idx] * scaling_matrix[contour_idx] * translation_matrix[contour_idx],
+                                  frame.size(), cv::INTER_CUBIC, cv::BORDER_REPLICATE);
+              initopt::roi_extraction(warp_image, region.roi, full_frame_rois[contour_idx]);
+            }
+        }, 3);
+
+      const double roi_ms = time_ms([&]() {
+          for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++)
+            initopt::warp_contour_region(frame, translation_matrix[contour_idx], rotation_matrix[contour_idx], scaling_matrix[contour_idx],
+                                         normalised_contours[contour_idx], factor_vector[contour_idx], regions[contour_idx]);
+        }, 3);
+
+      double max_difference = 0.0;
+      for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++)
+        if (full_frame_rois[contour_idx].size() == regions[contour_idx].roi_image.size())
+          max_difference = std::max(max_difference, cv::norm(full_frame_rois[contour_idx], regions[contour_idx].roi_image, cv::NORM_INF));
+        else
+          max_difference = std::numeric_limits<double>::infinity();
+
+      std::cout << std::fixed << std::setprecision(2)
+                << frame_size.width << "x" << frame_size.height << ", " << n_contours << " contours\n"
+                << "  full frame warp per sign type: " << full_frame_ms << " ms\n"
+                << "  ROI warp per contour:          " << roi_ms << " ms, speed-up x" << full_frame_ms / roi_ms << "\n"
+                << "  maximum difference: " << max_difference << std::endl;
+    }
+
+    return 0;
+  }
+
+  /*
+   * Radial symmetry detector of the candidates -- gradients per sign type vs gradient field shared by the sign types
+   */
+  int benchmark_gradients(const std::string& input_filename) {
+
+    // Edges and radius divider of each sign type, as in mass_center_discovery
+    const int edges_number[NB_SIGN_TYPES] = { 3, 4, 12, 8, 3 };
+    const int radius_divider[NB_SIGN_TYPES] = { 1, 1, 1, 1, 2 };
+
+    for (const cv::Size& frame_size : frame_sizes) {
+      cv::Mat frame = load_frame(input_filename, frame_size);
+      if (!frame.data) {
+        std::cout << "Error to read the image " << input_filename << std::endl;
+        return -1;
+      }
+
+      const Candidates candidates(frame);
+      const size_t n_contours = candidates.normalised_contours.size();
+      std::vector< initopt::ContourRegion > regions(n_contours);
+      for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++)
+        initopt::warp_contour_region(frame, candidates.translation_matrix[contour_idx], candidates.rotation_matrix[contour_idx],
+                                     candidates.scaling_matrix[contour_idx], candidates.normalised_contours[contour_idx],
+                                     candidates.factor_vector[contour_idx], regions[contour_idx]);
+
+      std::vector< cv::Point2f > per_type_centers(n_contours * NB_SIGN_TYPES), shared_centers(n_contours * NB_SIGN_TYPES);
+      const double per_type_ms = time_ms([&]() {
+          for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++)
+            for (int sign_type = 0; sign_type < NB_SIGN_TYPES; sign_type++)
+              per_type_centers[contour_idx * NB_SIGN_TYPES + sign_type] = initopt::radial_symmetry_detector(
+                  regions[contour_idx].roi_image, (regions[contour_idx].radius + radius_divider[sign_type] - 1) / radius_divider[sign_type], edges_number[sign_type]);
+        }, 3);
+
+      const double shared_ms = time_ms([&]() {
+          for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++) {
+            initopt::gradient_field(regions[contour_idx].roi_image, regions[contour_idx].gradients);
+            for (int sign_type = 0; sign_type < NB_SIGN_TYPES; sign_type++)
+              shared_centers[contour_idx * NB_SIGN_TYPES + sign_type] = initopt::radial_symmetry_voting(
+                  regions[contour_idx].gradients, (regions[contour_idx].radius + radius_divider[sign_type] - 1) / radius_divider[sign_type], edges_number[sign_type]);
+          }
+        }, 3);
+
+      std::cout << std::fixed << std::setprecision(2)
+                << frame_size.width << "x" << frame_size.height << ", " << n_contours << " contours\n"
+                << "  gradients per sign type:  " << per_type_ms << " ms\n"
+                << "  gradients per contour:    " << shared_ms << " ms, speed-up x" << per_type_ms / shared_ms << "\n"
+                << "  identical centers: " << (per_type_centers == shared_centers ? "yes" : "no") << std::endl;
+    }
+
+    return 0;
+  }
+
+  /*
+   * Gradient field of the radial symmetry detector -- pre-blur and dense 5x5 filters vs separable kernels at each supported level
+   */
+  int benchmark_gradient_field(const std::string& input_filename) {
+
+    std::cout << "Detected SIMD level: " << simd::level_name(simd::detected_level()) << std::endl;
+
+    for (const cv::Size& frame_size : frame_sizes) {
+      cv::Mat frame = load_frame(input_filename, frame_size);
+      if (!frame.data) {
+        std::cout << "Error to read the image " << input_filename << std::endl;
+        return -1;
+      }
+
+      initopt::GradientField dense;
+      const double dense_ms = time_ms([&]() { initopt::gradient_field_dense(frame, dense); });
+
+      std::cout << std::fixed << std::setprecision(2)
+                << frame_size.width << "x" << frame_size.height << "\n"
+                << "  dense:     " << dense_ms << " ms" << std::endl;
+
+      for (int level = simd::LEVEL_SCALAR; level <= simd::detected_level(); level++) {
+        initopt::GradientField separable;
+        const double separable_ms = time_ms([&]() {
+            initopt::gradient_field(frame, separable, static_cast<simd::Level> (level));
+          });
+
+        // Largest difference of the magnitudes kept by both fields, relative to the largest magnitude
+        double max_magnitude = 0.0, max_diff = 0.0;
+        cv::minMaxLoc(dense.magnitude_image, NULL, &max_magnitude);
+        cv::Mat diff;
+        cv::absdiff(dense.magnitude_image, separable.magnitude_image, diff);
+        cv::minMaxLoc(diff, NULL, &max_diff, NULL, NULL, (dense.magnitude_image != 0) & (separable.magnitude_image != 0));
+
+        std::cout << "  " << std::setw(9) << std::left << simd::level_name(static_cast<simd::Level> (level)) << std::right << ": "
+                  << separable_ms << " ms, speed-up x" << dense_ms / separable_ms
+                  << std::setprecision(5) << ", max relative difference " << max_diff / max_magnitude << std::setprecision(2) << std::endl;
+      }
+    }
+
+    return 0;
+  }
+
+  /*
+   * Voting of the radial symmetry detector -- full size images vs list of the edge pixels
+   */
+  int benchmark_voting(const std::string& input_filename) {
+
+    for (const cv::Size& frame_size : frame_sizes) {
+      cv::Mat frame = load_frame(input_filename, frame_size);
+      if (!frame.data) {
+        std::cout << "Error to read the image " << input_filename << std::endl;
+        return -1;
+      }
+
+      initopt::GradientField field;
+      initopt::gradient_field(frame, field);
+      const int n_edges = cv::countNonZero(field.magnitude_image);
+
+      std::cout << frame_size.width << "x" << frame_size.height << ", " << n_edges << " edge pixels ("
+                << std::fixed << std::setprecision(2) << 100.0 * n_edges / field.magnitude_image.total() << "%)" << std::endl;
+
+      // Mid-size shapes, as in the scaling stage
+      for (const int edges_number : { 3, 4, 8, 12 }) {
+        cv::Mat gradient_vp_x, gradient_vp_y, gradient_bar_x, gradient_bar_y;
+        initopt::orientations_from_gradient(field.gradient_x, field.gradient_y, edges_number, gradient_vp_x, gradient_vp_y, gradient_bar_x, gradient_bar_y);
+
+        cv::Point2f dense_center, sparse_center;
+        const double dense_ms = time_ms([&]() {
+            dense_center = initopt::mass_center_by_voting_dense(field.magnitude_image, field.gradient_x, field.gradient_y, gradient_bar_x, gradient_bar_y,
+                                                                gradient_vp_x, gradient_vp_y, 32.0f, edges_number);
+          }, 3);
+        const double sparse_ms = time_ms([&]() {
+            sparse_center = initopt::mass_center_by_voting(field.magnitude_image, field.gradient_x, field.gradient_y, gradient_bar_x, gradient_bar_y,
+                                                           gradient_vp_x, gradient_vp_y, 32.0f, edges_number);
+          }, 3);
+
+        std::cout << "  " << std::setw(2) << edges_number << " edges: dense " << dense_ms << " ms, sparse " << sparse_ms
+                  << " ms, speed-up x" << dense_ms / sparse_ms << ", identical " << (dense_center == sparse_center ? "yes" : "no") << std::endl;
+      }
+    }
+
+    return 0;
+  }
+
+  /*
+   * Orientations of the radial symmetry detector -- atan2, cos and sin per pixel vs complex powers at each supported level
+   */
+  int benchmark_orientations(const std::string& input_filename) {
+
+    std::cout << "Detected SIMD level: " << simd::level_name(simd::detected_level()) << std::endl;
+
+    for (const cv::Size& frame_size : frame_sizes) {
+      cv::Mat frame = load_frame(input_filename, frame_size);
+      if (!frame.data) {
+        std::cout << "Error to read the image " << input_filename << std::endl;
+        return -1;
+      }
+
+      initopt::GradientField field;
+      initopt::gradient_field(frame, field);
+      std::cout << frame_size.width << "x" << frame_size.height << std::endl;
+
+      for (const int edges_number : { 3, 4, 8, 12 }) {
+        cv::Mat reference_vp_x, reference_vp_y, reference_bar_x, reference_bar_y;
+        const double trig_ms = time_ms([&]() {
+            initopt::orientations_from_gradient_trig(field.gradient_x, field.gradient_y, edges_number, reference_vp_x, reference_vp_y, reference_bar_x, reference_bar_y);
+          });
+        std::cout << std::fixed << std::setprecision(2) << "  " << std::setw(2) << edges_number << " edges, trig: " << trig_ms << " ms" << std::endl;
+
+        for (int level = simd::LEVEL_SCALAR; level <= simd::detected_level(); level++) {
+          cv::Mat gradient_vp_x, gradient_vp_y, gradient_bar_x, gradient_bar_y;
+          const double power_ms = time_ms([&]() {
+              initopt::orientations_from_gradient(field.gradient_x, field.gradient_y, edges_number, gradient_vp_x, gradient_vp_y, gradient_bar_x, gradient_bar_y,
+                                                  static_cast<simd::Level> (level));
+            });
+          const double max_diff = std::max(cv::norm(reference_vp_x, gradient_vp_x, cv::NORM_INF), cv::norm(reference_vp_y, gradient_vp_y, cv::NORM_INF));
+
+          std::cout << "    " << std::setw(9) << std::left << simd::level_name(static_cast<simd::Level> (level)) << std::right << ": "
+                    << power_ms << " ms, speed-up x" << trig_ms / power_ms << std::scientific << std::setprecision(1)
+                    << ", max difference " << max_diff << std::fixed << std::setprecision(2) << std::endl;
+        }
+      }
+    }
+
+    return 0;
+  }
+
+  /*
+   * Voting of the radial symmetry detector for the candidates -- one sweep per sign type vs one sweep per contour
+   */
+  int benchmark_multi_voting(const std::string& input_filename) {
+
+    for (const cv::Size& frame_size : frame_sizes) {
+      cv::Mat frame = load_frame(input_filename, frame_size);
+      if (!frame.data) {
+        std::cout << "Error to read the image " << input_filename << std::endl;
+        return -1;
+      }
+
+      const Candidates candidates(frame);
+      const size_t n_contours = candidates.normalised_contours.size();
+      std::vector< initopt::ContourRegion > regions(n_contours);
+      for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++)
+        initopt::prepare_contour_region(frame, candidates.translation_matrix[contour_idx], candidates.rotation_matrix[contour_idx],
+                                        candidates.scaling_matrix[contour_idx], candidates.normalised_contours[contour_idx],
+                                        candidates.factor_vector[contour_idx], regions[contour_idx]);
+
+      std::vector< int > sign_types(NB_SIGN_TYPES);
+      for (int sign_type = 0; sign_type < NB_SIGN_TYPES; sign_type++)
+        sign_types[sign_type] = sign_type;
+
+      std::vector< cv::Point2f > per_type_centers(n_contours * NB_SIGN_TYPES), single_sweep_centers;
+      const double per_type_ms = time_ms([&]() {
+          for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++)
+            for (int sign_type = 0; sign_type < NB_SIGN_TYPES; sign_type++) {
+              const initopt::SymmetryHypothesis hypothesis = initopt::sign_type_hypothesis(regions[contour_idx].radius, sign_type);
+              per_type_centers[contour_idx * NB_SIGN_TYPES + sign_type] = initopt::radial_symmetry_voting(
+                  regions[contour_idx].gradients, hypothesis.radius, hypothesis.edges_number);
+            }
+        }, 3);
+
+      const double single_sweep_ms = time_ms([&]() {
+          for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++)
+            initopt::vote_mass_centers(regions[contour_idx], sign_types);
+        }, 3);
+      for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++)
+        single_sweep_centers.insert(single_sweep_centers.end(), regions[contour_idx].voted_centers.begin(), regions[contour_idx].voted_centers.end());
+
+      // NaN centers, i.e. regions without edge pixels, compare as identical
+      bool identical = true;
+      for (size_t k = 0; k < per_type_centers.size(); k++)
+        identical = identical && (std::memcmp(&per_type_centers[k], &single_sweep_centers[k], sizeof(cv::Point2f)) == 0);
+
+      std::cout << std::fixed << std::setprecision(2)
+                << frame_size.width << "x" << frame_size.height << ", " << n_contours << " contours\n"
+                << "  one sweep per sign type:  " << per_type_ms << " ms\n"
+                << "  one sweep per contour:    " << single_sweep_ms << " ms, speed-up x" << per_type_ms / single_sweep_ms << "\n"
+                << "  identical centers: " << (identical ? "yes" : "no") << std::endl;
+    }
+
+    return 0;
+  }
+
+  /*
+   * Voting of the radial symmetry detector on synthetic near-field ROIs, then regions stage of the detector over the images next
+   * to the input image -- ordered votes vs private accumulators on 1 to N threads
+   */
+  int benchmark_voting_threads(const std::string& input_filename) {
+
+    const int max_threads = std::max(1, static_cast<int> (std::thread::hardware_concurrency()));
+    const initopt::VoteAccumulation accumulations[] = { initopt::VOTES_ORDERED, initopt::VOTES_PRIVATE_FLOAT, initopt::VOTES_PRIVATE_INTEGER };
+    const char* accumulation_names[] = { "ordered", "private float", "private integer" };
+
+    for (const int roi_size : { 200, 400, 600 }) {
+      // Octagon filling the ROI, as a near-field stop sign
+      const int radius = roi_size * 3 / 8;
+      cv::Mat roi_image(roi_size, roi_size, CV_8UC3, cv::Scalar(128, 128, 128));
+      std::vector< cv::Point > octagon;
+      fixtures::draw_octagon(roi_image, cv::Point2d(roi_size / 2, roi_size / 2), radius, octagon);
+
+      initopt::GradientField field;
+      initopt::gradient_field(roi_image, field);
+      std::cout << roi_size << "x" << roi_size << " ROI, radius " << radius << ", " << cv::countNonZero(field.magnitude_image) << " edge pixels\n"
+                << "  threads  ordered(ms)  private float(ms)  private integer(ms)" << std::endl;
+
+      double ordered_serial_ms = 0.0;
+      cv::Point2f serial_centers[3];
+      bool identical[3] = { true, true, true };
+      for (int n_threads = 1; n_threads <= max_threads; n_threads++) {
+        parallel::set_num_threads(n_threads);
+
+        std::cout << "  " << std::setw(7) << n_threads;
+        for (int mode = 0; mode < 3; mode++) {
+          cv::Point2f center;
+          const double voting_ms = time_ms([&]() { center = initopt::radial_symmetry_voting(field, radius, 8, accumulations[mode]); }, 3);
+          if (n_threads == 1) {
+            serial_centers[mode] = center;
+            if (mode == 0)
+              ordered_serial_ms = voting_ms;
+          }
+          identical[mode] = identical[mode] && (serial_centers[mode] == center);
+          std::cout << std::fixed << std::setprecision(2) << std::setw(mode == 0 ? 13 : 19) << voting_ms
+                    << " (x" << ordered_serial_ms / voting_ms << ")";
+        }
+        std::cout << std::endl;
+      }
+
+      for (int mode = 0; mode < 3; mode++)
+        std::cout << "  " << accumulation_names[mode] << ": center (" << serial_centers[mode].x << ", " << serial_centers[mode].y
+                  << "), identical to serial " << (identical[mode] ? "yes" : "no") << std::endl;
+    }
+
+    // Regions stage of the detector over the images next to the input image, with each accumulation
+    const std::string directory = input_filename.substr(0, input_filename.find_last_of('/') + 1);
+    std::vector< std::string > filenames;
+    cv::glob(directory + "*.jpg", filenames);
+    std::cout << "Detector over " << filenames.size() << " images of " << directory << "\n"
+              << "  threads  ordered regions/detect(ms)  private float regions/detect(ms)  private integer regions/detect(ms)" << std::endl;
+    for (int n_threads = 1; n_threads <= max_threads; n_threads++) {
+      parallel::set_num_threads(n_threads);
+
+      std::cout << "  " << std::setw(7) << n_threads;
+      for (int mode = 0; mode < 3; mode++) {
+        detection::TrafficSignDetector detector;
+        detector.set_vote_accumulation(accumulations[mode]);
+        std::vector< detection::Detection > detections;
+        double regions_ms = 0.0, detect_ms = 0.0;
+        for (const std::string& filename : filenames) {
+          const cv::Mat image = cv::imread(filename);
+          if (!image.data)
+            continue;
+          detect_ms += time_ms([&]() { detector.detect(image, detections); }, 1);
+          regions_ms += detector.regions_ms();
+        }
+        std::cout << std::fixed << std::setprecision(2) << std::setw(mode == 0 ? 18 : 24) << regions_ms << " / " << detect_ms;
+      }
+      std::cout << std::endl;
+    }
+
+    parallel::set_num_threads(0);
+    return 0;
+  }
+
+  /*
+   * Regions of the candidates on the images next to the input image -- ROI warp then gradients vs gradients of the
+   * original pixels mapped through the correction
+   */
+  int benchmark_warp_free(const std::string& input_filename) {
+
+    const std::string directory = input_filename.substr(0, input_filename.find_last_of('/') + 1);
+    std::vector< std::string > filenames;
+    cv::glob(directory + "*.jpg", filenames);
+    if (filenames.empty()) {
+      std::cout << "No image in " << directory << std::endl;
+      return -1;
+    }
+
+    std::vector< int > sign_types(NB_SIGN_TYPES);
+    for (int sign_type = 0; sign_type < NB_SIGN_TYPES; sign_type++)
+      sign_types[sign_type] = sign_type;
+
+    // Regions and mass centers of every sign type of every candidate
+    double warp_ms = 0.0, warp_free_ms = 0.0, sum_distance = 0.0, max_distance = 0.0;
+    int n_images = 0, n_contours = 0, n_centers = 0, n_within_1 = 0, n_within_2 = 0;
+    for (const std::string& filename : filenames) {
+      const cv::Mat image = cv::imread(filename);
+      if (!image.data)
+        continue;
+      n_images++;
+
+      const Candidates candidates(image);
+      const size_t n_image_contours = candidates.normalised_contours.size();
+      std::vector< initopt::ContourRegion > warped(n_image_contours), warp_free(n_image_contours);
+      warp_ms += time_ms([&]() {
+          for (size_t contour_idx = 0; contour_idx < n_image_contours; contour_idx++) {
+            initopt::prepare_contour_region(image, candidates.translation_matrix[contour_idx], candidates.rotation_matrix[contour_idx],
+                                            candidates.scaling_matrix[contour_idx], candidates.normalised_contours[contour_idx],
+                                            candidates.factor_vector[contour_idx], warped[contour_idx]);
+            initopt::vote_mass_centers(warped[contour_idx], sign_types);
+          }
+        }, 3);
+      warp_free_ms += time_ms([&]() {
+          for (size_t contour_idx = 0; contour_idx < n_image_contours; contour_idx++) {
+            initopt::prepare_contour_region_warp_free(image, candidates.translation_matrix[contour_idx], candidates.rotation_matrix[contour_idx],
+                                                      candidates.scaling_matrix[contour_idx], candidates.normalised_contours[contour_idx],
+                                                      candidates.factor_vector[contour_idx], warp_free[contour_idx]);
+            initopt::vote_mass_centers(warp_free[contour_idx], sign_types);
+          }
+        }, 3);
+
+      // Distance between the centers, in pixels of the corrected image -- the regions without edge pixel are skipped
+      for (size_t contour_idx = 0; contour_idx < n_image_contours; contour_idx++) {
+        n_contours++;
+        for (int sign_type = 0; sign_type < NB_SIGN_TYPES; sign_type++) {
+          const cv::Point2f difference = warped[contour_idx].voted_centers[sign_type] - warp_free[contour_idx].voted_centers[sign_type];
+          const double distance = std::sqrt(difference.dot(difference));
+          if (std::isnan(distance))
+            continue;
+          n_centers++;
+          sum_distance += distance;
+          max_distance = std::max(max_distance, distance);
+          n_within_1 += distance <= 1.0;
+          n_within_2 += distance <= 2.0;
+        }
+      }
+    }
+
+    // Detections of the whole pipeline with both regions
+    detection::TrafficSignDetector warp_detector, warp_free_detector;
+    warp_free_detector.set_warp_free_regions(true);
+    std::vector< detection::Detection > warp_detections, warp_free_detections;
+    double warp_regions_ms = 0.0, warp_free_regions_ms = 0.0;
+    int n_signs = 0, n_same_type = 0;
+    for (const std::string& filename : filenames) {
+      const cv::Mat image = cv::imread(filename);
+      if (!image.data)
+        continue;
+
+      warp_detector.detect(image, warp_detections);
+      warp_regions_ms += warp_detector.regions_ms();
+      warp_free_detector.detect(image, warp_free_detections);
+      warp_free_regions_ms += warp_free_detector.regions_ms();
+      n_signs += static_cast<int> (warp_detections.size());
+      for (size_t k = 0; k < warp_detections.size() && k < warp_free_detections.size(); k++)
+        n_same_type += warp_detections[k].sign_type == warp_free_detections[k].sign_type;
+    }
+
+    std::cout << std::fixed << std::setprecision(2)
+              << n_images << " images, " << n_contours << " candidates, " << n_centers << " mass centers\n"
+              << "  ROI warp:  " << warp_ms << " ms\n"
+              << "  warp free: " << warp_free_ms << " ms, speed-up x" << warp_ms / warp_free_ms << "\n"
+              << "  center distance: mean " << (n_centers ? sum_distance / n_centers : 0.0) << " px, max " << max_distance
+              << " px, within 1 px " << n_within_1 << "/" << n_centers << ", within 2 px " << n_within_2 << "/" << n_centers << "\n"
+              << "  detector regions: ROI warp " << warp_regions_ms << " ms, warp free " << warp_free_regions_ms << " ms\n"
+              << "  same sign type:   " << n_same_type << "/" << n_signs << std::endl;
+
+    return 0;
+  }
+
+  /*
+   * Contour extraction of the candidates on the input image at each frame size, cluttered or not, and on the images
+   * next to it -- contours traced for every object vs labelled components filtered on their statistics before the tracing
+   */
+  int benchmark_components(const std::string& input_filename) {
+
+    std::vector< std::pair< std::string, cv::Mat > > bin_images;
+    for (const cv::Size& frame_size : frame_sizes) {
+      cv::Mat frame = load_frame(input_filename, frame_size);
+      if (!frame.data) {
+        std::cout << "Error to read the image " << input_filename << std::endl;
+        return -1;
+      }
+      cv::Mat seg_image, bin_image;
+      segmentation::seg_fused_rgb(frame, seg_image, 0);
+      imageprocessing::filter_image(seg_image, bin_image);
+      const std::string label = std::to_string(frame_size.width) + "x" + std::to_string(frame_size.height);
+      bin_images.push_back(std::make_pair(label, bin_image));
+
+      // Cluttered frame -- hundreds of small objects and a few ones passing the checks
+      cv::Mat cluttered = bin_image.clone();
+      cv::RNG rng(11);
+      for (int k = 0; k < 800; k++) {
+        const cv::Point center(rng.uniform(0, frame_size.width), rng.uniform(0, frame_size.height));
+        cv::circle(cluttered, center, rng.uniform(2, (k % 20 == 0) ? 80 : 12), cv::Scalar(255), -1);
+      }
+      bin_images.push_back(std::make_pair(label + " cluttered", cluttered));
+    }
+
+    // Frames of the input directory at their own size
+    const size_t n_synthetic = bin_images.size();
+    const std::string directory = input_filename.substr(0, input_filename.find_last_of('/') + 1);
+    std::vector< std::string > filenames;
+    cv::glob(directory + "*.jpg", filenames);
+    for (const std::string& filename : filenames) {
+      const cv::Mat frame = cv::imread(filename);
+      if (!frame.data)
+        continue;
+      cv::Mat seg_image, bin_image;
+      segmentation::seg_fused_rgb(frame, seg_image, 0);
+      imageprocessing::filter_image(seg_image, bin_image);
+      bin_images.push_back(std::make_pair(filename.substr(directory.size()), bin_image));
+    }
+
+    // Totals over the synthetic cluttered frames and over the frames of the directory
+    double cluttered_traced_ms = 0.0, cluttered_labelled_ms = 0.0, directory_traced_ms = 0.0, directory_labelled_ms = 0.0;
+    bool all_same = true;
+    for (size_t image_idx = 0; image_idx < bin_images.size(); image_idx++) {
+      const cv::Mat& bin_image = bin_images[image_idx].second;
+      imageprocessing::ComponentLabels labels;
+      imageprocessing::label_components(bin_image, labels);
+
+      // The reference overwrites its input, each of its runs -- the warm up included -- gets a copy of the binary
+      // image made before the timing. The labelled extraction leaves the image untouched.
+      const int repetitions = 10;
+      std::vector< cv::Mat > traced_inputs(repetitions + 1);
+      for (cv::Mat& input : traced_inputs)
+        input = bin_image.clone();
+      std::vector< std::vector< cv::Point > > traced_contours, labelled_contours;
+      size_t traced_run = 0;
+      const double traced_ms = time_ms([&]() {
+          imageprocessing::contours_extraction_traced(traced_inputs[traced_run++], traced_contours);
+        }, repetitions);
+      const double labelled_ms = time_ms([&]() {
+          imageprocessing::contours_extraction(bin_image, labelled_contours);
+        }, repetitions);
+      const bool same = traced_contours == labelled_contours;
+      all_same = all_same && same;
+      if (image_idx >= n_synthetic) {
+        directory_traced_ms += traced_ms;
+        directory_labelled_ms += labelled_ms;
+      } else if (image_idx % 2 == 1) {
+        cluttered_traced_ms += traced_ms;
+        cluttered_labelled_ms += labelled_ms;
+      }
+
+      std::cout << std::fixed << std::setprecision(2)
+                << bin_images[image_idx].first << ": " << labels.stats.size() << " objects, " << traced_contours.size() << " contours\n"
+                << "  traced:   " << traced_ms << " ms\n"
+                << "  labelled: " << labelled_ms << " ms, speed-up x" << traced_ms / labelled_ms
+                << ", same contours " << (same ? "yes" : "no") << std::endl;
+    }
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "Cluttered frames: traced " << cluttered_traced_ms << " ms, labelled " << cluttered_labelled_ms
+              << " ms, speed-up x" << cluttered_traced_ms / cluttered_labelled_ms << "\n"
+              << filenames.size() << " frames of " << directory << ": traced " << directory_traced_ms << " ms, labelled "
+              << directory_labelled_ms << " ms, speed-up x" << directory_traced_ms / directory_labelled_ms << "\n"
+              << "Same contours on every frame: " << (all_same ? "yes" : "no") << std::endl;
+
+    return 0;
+  }
+
+  struct BenchmarkStage {
+    const char* name;
+    const char* description;
+    int (*run)(const std::string& input_filename);
+  };
+
+  const BenchmarkStage stages[] = {
+    { "segmentation", "colour conversion and segmentation, multi pass vs fused kernel", benchmark_segmentation },
+    { "ihls", "RGB to IHLS conversion, reference vs SIMD kernels", benchmark_ihls },
+    { "hue", "normalised hue segmentation, IHLS thresholds vs trig-free predicate", benchmark_hue },
+    { "cascade", "normalised hue segmentation, IHLS thresholds vs saturation first cascade", benchmark_cascade },
+    { "log_chromatic", "log chromatic stage, std::log vs lookup table vs threshold bits", benchmark_log_chromatic },
+    { "scaling", "full-frame stages on 1 to N threads", benchmark_scaling },
+    { "supershape", "supershape radius derivatives, finite differences vs closed form", benchmark_supershape },
+    { "xisquare", "8D chi-square of a contour, XiSquare<8> vs the batched evaluation", benchmark_xisquare },
+    { "bound", "LM iterations over the images of the input directory, exhaustive search vs branch and bound", benchmark_bound },
+    { "preclassifier", "recall and latency of the top k sign types of the shape pre-classifier over the input directory", benchmark_preclassifier },
+    { "warp", "distortion correction of the candidates, full frame warp per sign type vs ROI warp per contour", benchmark_warp },
+    { "gradients", "radial symmetry of the candidates, gradients per sign type vs per contour", benchmark_gradients },
+    { "gradient_field", "gradient field of the radial symmetry detector, dense filters vs separable SIMD kernels", benchmark_gradient_field },
+    { "voting", "voting of the radial symmetry detector, full size images vs list of the edge pixels", benchmark_voting },
+    { "orientations", "vote directions of the radial symmetry detector, trigonometry vs complex powers", benchmark_orientations },
+    { "voting_threads", "voting of the radial symmetry detector on synthetic large ROIs and regions stage of the detector over the input directory, ordered votes vs private accumulators on 1 to N threads", benchmark_voting_threads },
+    { "multi_voting", "voting of the radial symmetry detector for the 5 sign types, one sweep per sign type vs per contour", benchmark_multi_voting },
+    { "warp_free", "regions of the candidates over the input directory, ROI warp vs gradients mapped through the correction", benchmark_warp_free },
+    { "components", "contour extraction of the candidates, synthetic cluttered frames and input directory, contours traced for every object vs labelled components filtered before the tracing", benchmark_components },
+    { "warmstart", "per-sign fitting latency, independent frames vs warm started video mode", benchmark_warm_start },
+  };
+
+}
+
+int main(int argc, char *argv[]) {
+
+  // Check the number of arguments
+  if (argc < 2 || argc > 3) {
+    std::cout << "********************************" << std::endl;
+    std::cout << "Usage of the code: ./benchmark stage [imageFileName.extension]" << std::endl;
+    for (const BenchmarkStage& stage : stages)
+      std::cout << "  " << stage.name << ": " << stage.description << std::endl;
+    std::cout << "********************************" << std::endl;
+
+    return -1;
+  }
+
+  std::string input_filename(TEST_DATA_DIR);
+  input_filename.append("/circular0009.jpg");
+  if (argc == 3)
+    input_filename = argv[2];
+
+  for (const BenchmarkStage& stage : stages)
+    if (std::strcmp(stage.name, argv[1]) == 0)
+      return stage.run(input_filename);
+
+  std::cout << "Unknown stage " << argv[1] << std::endl;
+  return -1;
+}
@@ -41,39 +41,90 @@
 // the use of this software, even if advised of the possibility of such damage.
 
 // our own code
-#include <common/segmentation.h>
-#include <common/colorConversion.h>
-#include <common/imageProcessing.h>
-#include <common/smartOptimisation.h>
-#include <common/math_utils.h>
-#include <common/timer.h>
+#include <common/trafficSignDetector.h>
 
 // stl library
 #include <string>
 #include <iostream>
 #include <chrono>
 #include <ctime>
-#include <limits>
+#include <cmath>
 
 // OpenCV library
 #include <opencv2/opencv.hpp>
 
-// Eigen library
-#include <Eigen/Core>
 
+// Convert the detected contours to cv::Point to draw them
+static void detections_to_points(const std::vector< detection::Detection >& detections, std::vector< std::vector< cv::Point > >& detected_signs) {
+
+    detected_signs.resize(detections.size());
+    for (unsigned int contour_idx = 0; contour_idx < detections.size(); contour_idx++) {
+        const std::vector< cv::Point2f >& contour = detections[contour_idx].contour;
+        detected_signs[contour_idx].resize(contour.size());
+        for (unsigned int i = 0; i < contour.size(); i++) {
+            detected_signs[contour_idx][i].x = (int) std::round(contour[i].x);
+            detected_signs[contour_idx][i].y = (int) std::round(contour[i].y);
+        }
+    }
+}
+
+// Detection on a video -- the fits of a frame are warm started from the signs of the previous frame
+static int run_video(const std::string& input_filename, const int nhs_mode) {
+
+    cv::VideoCapture capture(input_filename);
+    if (!capture.isOpened()) {
+        std::cout << "Error to read the video. Check ''cv::VideoCapture'' of OpenCV" << std::endl;
+        return -1;
+    }
+
+    detection::TrafficSignDetector detector(nhs_mode);
+    detector.set_video_mode(true);
+
+    cv::Mat frame, output_image;
+    std::vector< detection::Detection > detections;
+    std::vector< std::vector< cv::Point > > detected_signs;
+    cv::namedWindow("Window", CV_WINDOW_AUTOSIZE);
+    for (int frame_idx = 0; capture.read(frame); frame_idx++) {
+
+        std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+        detector.detect(frame, detections);
+        const std::chrono::duration<double> elapsed_seconds = std::chrono::steady_clock::now() - start;
+
+        int n_warm_started = 0;
+        for (unsigned int contour_idx = 0; contour_idx < detections.size(); contour_idx++)
+            n_warm_started += detections[contour_idx].warm_started;
+        std::cout << "Frame #" << frame_idx << ": " << detections.size() << " signs, " << n_warm_started
+                  << " warm started, " << elapsed_seconds.count()*1000 << " ms" << std::endl;
+
+        output_image = frame.clone();
+        detections_to_points(detections, detected_signs);
+        cv::drawContours(output_image, detected_signs, -1, cv::Scalar(0,255,0), 2, 8);
+        cv::imshow("Window", output_image);
+        if (cv::waitKey(1) >= 0)
+            break;
+    }
+
+    return 0;
+}
 
-//TODO: code here should be abstracted outside the app, modify tests accordingly
 int main(int argc, char *argv[]) {
 
     // Chec the number of arguments
-    if (argc != 2) {
+    const bool video = argc == 3 && std::string(argv[1]) == "--video";
+    if (argc != 2 && !video) {
         std::cout << "********************************" << std::endl;
         std::cout << "Usage of the code: ./traffic-sign-detection imageFileName.extension" << std::endl;
+        std::cout << "                   ./traffic-sign-detection --video videoFileName.extension" << std::endl;
         std::cout << "********************************" << std::endl;
 
         return -1;
     }
 
+    // ONE PARAMETER TO CONSIDER - COLOR OF THE TRAFFIC SIGN TO DETECT - RED VS BLUE
+    int nhs_mode = 0; // nhs_mode == 0 -> red segmentation / nhs_mode == 1 -> blue segmentation
+    if (video)
+        return run_video(argv[2], nhs_mode);
+
     // Clock for measuring the elapsed time
     std::chrono::time_point<std::chrono::system_clock> start, end;
     start = std::chrono::system_clock::now();
@@ -92,184 +143,26 @@ int main(int argc, char *argv[]) {
     // Check that the image read is a 3 channels image
     CV_Assert(input_image.channels() == 3);
 
-
-    /*
-   * Conversion of the image in some specific color space
-   */
-
-    // Conversion of the rgb image in ihls color space
-    cv::Mat ihls_image;
-    colorconversion::convert_rgb_to_ihls(input_image, ihls_image);
-    // Conversion from RGB to logarithmic chromatic red and blue
-    std::vector< cv::Mat > log_image;
-    colorconversion::rgb_to_log_rb(input_image, log_image);
-
-    /*
-   * Segmentation of the image using the previous transformation
-   */
-
-    // Segmentation of the IHLS and more precisely of the normalised hue channel
-    // ONE PARAMETER TO CONSIDER - COLOR OF THE TRAFFIC SIGN TO DETECT - RED VS BLUE
-    int nhs_mode = 0; // nhs_mode == 0 -> red segmentation / nhs_mode == 1 -> blue segmentation
-    cv::Mat nhs_image_seg_red;
-
-    segmentation::seg_norm_hue(ihls_image, nhs_image_seg_red, nhs_mode);
-    //nhs_mode = 1; // nhs_mode == 0 -> red segmentation / nhs_mode == 1 -> blue segmentation
-    //cv::Mat nhs_image_seg_blue;
-    cv::Mat nhs_image_seg_blue = nhs_image_seg_red.clone();
-    //segmentation::seg_norm_hue(ihls_image, nhs_image_seg_blue, nhs_mode);
-    // Segmentation of the log chromatic image
+    // Segmentation, filtering, contour extraction and Gielis fitting of the candidates
     // TODO - DEFINE THE THRESHOLD FOR THE BLUE TRAFFIC SIGN. FOR NOW WE AVOID THE PROCESSING FOR BLUE SIGN AND LET ONLY THE OTHER METHOD TO TAKE CARE OF IT.
-    cv::Mat log_image_seg;
-    segmentation::seg_log_chromatic(log_image, log_image_seg);
-
-    /*
-   * Merging and filtering of the previous segmentation
-   */
-
-    // Merge the results of previous segmentation using an OR operator
-    // Pre-allocation of an image by cloning a previous image
-    cv::Mat merge_image_seg_with_red = nhs_image_seg_red.clone();
-    cv::Mat merge_image_seg = nhs_image_seg_blue.clone();
-    cv::bitwise_or(nhs_image_seg_red, log_image_seg, merge_image_seg_with_red);
-    cv::bitwise_or(nhs_image_seg_blue, merge_image_seg_with_red, merge_image_seg);
-
-    // Filter the image using median filtering and morpho math
-    cv::Mat bin_image;
-    imageprocessing::filter_image(merge_image_seg, bin_image);
-
-
-    cv::imwrite("seg.jpg", bin_image);
-
-    /*
-   * Extract candidates (i.e., contours) and remove inconsistent candidates
-   */
-
-    std::vector< std::vector< cv::Point > > distorted_contours;
-    imageprocessing::contours_extraction(bin_image, distorted_contours);
-
-    /*
-   * Correct the distortion for each contour
-   */
-
-    // Initialisation of the variables which will be returned after the distortion. These variables are linked with the transformation applied to correct the distortion
-    std::vector< cv::Mat > rotation_matrix(distorted_contours.size());
-    std::vector< cv::Mat > scaling_matrix(distorted_contours.size());
-    std::vector< cv::Mat > translation_matrix(distorted_contours.size());
-    for (unsigned int contour_idx = 0; contour_idx < distorted_contours.size(); contour_idx++) {
-        rotation_matrix[contour_idx] = cv::Mat::eye(3, 3, CV_32F);
-        scaling_matrix[contour_idx] = cv::Mat::eye(3, 3, CV_32F);
-        translation_matrix[contour_idx] = cv::Mat::eye(3, 3, CV_32F);
-    }
-
-    // Correct the distortion
-    std::vector< std::vector< cv::Point2f > > undistorted_contours;
-    imageprocessing::correction_distortion(distorted_contours, undistorted_contours, translation_matrix, rotation_matrix, scaling_matrix);
-
-    // Normalise the contours to be inside a unit circle
-    std::vector<double> factor_vector(undistorted_contours.size());
-    std::vector< std::vector< cv::Point2f > > normalised_contours;
-    initopt::normalise_all_contours(undistorted_contours, normalised_contours, factor_vector);
-
-    std::vector< std::vector< cv::Point2f > > detected_signs_2f(normalised_contours.size());
-    std::vector< std::vector< cv::Point > > detected_signs(normalised_contours.size());
-
-    // For each contours
-    for (unsigned int contour_idx = 0; contour_idx < normalised_contours.size(); contour_idx++) {
-
-        // For each type of traffic sign
-        /*
-     * sign_type = 0 -> nb_edges = 3;  gielis_sym = 6; radius
-     * sign_type = 1 -> nb_edges = 4;  gielis_sym = 4; radius
-     * sign_type = 2 -> nb_edges = 12; gielis_sym = 4; radius
-     * sign_type = 3 -> nb_edges = 8;  gielis_sym = 8; radius
-     * sign_type = 4 -> nb_edges = 3;  gielis_sym = 6; radius / 2
-     */
-
-        Timer tmrSgnType("For signType");
-        optimisation::ConfigStruct_<double> final_config;
-        double best_fit = std::numeric_limits<double>::infinity();
-        //int type_sign_to_keep = 0;
-        for (int sign_type = 0; sign_type < 5; sign_type++) {
-            Timer tmrIteration(" for_signType_iter");
-
-            // Check the center mass for a contour
-            cv::Point2f mass_center = initopt::mass_center_discovery(input_image, translation_matrix[contour_idx],
-                                                                     rotation_matrix[contour_idx], scaling_matrix[contour_idx],
-                                                                     normalised_contours[contour_idx], factor_vector[contour_idx],
-                                                                     sign_type);
-
-            // Find the rotation offset
-            double rot_offset = initopt::rotation_offset(normalised_contours[contour_idx]);
-
-            // Declaration of the parameters of the gielis with the default parameters
-            optimisation::ConfigStruct_<double> contour_config;
-            // Set the number of symmetry
-            int gielis_symmetry = 0;
-            switch (sign_type) {
-            case 0:
-                gielis_symmetry = 6;
-                break;
-            case 1:
-                gielis_symmetry = 4;
-                break;
-            case 2:
-                gielis_symmetry = 4;
-                break;
-            case 3:
-                gielis_symmetry = 8;
-                break;
-            case 4:
-                gielis_symmetry = 6;
-                break;
-            }
-            contour_config.p = gielis_symmetry;
-            // Set the rotation matrix
-            contour_config.theta_offset = rot_offset;
-            // Set the mass center
-            contour_config.x_offset = mass_center.x;
-            contour_config.y_offset = mass_center.y;
-
-            Timer tmrOpt("\t for_signType_gielisOptimization");
-            // Go for the optimisation
-            Eigen::Vector4d mean_err(0,0,0,0), std_err(0,0,0,0);
-            optimisation::gielis_optimisation(normalised_contours[contour_idx], contour_config, mean_err, std_err);
-
-            mean_err = mean_err.cwiseAbs();
-            double err_fit = mean_err.sum();
-
-            if (err_fit < best_fit) {
-                best_fit = err_fit;
-                final_config = contour_config;
-                //type_sign_to_keep = sign_type;
-            }
-        }
-
-        Timer tmr2("Reconstruct contour");
-
-        // Reconstruct the contour
-        std::cout << "Contour #" << contour_idx << ":\n" << final_config << std::endl;
-        std::vector< cv::Point2f > gielis_contour;
-        int nb_points = 1000;
-        optimisation::gielis_reconstruction(final_config, gielis_contour, nb_points);
-        std::vector< cv::Point2f > denormalised_gielis_contour;
-        initopt::denormalise_contour(gielis_contour, denormalised_gielis_contour, factor_vector[contour_idx]);
-        std::vector< cv::Point2f > distorted_gielis_contour;
-        imageprocessing::inverse_transformation_contour(denormalised_gielis_contour, distorted_gielis_contour,
-                                                        translation_matrix[contour_idx], rotation_matrix[contour_idx],
-                                                        scaling_matrix[contour_idx]);
-
-        // Transform to cv::Point to show the results
-        std::vector< cv::Point > distorted_gielis_contour_int(distorted_gielis_contour.size());
-        for (unsigned int i = 0; i < distorted_gielis_contour.size(); i++) {
-            distorted_gielis_contour_int[i].x = (int) std::round(distorted_gielis_contour[i].x);
-            distorted_gielis_contour_int[i].y = (int) std::round(distorted_gielis_contour[i].y);
-        }
-
-        detected_signs_2f[contour_idx] = distorted_gielis_contour;
-        detected_signs[contour_idx] = distorted_gielis_contour_int;
-
-    }
+    detection::TrafficSignDetector detector(nhs_mode);
+    std::vector< detection::Detection > detections = detector.detect(input_image);
+
+    cv::imwrite("seg.jpg", detector.binary_image());
+
+    // Transform to cv::Point to show the results
+    std::vector< std::vector< cv::Point > > detected_signs;
+    detections_to_points(detections, detected_signs);
+    for (unsigned int contour_idx = 0; contour_idx < detections.size(); contour_idx++)
+        std::cout << "Contour #" << contour_idx << ":\n" << detections[contour_idx].config << std::endl;
+
+    // Time spent on each (contour, sign type) hypothesis
+    const std::vector< detection::FitTiming >& timings = detector.fit_timings();
+    for (unsigned int k = 0; k < timings.size(); k++)
+        std::cout << "Contour #" << timings[k].contour_idx << " sign type " << timings[k].sign_type
+                  << ": mass center " << timings[k].mass_center_ms << " ms, optimisation "
+                  << timings[k].optimisation_ms << " ms, " << timings[k].iterations << " iterations"
+                  << (timings[k].abandoned ? " (abandoned)" : "") << std::endl;
 
     end = std::chrono::system_clock::now();
     std::chrono::duration<double> elapsed_seconds = end-start;
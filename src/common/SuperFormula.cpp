@@ -44,7 +44,7 @@ the use of this software, even if advised of the possibility of such damage.
 
 #include "math_utils.h"
 #include "SuperFormula.h"
-#include "random-standalone.h"
+#include "levenbergMarquardt.h"
 #include "timer.h"
 
 #include <iostream>
@@ -67,8 +67,6 @@ the use of this software, even if advised of the possibility of such damage.
 using namespace std;
 using namespace Eigen;
 
-extern Random R1;
-
 //---------------------------------------------------------------------
 //
 //                      Rational 2D Gielis Curves
@@ -77,25 +75,22 @@ extern Random R1;
 
 void RationalSuperShape2D :: Init( double a, double b, double n1,double n2,double n3,double p, double q , double thtoffset, double phioffset, double xoffset, double yoffset, double zoffset){
 
-    Parameters.clear();
-    Parameters.reserve(12);
-
-    Parameters.push_back(a);
-    Parameters.push_back(b);
+    Parameters[0] = a;
+    Parameters[1] = b;
 
-    Parameters.push_back(n1);
-    Parameters.push_back(n2);
-    Parameters.push_back(n3);
+    Parameters[2] = n1;
+    Parameters[3] = n2;
+    Parameters[4] = n3;
 
-    Parameters.push_back(p);
-    Parameters.push_back(q);
+    Parameters[5] = p;
+    Parameters[6] = q;
 
-    Parameters.push_back(thtoffset);
-    Parameters.push_back(phioffset);
+    Parameters[7] = thtoffset;
+    Parameters[8] = phioffset;
 
-    Parameters.push_back(xoffset);
-    Parameters.push_back(yoffset);
-    Parameters.push_back(zoffset);
+    Parameters[9] = xoffset;
+    Parameters[10] = yoffset;
+    Parameters[11] = zoffset;
 }
 
 void RationalSuperShape2D :: Init( double a, double b, double n1,double n2,double n3)
@@ -127,19 +122,19 @@ RationalSuperShape2D :: ~RationalSuperShape2D() {
 
 }
 
-double RationalSuperShape2D :: radius ( const double angle ){
+double supershape::radius ( const SuperShapeParams& params, const double angle ){
 
-    double tmp_angle = Get_p() * angle * 0.25 / Get_q() ;
+    double tmp_angle = params.p() * angle * 0.25 / params.q() ;
 
     double tmp1( cos(tmp_angle) );
     double tmp2( sin(tmp_angle) );
 
     //if( tmp1 != 0)
-    tmp1 = pow(fabs(tmp1),Get_n2()) / Get_a();
+    tmp1 = pow(fabs(tmp1),params.n2()) / params.a();
     //if( tmp2 != 0)
-    tmp2 = pow(fabs(tmp2),Get_n3()) / Get_b();
+    tmp2 = pow(fabs(tmp2),params.n3()) / params.b();
 
-    if( tmp1 + tmp2 !=0 )	return( pow( (tmp1 + tmp2), -1.0/Get_n1() ) );
+    if( tmp1 + tmp2 !=0 )	return( pow( (tmp1 + tmp2), -1.0/params.n1() ) );
     else				   {cout<<"ERROR RADIUS NULL"<<endl;return 0;}
 
 }
@@ -155,112 +150,93 @@ double RationalSuperShape2D :: radius ( const double angle ){
 
 //Potential fields
 
-double RationalSuperShape2D :: ImplicitFunction1( const Vector2d P, vector<double> &Dffinal) {
+namespace {
 
-    Dffinal.clear();
-
-    // nothing computable, return zero values, zero partial derivatives
-    // the point will have no effect on the ongoing computations
+    //number of intersections of the ray with the curve, i.e. of integers i with 0 <= i < q
 
-    if ( P[0] == 0 && P[1] == 0)
+    inline int branch_count(const SuperShapeParams& params)
     {
-        // Df/Dx, Df/Dy, Df/Dr set to zero...
-        for (int i=0; i<3; i++) Dffinal.push_back(0);
-        return 0;
+        int n_branches = 0;
+        while (n_branches < params.q()) n_branches++;
+        assert(n_branches >= 1);
+        return n_branches;
     }
 
-    vector <double> f, Ddum;
-    double x(P[0]), y(P[1]), PSL(P.squaredNorm()), PL(sqrt(PSL)), dthtdx (-y/PSL), dthtdy (x/PSL), R,drdth;
-
-    vector< vector<double> > Df;
-    Df.reserve(Get_q());
-
-    //assert angular values between [0, 2q*Pi]
-
-    double tht (atan2(y,x)), thtbase(tht);
-    if (tht<0) thtbase += 2.*PI;
-
-    //compute all intersections and associated partial derivatives
-
-    vector <double> rowi;
-    rowi.reserve(3);
-    f.reserve(Get_q());
+    //values f[i] and partial derivatives Df[i] of the branches
+    //on the stack up to SUPERSHAPE_MAX_BRANCHES branches, on the heap beyond
 
-    for (int i=0; i<Get_q(); i++)
+    struct BranchBuffer
     {
-        tht = thtbase + i*2.*PI;
-
-        R = radius(tht);
-        f.push_back(R - PL); //store function
-
-        // store partial derivatives
-
-        rowi.clear();
-
-        drdth = DrDtheta(tht);
-        rowi.push_back(  drdth*dthtdx -  cos(tht)); //df/dx
-        rowi.push_back(  drdth*dthtdy -  sin(tht)); //df/dy
-        rowi.push_back( 1. );  //df/dr
-        Df.push_back(rowi);
-    }
-
-    //bubble sort, not really efficient but acceptable for such small arrays
-
-    for(int i=0; i<Get_q()-1; i++)
-        for (int j=i+1; j<Get_q(); j++)
+        explicit BranchBuffer(const int n_branches) : f(f_stack), Df(Df_stack)
         {
-            if (f[i]<f[j])
+            if (n_branches > SUPERSHAPE_MAX_BRANCHES)
             {
-                //swap values of f[i] and f[j]
-                swap(f[i],f[j]);
-                //swap rows Df[i] and Df[j]
-                Df[i].swap(Df[j]);
+                f_heap.resize(n_branches);
+                Df_heap.resize(n_branches);
+                f = f_heap.data();
+                Df = Df_heap.data();
             }
         }
 
-    //Compute resulting Rfunction
+        BranchBuffer(const BranchBuffer&) = delete;
+        BranchBuffer& operator=(const BranchBuffer&) = delete;
+
+        double* f;
+        Vector3d* Df;
 
-    vector<double> Df1; //vector for df/dxi
-    Df1.reserve(Get_q());
+    private:
+        double f_stack[SUPERSHAPE_MAX_BRANCHES];
+        Vector3d Df_stack[SUPERSHAPE_MAX_BRANCHES];
+        vector <double> f_heap;
+        vector <Vector3d> Df_heap;
+    };
 
-    //iterative evaluation of:
-    //      -the resulting R-functions
-    //      -the associated partial derivatives
+    //Compute resulting Rfunction of the branches f[i] with partial derivatives Df[i]
 
-    double f1,fdum;
+    double union_of_branches(double f[], Vector3d Df[], const int n_branches, Vector3d &Dffinal)
+    {
+        //bubble sort, not really efficient but acceptable for such small arrays
 
-    f1 = f[0];      // first value of f
-    Df1 = Df[0];    // first associated row with partial derivatives
+        for(int i=0; i<n_branches-1; i++)
+            for (int j=i+1; j<n_branches; j++)
+                if (f[i]<f[j])
+                {
+                    //swap values of f[i] and f[j]
+                    swap(f[i],f[j]);
+                    //swap rows Df[i] and Df[j]
+                    swap(Df[i],Df[j]);
+                }
 
-    //combine functions as (...((F1 v F2) v F3 ) v F4) v ...)
+        //iterative evaluation of:
+        //      -the resulting R-functions
+        //      -the associated partial derivatives
 
-    for(int i=1; i<Get_q(); i++) // for all intersections
-    {
-        //compute R-function, sets all partial derivatives
-        //fdum and Ddum temporary results of the union from F1 to Fi
+        double f1(f[0]), fdum;  // first value of f
+        Vector3d Df1(Df[0]), Ddum;  // first associated row with partial derivatives
 
-        RpUnion(f1, f[i], Df1, Df[i], fdum, Ddum);
+        //combine functions as (...((F1 v F2) v F3 ) v F4) v ...)
 
-        //update results in f1 and Df1, and iterate
-        f1 = fdum;
-        Df1 = Ddum;
-    }
+        for(int i=1; i<n_branches; i++) // for all intersections
+        {
+            //compute R-function, sets all partial derivatives
+            //fdum and Ddum temporary results of the union from F1 to Fi
 
-    //final partial derivatives df/dxi after R-functions
-    Dffinal = Df1;
+            RpUnion(f1, f[i], Df1, Df[i], fdum, Ddum);
 
-    //clear arrays
+            //update results in f1 and Df1, and iterate
+            f1 = fdum;
+            Df1 = Ddum;
+        }
 
-    //f.clear();    Df.clear();    Ddum.clear();    Df1.clear();
+        //final partial derivatives df/dxi after R-functions
+        Dffinal = Df1;
 
-    //return results
+        return f1;
+    }
 
-    return f1;
 }
 
-double RationalSuperShape2D :: ImplicitFunction2( const Vector2d P, vector <double> &Dffinal){
-
-    Dffinal.clear();
+double supershape::implicit_function1( const SuperShapeParams& params, const Vector2d& P, Vector3d &Dffinal){
 
     // nothing computable, return zero values, zero partial derivatives
     // the point will have no effect on the ongoing computations
@@ -268,99 +244,43 @@ double RationalSuperShape2D :: ImplicitFunction2( const Vector2d P, vector <doub
     if ( P[0] == 0 && P[1] == 0)
     {
         // Df/Dx, Df/Dy, Df/Dr set to zero...
-        for (int i=0; i<3; i++) Dffinal.push_back(0);
+        Dffinal.setZero();
         return 0;
     }
 
-    vector <double> f, Ddum;
     double x(P[0]), y(P[1]), PSL(P.squaredNorm()), PL(sqrt(PSL)), dthtdx (-y/PSL), dthtdy (x/PSL), R,drdth;
 
-    vector<vector<double> > Df;
-
     //assert angular values between [0, 2q*Pi]
 
     double tht (atan2(y,x)), thtbase(tht);
     if (tht<0) thtbase += 2.*PI;
 
-    //compute all intersections and associated gradient values
+    //compute all intersections and associated partial derivatives
 
-    vector <double> rowi;
+    const int n_branches = branch_count(params);
+    BranchBuffer branches(n_branches);
+    double* f = branches.f;
+    Vector3d* Df = branches.Df;
 
-    for (int i=0; i<Get_q(); i++)
+    for (int i=0; i<n_branches; i++)
     {
         tht = thtbase + i*2.*PI;
 
-        R = radius(tht);
-        drdth = DrDtheta(tht);
-
-        f.push_back(1. - PL/R); //store function
+        R = radius(params, tht);
+        f[i] = R - PL; //store function
 
         // store partial derivatives
 
-        rowi.clear();
-
-        drdth = DrDtheta(tht);
-        rowi.push_back( - ( x*R/PL - drdth*dthtdx*PL )/(R*R) ); //df/dx
-        rowi.push_back( - ( y*R/PL - drdth*dthtdy*PL )/(R*R) ); //df/dy
-        rowi.push_back( PL/(R*R) );  //df/dr
-        Df.push_back(rowi);
-    }
-
-    //bubble sort, not really efficient but acceptable for such small arrays
-
-    for(int i=0; i<Get_q()-1; i++)
-        for (int j=i+1; j<Get_q(); j++)
-            if (f[i]<f[j])
-            {
-                //swap values of f[i] and f[j]
-                swap(f[i],f[j]);
-                //swap rows Df[i] and Df[j]
-                Df[i].swap(Df[j]);
-            }
-
-    //Compute resulting Rfunction
-
-    vector<double> Df1; //vector for df/dxi
-
-    //iterative evaluation of:
-    //      -the resulting R-functions
-    //      -the associated partial derivatives
-
-    double f1,fdum;
-
-    f1 = f[0];      // first value of f
-    Df1 = Df[0];    // first associated row with partial derivatives
-
-    //combine functions as (...((F1 v F2) v F3 ) v F4) v ...)
-
-    for(int i=1; i<Get_q(); i++) // for all intersections
-    {
-        //compute R-function, sets all partial derivatives
-        //fdum and Ddum temporary results of the union from F1 to Fi
-
-        RpUnion(f1, f[i], Df1, Df[i], fdum, Ddum);
-
-        //update results in f1 and Df1, and iterate
-        f1 = fdum;
-        Df1 = Ddum;
+        drdth = dr_dtheta(params, tht);
+        Df[i][0] = drdth*dthtdx -  cos(tht); //df/dx
+        Df[i][1] = drdth*dthtdy -  sin(tht); //df/dy
+        Df[i][2] = 1.;  //df/dr
     }
 
-    //final partial derivatives df/dxi after R-functions
-    Dffinal = Df1;
-
-    //clear arrays
-
-    f.clear();    Df.clear();    Ddum.clear();    Df1.clear();
-
-    //return results
-
-    return f1;
+    return union_of_branches(f, Df, n_branches, Dffinal);
 }
 
-
-double RationalSuperShape2D :: ImplicitFunction3( const Vector2d P, vector <double> &Dffinal){
-
-    Dffinal.clear();
+double supershape::implicit_function2( const SuperShapeParams& params, const Vector2d& P, Vector3d &Dffinal){
 
     // nothing computable, return zero values, zero partial derivatives
     // the point will have no effect on the ongoing computations
@@ -368,14 +288,11 @@ double RationalSuperShape2D :: ImplicitFunction3( const Vector2d P, vector <doub
     if ( P[0] == 0 && P[1] == 0)
     {
         // Df/Dx, Df/Dy, Df/Dr set to zero...
-        for (int i=0; i<3; i++) Dffinal.push_back(0);
+        Dffinal.setZero();
         return 0;
     }
 
-    vector <double> f, Ddum;
-    double x(P[0]), y(P[1]), PSL(P.squaredNorm()), dthtdx (-y/PSL), dthtdy (x/PSL), R,drdth;
-
-    vector< vector<double> > Df;
+    double x(P[0]), y(P[1]), PSL(P.squaredNorm()), PL(sqrt(PSL)), dthtdx (-y/PSL), dthtdy (x/PSL), R,drdth;
 
     //assert angular values between [0, 2q*Pi]
 
@@ -384,192 +301,110 @@ double RationalSuperShape2D :: ImplicitFunction3( const Vector2d P, vector <doub
 
     //compute all intersections and associated gradient values
 
-    vector <double> rowi;
+    const int n_branches = branch_count(params);
+    BranchBuffer branches(n_branches);
+    double* f = branches.f;
+    Vector3d* Df = branches.Df;
 
-    for (int i=0; i<Get_q(); i++)
+    for (int i=0; i<n_branches; i++)
     {
         tht = thtbase + i*2.*PI;
 
-        R = radius(tht);
-        drdth = DrDtheta(tht);
+        R = radius(params, tht);
+        drdth = dr_dtheta(params, tht);
 
-        f.push_back( log( R*R / PSL)); //store function
+        f[i] = 1. - PL/R; //store function
 
         // store partial derivatives
 
-        drdth = DrDtheta(tht);
-
-        rowi.clear();
-        rowi.push_back( -2.*(x*R - PSL * drdth*dthtdx)/(R*PSL)  ); //df/dx
-        rowi.push_back( -2.*(y*R - PSL * drdth*dthtdy)/(R*PSL) ); //df/dy
-        rowi.push_back( 2./R );  //df/dr
-
-        Df.push_back(rowi);
+        Df[i][0] = - ( x*R/PL - drdth*dthtdx*PL )/(R*R); //df/dx
+        Df[i][1] = - ( y*R/PL - drdth*dthtdy*PL )/(R*R); //df/dy
+        Df[i][2] = PL/(R*R);  //df/dr
     }
 
-    //bubble sort, not really efficient but acceptable for such small arrays
-
-    for(int i=0; i<Get_q()-1; i++)
-        for (int j=i+1; j<Get_q(); j++)
-            if (f[i]<f[j])
-            {
-                //swap values of f[i] and f[j]
-                swap(f[i],f[j]);
-                //swap rows Df[i] and Df[j]
-                Df[i].swap(Df[j]);
-            }
-
-    //Compute resulting Rfunction
-
-    vector<double> Df1; //vector for df/dxi
-
-    //iterative evaluation of:
-    //      -the resulting R-functions
-    //      -the associated partial derivatives
-
-    double f1,fdum;
+    return union_of_branches(f, Df, n_branches, Dffinal);
+}
 
-    f1 = f[0];      // first value of f
-    Df1 = Df[0];    // first associated row with partial derivatives
+double supershape::implicit_function3( const SuperShapeParams& params, const Vector2d& P, Vector3d &Dffinal){
 
-    //combine functions as (...((F1 v F2) v F3 ) v F4) v ...)
+    // nothing computable, return zero values, zero partial derivatives
+    // the point will have no effect on the ongoing computations
 
-    for(int i=1; i<Get_q(); i++) // for all intersections
+    if ( P[0] == 0 && P[1] == 0)
     {
-        //compute R-function, sets all partial derivatives
-        //fdum and Ddum temporary results of the union from F1 to Fi
-
-        RpUnion(f1, f[i], Df1, Df[i], fdum, Ddum);
-
-        //update results in f1 and Df1, and iterate
-        f1 = fdum;
-        Df1 = Ddum;
+        // Df/Dx, Df/Dy, Df/Dr set to zero...
+        Dffinal.setZero();
+        return 0;
     }
 
-    //final partial derivatives df/dxi after R-functions
-    Dffinal = Df1;
-
-    //return results
-
-    return f1;
-}
-
-
-double RationalSuperShape2D :: DrDtheta(double tht)
-{
-    // analytic
-    /*
-    double n1(Get_n1()), n2(Get_n2()), n3(Get_n3()), m(Get_p()),q(Get_q()),a(Get_a()),b(Get_b());
-
-    double c ( cos( m*0.25*tht / q)), C( fabs(c)), s( sin( m*0.25*tht / q)), S( fabs(s));
-
-    if(C<EPSILON || S<EPSILON) return 0;
-
-    double DC (-0.25*m*s/q), DS (0.25*m*c/q);
-
-    return
-                        (-1./n1) *
-                        pow(  pow(C,n2) / a + pow(S,n3)/b , -1./n1 - 1.)*
-                        (
-                                -0.25*m*pow(C,n2)*(n2*tan(m*tht*0.25/q)) / (a*q)
-                                +
-                                0.25*m*pow(S,n3)*(n3/tan(m*tht*0.25/q)) / (b*q)
-                        );
-                        */
-
+    double x(P[0]), y(P[1]), PSL(P.squaredNorm()), dthtdx (-y/PSL), dthtdy (x/PSL), R,drdth;
 
-    double r0,r1,r2,r3;
+    //assert angular values between [0, 2q*Pi]
 
-    double delta(1e-3);
-    r0 = radius(tht - 2*delta);
-    r1 = radius(tht - delta);
-    r2 = radius(tht + delta);
-    r3 = radius(tht + 2*delta);
+    double tht (atan2(y,x)), thtbase(tht);
+    if (tht<0) thtbase += 2.*PI;
 
+    //compute all intersections and associated gradient values
 
+    const int n_branches = branch_count(params);
+    BranchBuffer branches(n_branches);
+    double* f = branches.f;
+    Vector3d* Df = branches.Df;
 
+    for (int i=0; i<n_branches; i++)
+    {
+        tht = thtbase + i*2.*PI;
 
-    Vector4d V(
-                r0,
-                -8*r1,
-                8*r2,
-                -r3
-                );
+        R = radius(params, tht);
+        drdth = dr_dtheta(params, tht);
 
-    return V.sum() / (12.*delta);
+        f[i] = log( R*R / PSL); //store function
 
+        // store partial derivatives
 
+        Df[i][0] = -2.*(x*R - PSL * drdth*dthtdx)/(R*PSL); //df/dx
+        Df[i][1] = -2.*(y*R - PSL * drdth*dthtdy)/(R*PSL); //df/dy
+        Df[i][2] = 2./R;  //df/dr
+    }
 
+    return union_of_branches(f, Df, n_branches, Dffinal);
 }
 
+//versions returning the partial derivatives in a std::vector
 
+double supershape::implicit_function1( const SuperShapeParams& params, const Vector2d& P, vector <double> &Dffinal){
 
-double RationalSuperShape2D :: DrDa(const double tht)
-{
-    //analytic version
-    /*
-    double C = fabs( cos( Get_p() * tht * 0.25 / Get_q())) ;
-    double S = fabs( sin( Get_p() * tht * 0.25 / Get_q())) ;
-    double aCn2 = pow(C, Get_n2())/Get_a();
-    double bSn3 = pow(S, Get_n3())/Get_b();
-
-    return  aCn2 * pow( aCn2 + bSn3, -1./Get_n1() - 1.) / (Get_n1()*Get_a());
-    */
-    //discrete approximation
-
-    double olda(Get_a());
-
-    double r0,r1,r2,r3;
-
-    double delta(1e-3);
-    Set_a(olda - 2*delta); r0 = radius(tht);
-    Set_a(olda - delta); r1 = radius(tht);
-    Set_a(olda + delta); r2 = radius(tht);
-    Set_a(olda + 2*delta); r3 = radius(tht);
-    Set_a(olda);
-
-
-
-    Vector4d V(
-                r0,
-                -8*r1,
-                8*r2,
-                -r3
-                );
+    Vector3d Df;
+    const double f = implicit_function1(params, P, Df);
+    Dffinal.assign(Df.data(), Df.data() + 3);
+    return f;
+}
 
-    return V.sum() / (12.*delta);
+double supershape::implicit_function2( const SuperShapeParams& params, const Vector2d& P, vector <double> &Dffinal){
 
+    Vector3d Df;
+    const double f = implicit_function2(params, P, Df);
+    Dffinal.assign(Df.data(), Df.data() + 3);
+    return f;
+}
 
+double supershape::implicit_function3( const SuperShapeParams& params, const Vector2d& P, vector <double> &Dffinal){
 
+    Vector3d Df;
+    const double f = implicit_function3(params, P, Df);
+    Dffinal.assign(Df.data(), Df.data() + 3);
+    return f;
 }
 
-double RationalSuperShape2D :: DrDb(const double tht)
+double supershape::dr_dtheta(const SuperShapeParams& params, const double tht)
 {
-    //analytic
-    /*
-    double C = fabs( cos( Get_p() * tht * 0.25 / Get_q())) ;
-    double S = fabs( sin( Get_p() * tht * 0.25 / Get_q())) ;
-
-    double aCn2 = pow(C, Get_n2())/Get_a();
-    double bSn3 = pow(S, Get_n3())/Get_b();
-
-    return  bSn3 * pow( aCn2 + bSn3, -1./Get_n1() - 1.) / (Get_n1()*Get_b());
-    */
-
-    //discrete approximation
-
-    double oldb(Get_b());
-
     double r0,r1,r2,r3;
 
     double delta(1e-3);
-    Set_b(oldb - 2*delta); r0 = radius(tht);
-    Set_b(oldb - delta); r1 = radius(tht);
-    Set_b(oldb + delta); r2 = radius(tht);
-    Set_b(oldb + 2*delta); r3 = radius(tht);
-    Set_b(oldb);
-
-
+    r0 = radius(params, tht - 2*delta);
+    r1 = radius(params, tht - delta);
+    r2 = radius(params, tht + delta);
+    r3 = radius(params, tht + 2*delta);
 
     Vector4d V(
                 r0,
@@ -581,36 +416,23 @@ double RationalSuperShape2D :: DrDb(const double tht)
     return V.sum() / (12.*delta);
 }
 
-double RationalSuperShape2D :: DrDn1(const double tht)
+double supershape::dr_dparameter(const SuperShapeParams& params, const int index, const double tht)
 {
-    //analytic
-    /*
-    double R(radius(tht));
-    double rn1 = pow(R, -Get_n1());
-
-    if (R>EPSILON){
-    //return log ( pow ( R, -1./Get_n1()))*R;
-    return log(rn1) * R /(Get_n1()*Get_n1());
-    }
+    assert(index >= 0 && index < 5);
 
-    //cout <<"rhaaaa"<<endl;
-    return 0;
-    */
-
-    //discrete approximation
+    //discrete approximation on a perturbed copy of the parameters
+    //a, b, n1, n2 and n3 are kept positive as in Set_a and the other setters
 
-    double oldn1(Get_n1());
+    SuperShapeParams perturbed(params);
+    const double old(params[index]);
 
     double r0,r1,r2,r3;
 
     double delta(1e-3);
-    Set_n1(oldn1 - 2*delta); r0 = radius(tht);
-    Set_n1(oldn1 - delta); r1 = radius(tht);
-    Set_n1(oldn1 + delta); r2 = radius(tht);
-    Set_n1(oldn1 + 2*delta); r3 = radius(tht);
-    Set_n1(oldn1);
-
-
+    perturbed[index] = fabs(old - 2*delta); r0 = radius(perturbed, tht);
+    perturbed[index] = fabs(old - delta); r1 = radius(perturbed, tht);
+    perturbed[index] = fabs(old + delta); r2 = radius(perturbed, tht);
+    perturbed[index] = fabs(old + 2*delta); r3 = radius(perturbed, tht);
 
     Vector4d V(
                 r0,
@@ -620,94 +442,55 @@ double RationalSuperShape2D :: DrDn1(const double tht)
                 );
 
     return V.sum() / (12.*delta);
-
 }
 
-double RationalSuperShape2D :: DrDn2(const double tht)
+double supershape::radius_and_derivatives(const SuperShapeParams& params, const double tht, double &drda, double &drdb, double &drdn1, double &drdn2, double &drdn3, double &drdtht)
 {
-    //analytic
-    /*
-    double C = fabs( cos( Get_p() * tht * 0.25 / Get_q())) ;
-    double S = fabs( sin( Get_p() * tht * 0.25 / Get_q())) ;
+    // r = T^(-1/n1) with T = A + B, A = |cos(u)|^n2 / a, B = |sin(u)|^n3 / b and u = k*tht, k = p/(4q)
+    // r is computed as in radius() so that both give the same value
 
-    double aCn2 = pow(C, Get_n2())/Get_a();
-    double bSn3 = pow(S, Get_n3())/Get_b();
+    const double a(params.a()), b(params.b()), n1(params.n1()), n2(params.n2()), n3(params.n3());
+    const double k(params.p() * 0.25 / params.q());
+    const double tmp_angle(params.p() * tht * 0.25 / params.q());
 
-    if(C <EPSILON) return 0;
-    return
-        - pow( aCn2 + bSn3, -1./Get_n1() - 1.)
-        *
-        log(C)*aCn2 / Get_n1();
-        */
+    const double c(cos(tmp_angle)), s(sin(tmp_angle)), C(fabs(c)), S(fabs(s));
+    const double A(pow(C, n2) / a), B(pow(S, n3) / b), T(A + B);
 
-    //discrete approximation
-
-    double oldn2(Get_n2());
+    if (T == 0) {
+        cout<<"ERROR RADIUS NULL"<<endl;
+        drda = drdb = drdn1 = drdn2 = drdn3 = drdtht = 0;
+        return 0;
+    }
 
-    double r0,r1,r2,r3;
+    const double r(pow(T, -1.0/n1));
 
-    double delta(1e-3);
-    Set_n2(oldn2 - 2*delta); r0 = radius(tht);
-    Set_n2(oldn2 - delta); r1 = radius(tht);
-    Set_n2(oldn2 + delta); r2 = radius(tht);
-    Set_n2(oldn2 + 2*delta); r3 = radius(tht);
-    Set_n2(oldn2);
+    // dr/dT = -r / (n1*T)
+    const double rn1T(r / (n1*T));
 
+    // dT/da = -A/a, dT/db = -B/b
+    drda = rn1T * A / a;
+    drdb = rn1T * B / b;
 
+    // d(T^(-1/n1))/dn1 = r * log(T) / n1^2
+    drdn1 = r * log(T) / (n1*n1);
 
-    Vector4d V(
-                r0,
-                -8*r1,
-                8*r2,
-                -r3
-                );
+    // dT/dn2 = A*log(C), dT/dn3 = B*log(S) -- both tend to 0 with C or S
+    drdn2 = (C > 0) ? -rn1T * A * log(C) : 0;
+    drdn3 = (S > 0) ? -rn1T * B * log(S) : 0;
 
-    return V.sum() / (12.*delta);
+    // dA/dtht = -k*n2*A*tan(u), dB/dtht = k*n3*B/tan(u)
+    double dTdu(0);
+    if (C > 0) dTdu -= n2 * A * s / c;
+    if (S > 0) dTdu += n3 * B * c / s;
+    drdtht = -rn1T * k * dTdu;
 
+    return r;
 }
 
-double RationalSuperShape2D :: DrDn3(const double tht)
+void RationalSuperShape2D :: GetPartialDerivatives(double tht, double &drda, double &drdb, double &drdn1, double &drdn2, double &drdn3) const
 {
-    //analytic
-    /*
-    double C = fabs( cos( Get_p() * tht * 0.25 / Get_q())) ;
-    double S = fabs( sin( Get_p() * tht * 0.25 / Get_q())) ;
-
-
-    double aCn2 = pow(C, Get_n2())/Get_a();
-    double bSn3 = pow(S, Get_n3())/Get_b();
-
-    if(S < EPSILON) return 0;
-    return
-        - pow( aCn2 + bSn3, -1./Get_n1() - 1.)
-        *
-        log(S)*bSn3 / Get_n1();
-        */
-
-    //discrete approx
-    double oldn3(Get_n3());
-
-    double r0,r1,r2,r3;
-
-    double delta(1e-3);
-    Set_n3(oldn3 - 2*delta); r0 = radius(tht);
-    Set_n3(oldn3 - delta); r1 = radius(tht);
-    Set_n3(oldn3 + delta); r2 = radius(tht);
-    Set_n3(oldn3 + 2*delta); r3 = radius(tht);
-    Set_n3(oldn3);
-
-
-
-    Vector4d V(
-                r0,
-                -8*r1,
-                8*r2,
-                -r3
-                );
-
-    return V.sum() / (12.*delta);
-
-
+    double drdtht;
+    RadiusAndDerivatives(tht, drda, drdb, drdn1, drdn2, drdn3, drdtht);
 }
 
 
@@ -732,6 +515,21 @@ void RpUnion(double f1, double f2, vector<double> Df1, vector<double> Df2, doubl
     }
 }
 
+void RpUnion(double f1, double f2, const Vector3d &Df1, const Vector3d &Df2, double &f, Vector3d &Df)
+{
+    const double squareRoot = sqrt(f1*f1+f2*f2);
+    f = f1+f2+squareRoot;
+
+    if(f1 != 0 || f2 != 0) // function differentiable
+    {
+        const double division = 1.0f/squareRoot;
+        for(int i=0; i<3; i++)
+            Df[i] = Df1[i] + Df2[i] +  (f1*Df1[i]+f2*Df2[i])*division;
+    }
+    else                   //function not differentiable, set everything to zero
+        Df.setZero();
+}
+
 void RpIntersection(double f1, double f2, vector<double> Df1, vector<double> Df2, double &f, vector<double> &Df)
 {
     assert(Df1.size() == Df2.size());
@@ -751,561 +549,157 @@ void RpIntersection(double f1, double f2, vector<double> Df1, vector<double> Df2
 
 
 void RationalSuperShape2D :: Optimize5D(
-        string outfilename,
         const vector< Vector2d, aligned_allocator< Vector2d> > & Data,
         double &err ,
         int functionused
         )
 {
+    supershape::NullFitObserver observer;
+    supershape::levenberg_marquardt<5>(*this, Data, err, functionused, observer);
+}
+
+
+void RationalSuperShape2D :: Optimize7D(
+        const vector< Vector2d, aligned_allocator< Vector2d> > & Data,
+        double &err ,
+        int functionused
+        )
+{
+    supershape::NullFitObserver observer;
+    supershape::levenberg_marquardt<7>(*this, Data, err, functionused, observer);
+}
 
-    double NewChiSquare, ChiSquare(1e15), OldChiSquare(1e15);
 
-    ofstream logfile;
-    logfile.open(outfilename.c_str());
+void RationalSuperShape2D :: Optimize8D(
+        const vector< Vector2d, aligned_allocator< Vector2d> > & Data,
+        double &err ,
+        int functionused
+        )
+{
+    Timer tmr("\tOptimize8D");
+    supershape::NullFitObserver observer;
+    supershape::levenberg_marquardt<8>(*this, Data, err, functionused, observer);
+}
 
-    bool STOP(false);
-    double oldparams[] ={0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};  //dj[16];
-    double LAMBDA_INCR(10), lambda(pow(LAMBDA_INCR, -6));
 
+template<int N>
+double RationalSuperShape2D :: XiSquare(
+        const vector < Vector2d, aligned_allocator< Vector2d> > & Data,
+        Matrix<double,N,N> &alpha,
+        Matrix<double,N,1> &beta,
+        int functionused,
+        bool update) const {
+    //Timer tmr("\t\tXiSquare8D");
 
-    MatrixXd alpha, alpha2;
+    // N = 5: a, b, n1, n2, n3 are optimized
+    // N = 7: and the x and y offsets
+    // N = 8: and the angular offset
+    static_assert(N == 5 || N == 7 || N == 8, "the fit optimises 5, 7 or 8 parameters");
 
-    alpha =  MatrixXd::Zero(5,5);
-    alpha2 =  MatrixXd::Zero(5,5);
+    Matrix<double,N,1> dj;
 
-    VectorXd beta, beta2, dj, oldbeta;
+    Matrix3d Tr,Rot, dTrdx0, dTrdy0, dRotdtht0;
 
-    beta = VectorXd::Zero(5);
-    beta2 = VectorXd::Zero(5);
-    dj = VectorXd::Zero(5);
-    oldbeta = VectorXd::Zero(5);
-    //  trial = VectorXd::Zero(5);
-    //  sigma = VectorXd::Zero(5);
 
-    logfile << *this;
+    //functions pointer
+    double (RationalSuperShape2D ::*pt2ConstMember)(const Vector2d P, Vector3d &Dffinal) const = NULL;
 
-    int itnum = 0;
-    for(itnum=0; itnum<1000 && STOP==false; itnum++)	{
+    switch (functionused){
+    case 1 :{  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction1;      }break;
+    case 2 :{  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction2;      }break;
+    case 3 :{  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction3;      }break;
+    default :  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction1;
+    }
 
-        //store oldparams
+    Vector3d Df;
 
-        for(size_t i=0; i<Parameters.size(); i++) oldparams[i] = Parameters[i];
+    double  x, y, tht, dthtdx, dthtdy,dthtdx0(0), dthtdy0(0),
+            ChiSquare(1e15), f(0),
+            x0(Get_xoffset()),y0(Get_yoffset()),tht0(Get_thtoffset()),
+            dxdx0,dxdy0,dxdtht0(0), dydx0,dydy0,dydtht0(0), dthtdtht0(0);
 
+    //clean memory
+    if(update)
+    {
         alpha.setZero();
         beta.setZero();
-        alpha2.setZero();
-        beta2.setZero();
-
-        //cout <<"TRIAL:"<<*this<<endl;
-        bool outofbounds(false);
-
-        //cout <<"Norm on in Opt2 : "<<Normalization<<endl;
-        ChiSquare = XiSquare5D(Data,
-                               alpha,
-                               beta,
-                               functionused,             //implicit function1
-                               true);         //update vectors
-        //
-        // add Lambda to diagonla elements and solve the matrix
-        //
-
-        //Linearization of Hessian, cf Numerical Recepies
-        for(int k=0; k<5; k++)
-        {
-            alpha(k,k) *=   1. + lambda;  //multiplicative factor to make diagonal dominant
-            alpha(k,k) +=   lambda;       //additive factor to avoid rank deficient matrix
-        }
+    }
 
-        //solve system
-        alpha.ldlt().solveInPlace(beta);
+    //evaluate ChiSquare, components for the beta and matrix alpha
 
-        //coefficients a and b in [0.01, 100] to preserve numerical accuracy
+    ChiSquare=0;
 
-        outofbounds =  Parameters[0] + beta[0] < 0.01 || Parameters[0] + beta[0] > 1000 ||
-                Parameters[1] + beta[1] < 0.01 || Parameters[1] + beta[1] > 1000 ||
-                Parameters[2] + beta[2] < 0.1  || Parameters[2] + beta[2]> 1000 ||
-                Parameters[3] + beta[3] < 0.1 || Parameters[3] + beta[3]> 1000 ||
-                Parameters[4] + beta[4] < 0.1 || Parameters[4] + beta[4]> 1000;
+    //First define inverse translation T-1
 
+    Tr << 1 , 0 , -x0 ,
+            0 , 1 , -y0 ,
+            0 , 0 , 1;
 
-        if( !outofbounds )
-        {
+    //derivatives of translation matrix are constant and can be computed once for all
+    dTrdx0 << 0 , 0 , -1 , 0 , 0 , 0 ,  0 , 0 , 1;
+    dTrdy0 << 0 , 0 , 0 ,  0 , 0 , -1 , 0 , 0 , 1;
 
-            Set_a(Parameters[0] + beta[0]);
-            Set_b(Parameters[1] + beta[1]);
+    //Then define inverse rotation, i.e. transposed rotation
 
+    Rot << cos(tht0) , sin(tht0) , 0 ,
+            -sin(tht0) , cos(tht0) , 0 ,
+            0 , 0 , 1;
 
-            // coefficients n1 in [1., 1000]
-            // setting n1<1. leads to strong numerical instabilities
+    //get partial derivatives
+    dRotdtht0 << -sin(tht0) , cos(tht0) , 0 ,
+            -cos(tht0) , -sin(tht0) , 0 ,
+            0 , 0 , 1;
 
-            Set_n1( Parameters[2] + beta[2] );
+    for(size_t i=0; i<Data.size(); i++){
 
-            // coefficients n2,n3 in [0.001, 1000]
+        double DfDr;
+        //global inverse transform is T * R
 
-            Set_n2( Parameters[3] + beta[3]);
-            Set_n3( Parameters[4] + beta[4]);
-        }
-
-        //
-        //	Evaluate chisquare with new values
-        //
-
-
-        OldChiSquare=ChiSquare;
-
-        NewChiSquare=XiSquare5D(Data,
-                                alpha2,
-                                beta2,
-                                functionused,             //implicit function
-                                false);  // update alpha and beta or not
-
-        //
-        // check if better result
-        //
-
-        if(	NewChiSquare>0.999*OldChiSquare )			// new result sucks-->restore old params and try with lambda 10 times bigger
-        {
-            lambda *=LAMBDA_INCR;
-            for(size_t i=0; i<Parameters.size(); i++) Parameters[i]=oldparams[i];
-        }
-        else    //successful iteration
-        {
-
-            // huge improvement, something may have been wrong
-            // this may arise during the first iterations
-            // n1 may literally explode, or tend to 0...
-            // in such case, the next iteration is successful but leads to a local minimum
-            // ==> it is better to verify the result with a smaller step
-            // if indeed it was a correct iteration, then it will pass the next time
-
-            if (NewChiSquare <= 0.01*OldChiSquare) //99% improvement, impossible
-            {
-                lambda *=LAMBDA_INCR; // reduce the step within the search direction
-                for(size_t i=0; i<Parameters.size(); i++) Parameters[i]=oldparams[i]; // restore old parameters
-            }
-            else
-            {
-                //correct and realistic improvement
-                logfile << *this;
-                lambda /=LAMBDA_INCR;
-            }
-        }
-
-        STOP = lambda > 1e15 || NewChiSquare < 1e-5; // very small displacement ==> local convergence
-
-
-    }	//end for(...
-
-
-    err = ChiSquare;
-
-    logfile << *this;
-    logfile.close();
-}
-
-
-double RationalSuperShape2D :: XiSquare5D(
-        const vector < Vector2d, aligned_allocator< Vector2d> > & Data,
-        MatrixXd &alpha,
-        VectorXd &beta,
-        int functionused,
-        bool update) {
-
-
-    //five dimensional optimization: a, b, n1, n2, n3 are optimized
-
-    VectorXd dj;     dj = VectorXd::Zero(5);
-
-    Matrix3d Tr,Rot;
-
-    //functions pointer
-    double (RationalSuperShape2D ::*pt2ConstMember)(const Vector2d P, vector<double> &Dffinal) = NULL;
-
-    switch (functionused){
-    case 1 :{  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction1;      }break;
-    case 2 :{  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction2;      }break;
-    case 3 :{  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction3;      }break;
-    default :  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction1;
-    }
-
-    vector<double> Df;
-
-    double  x, y, tht, ChiSquare(1e15),
-            f(0), x0(Get_xoffset()),y0(Get_yoffset()),tht0(Get_thtoffset());
-
-    //clean memory
-    if ( update )  {
-        alpha.setZero();
-        beta.setZero();
-    }
-
-    //evaluate ChiSquare, components for the beta and matrix alpha
-
-    ChiSquare=0;
-
-    //First define inverse translation T-1
-    Tr.setZero();
-    Rot.setZero();
-
-    Tr << 1 , 0 , -x0 ,
-            0 , 1 , -y0 ,
-            0 , 0 , 1;
-
-    //Then define inverse rotation, i.e. transposed rotation
-
-    Rot << cos(tht0) , sin(tht0) , 0 ,
-            -sin(tht0) , cos(tht0) , 0 ,
-            0 , 0 , 1;
-
-    //summation of squared potentials
-    for(size_t i=0; i<Data.size(); i++ ){
-
-        double DfDr;
-
-        //global inverse transform is T * R
-
-        Vector2d dum(Data[i]);
-        Vector3d dum2(dum[0],dum[1],1);
+        const Vector2d dum(Data[i]);
+        const Vector3d dum2(dum[0],dum[1],1);
 
         //apply inverse transform
-        Vector3d dum3 ( Rot * (Tr * dum2));
-        Vector2d P( dum3[0], dum3[1]); //2D point in canonical referential
+        const Vector3d dum3 ( Rot * (Tr * dum2));
 
-        //get partial derivatives for canonical point
+        const Vector2d P(dum3[0],dum3[1]);
 
         x = P[0]; y = P[1];
 
         // avoid division by 0 ==> numerical stability
 
         if (P.norm()<EPSILON) continue; // avoids division by zero
-
         tht = atan2(y,x); if( tht<0) tht+=2.*PI;
 
-        //double R = radius(tht);
-
-        //theta = Arctan(Y/X)
-        //double dthtdx = -sin(tht) ;//-y / (x*x+y*y);
-        //double dthtdy =  cos(tht); //x / (x*x+y*y);
-
-        //avoid non differentiable cases
-
-        //double drdth = DrDtheta(tht);
-
-        f = (*this.*pt2ConstMember)(P, Df); // call to the implicit function
-
-        //
-        //compute elements beta[i][0] and alpha[i][j]
-        //
-
-        //==> requires partial derivatives!!
-
-        DfDr = Df[2]; //Df/Dr stored at index 2 in array Df during the call to ImplicitFunction1-2-3
-
-        // F1 = R-PL ==> DfDr = 1. ;
-        // F2 = 1-PL/R ==> DfDr = PL/R\B2 ;
-        // F3 =  log ( R\B2/PSL) ==> DfDr = 2/R
-
-        dj.setZero();
-
-        //df/da = df/dr * dr/da
-        dj[0] = DfDr * DrDa(tht) ;
-
-        //df/db = df/dr * dr/db
-        dj[1] = DfDr * DrDb(tht) ;
-
-        //df/dn1 = df/dr * dr/dn1
-        dj[2] = DfDr * DrDn1(tht);
-
-        //df/dn2 = df/dr * dr/dn2
-        dj[3] = DfDr * DrDn2(tht);
-
-        //df/dn3 = df/dr * dr/dn3
-        dj[4] = DfDr * DrDn3(tht);
-
+        if (N > 5) {
 
-        ChiSquare += f*f;
-
-        if(update){
-
-            //gradient beta
-            beta -= f*dj;
-
-            //compute approximation of Hessian matrix
-            for(int k=0; k<5; k++)
-                for(int j=0; j<5; j++)
-                    alpha(k,j) +=  dj[k]*dj[j];
-
-
-        }
-
-    }//for all vertices
-
-    return ChiSquare;
-}
-
-void RationalSuperShape2D :: Optimize7D(
-        string outfilename,
-        const vector< Vector2d, aligned_allocator< Vector2d> > & Data,
-        double &err ,
-        int functionused
-        )
-{
-    double NewChiSquare, ChiSquare(1e15), OldChiSquare(1e15);
-    ofstream logfile;
-    logfile.open(outfilename.c_str());
-
-    bool STOP(false);
-    double oldparams[] ={0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};//, dj[16];
-    double LAMBDA_INCR(10), lambda(pow(LAMBDA_INCR, -6));
-
-    MatrixXd alpha, alpha2;
-
-    alpha =  MatrixXd::Zero(7,7);
-    alpha2 =  MatrixXd::Zero(7,7);
-
-    VectorXd beta, beta2, dj, oldbeta,  trial, sigma;
+            //get partial derivatives for canonical point
+            const Vector3d dPdx0 ( Rot * (dTrdx0 * dum2) );
+            const Vector3d dPdy0 ( Rot * (dTrdy0 * dum2) );
 
-    beta = VectorXd::Zero(7);
-    beta2 = VectorXd::Zero(7);
-    dj = VectorXd::Zero(7);
-    oldbeta = VectorXd::Zero(7);
-    trial = VectorXd::Zero(7);
-    sigma = VectorXd::Zero(7);
+            //simplify notations
+            dxdx0 = dPdx0[0];
+            dxdy0 = dPdy0[0];
 
-    Matrix3d Tr,Rot, dTrdx0, dTrdy0;
+            dydx0 = dPdx0[1];
+            dydy0 = dPdy0[1];
 
-    logfile << *this;
+            //theta = Arctan(Y/X)
+            dthtdx = -sin(tht) ;//-y / (x*x+y*y);
+            dthtdy =  cos(tht); //x / (x*x+y*y);
 
-    vector<double> Df;
+            //partial derivatives of theta regarding x offset, y offset, and angular offset
 
-    int itnum = 0;
-    for(itnum=0; itnum<1000 && STOP==false; itnum++)	{
+            dthtdx0   = dthtdx * dxdx0  + dthtdy * dydx0;
+            dthtdy0   = dthtdx * dxdy0  + dthtdy * dydy0;
 
-        //store oldparams
-
-        for(size_t i=0; i<Parameters.size(); i++) oldparams[i]=Parameters[i];
-
-        alpha.setZero();
-        beta.setZero();
-        alpha2.setZero();
-        beta2.setZero();
-
-        //cout <<"TRIAL:"<<*this<<endl;
-        bool outofbounds(false);
-
-        //cout <<"Norm on in Opt2 : "<<Normalization<<endl;
-        ChiSquare = XiSquare7D(Data,
-                               alpha,
-                               beta,
-                               functionused,             //implicitf cuntion1
-                               true);         //update vectors
-
-        //
-        // add Lambda to diagonla elements and solve the matrix
-        //
-
-        //Linearization of Hessian, cf Numerical Recepies
-
-        alpha *= 1. + lambda;
-        alpha.array() += lambda;
-
-
-        //cout << alpha << endl<<endl;
-        //cout << beta << endl<<endl;
-
-        //solve system
-        alpha.ldlt().solveInPlace(beta);
-
-        //coefficients a and b in [0.01, 100]
-
-        outofbounds =  Parameters[0] + beta[0] < 0.01 || Parameters[0] + beta[0] > 1000 ||
-                Parameters[1] + beta[1] < 0.01 || Parameters[1] + beta[1] > 1000 ||
-                Parameters[2] + beta[2] < 0.1  || Parameters[2] + beta[2]> 1000 ||
-                Parameters[3] + beta[3] < 0.1 || Parameters[3] + beta[3]> 1000 ||
-                Parameters[4] + beta[4] < 0.1 || Parameters[4] + beta[4]> 1000;
-
-        if( !outofbounds )
-        {
-
-            Set_a( Parameters[0] + beta[0]);
-            Set_b( Parameters[1] + beta[1]);
-
-            // coefficients n1 in [1., 1000]
-            // setting n1<1. leads to strong numerical instabilities
-
-            Set_n1( Parameters[2] + beta[2] );
-
-            // coefficients n2,n3 in [0.001, 1000]
-
-            Set_n2( Parameters[3] + beta[3]);
-            Set_n3( Parameters[4] + beta[4]);
-
-            // coefficients x0 and y0
-            //truncate translation to avoid huge gaps
-
-            beta[5] = min(0.05, max(-0.05, beta[5]));
-            beta[6] = min(0.05, max(-0.05, beta[6]));
-
-            Parameters[9] += beta[5];
-            Parameters[10] += beta[6];
-
-        }
-
-        //
-        //	Evaluate chisquare with new values
-        //
-
-        OldChiSquare = ChiSquare;
-
-        NewChiSquare = XiSquare7D(Data,
-                                  alpha2,
-                                  beta2,
-                                  functionused,             //implicitf cuntion1
-                                  false);
-
-        if(	NewChiSquare>0.999*OldChiSquare )			// new result sucks-->restore old params and try with lambda 10 times bigger
-        {
-            lambda *= LAMBDA_INCR;
-            for(size_t i=0; i<Parameters.size(); i++) Parameters[i]=oldparams[i];
-        }
-        else    //successful iteration
-        {
-
-            // huge improvement, something may have been wrong
-            // this may arise during the first iterations
-            // n1 may literally explode, or tend to 0...
-            // in such case, the next iteration is successful but leads to a local minimum
-            // ==> it is better to verify the result with a smaller step
-            // if indeed it was a correct iteration, then it will pass the next time
-
-            if (NewChiSquare <= 0.01*OldChiSquare) //99% improvement, impossible
-            {
-                lambda *= LAMBDA_INCR; // reduce the step within the search direction
-                for(size_t i=0; i<Parameters.size(); i++) Parameters[i]=oldparams[i]; // restore old parameters
-            }
-            else
-            {
-                //correct and realistic improvement
-                logfile << *this;
-                lambda /=LAMBDA_INCR;
+            if (N > 7) {
+                const Vector3d dPdtht0 (dRotdtht0 * (Tr *dum2) );
+                dxdtht0 =  dPdtht0[0];
+                dydtht0 =  dPdtht0[1];
+                dthtdtht0 = dthtdx * dxdtht0+ dthtdy * dydtht0;
             }
         }
 
-        STOP = lambda > 1e15 || NewChiSquare < 1e-5;
-
-
-    }	//end for(...
-
-    err = ChiSquare;
-    logfile << *this;
-    logfile.close();
-}
-
-
-double RationalSuperShape2D :: XiSquare7D(
-        const vector < Vector2d, aligned_allocator< Vector2d> > & Data,
-        MatrixXd &alpha,
-        VectorXd &beta,
-        int functionused,
-        bool update) {
-
-    VectorXd dj; dj = VectorXd::Zero(7);
-
-    Matrix3d Tr,Rot, dTrdx0, dTrdy0;
-
-    //functions pointer
-    double (RationalSuperShape2D ::*pt2ConstMember)(const Vector2d P, vector<double> &Dffinal) = NULL;
-
-    switch (functionused){
-    case 1 :{  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction1;      }break;
-    case 2 :{  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction2;      }break;
-    case 3 :{  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction3;      }break;
-    default :  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction1;
-    }
-
-    vector<double> Df;
-
-    double  x, y, tht, dthtdx, dthtdy,dthtdx0, dthtdy0, drdth,
-            ChiSquare(1e15), f(0), x0(Get_xoffset()),y0(Get_yoffset()),tht0(Get_thtoffset()),
-            dxdx0,dxdy0, dydx0,dydy0;
-
-    //clean memory
-    if(update)   {
-        alpha.setZero();
-        beta.setZero();
-    }
-
-    //evaluate ChiSquare, components for the beta and matrix alpha
-
-    ChiSquare=0;
-
-    //First define inverse translation T-1
-
-    Tr.setZero();
-    Rot.setZero();
-
-    Tr << 1 , 0 , -x0 ,
-            0 , 1 , -y0 ,
-            0 , 0 , 1;
-
-    //derivatives of translation matrix are constant and can be computed once for all
-    dTrdx0 << 0 , 0 , -1 , 0 , 0 , 0 ,  0 , 0 , 1;
-    dTrdy0 << 0 , 0 , 0 ,  0 , 0 , -1 , 0 , 0 , 1;
-
-    //Then define inverse rotation, i.e. transposed rotation
-
-    Rot << cos(tht0) , sin(tht0) , 0 ,
-            -sin(tht0) , cos(tht0) , 0 ,
-            0 , 0 , 1;
-
-    for(size_t i=0; i<Data.size(); i++){
-
-        double DfDr;
-
-        //global inverse transform is T * R
-
-        Vector2d dum(Data[i]);
-        Vector3d dum2(dum[0],dum[1],1);
-
-        //apply inverse transform
-        Vector3d dum3 ( Rot * (Tr * dum2));
-        Vector2d P(dum3[0],dum3[1]); //2D point in canonical ref
-
-        //get partial derivatives for canonical point
-
-        Vector3d dPdx0 ( Rot * (dTrdx0 * dum2) );
-        Vector3d dPdy0 ( Rot * (dTrdy0 * dum2) );
-
-        //simplify notations
-        dxdx0 = dPdx0[0];
-        dxdy0 = dPdy0[0];
-
-        dydx0 = dPdx0[1];
-        dydy0 = dPdy0[1];
-
-        x = P[0]; y = P[1];
-
-        // avoid division by 0 ==> numerical stability
-
-        if (P.norm()<EPSILON) continue; // avoids division by zero
-
-        tht = atan2(y,x); if( tht < 0 ) tht+=2.*PI;
-
-        //double R = radius(tht);
-
-        //theta = Arctan(Y/X)
-        dthtdx = -sin(tht) ;//-y / (x*x+y*y);
-        dthtdy =  cos(tht); //x / (x*x+y*y);
-
-        //partial derivatives of theta regarding x offset, y offset, and angular offset
-
-        dthtdx0   = dthtdx * dxdx0  + dthtdy * dydx0;
-        dthtdy0   = dthtdx * dxdy0  + dthtdy * dydy0;
-
-        //avoid non differentiable cases
-
-        drdth = DrDtheta(tht);
-
         f = (*this.*pt2ConstMember)(P, Df); // call to the implicit function
 
         //
@@ -1320,359 +714,38 @@ double RationalSuperShape2D :: XiSquare7D(
         // F2 = 1-PL/R ==> DfDr = PL/R\B2 ;
         // F3 =  log ( R\B2/PSL) ==> DfDr = 2/R
 
-        dj.setZero();
+        //partial derivatives of the radius, in closed form
+        double drda, drdb, drdn1, drdn2, drdn3, drdtht;
+        RadiusAndDerivatives(tht, drda, drdb, drdn1, drdn2, drdn3, drdtht);
 
         //df/da = df/dr * dr/da
-        dj[0] = DfDr * DrDa(tht) ;
+        dj[0] = DfDr * drda ;
 
         //df/db = df/dr * dr/db
-        dj[1] = DfDr * DrDb(tht) ;
+        dj[1] = DfDr * drdb ;
 
         //df/dn1 = df/dr * dr/dn1
-        dj[2] = DfDr * DrDn1(tht);
+        dj[2] = DfDr * drdn1;
 
         //df/dn2 = df/dr * dr/dn2
-        dj[3] = DfDr * DrDn2(tht);
+        dj[3] = DfDr * drdn2;
 
         //df/dn3 = df/dr * dr/dn3
-        dj[4] = DfDr * DrDn3(tht);
+        dj[4] = DfDr * drdn3;
 
-        //df/dx0 = df/dr * dr/dtht *dtht/dx0
-        dj[5]= DfDr * drdth*dthtdx0;
+        if (N > 5) {
+            //df/dx0 = df/dr * dr/dtht *dtht/dx0
+            dj[5]= DfDr * drdtht*dthtdx0;
 
-        //df/dy0 = df/dr * dr/dtht *dtht/dy0
-        dj[6]= DfDr * drdth*dthtdy0;
-
-        //squared summation
-        ChiSquare += f*f;
-
-        if(update){
-            beta -= f*dj;
-            //compute approximation of Hessian matrix
-            for(int k=0; k<5; k++)
-                for(int j=0; j<5; j++)
-                    alpha(k,j) +=  dj[k]*dj[j];
+            //df/dy0 = df/dr * dr/dtht *dtht/dy0
+            dj[6]= DfDr * drdtht*dthtdy0;
         }
 
-    }//for all vertices
-
-    return ChiSquare;
-}
-
-
-void RationalSuperShape2D :: Optimize8D(
-        const vector< Vector2d, aligned_allocator< Vector2d> > & Data,
-        double &err ,
-        int functionused
-        )
-{
-    Timer tmr("\tOptimize8D");
-    double NewChiSquare, ChiSquare(1e15), OldChiSquare(1e15);
-
-    // ofstream logfile;
-    // logfile.open(outfilename.c_str());
-
-
-    bool STOP(false);
-    double oldparams[] ={0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};//, dj[16];
-
-    double LAMBDA_INCR(10);
-    double lambda(pow(LAMBDA_INCR, -6));
-
-    MatrixXd alpha, alpha2;
-
-    alpha =  MatrixXd::Zero(8,8);
-    alpha2 =  MatrixXd::Zero(8,8);
-
-    VectorXd beta, beta2, dj, oldbeta,  trial, sigma;
-
-    beta = VectorXd::Zero(8);
-    beta2 = VectorXd::Zero(8);
-    dj = VectorXd::Zero(8);
-    oldbeta = VectorXd::Zero(8);
-    trial = VectorXd::Zero(8);
-    sigma = VectorXd::Zero(8);
-
-    int itnum = 0;
-    for(itnum=0; itnum<1000 && STOP==false; itnum++)	{
-        //Timer tmrLoop("\t\tTheLoop");
-
-        //store oldparams
-
-        for(size_t i=0; i<Parameters.size(); i++) oldparams[i]=Parameters[i];
-
-        alpha.setZero();
-        beta.setZero();
-        alpha2.setZero();
-        beta2.setZero();
-
-        //cout <<"TRIAL:"<<*this<<endl;
-
-
-        //cout <<"Norm on in Opt2 : "<<Normalization<<endl;
-        ChiSquare = XiSquare8D(Data,
-                               alpha,
-                               beta,
-                               functionused,             //implicitf cuntion1
-                               true);         //update vectors
-        //
-        // add Lambda to diagonla elements and solve the matrix
-        //
-
-        //Linearization of Hessian, cf Numerical Recepies
-
-        alpha *= 1. + lambda;
-        alpha.array() += lambda;
-
-
-
-        //solve system
-        alpha.ldlt().solveInPlace(beta);
-
-        //coefficients a and b in [0.01, 100]
-
-        const bool outofbounds =
-                Parameters[0] + beta[0] < 0.01 || Parameters[0] + beta[0] > 1000 ||
-                Parameters[1] + beta[1] < 0.01 || Parameters[1] + beta[1] > 1000 ||
-                Parameters[2] + beta[2] < 0.1  || Parameters[2] + beta[2]> 1000 ||
-                Parameters[3] + beta[3] < 0.1 || Parameters[3] + beta[3]> 1000 ||
-                Parameters[4] + beta[4] < 0.1 || Parameters[4] + beta[4]> 1000;
-
-        if( !outofbounds ) {
-
-            Set_a( Parameters[0] + beta[0]);
-            Set_b( Parameters[1] + beta[1]);
-
-            // coefficients n1 in [1., 1000]
-            // setting n1<1. leads to strong numerical instabilities
-
-            Set_n1( Parameters[2] + beta[2] );
-
-            // coefficients n2,n3 in [0.001, 1000]
-
-            Set_n2( Parameters[3] + beta[3]);
-            Set_n3( Parameters[4] + beta[4]);
-
-            // coefficients x0 and y0
-            //truncate translation to avoid huge gaps
-
-            beta[5] = min(0.05, max(-0.05, beta[5]));
-            beta[6] = min(0.05, max(-0.05, beta[6]));
-
-            Parameters[9] += beta[5];
-            Parameters[10] += beta[6];
-
-            //same for rotational offset tht0
-            beta[7] = min(PI/50., max(-PI/50., beta[7]));
-            Parameters[7] += beta[7];
+        if (N > 7) {
+            //df/dth0 = dfdr * dr/dtht * dtht/dtht0
+            dj[7]= DfDr * drdtht*dthtdtht0;
         }
 
-        //
-        //	Evaluate chisquare with new values
-        //
-
-        OldChiSquare = ChiSquare;
-
-        NewChiSquare=XiSquare8D(Data,
-                                alpha2,
-                                beta2,
-                                functionused,             //implicitf cuntion1
-                                false);
-        //
-        // check if better result
-        //
-
-        if(	NewChiSquare>0.999*OldChiSquare )			// new result sucks-->restore old params and try with lambda 10 times bigger
-        {
-            lambda *=LAMBDA_INCR;
-            for(size_t i=0; i<Parameters.size(); i++) Parameters[i]=oldparams[i];
-        }
-        else    //successful iteration
-        {
-            // huge improvement, something may have been wrong
-            // this may arise during the first iterations
-            // n1 may literally explode, or tend to 0...
-            // in such case, the next iteration is successful but leads to a local minimum
-            // ==> it is better to verify the result with a smaller step
-            // if indeed it was a correct iteration, then it will pass the next time
-
-            if (NewChiSquare <= 0.01*OldChiSquare) //99% improvement, impossible
-            {
-                lambda *=LAMBDA_INCR; // reduce the step within the search direction
-                for(size_t i=0; i<Parameters.size(); i++) Parameters[i]=oldparams[i]; // restore old parameters
-            }
-            else
-            {
-                //correct and realistic improvement
-                // logfile << *this;
-                lambda /=LAMBDA_INCR;
-            }
-        }
-
-        STOP = lambda > 1e15 || NewChiSquare < 1e-5; // very small displacement ==> local convergence
-
-    }	//end for(...
-
-    err = ChiSquare;
-    // logfile << *this;
-    // logfile.close();
-}
-
-
-double RationalSuperShape2D :: XiSquare8D(
-        const vector < Vector2d, aligned_allocator< Vector2d> > & Data,
-        MatrixXd &alpha,
-        VectorXd &beta,
-        int functionused,
-        bool update) {
-    //Timer tmr("\t\tXiSquare8D");
-    //VectorXd dj;  dj = VectorXd::Zero(8);
-    VectorXd dj(8);
-
-    Matrix3d Tr,Rot, dTrdx0, dTrdy0, dRotdtht0;
-
-
-    //functions pointer
-    double (RationalSuperShape2D ::*pt2ConstMember)(const Vector2d P, vector<double> &Dffinal) = NULL;
-
-    switch (functionused){
-    case 1 :{  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction1;      }break;
-    case 2 :{  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction2;      }break;
-    case 3 :{  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction3;      }break;
-    default :  pt2ConstMember = &RationalSuperShape2D :: ImplicitFunction1;
-    }
-
-    vector<double> Df;
-
-    double  x, y, tht, dthtdx, dthtdy,dthtdx0, dthtdy0, drdth,
-            ChiSquare(1e15), f(0),
-            x0(Get_xoffset()),y0(Get_yoffset()),tht0(Get_thtoffset()),
-            dxdx0,dxdy0,dxdtht0, dydx0,dydy0,dydtht0, dthtdtht0;
-
-    //clean memory
-    if(update)
-    {
-        alpha.setZero();
-        beta.setZero();
-    }
-
-    //evaluate ChiSquare, components for the beta and matrix alpha
-
-    ChiSquare=0;
-
-    //First define inverse translation T-1
-
-    //Tr.setZero();
-    //Rot.setZero();
-    //dRotdtht0.setZero();
-    Tr << 1 , 0 , -x0 ,
-            0 , 1 , -y0 ,
-            0 , 0 , 1;
-
-    //derivatives of translation matrix are constant and can be computed once for all
-    dTrdx0 << 0 , 0 , -1 , 0 , 0 , 0 ,  0 , 0 , 1;
-    dTrdy0 << 0 , 0 , 0 ,  0 , 0 , -1 , 0 , 0 , 1;
-
-    //Then define inverse rotation, i.e. transposed rotation
-
-    Rot << cos(tht0) , sin(tht0) , 0 ,
-            -sin(tht0) , cos(tht0) , 0 ,
-            0 , 0 , 1;
-
-    //get partial derivatives
-    dRotdtht0 << -sin(tht0) , cos(tht0) , 0 ,
-            -cos(tht0) , -sin(tht0) , 0 ,
-            0 , 0 , 1;
-
-    for(size_t i=0; i<Data.size(); i++){
-
-        double DfDr;
-        //global inverse transform is T * R
-
-        const Vector2d dum(Data[i]);
-        const Vector3d dum2(dum[0],dum[1],1);
-
-        //apply inverse transform
-        const Vector3d dum3 ( Rot * (Tr * dum2));
-
-        //get partial derivatives for canonical point
-        const Vector3d dPdx0 ( Rot * (dTrdx0 * dum2) );
-        const Vector3d dPdy0 ( Rot * (dTrdy0 * dum2) );
-        const Vector3d dPdtht0 (dRotdtht0 * (Tr *dum2) );
-
-        const Vector2d P(dum3[0],dum3[1]);
-
-        //simplify notations
-        dxdx0 = dPdx0[0];
-        dxdy0 = dPdy0[0];
-        dxdtht0 =  dPdtht0[0];
-
-        dydx0 = dPdx0[1];
-        dydy0 = dPdy0[1];
-        dydtht0 =  dPdtht0[1];
-
-        x = P[0]; y = P[1];
-
-        // avoid division by 0 ==> numerical stability
-
-        if (P.norm()<EPSILON) continue; // avoids division by zero
-        tht = atan2(y,x); if( tht<0) tht+=2.*PI;
-
-        //double R = radius(tht);
-
-        //theta = Arctan(Y/X)
-        dthtdx = -sin(tht) ;//-y / (x*x+y*y);
-        dthtdy =  cos(tht); //x / (x*x+y*y);
-
-        //partial derivatives of theta regarding x offset, y offset, and angular offset
-
-        dthtdx0   = dthtdx * dxdx0  + dthtdy * dydx0;
-        dthtdy0   = dthtdx * dxdy0  + dthtdy * dydy0;
-        dthtdtht0 = dthtdx * dxdtht0+ dthtdy * dydtht0;
-
-        //avoid non differentiable cases
-        drdth = DrDtheta(tht);
-        f = (*this.*pt2ConstMember)(P, Df); // call to the implicit function
-
-        //
-        //compute elements beta[i][0] and alpha[i][j]
-        //
-
-        //==> requires partial derivatives!!
-
-        DfDr = Df[2]; //Df/Dr stored at index 2 in array Df during the call to ImplicitFunction1-2-3
-
-        // F1 = R-PL ==> DfDr = 1. ;
-        // F2 = 1-PL/R ==> DfDr = PL/R\B2 ;
-        // F3 =  log ( R\B2/PSL) ==> DfDr = 2/R
-
-        //GetPartialDerivatives(tht, DrDa, DrDb, DrDn1, DrDn2, DrDn3);
-        //for(int toto=0; toto<8; toto++) dj[toto]=0;
-
-        //df/da = df/dr * dr/da
-        dj[0] = DfDr * DrDa(tht) ;
-
-        //df/db = df/dr * dr/db
-        dj[1] = DfDr * DrDb(tht) ;
-
-        //df/dn1 = df/dr * dr/dn1
-        dj[2] = DfDr * DrDn1(tht);
-
-        //df/dn2 = df/dr * dr/dn2
-        dj[3] = DfDr * DrDn2(tht);
-
-        //df/dn3 = df/dr * dr/dn3
-        dj[4] = DfDr * DrDn3(tht);
-
-        //df/dx0 = df/dr * dr/dtht *dtht/dx0
-        dj[5]= DfDr * drdth*dthtdx0;
-
-        //df/dy0 = df/dr * dr/dtht *dtht/dy0
-        dj[6]= DfDr * drdth*dthtdy0;
-
-        //df/dth0 = dfdr * dr/dtht * dtht/dtht0
-        dj[7]= DfDr * drdth*dthtdtht0;
-
         ChiSquare += f*f;
 
         if( update ){
@@ -1687,8 +760,12 @@ double RationalSuperShape2D :: XiSquare8D(
     return ChiSquare;
 }
 
+template double RationalSuperShape2D :: XiSquare<5>(const vector < Vector2d, aligned_allocator< Vector2d> > &, Matrix<double,5,5> &, Matrix<double,5,1> &, int, bool) const;
+template double RationalSuperShape2D :: XiSquare<7>(const vector < Vector2d, aligned_allocator< Vector2d> > &, Matrix<double,7,7> &, Matrix<double,7,1> &, int, bool) const;
+template double RationalSuperShape2D :: XiSquare<8>(const vector < Vector2d, aligned_allocator< Vector2d> > &, Matrix<double,8,8> &, Matrix<double,8,1> &, int, bool) const;
+
 
-Vector2d RationalSuperShape2D :: ClosestPoint( Vector2d P, int itmax){
+Vector2d RationalSuperShape2D :: ClosestPoint( Vector2d P, int itmax) const {
 
     // P is supposed to be expressed in canonical referential
 
@@ -1746,7 +823,7 @@ Vector2d RationalSuperShape2D :: ClosestPoint( Vector2d P, int itmax){
 //  }
 
 
-bool RationalSuperShape2D :: ErrorMetric (vector < Vector2d, aligned_allocator< Vector2d> > Data, Vector4d &Mean, Vector4d &Var)
+bool RationalSuperShape2D :: ErrorMetric (vector < Vector2d, aligned_allocator< Vector2d> > Data, Vector4d &Mean, Vector4d &Var) const
 {
     //Bring back data into canonical referential
     double x0(Get_xoffset()), y0(Get_yoffset()), tht0(Get_thtoffset());
@@ -1801,7 +878,7 @@ bool RationalSuperShape2D :: ErrorMetric (vector < Vector2d, aligned_allocator<
     Mean = Vector4d(0,0,0,0);
     Var = Mean;
 
-    vector<double> Dffinal;//dummy local variable to store partial derivatives, unused in this function
+    Vector3d Dffinal;//dummy local variable to store partial derivatives, unused in this function
     //compute Mean
     /*
     glColor3f(1,0,0);
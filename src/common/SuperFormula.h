@@ -44,6 +44,7 @@ the use of this software, even if advised of the possibility of such damage.
 #pragma once
 
 #include <cassert>
+#include <cmath>
 #include <cstring>
 
 #include <Eigen/Core>
@@ -53,6 +54,94 @@ the use of this software, even if advised of the possibility of such damage.
 //USING_PART_OF_NAMESPACE_EIGEN
 using namespace Eigen;
 
+// Number of intersections of a ray with the curve, i.e. value of q, evaluated without any allocation -- the
+// implicit functions fall back to heap buffers beyond it
+#define SUPERSHAPE_MAX_BRANCHES 16
+
+// Parameters of a rational supershape, stored in a fixed size array
+// values[0] : a            values[1] : b
+// values[2] : n1           values[3] : n2            values[4] : n3
+// values[5] : p            values[6] : q
+// values[7] : theta offset values[8] : phi offset   // unused in 2D
+// values[9] : x offset     values[10] : y offset     values[11] : z offset // unused in 2D
+// The struct is trivially copyable: it can be passed by value to the evaluation functions below
+// and shared by several threads.
+struct SuperShapeParams {
+
+        enum { SIZE = 12 };
+
+        double values[SIZE];
+
+        inline double& operator[] (const size_t i) {return values[i];};
+        inline const double& operator[] (const size_t i) const {return values[i];};
+        static inline size_t size() {return SIZE;};
+
+        inline double a() const  {return values [0];};
+        inline double b() const  {return values [1];};
+
+        inline double n1() const {return values [2];};
+        inline double n2() const {return values [3];};
+        inline double n3() const {return values [4];};
+
+        inline double p() const  {return values [5];};
+        inline double q() const  {return values [6];};
+
+        inline double thtoffset() const  {return values [7];};
+        inline double phioffset() const  {return values [8];};
+
+        inline double xoffset() const  {return values [9];};
+        inline double yoffset() const  {return values [10];};
+        inline double zoffset() const  {return values [11];};
+};
+
+// Stateless evaluation of a rational supershape -- pure functions of the parameters, safe to call
+// concurrently on the same parameters
+namespace supershape {
+
+        // radius of the curve at angle tht
+        double radius(const SuperShapeParams& params, const double tht);
+
+        // radius and its partial derivatives regarding a, b, n1, n2, n3 and theta in closed form
+        double radius_and_derivatives(const SuperShapeParams& params, const double tht, double &drda, double &drdb, double &drdn1, double &drdn2, double &drdn3, double &drdtht);
+
+        // finite difference approximation of the derivative of the radius regarding theta
+        double dr_dtheta(const SuperShapeParams& params, const double tht);
+
+        // finite difference approximation of the derivative of the radius regarding one of a, b, n1, n2, n3
+        // (index 0 to 4), computed on a perturbed copy of the parameters
+        double dr_dparameter(const SuperShapeParams& params, const int index, const double tht);
+
+        // implicit functions of a point P in canonical referential, Dffinal receives df/dx, df/dy and df/dr
+        // 1: f = r - |P|, 2: f = 1 - |P|/r, 3: f = log(r^2/|P|^2)
+        double implicit_function1(const SuperShapeParams& params, const Vector2d& P, std::vector <double> &Dffinal);
+        double implicit_function2(const SuperShapeParams& params, const Vector2d& P, std::vector <double> &Dffinal);
+        double implicit_function3(const SuperShapeParams& params, const Vector2d& P, std::vector <double> &Dffinal);
+
+        // same implicit functions writing to a fixed size vector, without any heap allocation
+        double implicit_function1(const SuperShapeParams& params, const Vector2d& P, Vector3d &Dffinal);
+        double implicit_function2(const SuperShapeParams& params, const Vector2d& P, Vector3d &Dffinal);
+        double implicit_function3(const SuperShapeParams& params, const Vector2d& P, Vector3d &Dffinal);
+
+        // contour points stored as a structure of arrays for the batched evaluation
+        struct PointBatch {
+                std::vector<double> x, y;
+
+                void assign(const std::vector< Vector2d, aligned_allocator< Vector2d> > & Data);
+                inline size_t size() const {return x.size();};
+        };
+
+        // RationalSuperShape2D::XiSquare<N> on a batch of points, for curves with q = 1. The pose is applied
+        // as a 2x2 rotation and an offset on whole arrays and only df/dr of the implicit function is computed.
+        // Same operations as XiSquare<N>, the values are identical
+        template<int N>
+        double xi_square_batch(const SuperShapeParams& params, const PointBatch& points,
+                               Matrix<double,N,N> &alpha, Matrix<double,N,1> &beta,
+                               int function_used = 1, bool update = false);
+}
+
+// Rational Gielis curve and its fitting. The evaluation functions are thin wrappers over the
+// supershape namespace. The state lives in the instance only, distinct instances
+// can be fitted concurrently from different threads.
 class RationalSuperShape2D{
 
 	public:
@@ -75,7 +164,7 @@ class RationalSuperShape2D{
         // Parameters[10] : y offset
         // Parameters[11] : z offset // unused in 2D
 
-        std::vector<double> Parameters;
+        SuperShapeParams Parameters;
 
 		//data storage for display
         std::vector< Vector3d, aligned_allocator< Vector3d> > PointList;
@@ -91,27 +180,35 @@ class RationalSuperShape2D{
 
 		//computation
         //double ImplicitFunction0(const Vector2d P, bool op=1, int m=1);
-        double ImplicitFunction1( const Vector2d P, std::vector <double> &Dffinal );
-        double ImplicitFunction2( const Vector2d P, std::vector <double> &Dffinal );
-        double ImplicitFunction3( const Vector2d P, std::vector <double> &Dffinal );
-
-        double DrDa(const double);
-        double DrDb(const double);
-        double DrDn1(const double);
-        double DrDn2(const double);
-        double DrDn3(const double);
-
-        void GetPartialDerivatives(double tht, double &DrDa, double &DrDb, double &DrDn1, double &DrDn2, double &DrDn3);
-
+        double ImplicitFunction1( const Vector2d P, std::vector <double> &Dffinal ) const {return supershape::implicit_function1(Parameters, P, Dffinal);};
+        double ImplicitFunction2( const Vector2d P, std::vector <double> &Dffinal ) const {return supershape::implicit_function2(Parameters, P, Dffinal);};
+        double ImplicitFunction3( const Vector2d P, std::vector <double> &Dffinal ) const {return supershape::implicit_function3(Parameters, P, Dffinal);};
+        double ImplicitFunction1( const Vector2d P, Vector3d &Dffinal ) const {return supershape::implicit_function1(Parameters, P, Dffinal);};
+        double ImplicitFunction2( const Vector2d P, Vector3d &Dffinal ) const {return supershape::implicit_function2(Parameters, P, Dffinal);};
+        double ImplicitFunction3( const Vector2d P, Vector3d &Dffinal ) const {return supershape::implicit_function3(Parameters, P, Dffinal);};
+
+        double DrDa(const double tht) const  {return supershape::dr_dparameter(Parameters, 0, tht);};
+        double DrDb(const double tht) const  {return supershape::dr_dparameter(Parameters, 1, tht);};
+        double DrDn1(const double tht) const {return supershape::dr_dparameter(Parameters, 2, tht);};
+        double DrDn2(const double tht) const {return supershape::dr_dparameter(Parameters, 3, tht);};
+        double DrDn3(const double tht) const {return supershape::dr_dparameter(Parameters, 4, tht);};
+
+        void GetPartialDerivatives(double tht, double &DrDa, double &DrDb, double &DrDn1, double &DrDn2, double &DrDn3) const;
+
+        //radius and its partial derivatives regarding a, b, n1, n2, n3 and theta in closed form, sharing
+        //the cos/sin/pow subexpressions. The DrDxx functions above are the finite difference references
+        double RadiusAndDerivatives(const double tht, double &DrDa, double &DrDb, double &DrDn1, double &DrDn2, double &DrDn3, double &DrDtht) const
+            {return supershape::radius_and_derivatives(Parameters, tht, DrDa, DrDb, DrDn1, DrDn2, DrDn3, DrDtht);};
+
+        //Levenberg-Marquardt fit of a, b, n1, n2, n3 (5D), plus the x and y offsets (7D), plus the
+        //angular offset (8D), see levenberg_marquardt in levenbergMarquardt.h
         void Optimize5D(
-            std::string outfilename, //file to store the evolution of the best fitted curve though iterations
             const std::vector< Vector2d, aligned_allocator< Vector2d> > &, // array of 2D points
             double & ,         //error of fit
             int functionused = 1 //index of the implicit function used:1,2,or 3
             );
 
         void Optimize7D(
-            std::string outfilename, //file to store the evolution of the best fitted curve though iterations
             const std::vector< Vector2d, aligned_allocator< Vector2d> > &, // array of 2D points
             double & ,         //error of fit
             int functionused = 1 //index of the implicit function used:1,2,or 3
@@ -123,48 +220,36 @@ class RationalSuperShape2D{
             int functionused = 1 //index of the implicit function used:1,2,or 3
             );
 
-        //sub function used in the baove function to compute hessian approx and gradient
-        double XiSquare5D(
+        //sub function used in the above functions to compute hessian approx and gradient regarding the
+        //N = 5, 7 or 8 optimised parameters. alpha and beta are left untouched when update is false
+        template<int N>
+        double XiSquare(
                       const std::vector < Vector2d, aligned_allocator< Vector2d> > & Data,    //array of 2D points
-                      MatrixXd &alpha,      //hessian approximation
-                      VectorXd &beta,       //gradient approximation
+                      Matrix<double,N,N> &alpha,      //hessian approximation
+                      Matrix<double,N,1> &beta,       //gradient approximation
                       int function_used = 1,    //index of the implicit function used
-                      bool udpate = false); //boolean if hessian and gradient have to be updated or not
+                      bool udpate = false) const; //boolean if hessian and gradient have to be updated or not
 
-        double XiSquare7D(
-                      const std::vector < Vector2d, aligned_allocator< Vector2d> > & Data,    //array of 2D points
-                      MatrixXd &alpha,      //hessian approximation
-                      VectorXd &beta,       //gradient approximation
-                      int function_used = 1,    //index of the implicit function used
-                      bool udpate = false); //boolean if hessian and gradient have to be updated or not
+		double radius ( const double angle ) const {return supershape::radius(Parameters, angle);};
 
-        double XiSquare8D(
-                      const std::vector < Vector2d, aligned_allocator< Vector2d> > & Data,    //array of 2D points
-                      MatrixXd &alpha,      //hessian approximation
-                      VectorXd &beta,       //gradient approximation
-                      int function_used = 1,    //index of the implicit function used
-                      bool udpate = false); //boolean if hessian and gradient have to be updated or not
+        inline Vector2d Point( double angle) const {double r = radius(angle); return Vector2d (r*cos(angle),r*sin(angle));};
 
-		double radius ( const double angle );
+        inline double Get_a() const  {return Parameters [0];};
+        inline double Get_b() const  {return Parameters [1];};
 
-        inline Vector2d Point( double angle) {double r = radius(angle); return Vector2d (r*cos(angle),r*sin(angle));};
+        inline double Get_n1() const {return Parameters [2];};
+        inline double Get_n2() const {return Parameters [3];};
+        inline double Get_n3() const {return Parameters [4];};
 
-        inline double Get_a()  {return Parameters [0];};
-        inline double Get_b()  {return Parameters [1];};
+        inline double Get_p() const  {return Parameters [5];};
+        inline double Get_q() const  {return Parameters [6];};
 
-        inline double Get_n1() {return Parameters [2];};
-        inline double Get_n2() {return Parameters [3];};
-        inline double Get_n3() {return Parameters [4];};
+        inline double Get_thtoffset() const  {return Parameters [7];};
+        inline double Get_phioffset() const  {return Parameters [8];};
 
-        inline double Get_p()  {return Parameters [5];};
-        inline double Get_q()  {return Parameters [6];};
-
-        inline double Get_thtoffset()  {return Parameters [7];};
-        inline double Get_phioffset()  {return Parameters [8];};
-
-        inline double Get_xoffset()  {return Parameters [9];};
-        inline double Get_yoffset()  {return Parameters [10];};
-        inline double Get_zoffset()  {return Parameters [11];};
+        inline double Get_xoffset() const  {return Parameters [9];};
+        inline double Get_yoffset() const  {return Parameters [10];};
+        inline double Get_zoffset() const  {return Parameters [11];};
 
         inline void Set_a ( const double a)  {Parameters [0]=fabs(a);};
         inline void Set_b ( const double b)  {Parameters [1]=fabs(b);};
@@ -190,13 +275,13 @@ class RationalSuperShape2D{
 	// Guillaume stupid function 
     //void writeFile(std::std::string fileName);
 
-        double DrDtheta(double tht);
+        double DrDtheta(double tht) const {return supershape::dr_dtheta(Parameters, tht);};
 
 
         //update Guillaume
 
         //first and second order approximation of the distance point to curve(tht) regarding tht
-        inline double Deriv1(double tht, Vector2d P, double delta = 1e-3)
+        inline double Deriv1(double tht, Vector2d P, double delta = 1e-3) const
         {
         Vector4d V(
                   Distance (P, tht-2*delta),
@@ -208,7 +293,7 @@ class RationalSuperShape2D{
         return V.sum() / (12*delta);
         };
 
-        inline double Deriv2(double theta, Vector2d P, double delta = 1e-3)
+        inline double Deriv2(double theta, Vector2d P, double delta = 1e-3) const
         {
 
         VectorXd V(5);
@@ -223,12 +308,12 @@ class RationalSuperShape2D{
 
         //distance between point and point (tht) on the curve:
 
-        inline double Distance (Vector2d P, double tht)
+        inline double Distance (Vector2d P, double tht) const
         {
         //convert P in polar coordinates. P must be in canonical ref
 
         Vector2d Ppol(P.norm(), atan2(P[1],P[0]));
-        if (Ppol[1]<0) Ppol[1] += 2*PI;
+        if (Ppol[1]<0) Ppol[1] += 2*M_PI;
 
         double r (radius(tht));
         return sqrt( r*r + Ppol[0]*Ppol[0] - 2*r*Ppol[0]*cos(tht-Ppol[1]));
@@ -236,10 +321,10 @@ class RationalSuperShape2D{
         };
 
         //variation of gauss newton algo for shortest distance computation
-        Vector2d ClosestPoint( Vector2d P, int itmax = 10);
+        Vector2d ClosestPoint( Vector2d P, int itmax = 10) const;
 
         //computation of the four cost functions for a given data set, returns Mean and Var for each cost function
-        bool ErrorMetric (std::vector < Vector2d, aligned_allocator< Vector2d> > Data, Vector4d &Mean, Vector4d &Var);
+        bool ErrorMetric (std::vector < Vector2d, aligned_allocator< Vector2d> > Data, Vector4d &Mean, Vector4d &Var) const;
 };
 
 inline std::ostream& operator<<(std::ostream& os, const RationalSuperShape2D& RS2D)
@@ -253,3 +338,6 @@ inline std::ostream& operator<<(std::ostream& os, const RationalSuperShape2D& RS
 void RpUnion(double f1, double f2, std::vector<double> Df1, std::vector<double> Df2, double &f, std::vector<double> &Df);
 void RpIntersection(double f1, double f2, std::vector<double> Df1, std::vector<double> Df2, double &f, std::vector<double> &Df);
 
+//Rfunction union on fixed size partial derivatives df/dx, df/dy, df/dr
+void RpUnion(double f1, double f2, const Vector3d &Df1, const Vector3d &Df2, double &f, Vector3d &Df);
+
@@ -0,0 +1,167 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+#include "math_utils.h"
+#include "SuperFormula.h"
+
+// stl library
+#include <cmath>
+
+namespace supershape {
+
+  void PointBatch::assign(const std::vector< Vector2d, aligned_allocator< Vector2d> > & Data) {
+    x.resize(Data.size());
+    y.resize(Data.size());
+    for (size_t i = 0; i < Data.size(); ++i) {
+      x[i] = Data[i][0];
+      y[i] = Data[i][1];
+    }
+  }
+
+  namespace {
+
+    // Inverse pose of the curve: the points are translated by -(x0, y0) then rotated by -tht0
+    struct Pose {
+      double x0, y0, cos_tht0, sin_tht0;
+
+      explicit Pose(const SuperShapeParams& params)
+        : x0(params.xoffset()), y0(params.yoffset()),
+          cos_tht0(std::cos(params.thtoffset())), sin_tht0(std::sin(params.thtoffset())) {}
+    };
+
+    // Sum of squared potentials of n points, alpha and beta are accumulated and not cleared.
+    // Same operations as RationalSuperShape2D::XiSquare<N>, on a single branch. The partial derivatives of the
+    // pose are constant -- dx/dx0 = -cos(tht0), dy/dx0 = sin(tht0), dx/dy0 = -sin(tht0), dy/dy0 = -cos(tht0),
+    // dx/dtht0 = y and dy/dtht0 = -x
+    template<int N>
+    double xi_square_points(const SuperShapeParams& params, const Pose& pose, const double* xs, const double* ys, const int n,
+                            Matrix<double,N,N> &alpha, Matrix<double,N,1> &beta, const int function_used, const bool update) {
+
+      Matrix<double,N,1> dj;
+      double ChiSquare(0);
+
+      for (int i = 0; i < n; ++i) {
+
+        const double tx(xs[i] - pose.x0), ty(ys[i] - pose.y0);
+        const double x(pose.cos_tht0 * tx + pose.sin_tht0 * ty);
+        const double y(-pose.sin_tht0 * tx + pose.cos_tht0 * ty);
+
+        const double PSL(x*x + y*y), PL(std::sqrt(PSL));
+        if (PL < EPSILON) continue; // avoids division by zero
+
+        double tht = std::atan2(y, x); if (tht < 0) tht += 2.*PI;
+
+        double R, drda(0), drdb(0), drdn1(0), drdn2(0), drdn3(0), drdtht(0);
+        if (update)
+          R = radius_and_derivatives(params, tht, drda, drdb, drdn1, drdn2, drdn3, drdtht);
+        else
+          R = radius(params, tht);
+
+        // implicit function and df/dr
+        double f, DfDr;
+        switch (function_used) {
+        case 2 :  f = 1. - PL/R; DfDr = PL/(R*R); break;
+        case 3 :  f = std::log(R*R / PSL); DfDr = 2./R; break;
+        default : f = R - PL; DfDr = 1.;
+        }
+
+        ChiSquare += f*f;
+
+        if (!update) continue;
+
+        dj[0] = DfDr * drda;
+        dj[1] = DfDr * drdb;
+        dj[2] = DfDr * drdn1;
+        dj[3] = DfDr * drdn2;
+        dj[4] = DfDr * drdn3;
+
+        if (N > 5) {
+          const double dthtdx(-std::sin(tht)), dthtdy(std::cos(tht));
+
+          const double dthtdx0 = dthtdx * -pose.cos_tht0 + dthtdy * pose.sin_tht0;
+          const double dthtdy0 = dthtdx * -pose.sin_tht0 + dthtdy * -pose.cos_tht0;
+          dj[5] = DfDr * drdtht*dthtdx0;
+          dj[6] = DfDr * drdtht*dthtdy0;
+
+          if (N > 7) {
+            const double dthtdtht0 = dthtdx * y + dthtdy * -x;
+            dj[7] = DfDr * drdtht*dthtdtht0;
+          }
+        }
+
+        beta -= f*dj;
+        for (int k = 0; k < 5; k++)
+          for (int j = 0; j < 5; j++)
+            alpha(k,j) += dj[k]*dj[j];
+      }
+
+      return ChiSquare;
+    }
+
+  }
+
+  /*
+   * Sum of squared potentials of a batch of points, hessian and gradient approximations
+   */
+  template<int N>
+  double xi_square_batch(const SuperShapeParams& params, const PointBatch& points,
+                         Matrix<double,N,N> &alpha, Matrix<double,N,1> &beta,
+                         int function_used, bool update) {
+
+    static_assert(N == 5 || N == 7 || N == 8, "the fit optimises 5, 7 or 8 parameters");
+    assert(params.q() == 1);
+
+    if (update) {
+      alpha.setZero();
+      beta.setZero();
+    }
+
+    return xi_square_points<N>(params, Pose(params), points.x.data(), points.y.data(), static_cast<int> (points.size()),
+                               alpha, beta, function_used, update);
+  }
+
+  template double xi_square_batch<5>(const SuperShapeParams&, const PointBatch&, Matrix<double,5,5> &, Matrix<double,5,1> &, int, bool);
+  template double xi_square_batch<7>(const SuperShapeParams&, const PointBatch&, Matrix<double,7,7> &, Matrix<double,7,1> &, int, bool);
+  template double xi_square_batch<8>(const SuperShapeParams&, const PointBatch&, Matrix<double,8,8> &, Matrix<double,8,1> &, int, bool);
+
+}
@@ -42,58 +42,44 @@ the use of this software, even if advised of the possibility of such damage.
 */
 
 #include "colorConversion.h"
+#include "parallel.h"
 
 namespace colorconversion {
 
-// Function to convert an RGB image (uchar) to log chromatic format (double)
-void rgb_to_log_rb(const cv::Mat& rgbImage, std::vector< cv::Mat >& log_chromatic_image) {
-
-    // Allocate the output - Format: double with two channels
-    cv::Mat log_chromatic_r = cv::Mat::zeros(rgbImage.size(), CV_32F);
-    cv::Mat log_chromatic_b = cv::Mat::zeros(rgbImage.size(), CV_32F);
-    if (!log_chromatic_image.empty())
-        log_chromatic_image.erase(log_chromatic_image.begin(), log_chromatic_image.end());
-    
-    // Split the channels rgb
-    //std::vector< cv::Mat > rgbVector;
-
-    const int blockIter = 64;
-    const int Niiter = std::max(1, int(std::ceil(float(rgbImage.rows)/blockIter)));
-    const int Njiter = std::max(1, int(std::ceil(float(rgbImage.cols)/blockIter)));
-
-    for (int iit = 0; iit <= Niiter; ++iit)
-    {
-        for (int i = iit*blockIter ; i < iit*(blockIter+1); i++) {
-
-            if(i>=rgbImage.rows)
-            {
-                break;
-            }
-
-            for (int jit = 0; jit <= Njiter; ++jit)
-            {
-                for (int j = jit*blockIter; j < jit*(blockIter+1); j++) {
+// Table of the log chromatic ratios, built on first use
+const float* log_chromatic_table() {
+
+    // Thread safe initialisation of the function local static
+    static const std::vector< float > table = []() {
+        std::vector< float > values(LOG_CHROMATIC_TABLE_SIZE);
+        for (int g = 0; g < 256; g++) {
+            // Do not divide by zero
+            const float division = 1.0f / static_cast<float> (g == 0 ? g + 1 : g);
+            for (int c = 0; c < 256; c++)
+                values[log_chromatic_index(static_cast<uchar> (c), static_cast<uchar> (g))] = std::log(static_cast<float> (c) * division);
+        }
+        return values;
+    }();
 
-                    if(j>=rgbImage.cols)
-                    {
-                        break;
-                    }
+    return table.data();
+}
 
-                    // The image in opencv are encoded in BGR and not RGB
-                    const cv::Vec3b px = rgbImage.at<cv::Vec3b>(i, j);
+// Function to convert an RGB image (uchar) to log chromatic format (float)
+void rgb_to_log_rb(const cv::Mat& rgbImage, std::vector< cv::Mat >& log_chromatic_image, const simd::Level level) {
 
-                    // Do not divide by zero
-                    // Compute the log chromatic red
-                    const float division = 1.0f / static_cast<float> (px[1] == 0 ? px[1] + 1 : px[1]);
-                    log_chromatic_r.at<float>(i, j) = std::log(static_cast<float> (px[2])*division);
+    // Check the that the image has three channels
+    CV_Assert(rgbImage.channels() == 3 && rgbImage.depth() == CV_8U);
 
-                    // Compute the log chromatic blue
-                    log_chromatic_b.at<float>(i, j) = std::log(static_cast<float> (px[0])*division);
-                }
-            }
-        }
+    // Allocate the output - Format: float with two channels
+    cv::Mat log_chromatic_r(rgbImage.size(), CV_32F);
+    cv::Mat log_chromatic_b(rgbImage.size(), CV_32F);
+    if (!log_chromatic_image.empty())
+        log_chromatic_image.erase(log_chromatic_image.begin(), log_chromatic_image.end());
 
-    }
+    parallel::parallel_for_rows(rgbImage.rows, [&](const int row_begin, const int row_end) {
+            for (int i = row_begin; i < row_end; i++)
+                log_rb_row_simd(rgbImage.ptr<uchar>(i), log_chromatic_r.ptr<float>(i), log_chromatic_b.ptr<float>(i), rgbImage.cols, level);
+        });
 
     log_chromatic_image.push_back(log_chromatic_r);
     log_chromatic_image.push_back(log_chromatic_b);
@@ -109,12 +95,17 @@ void convert_rgb_to_ihls(const cv::Mat& rgb_image, cv::Mat& ihls_image) {
     // ihls_image.create(rgb_image.size(), CV_8UC3);
     ihls_image = rgb_image.clone();
 
-    for (auto it = ihls_image.begin<cv::Vec3b>(); it != ihls_image.end<cv::Vec3b>(); ++it) {
-        const cv::Vec3b bgr = (*it);
-        (*it)[0] = static_cast<uchar> (retrieve_saturation(static_cast<float> (bgr[2]), static_cast<float> (bgr[1]), static_cast<float> (bgr[0])));
-        (*it)[1] = static_cast<uchar> (retrieve_luminance(static_cast<float> (bgr[2]), static_cast<float> (bgr[1]), static_cast<float> (bgr[0])));
-        (*it)[2] = static_cast<uchar> (retrieve_normalised_hue(static_cast<float> (bgr[2]), static_cast<float> (bgr[1]), static_cast<float> (bgr[0])));
-    }
+    parallel::parallel_for_rows(ihls_image.rows, [&](const int row_begin, const int row_end) {
+            for (int i = row_begin; i < row_end; i++) {
+                cv::Vec3b* px = ihls_image.ptr<cv::Vec3b>(i);
+                for (int j = 0; j < ihls_image.cols; j++) {
+                    const cv::Vec3b bgr = px[j];
+                    px[j][0] = static_cast<uchar> (retrieve_saturation(static_cast<float> (bgr[2]), static_cast<float> (bgr[1]), static_cast<float> (bgr[0])));
+                    px[j][1] = static_cast<uchar> (retrieve_luminance(static_cast<float> (bgr[2]), static_cast<float> (bgr[1]), static_cast<float> (bgr[0])));
+                    px[j][2] = static_cast<uchar> (retrieve_normalised_hue(static_cast<float> (bgr[2]), static_cast<float> (bgr[1]), static_cast<float> (bgr[0])));
+                }
+            }
+        });
 }
 
 }
@@ -45,6 +45,7 @@ the use of this software, even if advised of the possibility of such damage.
 
 // own library
 #include "math_utils.h"
+#include "simd.h"
 
 // stl library
 #include <vector>
@@ -55,12 +56,46 @@ the use of this software, even if advised of the possibility of such damage.
 
 namespace colorconversion {
 
-  // Conversion from RGB to logarithm RB
-  void rgb_to_log_rb(const cv::Mat& rgb_image, std::vector< cv::Mat >& log_chromatic_image);
+  // Number of entries of the log chromatic table -- one per pair (channel, green) of 8-bit values
+  const int LOG_CHROMATIC_TABLE_SIZE = 256 * 256;
+
+  // Index in the log chromatic table of the ratio between a channel and the green channel
+  inline int log_chromatic_index(const uchar& c, const uchar& g) { return (static_cast<int> (g) << 8) | static_cast<int> (c); }
+
+  // Read-only table of log(c / max(g, 1)) for all the 8-bit values of c and g. It is built once on first
+  // use and shared by the whole process, each entry is exactly the value computed per pixel before.
+  const float* log_chromatic_table();
+
+  // Conversion from RGB to logarithm RB -- the ratios are looked up in the log chromatic table, with an
+  // AVX2 gather when the CPU supports it
+  void rgb_to_log_rb(const cv::Mat& rgb_image, std::vector< cv::Mat >& log_chromatic_image, const simd::Level level = simd::LEVEL_AUTO);
+
+  // Lookup of the log chromatic ratios of n BGR pixels -- vectorized version used by rgb_to_log_rb
+  void log_rb_row_simd(const uchar* bgr, float* log_r, float* log_b, const int n, const simd::Level level = simd::LEVEL_AUTO);
 
   // Conversion from RGB to IHLS
   void convert_rgb_to_ihls(const cv::Mat& rgb_image, cv::Mat& ihls_image);
 
+  // Conversion from RGB to IHLS using vectorized kernels selected at runtime from the CPU features.
+  // The hue relies on approximations of acos and of the inverse square root and differs from
+  // convert_rgb_to_ihls by at most one level. The saturation and the luminance are identical.
+  void convert_rgb_to_ihls_simd(const cv::Mat& rgb_image, cv::Mat& ihls_image, const simd::Level level = simd::LEVEL_AUTO);
+
+  // Polynomial approximation of acos -- Abramowitz and Stegun 4.4.46 -- absolute error below 5e-7 rad in float
+  inline float approx_acos(const float& x) {
+    const float ax = std::fabs(x);
+    float p = -0.0012624911f;
+    p = p * ax + 0.0066700901f;
+    p = p * ax - 0.0170881256f;
+    p = p * ax + 0.0308918810f;
+    p = p * ax - 0.0501743046f;
+    p = p * ax + 0.0889789874f;
+    p = p * ax - 0.2145988016f;
+    p = p * ax + 1.5707963050f;
+    const float r = std::sqrt(1.0f - ax) * p;
+    return (x < 0.0f) ? (static_cast<float> (M_PI) - r) : r;
+  }
+
   // Theta computation
   inline float retrieve_theta(const float& r, const float& g, const float& b) { return acos((r - (g * 0.5) - (b * 0.5)) / sqrtf((r * r) + (g * g) + (b * b) - (r * g) - (r * b) - (g * b))); }
   // Hue computation -- H = θ if B <= G -- H = 2 * pi − θ if B > G
@@ -0,0 +1,309 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+#include "colorConversion.h"
+#include "parallel.h"
+
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace colorconversion {
+
+namespace {
+
+    // Number of pixels deinterleaved and converted at once -- multiple of the widest vector
+    const int ihls_chunk_size = 64;
+
+    // Scaling from theta to the normalised hue
+    const float hue_scale = static_cast<float> (255.0 / (2.0 * M_PI));
+
+    // Convert n pixels stored as planar float channels to planar saturation, luminance and hue.
+    // The kernels may process up to the next multiple of their width, the buffers are padded accordingly.
+    typedef void (*ihls_chunk_kernel)(const float* r, const float* g, const float* b, float* s, float* l, float* h, const int n);
+
+    void ihls_chunk_scalar(const float* r, const float* g, const float* b, float* s, float* l, float* h, const int n) {
+        for (int j = 0; j < n; ++j) {
+            s[j] = retrieve_saturation(r[j], g[j], b[j]);
+            l[j] = retrieve_luminance(r[j], g[j], b[j]);
+
+            // Grey pixels have an undefined theta, the reference gives a null hue
+            const float num = r[j] - 0.5f * g[j] - 0.5f * b[j];
+            const float den2 = r[j] * r[j] + g[j] * g[j] + b[j] * b[j] - r[j] * g[j] - r[j] * b[j] - g[j] * b[j];
+            if (den2 <= 0.0f) {
+                h[j] = 0.0f;
+                continue;
+            }
+            const float x = std::min(1.0f, std::max(-1.0f, num / std::sqrt(den2)));
+            const float theta = approx_acos(x);
+            h[j] = (b[j] <= g[j]) ? (theta * hue_scale) : ((2.0f * static_cast<float> (M_PI) - theta) * hue_scale);
+        }
+    }
+
+#if SIMD_X86
+
+    SIMD_TARGET_SSE41 inline __m128 rsqrt_nr_sse(const __m128 x) {
+        // One Newton-Raphson step on the hardware estimate -- relative error around 1e-7
+        const __m128 y = _mm_rsqrt_ps(x);
+        const __m128 yyx = _mm_mul_ps(_mm_mul_ps(y, y), x);
+        return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), y), _mm_sub_ps(_mm_set1_ps(3.0f), yyx));
+    }
+
+    SIMD_TARGET_SSE41 void ihls_chunk_sse41(const float* r_in, const float* g_in, const float* b_in, float* s_out, float* l_out, float* h_out, const int n) {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 minus_one = _mm_set1_ps(-1.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        const __m128 pi = _mm_set1_ps(static_cast<float> (M_PI));
+        const __m128 two_pi = _mm_set1_ps(2.0f * static_cast<float> (M_PI));
+        const __m128 scale = _mm_set1_ps(hue_scale);
+
+        for (int j = 0; j < n; j += 4) {
+            const __m128 r = _mm_load_ps(r_in + j);
+            const __m128 g = _mm_load_ps(g_in + j);
+            const __m128 b = _mm_load_ps(b_in + j);
+
+            // Saturation and luminance -- same operations and order as the scalar reference
+            _mm_store_ps(s_out + j, _mm_sub_ps(_mm_max_ps(r, _mm_max_ps(g, b)), _mm_min_ps(r, _mm_min_ps(g, b))));
+            _mm_store_ps(l_out + j, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.210f), r), _mm_mul_ps(_mm_set1_ps(0.715f), g)), _mm_mul_ps(_mm_set1_ps(0.072f), b)));
+
+            // Cosine of theta
+            const __m128 num = _mm_sub_ps(_mm_sub_ps(r, _mm_mul_ps(half, g)), _mm_mul_ps(half, b));
+            const __m128 den2 = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(g, g)), _mm_mul_ps(b, b)),
+                                                                 _mm_mul_ps(r, g)), _mm_mul_ps(r, b)), _mm_mul_ps(g, b));
+            const __m128 valid = _mm_cmpgt_ps(den2, zero);
+            __m128 x = _mm_mul_ps(num, rsqrt_nr_sse(den2));
+            x = _mm_min_ps(one, _mm_max_ps(minus_one, x));
+
+            // acos -- sqrt(1 - |x|) * poly(|x|), reflected for the negative values
+            const __m128 ax = _mm_andnot_ps(sign, x);
+            __m128 p = _mm_set1_ps(-0.0012624911f);
+            p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps(0.0066700901f));
+            p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps(-0.0170881256f));
+            p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps(0.0308918810f));
+            p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps(-0.0501743046f));
+            p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps(0.0889789874f));
+            p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps(-0.2145988016f));
+            p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps(1.5707963050f));
+            const __m128 t = _mm_sub_ps(one, ax);
+            const __m128 sqrt_t = _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_mul_ps(t, rsqrt_nr_sse(t)));
+            const __m128 acos_ax = _mm_mul_ps(sqrt_t, p);
+            const __m128 theta = _mm_blendv_ps(acos_ax, _mm_sub_ps(pi, acos_ax), _mm_cmplt_ps(x, zero));
+
+            // Normalised hue, null for the grey pixels
+            const __m128 hue = _mm_mul_ps(_mm_blendv_ps(_mm_sub_ps(two_pi, theta), theta, _mm_cmple_ps(b, g)), scale);
+            _mm_store_ps(h_out + j, _mm_and_ps(valid, hue));
+        }
+    }
+
+    SIMD_TARGET_AVX2 inline __m256 rsqrt_nr_avx(const __m256 x) {
+        const __m256 y = _mm256_rsqrt_ps(x);
+        const __m256 yyx = _mm256_mul_ps(_mm256_mul_ps(y, y), x);
+        return _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), y), _mm256_sub_ps(_mm256_set1_ps(3.0f), yyx));
+    }
+
+    // Same computation as ihls_chunk_sse41 on eight lanes -- FMA is deliberately not used to keep the
+    // saturation and the luminance identical to the scalar reference
+    SIMD_TARGET_AVX2 void ihls_chunk_avx2(const float* r_in, const float* g_in, const float* b_in, float* s_out, float* l_out, float* h_out, const int n) {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 minus_one = _mm256_set1_ps(-1.0f);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        const __m256 pi = _mm256_set1_ps(static_cast<float> (M_PI));
+        const __m256 two_pi = _mm256_set1_ps(2.0f * static_cast<float> (M_PI));
+        const __m256 scale = _mm256_set1_ps(hue_scale);
+
+        for (int j = 0; j < n; j += 8) {
+            const __m256 r = _mm256_load_ps(r_in + j);
+            const __m256 g = _mm256_load_ps(g_in + j);
+            const __m256 b = _mm256_load_ps(b_in + j);
+
+            _mm256_store_ps(s_out + j, _mm256_sub_ps(_mm256_max_ps(r, _mm256_max_ps(g, b)), _mm256_min_ps(r, _mm256_min_ps(g, b))));
+            _mm256_store_ps(l_out + j, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.210f), r), _mm256_mul_ps(_mm256_set1_ps(0.715f), g)), _mm256_mul_ps(_mm256_set1_ps(0.072f), b)));
+
+            const __m256 num = _mm256_sub_ps(_mm256_sub_ps(r, _mm256_mul_ps(half, g)), _mm256_mul_ps(half, b));
+            const __m256 den2 = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, r), _mm256_mul_ps(g, g)), _mm256_mul_ps(b, b)),
+                                                                          _mm256_mul_ps(r, g)), _mm256_mul_ps(r, b)), _mm256_mul_ps(g, b));
+            const __m256 valid = _mm256_cmp_ps(den2, zero, _CMP_GT_OQ);
+            __m256 x = _mm256_mul_ps(num, rsqrt_nr_avx(den2));
+            x = _mm256_min_ps(one, _mm256_max_ps(minus_one, x));
+
+            const __m256 ax = _mm256_andnot_ps(sign, x);
+            __m256 p = _mm256_set1_ps(-0.0012624911f);
+            p = _mm256_add_ps(_mm256_mul_ps(p, ax), _mm256_set1_ps(0.0066700901f));
+            p = _mm256_add_ps(_mm256_mul_ps(p, ax), _mm256_set1_ps(-0.0170881256f));
+            p = _mm256_add_ps(_mm256_mul_ps(p, ax), _mm256_set1_ps(0.0308918810f));
+            p = _mm256_add_ps(_mm256_mul_ps(p, ax), _mm256_set1_ps(-0.0501743046f));
+            p = _mm256_add_ps(_mm256_mul_ps(p, ax), _mm256_set1_ps(0.0889789874f));
+            p = _mm256_add_ps(_mm256_mul_ps(p, ax), _mm256_set1_ps(-0.2145988016f));
+            p = _mm256_add_ps(_mm256_mul_ps(p, ax), _mm256_set1_ps(1.5707963050f));
+            const __m256 t = _mm256_sub_ps(one, ax);
+            const __m256 sqrt_t = _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GT_OQ), _mm256_mul_ps(t, rsqrt_nr_avx(t)));
+            const __m256 acos_ax = _mm256_mul_ps(sqrt_t, p);
+            const __m256 theta = _mm256_blendv_ps(acos_ax, _mm256_sub_ps(pi, acos_ax), _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+
+            const __m256 hue = _mm256_mul_ps(_mm256_blendv_ps(_mm256_sub_ps(two_pi, theta), theta, _mm256_cmp_ps(b, g, _CMP_LE_OQ)), scale);
+            _mm256_store_ps(h_out + j, _mm256_and_ps(valid, hue));
+        }
+    }
+
+#endif
+
+    ihls_chunk_kernel select_ihls_kernel(const simd::Level level) {
+#if SIMD_X86
+        switch (simd::select_level(level)) {
+        case simd::LEVEL_AVX2:
+            return ihls_chunk_avx2;
+        case simd::LEVEL_SSE41:
+            return ihls_chunk_sse41;
+        default:
+            break;
+        }
+#else
+        (void) level;
+#endif
+        return ihls_chunk_scalar;
+    }
+
+}
+
+// Conversion from RGB to IHLS using vectorized kernels
+void convert_rgb_to_ihls_simd(const cv::Mat& rgb_image, cv::Mat& ihls_image, const simd::Level level) {
+
+    // Check the that the image has three channels
+    CV_Assert(rgb_image.channels() == 3 && rgb_image.depth() == CV_8U);
+
+    // Create the output image if needed -- a chunk is fully read before being written so that the
+    // conversion can be done in place
+    ihls_image.create(rgb_image.size(), CV_8UC3);
+
+    const ihls_chunk_kernel kernel = select_ihls_kernel(level);
+
+    parallel::parallel_for_rows(rgb_image.rows, [&](const int row_begin, const int row_end) {
+            // Planar buffers for one chunk, the padding lanes are kept initialised
+            alignas(32) float r[ihls_chunk_size] = {}, g[ihls_chunk_size] = {}, b[ihls_chunk_size] = {};
+            alignas(32) float s[ihls_chunk_size], l[ihls_chunk_size], h[ihls_chunk_size];
+
+            for (int i = row_begin; i < row_end; ++i) {
+                const uchar* src = rgb_image.ptr<uchar>(i);
+                uchar* dst = ihls_image.ptr<uchar>(i);
+
+                for (int j0 = 0; j0 < rgb_image.cols; j0 += ihls_chunk_size) {
+                    const int n = std::min(ihls_chunk_size, rgb_image.cols - j0);
+
+                    // The image in opencv are encoded in BGR and not RGB
+                    const uchar* px = src + 3 * j0;
+                    for (int j = 0; j < n; ++j) {
+                        b[j] = static_cast<float> (px[3 * j]);
+                        g[j] = static_cast<float> (px[3 * j + 1]);
+                        r[j] = static_cast<float> (px[3 * j + 2]);
+                    }
+
+                    kernel(r, g, b, s, l, h, n);
+
+                    uchar* out = dst + 3 * j0;
+                    for (int j = 0; j < n; ++j) {
+                        out[3 * j] = static_cast<uchar> (s[j]);
+                        out[3 * j + 1] = static_cast<uchar> (l[j]);
+                        out[3 * j + 2] = static_cast<uchar> (h[j]);
+                    }
+                }
+            }
+        });
+}
+
+
+namespace {
+
+    // Lookup of the log chromatic ratios of n BGR pixels
+    typedef void (*log_rb_row_kernel)(const uchar* bgr, float* log_r, float* log_b, const int n);
+
+    void log_rb_row_scalar(const uchar* bgr, float* log_r, float* log_b, const int n) {
+        const float* table = log_chromatic_table();
+        for (int j = 0; j < n; ++j, bgr += 3) {
+            // The image in opencv are encoded in BGR and not RGB
+            log_r[j] = table[log_chromatic_index(bgr[2], bgr[1])];
+            log_b[j] = table[log_chromatic_index(bgr[0], bgr[1])];
+        }
+    }
+
+#if SIMD_X86
+
+    SIMD_TARGET_AVX2 void log_rb_row_avx2(const uchar* bgr, float* log_r, float* log_b, const int n) {
+        const float* table = log_chromatic_table();
+
+        // 8 pixels per iteration -- the deinterleaving reads 24 bytes
+        int j = 0;
+        for (; j + 8 <= n; j += 8, bgr += 24) {
+            __m256i b, g, r;
+            simd::load_bgr8_epi32(bgr, b, g, r);
+            const __m256i g_high = _mm256_slli_epi32(g, 8);
+            _mm256_storeu_ps(log_r + j, _mm256_i32gather_ps(table, _mm256_or_si256(g_high, r), 4));
+            _mm256_storeu_ps(log_b + j, _mm256_i32gather_ps(table, _mm256_or_si256(g_high, b), 4));
+        }
+
+        log_rb_row_scalar(bgr, log_r + j, log_b + j, n - j);
+    }
+
+#endif
+
+    log_rb_row_kernel select_log_rb_kernel(const simd::Level level) {
+#if SIMD_X86
+        if (simd::select_level(level) == simd::LEVEL_AVX2)
+            return log_rb_row_avx2;
+#else
+        (void) level;
+#endif
+        return log_rb_row_scalar;
+    }
+
+}
+
+// Lookup of the log chromatic ratios of n BGR pixels
+void log_rb_row_simd(const uchar* bgr, float* log_r, float* log_b, const int n, const simd::Level level) {
+    select_log_rb_kernel(level)(bgr, log_r, log_b, n);
+}
+
+}
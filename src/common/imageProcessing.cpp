@@ -42,27 +42,70 @@ the use of this software, even if advised of the possibility of such damage.
 */
 
 #include "imageProcessing.h"
+#include "parallel.h"
 
 // stl library
 #include <vector>
+#include <algorithm>
+#include <functional>
 
 namespace imageprocessing {
 
+  namespace {
+
+    // Apply a neighbourhood operation band of rows by band of rows. Each band is computed with halo rows
+    // above and below, at least the reach of the operation, and only its own rows are kept so that the
+    // result is the same as on the whole image. The input and the output have to be different images.
+    void filter_by_row_bands(const cv::Mat& src, cv::Mat& dst, const int halo, const std::function<void(const cv::Mat&, cv::Mat&)>& operation) {
+
+      CV_Assert(src.data != dst.data || dst.empty());
+      dst.create(src.size(), src.type());
+
+      parallel::parallel_for_rows(src.rows, [&](const int row_begin, const int row_end) {
+          const int halo_begin = std::max(0, row_begin - halo);
+          const int halo_end = std::min(src.rows, row_end + halo);
+          cv::Mat band_result;
+          operation(src.rowRange(halo_begin, halo_end), band_result);
+          band_result.rowRange(row_begin - halo_begin, row_end - halo_begin).copyTo(dst.rowRange(row_begin, row_end));
+        }, 2 * halo);
+    }
+
+  }
+
   // Function to filter the image based on median filtering and morpho math
   void filter_image(const cv::Mat& seg_image, cv::Mat& bin_image) {
 
-    // Allocate the output
-    bin_image = seg_image.clone();
-    
+    // The dilation needs a source distinct from its destination
+    cv::Mat work_image;
+    if (seg_image.data == bin_image.data) {
+      cv::Mat seg_copy = seg_image.clone();
+      filter_image(seg_copy, bin_image, work_image);
+    }
+    else
+      filter_image(seg_image, bin_image, work_image);
+  }
+
+  // Function to filter the image using a caller owned scratch image
+  void filter_image(const cv::Mat& seg_image, cv::Mat& bin_image, cv::Mat& work_image) {
+
+    CV_Assert(seg_image.data != bin_image.data || bin_image.empty());
+    CV_Assert(seg_image.data != work_image.data || work_image.empty());
+
     // Create the structuring element for the erosion and dilation
-    cv::Mat struct_elt = cv::getStructuringElement(cv::MORPH_CROSS, cv::Size(4, 4));
+    const cv::Size struct_size(4, 4);
+    cv::Mat struct_elt = cv::getStructuringElement(cv::MORPH_CROSS, struct_size);
+    const int morpho_halo = struct_size.height;
 
     // Apply the dilation
-    cv::dilate(bin_image, bin_image, struct_elt);
+    filter_by_row_bands(seg_image, bin_image, morpho_halo, [&](const cv::Mat& src, cv::Mat& dst) { cv::dilate(src, dst, struct_elt); });
+
     // Threshold the image
-    cv::threshold(bin_image, bin_image, 254, 255, CV_THRESH_BINARY);
+    parallel::parallel_for_rows(bin_image.rows, [&](const int row_begin, const int row_end) {
+        cv::Mat band = bin_image.rowRange(row_begin, row_end);
+        cv::threshold(band, band, 254, 255, CV_THRESH_BINARY);
+      });
 
-    // Find the contours of the objects
+    // Find the contours of the objects -- the contours span the whole image and are not split in bands
     std::vector< std::vector< cv::Point > > contours;
     cv::vector< cv::Vec4i > hierarchy;
     cv::findContours(bin_image, contours, hierarchy, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);
@@ -71,32 +114,177 @@ namespace imageprocessing {
     cv::drawContours(bin_image, contours, -1, color, CV_FILLED, 8);
     
     // Apply some erosion on the destination image
-    cv::erode(bin_image, bin_image, struct_elt);
-
-    // Noise filtering via median filtering
-    for (int i = 0; i < 5; ++i)
-      cv::medianBlur(bin_image, bin_image, 5);
+    filter_by_row_bands(bin_image, work_image, morpho_halo, [&](const cv::Mat& src, cv::Mat& dst) { cv::erode(src, dst, struct_elt); });
+
+    // Noise filtering via median filtering -- ping-pong between the two images, an odd number of
+    // passes ends in bin_image
+    const int median_size = 5;
+    for (int i = 0; i < 5; ++i) {
+      if (i % 2 == 0)
+        filter_by_row_bands(work_image, bin_image, median_size, [&](const cv::Mat& src, cv::Mat& dst) { cv::medianBlur(src, dst, median_size); });
+      else
+        filter_by_row_bands(bin_image, work_image, median_size, [&](const cv::Mat& src, cv::Mat& dst) { cv::medianBlur(src, dst, median_size); });
+    }
   
   }
 
+  // Check of the bounding box of an object used by removal_elt
+  bool inconsistent_region(const cv::Rect& bound_rect, const cv::Size size_image, const long int areaRatio, const double lowAspectRatio, const double highAspectRatio) {
+
+    // Compute the aspect ratio
+    const double ratio = static_cast<double> (bound_rect.width) / static_cast<double> (bound_rect.height);
+    const long int areaRegion = bound_rect.area();
+
+    return (areaRegion < size_image.area() / areaRatio) || ((ratio > highAspectRatio) || (ratio < lowAspectRatio));
+  }
+
   // Function to remove ill-posed contours
   void removal_elt(std::vector< std::vector< cv::Point > >& contours, const cv::Size size_image, const long int areaRatio, const double lowAspectRatio, const double highAspectRatio) {
 
-    for (auto it = contours.begin(); it != contours.end(); /*We remove some part of the vector - DO NOT INCREMENT HERE*/) {      
-      // Find a bounding box to compute around the contours
-      const cv::Rect bound_rect = cv::boundingRect(cv::Mat(*it));
-      // Compute the aspect ratio
-      const double ratio = static_cast<double> (bound_rect.width) / static_cast<double> (bound_rect.height);
-      const long int areaRegion = bound_rect.area();
-
-      // Check the inconsistency
-      if ((areaRegion < size_image.area() / areaRatio) || ((ratio > highAspectRatio) || (ratio < lowAspectRatio)))
-	contours.erase(it);
-      else 
-	++it;
+    // Keep the order of the remaining contours and move each of them only once
+    contours.erase(std::remove_if(contours.begin(), contours.end(), [&](const std::vector< cv::Point >& contour) {
+          // Find a bounding box to compute around the contours
+          return inconsistent_region(cv::boundingRect(cv::Mat(contour)), size_image, areaRatio, lowAspectRatio, highAspectRatio);
+        }), contours.end());
+  }
+
+  namespace {
+
+    // Root of a run in the union-find of the runs, with path halving
+    inline int find_root(std::vector< int >& parent, int run) {
+      while (parent[run] != run) {
+        parent[run] = parent[parent[run]];
+        run = parent[run];
+      }
+      return run;
+    }
+
+    // Merge the sets of two runs -- the root is always the first run in raster order
+    inline void unite(std::vector< int >& parent, const int run_a, const int run_b) {
+      const int root_a = find_root(parent, run_a);
+      const int root_b = find_root(parent, run_b);
+      if (root_a < root_b)
+        parent[root_b] = root_a;
+      else if (root_b < root_a)
+        parent[root_a] = root_b;
+    }
+
+    // Add the pixels of a run to the statistics of its component, the sums over the columns in closed form
+    void accumulate_run(const PixelRun& run, const cv::Point& offset, ComponentStats& stats) {
+
+      const double n = run.end - run.begin;
+      const double x_first = run.begin + offset.x;
+      const double x_last = run.end - 1 + offset.x;
+      const double y = run.row + offset.y;
+      const double sum_x = n * (x_first + x_last) / 2.0;
+      // Sum of the squares of [x_first, x_last] as the difference of the sums of the squares up to both bounds
+      const double sum_x2 = (x_last * (x_last + 1.0) * (2.0 * x_last + 1.0) - (x_first - 1.0) * x_first * (2.0 * x_first - 1.0)) / 6.0;
+
+      stats.bbox |= cv::Rect(run.begin + offset.x, run.row + offset.y, run.end - run.begin, 1);
+      stats.area += run.end - run.begin;
+      stats.m10 += sum_x;
+      stats.m01 += n * y;
+      stats.m20 += sum_x2;
+      stats.m11 += y * sum_x;
+      stats.m02 += n * y * y;
+    }
+
+  }
+
+  // Label the 8-connected components of a binary image with their statistics
+  void label_components(const cv::Mat& bin_image, ComponentLabels& labels, const cv::Point& offset) {
+
+    CV_Assert(bin_image.type() == CV_8UC1);
+    const int rows = bin_image.rows;
+    const int cols = bin_image.cols;
+
+    // Find the runs band of rows by band of rows
+    const std::vector< int > bands = parallel::row_bands(rows);
+    const int n_bands = static_cast<int> (bands.size()) - 1;
+    std::vector< std::vector< PixelRun > > band_runs(n_bands);
+    parallel::global_pool().run(n_bands, [&](const int band) {
+        std::vector< int > bounds(cols + 1);
+        for (int i = bands[band]; i < bands[band + 1]; ++i) {
+          const int n_bounds = pixel_runs_row_simd(bin_image.ptr<uchar>(i), cols, bounds.data());
+          for (int k = 0; k < n_bounds; k += 2) {
+            const PixelRun run = { i, bounds[k], bounds[k + 1] };
+            band_runs[band].push_back(run);
+          }
+        }
+      });
+
+    // Concatenate the runs and index them by row
+    labels.offset = offset;
+    labels.runs.clear();
+    labels.row_runs.assign(rows + 1, 0);
+    for (int band = 0; band < n_bands; ++band)
+      labels.runs.insert(labels.runs.end(), band_runs[band].begin(), band_runs[band].end());
+    for (auto it = labels.runs.begin(); it != labels.runs.end(); ++it)
+      ++labels.row_runs[it->row + 1];
+    for (int i = 0; i < rows; ++i)
+      labels.row_runs[i + 1] += labels.row_runs[i];
+    const int n_runs = static_cast<int> (labels.runs.size());
+
+    // Merge each run with the runs of the previous row touching it -- [begin - 1, end + 1[ for the 8-connectivity
+    std::vector< int > parent(n_runs);
+    for (int run = 0; run < n_runs; ++run)
+      parent[run] = run;
+    for (int i = 1; i < rows; ++i) {
+      int previous = labels.row_runs[i - 1];
+      const int previous_end = labels.row_runs[i];
+      for (int run = labels.row_runs[i]; run < labels.row_runs[i + 1]; ++run) {
+        const PixelRun& current = labels.runs[run];
+        // The runs are sorted along the row, the ones ending before this run do not touch the next ones either
+        while (previous < previous_end && labels.runs[previous].end < current.begin)
+          ++previous;
+        for (int other = previous; other < previous_end && labels.runs[other].begin <= current.end; ++other)
+          unite(parent, other, run);
+      }
+    }
+
+    // Number the roots in raster order and accumulate the statistics of their components
+    labels.run_labels.resize(n_runs);
+    labels.stats.clear();
+    for (int run = 0; run < n_runs; ++run) {
+      const int root = find_root(parent, run);
+      if (root == run) {
+        const PixelRun& first = labels.runs[run];
+        ComponentStats stats;
+        stats.bbox = cv::Rect(first.begin + offset.x, first.row + offset.y, first.end - first.begin, 1);
+        stats.area = 0;
+        stats.m10 = stats.m01 = stats.m20 = stats.m11 = stats.m02 = 0.0;
+        stats.first_run = run;
+        labels.run_labels[run] = static_cast<int> (labels.stats.size());
+        labels.stats.push_back(stats);
+      }
+      else
+        labels.run_labels[run] = labels.run_labels[root];
+      accumulate_run(labels.runs[run], offset, labels.stats[labels.run_labels[run]]);
     }
   }
 
+  // External contour of a labelled component
+  void component_contour(const ComponentLabels& labels, const int label, std::vector< cv::Point >& contour) {
+
+    const cv::Rect& bbox = labels.stats[label].bbox;
+    const cv::Point origin = bbox.tl() - labels.offset;
+
+    // Draw the component alone with a null border, cv::findContours ignoring the border pixels
+    cv::Mat mask = cv::Mat::zeros(bbox.height + 2, bbox.width + 2, CV_8UC1);
+    for (int i = origin.y; i < origin.y + bbox.height; ++i) {
+      uchar* mask_row = mask.ptr<uchar>(i - origin.y + 1);
+      for (int run = labels.row_runs[i]; run < labels.row_runs[i + 1]; ++run)
+        if (labels.run_labels[run] == label)
+          std::fill(mask_row + labels.runs[run].begin - origin.x + 1, mask_row + labels.runs[run].end - origin.x + 1, 255);
+    }
+
+    // A single 8-connected component has a single external contour
+    std::vector< std::vector< cv::Point > > contours;
+    cv::findContours(mask, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_NONE, bbox.tl() - cv::Point(1, 1));
+    CV_Assert(contours.size() == 1);
+    contour.swap(contours[0]);
+  }
+
   // Compute the distance between the edge points (po and pf), with the current point pc
   float distance(const cv::Point& po, const cv::Point& pf, const cv::Point& pc)
   {
@@ -170,9 +358,79 @@ namespace imageprocessing {
     }
   }
 
+  namespace {
+
+    // Denoise the raw contours by their convex hull
+    void hull_thresholding(const std::vector< std::vector< cv::Point > >& contours, std::vector< std::vector< cv::Point > >& final_contours) {
+
+      // Extract the convex_hull for each contours in order to make some processing to finally extract the final contours
+      std::vector< std::vector< cv::Point > > hull_contours(contours.size());
+    
+      // Find the convec hull for each contours
+      auto it_hull = hull_contours.begin();
+      for (auto it = contours.begin(); it != contours.end(); ++it, ++it_hull)
+        cv::convexHull(cv::Mat(*it), (*it_hull), false);
+    
+      // Extract the contours
+      // DEFAULT VALUE OF 2.0 PIXELS
+      contours_thresholding(hull_contours, contours, final_contours);
+    }
+
+  }
+
   // Function to extract the contour with some denoising step
   void contours_extraction(const cv::Mat& bin_image, std::vector< std::vector< cv::Point > >& final_contours) {
 
+    std::vector< std::vector< cv::Point > > contours;
+
+    // cv::findContours ignores the pixels of the border of the image, the objects are labelled inside it
+    if (bin_image.rows < 3 || bin_image.cols < 3) {
+      final_contours.clear();
+      return;
+    }
+    ComponentLabels labels;
+    label_components(bin_image(cv::Rect(1, 1, bin_image.cols - 2, bin_image.rows - 2)), labels, cv::Point(1, 1));
+    const int n_labels = static_cast<int> (labels.stats.size());
+
+    // Contours traced on demand, the ones of the enclosing objects being shared
+    std::vector< std::vector< cv::Point > > traced(n_labels);
+
+    // Keep the objects in the order of cv::findContours, the reverse of the raster order of their first pixel
+    for (int label = n_labels - 1; label >= 0; --label) {
+      const cv::Rect& bbox = labels.stats[label].bbox;
+
+      // Need to remove some of the objects based on aspect ratio inconsistancy
+      // DO NOT FORGET THAT THERE IS SOME PARAMETERS REGARDING THE ASPECT RATIO
+      if (inconsistent_region(bbox, bin_image.size()))
+        continue;
+
+      // Only the external contours are kept -- an object in a hole of another one has its bounding box strictly
+      // inside the one of the other object, and its first pixel inside the contour of the other object
+      const PixelRun& first = labels.runs[labels.stats[label].first_run];
+      const cv::Point2f first_pixel(static_cast<float> (first.begin + labels.offset.x), static_cast<float> (first.row + labels.offset.y));
+      bool nested = false;
+      for (int other = 0; other < n_labels && !nested; ++other) {
+        const cv::Rect& other_bbox = labels.stats[other].bbox;
+        if (other_bbox.x < bbox.x && other_bbox.y < bbox.y && other_bbox.br().x > bbox.br().x && other_bbox.br().y > bbox.br().y) {
+          if (traced[other].empty())
+            component_contour(labels, other, traced[other]);
+          nested = cv::pointPolygonTest(traced[other], first_pixel, false) > 0;
+        }
+      }
+      if (nested)
+        continue;
+
+      if (traced[label].empty())
+        component_contour(labels, label, traced[label]);
+      contours.push_back(traced[label]);
+    }
+
+    hull_thresholding(contours, final_contours);
+  }
+
+  // Reference extraction tracing every contour before the filtering
+  void contours_extraction_traced(cv::Mat& bin_image, std::vector< std::vector< cv::Point > >& final_contours) {
+
     // Allocate the needed element
     std::vector< std::vector< cv::Point > > contours;
     std::vector< cv::Vec4i > hierarchy;
@@ -184,17 +442,7 @@ namespace imageprocessing {
     // DO NOT FORGET THAT THERE IS SOME PARAMETERS REGARDING THE ASPECT RATIO
     removal_elt(contours, bin_image.size());
 
-    // Extract the convex_hull for each contours in order to make some processing to finally extract the final contours
-    std::vector< std::vector< cv::Point > > hull_contours(contours.size());
-    
-    // Find the convec hull for each contours
-    auto it_hull = hull_contours.begin();
-    for (auto it = contours.begin(); it != contours.end(); ++it, ++it_hull)
-      cv::convexHull(cv::Mat(*it), (*it_hull), false);
-    
-    // Extract the contours
-    // DEFAULT VALUE OF 2.0 PIXELS
-    contours_thresholding(hull_contours, contours, final_contours);
+    hull_thresholding(contours, final_contours);
   }
 
   // Function to make forward transformation -- INPUT CV::POINT
@@ -309,16 +557,13 @@ namespace imageprocessing {
   void correction_distortion (const std::vector< std::vector < cv::Point > >& contours, std::vector< std::vector < cv::Point2f > >& output_contours, std::vector< cv::Mat >& translation_matrix, std::vector< cv::Mat >& rotation_matrix, std::vector< cv::Mat >& scaling_matrix) {
 
     // Allocation of the ouput -- The type is not anymore integer but float
-    if(!output_contours.empty()) {
-      output_contours.erase(output_contours.begin(), output_contours.end());
-      output_contours.resize(contours.size());
-    }
-    else
-      output_contours.resize(contours.size());
+    // Resizing keeps the capacity of the contours which are reused
+    output_contours.resize(contours.size());
 
     // Conversion into float point
     auto it_output_contour = output_contours.begin();
     for (auto it_contour = contours.begin(); it_contour != contours.end(); ++it_output_contour, ++it_contour) {
+      (*it_output_contour).clear();
       for (auto it_contour_point = (*it_contour).begin(); it_contour_point != (*it_contour).end(); ++it_contour_point) {
 	(*it_output_contour).push_back(cv::Point2f((*it_contour_point).x, (*it_contour_point).y));
       }
@@ -42,6 +42,9 @@ the use of this software, even if advised of the possibility of such damage.
 */
 
 #pragma once
+// our own code
+#include "simd.h"
+
 // OpenCV library
 #include <opencv2/opencv.hpp>
 
@@ -50,18 +53,74 @@ namespace imageprocessing {
   // Filter the binary image using morpho math and median filtering
   void filter_image(const cv::Mat& seg_image, cv::Mat& bin_image);
 
+  // Same filtering using a caller owned scratch image -- none of the images can share data
+  void filter_image(const cv::Mat& seg_image, cv::Mat& bin_image, cv::Mat& work_image);
+
   // Elimination of objects based on inconsistent aspects ratio and areas
   void removal_elt(std::vector< std::vector< cv::Point > >& contours, const cv::Size size_image, const long int areaRatio = 1500, const double lowAspectRatio = 0.5, const double highAspectRatio = 1.3);
 
+  // Check of the bounding box of an object used by removal_elt -- too small an area or an aspect ratio out of
+  // [lowAspectRatio, highAspectRatio]
+  bool inconsistent_region(const cv::Rect& bound_rect, const cv::Size size_image, const long int areaRatio = 1500, const double lowAspectRatio = 0.5, const double highAspectRatio = 1.3);
+
+  // Run of non-null pixels of a row of a binary image -- columns [begin, end[
+  struct PixelRun {
+    int row;
+    int begin;
+    int end;
+  };
+
+  // Statistics of a connected component of a binary image
+  struct ComponentStats {
+    // Bounding box
+    cv::Rect bbox;
+    // Number of pixels
+    int area;
+    // Raw moments of the first and second order, the area being the moment of order 0
+    double m10, m01, m20, m11, m02;
+    // First run of the component in raster order -- its begin on the first row of the bounding box is the first pixel
+    int first_run;
+  };
+
+  // Connected components of a binary image given as runs of non-null pixels
+  struct ComponentLabels {
+    // Runs of non-null pixels in raster order, and label of each run
+    std::vector< PixelRun > runs;
+    std::vector< int > run_labels;
+    // Index of the first run of each row, rows + 1 entries
+    std::vector< int > row_runs;
+    // Statistics of each label -- the labels are numbered in the raster order of their first pixel
+    std::vector< ComponentStats > stats;
+    // Shift from the coordinates of the runs to the ones of the statistics
+    cv::Point offset;
+  };
+
+  // Label the 8-connected components of the non-null pixels of a binary image and compute their statistics in a
+  // single pass. The runs of each row are found by a vectorized scan, then merged with the overlapping runs of the
+  // previous row. The coordinates are shifted by offset.
+  void label_components(const cv::Mat& bin_image, ComponentLabels& labels, const cv::Point& offset = cv::Point());
+
+  // External contour of a labelled component, as traced by cv::findContours with CV_CHAIN_APPROX_NONE
+  void component_contour(const ComponentLabels& labels, const int label, std::vector< cv::Point >& contour);
+
+  // Bounds of the runs of non-null pixels among n pixels, begin and end alternately -- bounds must hold n + 1
+  // entries, the number of bounds is returned
+  int pixel_runs_row_simd(const uchar* row, const int n, int* bounds, const simd::Level level = simd::LEVEL_AUTO);
+
   // Compute the distance between the edge points (po and pf), with th current point pc
   float distance(const cv::Point& po, const cv::Point& pf, const cv::Point& pc);
 
   // Remove the inconsitent points inside each contour
   void contours_thresholding(const std::vector< std::vector< cv::Point > >& hull_contours, const std::vector< std::vector< cv::Point > >& contours, std::vector< std::vector< cv::Point > >& final_contours, const float dist_threshold = 2.0);
 
-  // Function to extract the contour with some denoising step
+  // Function to extract the contour with some denoising step. The objects are labelled with their statistics and
+  // filtered as by removal_elt, the contours are only traced for the remaining ones. The binary image is left untouched.
   void contours_extraction(const cv::Mat& bin_image, std::vector< std::vector< cv::Point > >& final_contours);
 
+  // Reference extraction tracing the contours of every object with cv::findContours before the filtering. As in
+  // OpenCV 2.4, cv::findContours overwrites the binary image, pass a copy to keep it.
+  void contours_extraction_traced(cv::Mat& bin_image, std::vector< std::vector< cv::Point > >& final_contours);
+
   // Function to make forward transformation -- INPUT CV::POINT
   void forward_transformation_contour(const std::vector < cv::Point >& contour, std::vector< cv::Point2f >& output_contour, const cv::Mat& translation_matrix = cv::Mat::eye(3, 3, CV_32F), const cv::Mat& rotation_matrix = cv::Mat::eye(3, 3, CV_32F), const cv::Mat& scaling_matrix = cv::Mat::eye(3, 3, CV_32F));
 
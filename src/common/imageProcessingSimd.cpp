@@ -0,0 +1,152 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+#include "imageProcessing.h"
+
+namespace imageprocessing {
+
+  namespace {
+
+    // Columns from j on where a row of n pixels switches between null and non-null pixels, the pixel before
+    // column j being non-null if inside -- inside is updated to the state of the last pixel
+    int row_transitions_scalar(const uchar* row, int j, const int n, bool& inside, int* transitions) {
+      int n_transitions = 0;
+      for (; j < n; ++j) {
+        // Branch free compaction -- the column is always written and kept only for a transition
+        const bool foreground = row[j] != 0;
+        transitions[n_transitions] = j;
+        n_transitions += (foreground != inside);
+        inside = foreground;
+      }
+      return n_transitions;
+    }
+
+    // Bounds of the runs of non-null pixels among n pixels
+    typedef int (*pixel_runs_row_kernel)(const uchar* row, const int n, int* bounds);
+
+    int pixel_runs_row_scalar(const uchar* row, const int n, int* bounds) {
+      bool inside = false;
+      int n_bounds = row_transitions_scalar(row, 0, n, inside, bounds);
+      if (inside)
+        bounds[n_bounds++] = n;
+      return n_bounds;
+    }
+
+#if SIMD_X86
+
+    SIMD_TARGET_SSE41 int pixel_runs_row_sse41(const uchar* row, const int n, int* bounds) {
+      const __m128i zero = _mm_setzero_si128();
+
+      // 16 pixels per iteration -- a bit of foreground per pixel, the transitions are the bits differing from
+      // the ones of the previous pixels
+      int n_bounds = 0;
+      unsigned int previous = 0;
+      int j = 0;
+      for (; j + 16 <= n; j += 16) {
+        const unsigned int foreground = ~static_cast<unsigned int> (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*> (row + j)), zero))) & 0xFFFFu;
+        unsigned int transitions = (foreground ^ ((foreground << 1) | previous)) & 0xFFFFu;
+        previous = foreground >> 15;
+        while (transitions) {
+          bounds[n_bounds++] = j + __builtin_ctz(transitions);
+          transitions &= transitions - 1;
+        }
+      }
+
+      bool inside = previous != 0;
+      n_bounds += row_transitions_scalar(row, j, n, inside, bounds + n_bounds);
+      if (inside)
+        bounds[n_bounds++] = n;
+      return n_bounds;
+    }
+
+    SIMD_TARGET_AVX2 int pixel_runs_row_avx2(const uchar* row, const int n, int* bounds) {
+      const __m256i zero = _mm256_setzero_si256();
+
+      int n_bounds = 0;
+      unsigned int previous = 0;
+      int j = 0;
+      for (; j + 32 <= n; j += 32) {
+        const unsigned int foreground = ~static_cast<unsigned int> (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*> (row + j)), zero)));
+        unsigned int transitions = foreground ^ ((foreground << 1) | previous);
+        previous = foreground >> 31;
+        while (transitions) {
+          bounds[n_bounds++] = j + __builtin_ctz(transitions);
+          transitions &= transitions - 1;
+        }
+      }
+
+      bool inside = previous != 0;
+      n_bounds += row_transitions_scalar(row, j, n, inside, bounds + n_bounds);
+      if (inside)
+        bounds[n_bounds++] = n;
+      return n_bounds;
+    }
+
+#endif
+
+    pixel_runs_row_kernel select_pixel_runs_kernel(const simd::Level level) {
+#if SIMD_X86
+      switch (simd::select_level(level)) {
+      case simd::LEVEL_AVX2:
+        return pixel_runs_row_avx2;
+      case simd::LEVEL_SSE41:
+        return pixel_runs_row_sse41;
+      default:
+        break;
+      }
+#else
+      (void) level;
+#endif
+      return pixel_runs_row_scalar;
+    }
+
+  }
+
+  /*
+   * Runs of non-null pixels among n pixels
+   */
+  int pixel_runs_row_simd(const uchar* row, const int n, int* bounds, const simd::Level level) {
+    return select_pixel_runs_kernel(level)(row, n, bounds);
+  }
+
+}
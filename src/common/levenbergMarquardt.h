@@ -0,0 +1,415 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+#pragma once
+
+#include "SuperFormula.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+// Levenberg-Marquardt fitting of a rational supershape, templated over the number of optimised
+// parameters so that the normal equations live in fixed size matrices on the stack.
+
+namespace supershape {
+
+    // LDLT factorisation with diagonal pivoting of a fixed size symmetric matrix, only the lower
+    // triangular part is read. The loops have compile-time trip counts and are unrolled by the
+    // compiler. Up to N = 8 (Eigen's triangular panel width) the operations are done in the same
+    // order as Eigen's LDLT of a dynamic matrix, the solutions are identical bit for bit.
+    template<int N>
+    class FixedLDLT {
+
+    public:
+
+        typedef Matrix<double,N,N> MatrixType;
+        typedef Matrix<double,N,1> VectorType;
+
+        explicit FixedLDLT(const MatrixType& A) { compute(A); }
+
+        void compute(const MatrixType& A);
+
+        // b receives the solution of A x = b
+        void solve_in_place(VectorType& b) const;
+
+    private:
+
+        MatrixType m_;              // strict lower part: L, diagonal: D
+        int transpositions_[N];     // row swapped with row k at step k
+    };
+
+    template<int N>
+    void FixedLDLT<N>::compute(const MatrixType& A)
+    {
+        m_ = A;
+        for (int k = 0; k < N; ++k)
+            transpositions_[k] = k;
+
+        double temp[N];
+        for (int k = 0; k < N; ++k) {
+
+            // largest diagonal element of the trailing block, the first one on ties
+            int biggest = k;
+            double biggest_value = std::abs(m_(k, k));
+            for (int i = k + 1; i < N; ++i)
+                if (std::abs(m_(i, i)) > biggest_value) {
+                    biggest_value = std::abs(m_(i, i));
+                    biggest = i;
+                }
+
+            transpositions_[k] = biggest;
+            if (biggest != k) {
+                // symmetric swap, only touching the lower triangular part
+                for (int j = 0; j < k; ++j)
+                    std::swap(m_(k, j), m_(biggest, j));
+                for (int i = biggest + 1; i < N; ++i)
+                    std::swap(m_(i, k), m_(i, biggest));
+                std::swap(m_(k, k), m_(biggest, biggest));
+                for (int i = k + 1; i < biggest; ++i)
+                    std::swap(m_(i, k), m_(biggest, i));
+            }
+
+            if (k > 0) {
+                for (int j = 0; j < k; ++j)
+                    temp[j] = m_(j, j) * m_(k, j);
+
+                double dot = m_(k, 0) * temp[0];
+                for (int j = 1; j < k; ++j)
+                    dot += m_(k, j) * temp[j];
+                m_(k, k) -= dot;
+
+                for (int i = k + 1; i < N; ++i) {
+                    double sum = 0.0;
+                    for (int j = 0; j < k; ++j)
+                        sum += m_(i, j) * temp[j];
+                    m_(i, k) -= sum;
+                }
+            }
+
+            const double pivot = m_(k, k);
+            const bool pivot_is_valid = std::abs(pivot) > 0.0;
+
+            if (k == 0 && !pivot_is_valid) {
+                // null diagonal, nothing to factorise
+                for (int j = 0; j < N; ++j)
+                    transpositions_[j] = j;
+                return;
+            }
+
+            if (pivot_is_valid)
+                for (int i = k + 1; i < N; ++i)
+                    m_(i, k) /= pivot;
+        }
+    }
+
+    template<int N>
+    void FixedLDLT<N>::solve_in_place(VectorType& b) const
+    {
+        // b = P b
+        for (int k = 0; k < N; ++k)
+            std::swap(b[k], b[transpositions_[k]]);
+
+        // b = L^-1 b
+        for (int i = 0; i < N; ++i)
+            if (b[i] != 0.0)
+                for (int s = i + 1; s < N; ++s)
+                    b[s] -= b[i] * m_(s, i);
+
+        // b = D^-1 b, using the pseudo inverse for null pivots
+        const double tolerance = (std::numeric_limits<double>::min)();
+        for (int i = 0; i < N; ++i) {
+            if (std::abs(m_(i, i)) > tolerance)
+                b[i] /= m_(i, i);
+            else
+                b[i] = 0.0;
+        }
+
+        // b = L^-T b
+        for (int i = N - 2; i >= 0; --i) {
+            double sum = m_(i + 1, i) * b[i + 1];
+            for (int s = i + 2; s < N; ++s)
+                sum += m_(s, i) * b[s];
+            b[i] -= sum;
+        }
+
+        // b = P^T b
+        for (int k = N - 1; k >= 0; --k)
+            std::swap(b[k], b[transpositions_[k]]);
+    }
+
+    // Observers of the fit, called with the curve at the start, after each accepted iteration and at
+    // the end. abandon is called at the start of each iteration with the chi-square of the current
+    // curve and stops the fit when it returns true. The default one is empty and compiled out.
+    struct NullFitObserver {
+        inline void start(const RationalSuperShape2D&) {}
+        inline void improved(const RationalSuperShape2D&) {}
+        inline void finish(const RationalSuperShape2D&, double) {}
+        inline bool abandon(int, double) { return false; }
+    };
+
+    // Writes the parameters of the curve to a stream, one line per step
+    class StreamFitObserver {
+
+    public:
+
+        explicit StreamFitObserver(std::ostream& os) : os_(os) {}
+
+        void start(const RationalSuperShape2D& shape) { os_ << shape; }
+        void improved(const RationalSuperShape2D& shape) { os_ << shape; }
+        void finish(const RationalSuperShape2D& shape, double) { os_ << shape; }
+        bool abandon(int, double) { return false; }
+
+    private:
+
+        std::ostream& os_;
+    };
+
+    // Counts the iterations and abandons a fit unlikely to reach a chi-square below upper_bound. The
+    // chi-square only decreases, but by an unknown amount: a fit still above margin * upper_bound after
+    // min_iterations iterations is considered lost. An infinite bound never abandons.
+    class BoundFitObserver {
+
+    public:
+
+        BoundFitObserver(const double upper_bound, const double margin, const int min_iterations)
+            : upper_bound_(upper_bound), margin_(margin), min_iterations_(min_iterations),
+              iterations_(0), abandoned_(false) {}
+
+        void start(const RationalSuperShape2D&) {}
+        void improved(const RationalSuperShape2D&) {}
+        void finish(const RationalSuperShape2D&, double) {}
+        bool abandon(int iteration, double chi_square) {
+            iterations_ = iteration + 1;
+            abandoned_ = iteration >= min_iterations_ && chi_square > margin_ * upper_bound_;
+            return abandoned_;
+        }
+
+        // Iterations started, the abandoned one included
+        int iterations() const { return iterations_; }
+        bool abandoned() const { return abandoned_; }
+
+    private:
+
+        double upper_bound_;
+        double margin_;
+        int min_iterations_;
+        int iterations_;
+        bool abandoned_;
+    };
+
+    // Levenberg-Marquardt fit of the curve to the points Data, optimising
+    // N = 5: a, b, n1, n2, n3
+    // N = 7: a, b, n1, n2, n3, x offset, y offset
+    // N = 8: a, b, n1, n2, n3, x offset, y offset, theta offset
+    // err receives the sum of squared potentials of the last iteration. Curves with q = 1 are evaluated
+    // on a structure of arrays copy of the points with xi_square_batch, the others with XiSquare<N>
+    template<int N, class Observer>
+    void levenberg_marquardt(
+            RationalSuperShape2D& shape,
+            const std::vector< Vector2d, aligned_allocator< Vector2d> > & Data, // array of 2D points
+            double & err,           //error of fit
+            int function_used,      //index of the implicit function used:1,2,or 3
+            Observer & observer)
+    {
+        static_assert(N == 5 || N == 7 || N == 8, "the fit optimises 5, 7 or 8 parameters");
+
+        // q is not optimised
+        const bool batched = shape.Get_q() == 1;
+        PointBatch batch;
+        if (batched)
+            batch.assign(Data);
+
+        double NewChiSquare(1e15), ChiSquare(1e15), OldChiSquare(1e15);
+
+        bool STOP(false);
+
+        const double LAMBDA_INCR(10);
+        double lambda(std::pow(LAMBDA_INCR, -6));
+
+        Matrix<double,N,N> alpha;
+        Matrix<double,N,1> beta;
+
+        observer.start(shape);
+
+        for (int itnum = 0; itnum < 1000 && STOP == false; itnum++) {
+
+            //store oldparams
+            const SuperShapeParams oldparams(shape.Parameters);
+
+            ChiSquare = batched ?
+                        xi_square_batch<N>(shape.Parameters, batch, alpha, beta, function_used, true) :
+                        shape.XiSquare<N>(Data,
+                                          alpha,
+                                          beta,
+                                          function_used,
+                                          true);         //update vectors
+            if (observer.abandon(itnum, ChiSquare))
+                break;
+            //
+            // add Lambda to diagonla elements and solve the matrix
+            //
+
+            //Linearization of Hessian, cf Numerical Recepies
+            //the 5D fit damps the diagonal only, the 7D and 8D fits damp every coefficient
+
+            if (N == 5) {
+                alpha.diagonal() *= 1. + lambda;
+                alpha.diagonal().array() += lambda;
+            }
+            else {
+                alpha *= 1. + lambda;
+                alpha.array() += lambda;
+            }
+
+            //solve system
+            FixedLDLT<N>(alpha).solve_in_place(beta);
+
+            //coefficients a and b in [0.01, 100]
+
+            const SuperShapeParams& Parameters = shape.Parameters;
+            const bool outofbounds =
+                    Parameters[0] + beta[0] < 0.01 || Parameters[0] + beta[0] > 1000 ||
+                    Parameters[1] + beta[1] < 0.01 || Parameters[1] + beta[1] > 1000 ||
+                    Parameters[2] + beta[2] < 0.1  || Parameters[2] + beta[2]> 1000 ||
+                    Parameters[3] + beta[3] < 0.1 || Parameters[3] + beta[3]> 1000 ||
+                    Parameters[4] + beta[4] < 0.1 || Parameters[4] + beta[4]> 1000;
+
+            if( !outofbounds ) {
+
+                shape.Set_a( Parameters[0] + beta[0]);
+                shape.Set_b( Parameters[1] + beta[1]);
+
+                // coefficients n1 in [1., 1000]
+                // setting n1<1. leads to strong numerical instabilities
+
+                shape.Set_n1( Parameters[2] + beta[2] );
+
+                // coefficients n2,n3 in [0.001, 1000]
+
+                shape.Set_n2( Parameters[3] + beta[3]);
+                shape.Set_n3( Parameters[4] + beta[4]);
+
+                if (N >= 7) {
+                    // coefficients x0 and y0
+                    //truncate translation to avoid huge gaps
+
+                    beta[5] = std::min(0.05, std::max(-0.05, beta[5]));
+                    beta[6] = std::min(0.05, std::max(-0.05, beta[6]));
+
+                    shape.Set_xoffset(Parameters[9] + beta[5]);
+                    shape.Set_yoffset(Parameters[10] + beta[6]);
+                }
+
+                if (N == 8) {
+                    //same for rotational offset tht0
+                    beta[7] = std::min(M_PI/50., std::max(-M_PI/50., beta[7]));
+                    shape.Set_thtoffset(Parameters[7] + beta[7]);
+                }
+            }
+
+            //
+            //	Evaluate chisquare with new values, alpha and beta are left untouched
+            //
+
+            OldChiSquare = ChiSquare;
+
+            NewChiSquare = batched ?
+                           xi_square_batch<N>(shape.Parameters, batch, alpha, beta, function_used, false) :
+                           shape.XiSquare<N>(Data,
+                                             alpha,
+                                             beta,
+                                             function_used,
+                                             false);
+            //
+            // check if better result
+            //
+
+            if(	NewChiSquare>0.999*OldChiSquare )			// new result sucks-->restore old params and try with lambda 10 times bigger
+            {
+                lambda *=LAMBDA_INCR;
+                shape.Parameters = oldparams;
+            }
+            else    //successful iteration
+            {
+                // huge improvement, something may have been wrong
+                // this may arise during the first iterations
+                // n1 may literally explode, or tend to 0...
+                // in such case, the next iteration is successful but leads to a local minimum
+                // ==> it is better to verify the result with a smaller step
+                // if indeed it was a correct iteration, then it will pass the next time
+
+                if (NewChiSquare <= 0.01*OldChiSquare) //99% improvement, impossible
+                {
+                    lambda *=LAMBDA_INCR; // reduce the step within the search direction
+                    shape.Parameters = oldparams; // restore old parameters
+                }
+                else
+                {
+                    //correct and realistic improvement
+                    observer.improved(shape);
+                    lambda /=LAMBDA_INCR;
+                }
+            }
+
+            STOP = lambda > 1e15 || NewChiSquare < 1e-5; // very small displacement ==> local convergence
+
+        }	//end for(...
+
+        err = ChiSquare;
+        observer.finish(shape, err);
+    }
+
+    template<int N>
+    inline void levenberg_marquardt(
+            RationalSuperShape2D& shape,
+            const std::vector< Vector2d, aligned_allocator< Vector2d> > & Data,
+            double & err,
+            int function_used = 1)
+    {
+        NullFitObserver observer;
+        levenberg_marquardt<N>(shape, Data, err, function_used, observer);
+    }
+}
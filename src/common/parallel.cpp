@@ -0,0 +1,283 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+#include "parallel.h"
+
+// stl library
+#include <algorithm>
+#include <memory>
+#include <deque>
+
+namespace parallel {
+
+  namespace {
+
+    // Set for the threads currently running a task, nested loops run serially
+    thread_local bool inside_task = false;
+
+    // Requested number of threads, 0 for the default
+    std::atomic<int> requested_threads(0);
+
+    std::unique_ptr< ThreadPool > pool;
+    std::mutex pool_mutex;
+
+    // Number of bands per thread -- a few bands per thread balance the rows which cost more than the others
+    const int bands_per_thread = 4;
+
+    // Tasks owned by one thread of parallel_for_stealing -- the owner takes them from the front, the
+    // other threads steal them from the back
+    class TaskDeque {
+    public:
+      void push_back(const int task) { tasks_.push_back(task); }
+
+      bool pop_front(int& task) {
+        std::lock_guard< std::mutex > lock(mutex_);
+        if (tasks_.empty())
+          return false;
+        task = tasks_.front();
+        tasks_.pop_front();
+        return true;
+      }
+
+      bool steal_back(int& task) {
+        std::lock_guard< std::mutex > lock(mutex_);
+        if (tasks_.empty())
+          return false;
+        task = tasks_.back();
+        tasks_.pop_back();
+        return true;
+      }
+
+    private:
+      std::mutex mutex_;
+      std::deque< int > tasks_;
+    };
+
+  }
+
+  ThreadPool::ThreadPool(const int n_workers)
+    : task_(NULL), n_tasks_(0), next_task_(0), n_active_workers_(0), generation_(0), stop_(false) {
+
+    for (int k = 0; k < n_workers; k++)
+      workers_.push_back(std::thread(&ThreadPool::worker_loop, this));
+  }
+
+  ThreadPool::~ThreadPool() {
+
+    {
+      std::lock_guard< std::mutex > lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_)
+      worker.join();
+  }
+
+  void ThreadPool::run(const int n_tasks, const std::function<void(int)>& task) {
+
+    if (n_tasks <= 0)
+      return;
+
+    // Serial execution when there is nothing to share or when the pool is already busy
+    std::unique_lock< std::mutex > run_lock(run_mutex_, std::defer_lock);
+    if (workers_.empty() || n_tasks == 1 || inside_task || !run_lock.try_lock()) {
+      for (int k = 0; k < n_tasks; k++)
+        task(k);
+      return;
+    }
+
+    {
+      std::lock_guard< std::mutex > lock(mutex_);
+      task_ = &task;
+      n_tasks_ = n_tasks;
+      next_task_ = 0;
+      n_active_workers_ = static_cast<int> (workers_.size());
+      exception_ = std::exception_ptr();
+      generation_++;
+    }
+    wake_.notify_all();
+
+    // The calling thread works too
+    execute_tasks();
+
+    std::exception_ptr exception;
+    {
+      std::unique_lock< std::mutex > lock(mutex_);
+      done_.wait(lock, [this]() { return n_active_workers_ == 0; });
+      task_ = NULL;
+      exception = exception_;
+    }
+
+    if (exception)
+      std::rethrow_exception(exception);
+  }
+
+  void ThreadPool::worker_loop() {
+
+    unsigned long seen_generation = 0;
+    std::unique_lock< std::mutex > lock(mutex_);
+    for (;;) {
+      wake_.wait(lock, [&]() { return stop_ || generation_ != seen_generation; });
+      if (stop_)
+        return;
+      seen_generation = generation_;
+
+      lock.unlock();
+      execute_tasks();
+      lock.lock();
+
+      if (--n_active_workers_ == 0)
+        done_.notify_one();
+    }
+  }
+
+  void ThreadPool::execute_tasks() {
+
+    inside_task = true;
+    for (int k = next_task_++; k < n_tasks_; k = next_task_++) {
+      try {
+        (*task_)(k);
+      }
+      catch (...) {
+        std::lock_guard< std::mutex > lock(mutex_);
+        if (!exception_)
+          exception_ = std::current_exception();
+      }
+    }
+    inside_task = false;
+  }
+
+  // Number of threads used by the parallel loops
+  void set_num_threads(const int n_threads) {
+
+    std::lock_guard< std::mutex > lock(pool_mutex);
+    requested_threads = std::max(0, n_threads);
+    // The pool is created again with the new size on next use
+    pool.reset();
+  }
+
+  int get_num_threads() {
+
+    const int n_threads = requested_threads;
+    if (n_threads > 0)
+      return n_threads;
+    return std::max(1, static_cast<int> (std::thread::hardware_concurrency()));
+  }
+
+  // Whether the calling thread runs a task
+  bool in_pool_task() {
+
+    return inside_task;
+  }
+
+  // Pool shared by the whole process
+  ThreadPool& global_pool() {
+
+    std::lock_guard< std::mutex > lock(pool_mutex);
+    if (!pool)
+      pool.reset(new ThreadPool(get_num_threads() - 1));
+    return *pool;
+  }
+
+  // Bands of rows used by parallel_for_rows
+  std::vector< int > row_bands(const int n_rows, const int min_band_rows) {
+
+    const int max_bands = std::max(1, n_rows / std::max(1, min_band_rows));
+    const int n_bands = std::min(max_bands, get_num_threads() * bands_per_thread);
+
+    // Balanced bands, the first ones get the remaining rows
+    std::vector< int > bounds(n_bands + 1, 0);
+    for (int k = 0; k < n_bands; k++)
+      bounds[k + 1] = bounds[k] + n_rows / n_bands + ((k < n_rows % n_bands) ? 1 : 0);
+    return bounds;
+  }
+
+  // Row-band parallel loop
+  void parallel_for_rows(const int n_rows, const std::function<void(int, int)>& body, const int min_band_rows) {
+
+    if (n_rows <= 0)
+      return;
+
+    const std::vector< int > bounds = row_bands(n_rows, min_band_rows);
+    const int n_bands = static_cast<int> (bounds.size()) - 1;
+    if (n_bands == 1 || get_num_threads() == 1) {
+      body(0, n_rows);
+      return;
+    }
+
+    global_pool().run(n_bands, [&](const int band) { body(bounds[band], bounds[band + 1]); });
+  }
+
+  // Work stealing loop over coarse tasks
+  void parallel_for_stealing(const int n_tasks, const std::function<void(int)>& task) {
+
+    if (n_tasks <= 0)
+      return;
+
+    const int n_threads = std::min(get_num_threads(), n_tasks);
+    if (n_threads == 1) {
+      for (int k = 0; k < n_tasks; k++)
+        task(k);
+      return;
+    }
+
+    // Contiguous blocks of tasks, the first blocks get the remaining tasks
+    std::vector< TaskDeque > deques(n_threads);
+    for (int t = 0, k = 0; t < n_threads; t++)
+      for (int end = k + n_tasks / n_threads + ((t < n_tasks % n_threads) ? 1 : 0); k < end; k++)
+        deques[t].push_back(k);
+
+    global_pool().run(n_threads, [&](const int owner) {
+        int k;
+        while (deques[owner].pop_front(k))
+          task(k);
+        // Steal from the other threads, nearest first -- the blocks only shrink so one sweep is enough
+        for (int offset = 1; offset < n_threads; offset++) {
+          TaskDeque& victim = deques[(owner + offset) % n_threads];
+          while (victim.steal_back(k))
+            task(k);
+        }
+      });
+  }
+
+}
@@ -0,0 +1,124 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+#pragma once
+
+// stl library
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+
+// Thread pool shared by the whole process and row-band parallel loops.
+// The full-frame stages split the image into contiguous bands of rows, each band
+// writing only its own rows, so the result does not depend on the number of threads.
+
+namespace parallel {
+
+  // Pool of worker threads running the tasks of one job at a time
+  class ThreadPool {
+  public:
+    // Constructor -- the calling thread of run takes part to the jobs, n_workers can be 0
+    explicit ThreadPool(const int n_workers);
+    ~ThreadPool();
+
+    // Run task(k) for k in [0, n_tasks[ and return once all the tasks are done. The tasks are claimed in
+    // increasing order. A call from inside a task, or while another thread uses the pool, runs serially
+    // on the calling thread. The first exception thrown by a task is rethrown.
+    void run(const int n_tasks, const std::function<void(int)>& task);
+
+    // Number of worker threads, the calling thread excluded
+    int num_workers() const { return static_cast<int> (workers_.size()); }
+
+  private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    void worker_loop();
+    void execute_tasks();
+
+    std::vector< std::thread > workers_;
+
+    // Serialise the jobs
+    std::mutex run_mutex_;
+
+    // Current job
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(int)>* task_;
+    int n_tasks_;
+    std::atomic<int> next_task_;
+    int n_active_workers_;
+    unsigned long generation_;
+    bool stop_;
+    std::exception_ptr exception_;
+  };
+
+  // Number of threads used by the parallel loops, the calling thread included.
+  // 0 restores the default, i.e. the number of hardware threads. Must not be called while a loop runs.
+  void set_num_threads(const int n_threads);
+  int get_num_threads();
+
+  // Pool of get_num_threads() - 1 workers shared by the whole process
+  ThreadPool& global_pool();
+
+  // Whether the calling thread runs a task of a pool -- the loops it starts then run serially
+  bool in_pool_task();
+
+  // Split [0, n_rows[ into contiguous bands of at least min_band_rows rows and call body(row_begin, row_end)
+  // for each band on the global pool. The bands cover every row exactly once.
+  void parallel_for_rows(const int n_rows, const std::function<void(int, int)>& body, const int min_band_rows = 8);
+
+  // Bands used by parallel_for_rows for n_rows rows -- band k is [bounds[k], bounds[k + 1][
+  std::vector< int > row_bands(const int n_rows, const int min_band_rows = 8);
+
+  // Call task(k) for k in [0, n_tasks[ on the global pool with work stealing. Each thread starts on its own
+  // contiguous block of tasks and, once it is empty, steals from the end of the other blocks. Meant for a few
+  // coarse tasks of uneven cost -- the tasks run in no particular order.
+  void parallel_for_stealing(const int n_tasks, const std::function<void(int)>& task);
+
+}
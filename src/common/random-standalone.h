@@ -46,6 +46,8 @@ the use of this software, even if advised of the possibility of such damage.
 #include <limits>
 using namespace std;
 
+//Le generateur a un etat interne : un generateur par thread
+//The generator has an internal state: use one generator per thread, there is no global instance
 class Random //Autonome/Standalone
 {
   private:
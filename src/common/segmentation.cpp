@@ -42,9 +42,35 @@ the use of this software, even if advised of the possibility of such damage.
 */
 
 #include "segmentation.h"
+#include "colorConversion.h"
+#include "parallel.h"
 
 namespace segmentation {
 
+  /*
+   * Selection of the hue and saturation thresholds depending on the colour to segment
+   */
+  static void select_hue_thresholds(const int& colour, int& hue_max, int& hue_min, int& sat_min) {
+
+    if (colour == 2) {
+      if (hue_max > 255 || hue_max < 0 || hue_min > 255 || hue_min < 0 || sat_min > 255 || sat_min < 0) {
+        hue_min = R_HUE_MIN;
+        hue_max = R_HUE_MAX;
+        sat_min = R_SAT_MIN;
+      }
+    }
+    else if (colour == 1) {
+      hue_min = B_HUE_MIN;
+      hue_max = B_HUE_MAX;
+      sat_min = B_SAT_MIN;
+    }
+    else {
+      hue_min = R_HUE_MIN;
+      hue_max = R_HUE_MAX;
+      sat_min = R_SAT_MIN;
+    }
+  }
+
   /*
    * Segmentation of logarithmic chromatic image
    */
@@ -56,40 +82,179 @@ namespace segmentation {
     log_image_seg.create(log_image[0].size(), CV_8UC1);
     
     // Make the segmentation by simple threholding
-    for (int i = 0 ; i < log_image_seg.rows ; i++) {
-      for (int j = 0 ; j < log_image_seg.cols ; j++) {
-	const bool condR = (log_image[0].at<double>(i, j) > MINLOGRG)&&(log_image[0].at<double>(i, j) < MAXLOGRG);
-	const bool condB = (log_image[1].at<double>(i, j) > MINLOGBG)&&(log_image[1].at<double>(i, j) < MAXLOGBG);
-	/*----------- Red detection ----------*/
-	log_image_seg.at<uchar>(i, j) = (condR && condB) ? 255 : 0;
-	/*----------- Have to be done for blue too ------------*/
-      }
+    parallel::parallel_for_rows(log_image_seg.rows, [&](const int row_begin, const int row_end) {
+        for (int i = row_begin ; i < row_end ; i++) {
+          const float *log_r = log_image[0].ptr<float> (i);
+          const float *log_b = log_image[1].ptr<float> (i);
+          uchar *seg_data = log_image_seg.ptr<uchar> (i);
+          for (int j = 0 ; j < log_image_seg.cols ; j++) {
+            const bool condR = (log_r[j] > MINLOGRG)&&(log_r[j] < MAXLOGRG);
+            const bool condB = (log_b[j] > MINLOGBG)&&(log_b[j] < MAXLOGBG);
+            /*----------- Red detection ----------*/
+            seg_data[j] = (condR && condB) ? 255 : 0;
+            /*----------- Have to be done for blue too ------------*/
+          }
+        }
+      });
+  }
+
+  /*
+   * Hue predicate without trigonometry
+   */
+  HuePredicate::HuePredicate(const int& colour, int hue_max, int hue_min, int sat_min) {
+
+    // Define the different thresholds
+    select_hue_thresholds(colour, hue_max, hue_min, sat_min);
+
+    hue_max_bound_ = make_bound(hue_max);
+    hue_min_bound_ = make_bound(hue_min + 1);
+    sat_min_ = sat_min;
+    inside_ = (colour == 1);
+  }
+
+  HuePredicate::HueBound HuePredicate::make_bound(const int& t) {
+
+    HueBound bound;
+    // The hue is at most 254 since the angle is strictly below 2 pi
+    bound.always = (t >= 255);
+    bound.never = (t <= 0);
+    const double alpha = 2.0 * M_PI * static_cast<double> (t) / 255.0;
+    bound.half = (alpha < M_PI) ? 0 : 1;
+    // The smallest non null cross product between a chroma vector of 8-bit colours and a bound is about
+    // 2.6e-4 while the rounding of the coefficients moves it by at most 383 / COEFFICIENT_SCALE.
+    // With |x| <= 510 and |y| <= 255 the products stay within an int.
+    bound.sin_coef = static_cast<int> (std::lround(COEFFICIENT_SCALE * std::sin(alpha)));
+    bound.cos_coef = static_cast<int> (std::lround(COEFFICIENT_SCALE * std::sqrt(3.0) * std::cos(alpha)));
+    return bound;
+  }
+
+  /*
+   * Segmentation of the normalised hue from the BGR image
+   */
+  void seg_norm_hue_rgb(const cv::Mat& rgb_image, cv::Mat& nhs_image, const int& colour, int hue_max, int hue_min, int sat_min) {
+
+    // Check that the image has three channels
+    CV_Assert(rgb_image.channels() == 3 && rgb_image.depth() == CV_8U);
+
+    // Create the output image -- no reallocation if the size did not change
+    nhs_image.create(rgb_image.size(), CV_8UC1);
+
+    const HuePredicate hue_predicate(colour, hue_max, hue_min, sat_min);
+
+    parallel::parallel_for_rows(rgb_image.rows, [&](const int row_begin, const int row_end) {
+        for (int i = row_begin; i < row_end; ++i) {
+          const uchar *bgr_data = rgb_image.ptr<uchar> (i);
+          uchar *nhs_data = nhs_image.ptr<uchar> (i);
+          for (int j = 0; j < rgb_image.cols; ++j, bgr_data += 3) {
+            // The image in opencv are encoded in BGR and not RGB
+            *nhs_data++ = hue_predicate(bgr_data[2], bgr_data[1], bgr_data[0]) ? 255 : 0;
+          }
+        }
+      });
+  }
+
+  /*
+   * Cascaded segmentation of the normalised hue from the BGR image
+   */
+  void seg_norm_hue_cascade(const cv::Mat& rgb_image, cv::Mat& nhs_image, const int& colour, int hue_max, int hue_min, int sat_min,
+                            CascadeStats* stats, const simd::Level level) {
+
+    // Check that the image has three channels
+    CV_Assert(rgb_image.channels() == 3 && rgb_image.depth() == CV_8U);
+
+    // Create the output image -- no reallocation if the size did not change
+    nhs_image.create(rgb_image.size(), CV_8UC1);
+
+    const HuePredicate hue_predicate(colour, hue_max, hue_min, sat_min);
+
+    // Counters per band of rows, summed once all the bands are done
+    const std::vector< int > bounds = parallel::row_bands(rgb_image.rows);
+    std::vector< long long > band_survivors(bounds.size() - 1, 0), band_hue_accepted(bounds.size() - 1, 0);
+
+    parallel::global_pool().run(static_cast<int> (bounds.size()) - 1, [&](const int band) {
+        // Compacted indices of the pixels of a row surviving the saturation test
+        std::vector< int > survivors(rgb_image.cols);
+
+        for (int i = bounds[band]; i < bounds[band + 1]; ++i) {
+          const uchar *bgr_data = rgb_image.ptr<uchar> (i);
+          uchar *nhs_data = nhs_image.ptr<uchar> (i);
+
+          // First stage -- saturation on the whole row
+          const int n_row_survivors = saturation_survivors_row_simd(bgr_data, rgb_image.cols, hue_predicate.sat_min(), survivors.data(), level);
+          std::fill(nhs_data, nhs_data + rgb_image.cols, 0);
+
+          // Second stage -- hue of the survivors only
+          for (int k = 0; k < n_row_survivors; ++k) {
+            const int j = survivors[k];
+            // The image in opencv are encoded in BGR and not RGB
+            const uchar* px = bgr_data + 3 * j;
+            if (hue_predicate.hue_in_range(px[2], px[1], px[0])) {
+              nhs_data[j] = 255;
+              band_hue_accepted[band]++;
+            }
+          }
+          band_survivors[band] += n_row_survivors;
+        }
+      });
+
+    long long n_survivors = 0, n_hue_accepted = 0;
+    for (size_t band = 0; band < band_survivors.size(); ++band) {
+      n_survivors += band_survivors[band];
+      n_hue_accepted += band_hue_accepted[band];
+    }
+
+    if (stats) {
+      stats->n_pixels += static_cast<long long> (rgb_image.total());
+      stats->n_saturation_rejected += static_cast<long long> (rgb_image.total()) - n_survivors;
+      stats->n_hue_accepted += n_hue_accepted;
     }
   }
 
+  /*
+   * Table of the log chromatic thresholds, built on first use
+   */
+  const uchar* log_chromatic_threshold_table() {
+
+    // Thread safe initialisation of the function local static
+    static const std::vector< uchar > table = []() {
+      // Three bytes of padding for the 32-bit gathers
+      std::vector< uchar > bits(colorconversion::LOG_CHROMATIC_TABLE_SIZE + 3, 0);
+      const float* log_table = colorconversion::log_chromatic_table();
+      for (int k = 0; k < colorconversion::LOG_CHROMATIC_TABLE_SIZE; k++) {
+        const bool condRG = (log_table[k] > MINLOGRG) && (log_table[k] < MAXLOGRG);
+        const bool condBG = (log_table[k] > MINLOGBG) && (log_table[k] < MAXLOGBG);
+        bits[k] = (condRG ? LOG_RG_BIT : 0) | (condBG ? LOG_BG_BIT : 0);
+      }
+      return bits;
+    }();
+
+    return table.data();
+  }
+
+  /*
+   * Segmentation of the log chromatic ratios from the BGR image
+   */
+  void seg_log_chromatic_rgb(const cv::Mat& rgb_image, cv::Mat& log_image_seg, const simd::Level level) {
+
+    // Check that the image has three channels
+    CV_Assert(rgb_image.channels() == 3 && rgb_image.depth() == CV_8U);
+
+    // Create the output image -- no reallocation if the size did not change
+    log_image_seg.create(rgb_image.size(), CV_8UC1);
+
+    parallel::parallel_for_rows(rgb_image.rows, [&](const int row_begin, const int row_end) {
+        for (int i = row_begin; i < row_end; ++i)
+          seg_log_chromatic_row_simd(rgb_image.ptr<uchar> (i), log_image_seg.ptr<uchar> (i), rgb_image.cols, level);
+      });
+  }
+
   /*
    * Segmentation of IHLS image
    */
   void seg_norm_hue(const cv::Mat& ihls_image, cv::Mat& nhs_image, const int& colour, int hue_max, int hue_min, int sat_min) {
     
     // Define the different thresholds
-    if (colour == 2) {
-      if (hue_max > 255 || hue_max < 0 || hue_min > 255 || hue_min < 0 || sat_min > 255 || sat_min < 0) {
-	hue_min = R_HUE_MIN;
-	hue_max = R_HUE_MAX;
-	sat_min = R_SAT_MIN;
-      }
-    }
-    else if (colour == 1) {
-      hue_min = B_HUE_MIN;
-      hue_max = B_HUE_MAX;
-      sat_min = B_SAT_MIN;
-    }
-    else {
-      hue_min = R_HUE_MIN;
-      hue_max = R_HUE_MAX;
-      sat_min = R_SAT_MIN;
-    }
+    select_hue_thresholds(colour, hue_max, hue_min, sat_min);
 
     // Check that the image has three channels
     CV_Assert(ihls_image.channels() == 3);
@@ -101,36 +266,72 @@ namespace segmentation {
     // Otherwise for each pixel it had to check this condition.
     // Nicer implementation could be to separate these two for loops in
     // two different functions, one for red and one for blue.
-    if (colour == 1) {
-      for (int i = 0; i < ihls_image.rows; ++i) {
-	const uchar *ihls_data = ihls_image.ptr<uchar> (i);
-	uchar *nhs_data = nhs_image.ptr<uchar> (i);
-    for (int j = 0; j < ihls_image.cols; ++j) {
-      uchar s = *ihls_data++;
-      // Although l is not being used and we could have
-      // replaced the next line with ihls_data++
-      // but for the sake of readability, we left it as it it.
-      uchar l = *ihls_data++;
-      uchar h = *ihls_data++;
-	  *nhs_data++ = (B_CONDITION) ? 255 : 0;
-	}
-      }
-    }
-    else {
-      for (int i = 0; i < ihls_image.rows; ++i) {
-	const uchar *ihls_data = ihls_image.ptr<uchar> (i);
-	uchar *nhs_data = nhs_image.ptr<uchar> (i);
-	for (int j = 0; j < ihls_image.cols; ++j) {
-      uchar s = *ihls_data++;
-      // Although l is not being used and we could have
-      // replaced the next line with ihls_data++
-      // but for the sake of readability, we left it as it it.
-      uchar l = *ihls_data++;
-      uchar h = *ihls_data++;
-	  *nhs_data++ = (R_CONDITION) ? 255 : 0;
-	}
-      }
-    }
+    parallel::parallel_for_rows(ihls_image.rows, [&](const int row_begin, const int row_end) {
+        if (colour == 1) {
+          for (int i = row_begin; i < row_end; ++i) {
+            const uchar *ihls_data = ihls_image.ptr<uchar> (i);
+            uchar *nhs_data = nhs_image.ptr<uchar> (i);
+            for (int j = 0; j < ihls_image.cols; ++j) {
+              uchar s = *ihls_data++;
+              // The luminance is not used
+              ihls_data++;
+              uchar h = *ihls_data++;
+              *nhs_data++ = (B_CONDITION) ? 255 : 0;
+            }
+          }
+        }
+        else {
+          for (int i = row_begin; i < row_end; ++i) {
+            const uchar *ihls_data = ihls_image.ptr<uchar> (i);
+            uchar *nhs_data = nhs_image.ptr<uchar> (i);
+            for (int j = 0; j < ihls_image.cols; ++j) {
+              uchar s = *ihls_data++;
+              // The luminance is not used
+              ihls_data++;
+              uchar h = *ihls_data++;
+              *nhs_data++ = (R_CONDITION) ? 255 : 0;
+            }
+          }
+        }
+      });
+  }
+
+  /*
+   * Fused segmentation of the RGB image
+   */
+  void seg_fused_rgb(const cv::Mat& rgb_image, cv::Mat& seg_image, const int& colour, int hue_max, int hue_min, int sat_min) {
+
+    // Check that the image has three channels
+    CV_Assert(rgb_image.channels() == 3);
+
+    // Create the output image -- no reallocation if the size did not change
+    seg_image.create(rgb_image.size(), CV_8UC1);
+
+    // Thresholds of the normalised hue turned into integer tests once for the whole image
+    const HuePredicate hue_predicate(colour, hue_max, hue_min, sat_min);
+    const uchar* log_thresholds = log_chromatic_threshold_table();
+
+    parallel::parallel_for_rows(rgb_image.rows, [&](const int row_begin, const int row_end) {
+        for (int i = row_begin; i < row_end; ++i) {
+          const uchar *bgr_data = rgb_image.ptr<uchar> (i);
+          uchar *seg_data = seg_image.ptr<uchar> (i);
+          for (int j = 0; j < rgb_image.cols; ++j, bgr_data += 3) {
+            // The image in opencv are encoded in BGR and not RGB
+            // Normalised hue segmentation -- the predicate checks the saturation first since
+            // most of the pixels are rejected by it
+            const bool hue_seg = hue_predicate(bgr_data[2], bgr_data[1], bgr_data[0]);
+
+            // Log chromatic segmentation -- only computed when the hue did not already accept the pixel
+            bool log_seg = false;
+            if (!hue_seg) {
+              log_seg = (log_thresholds[colorconversion::log_chromatic_index(bgr_data[2], bgr_data[1])] & LOG_RG_BIT) &&
+                (log_thresholds[colorconversion::log_chromatic_index(bgr_data[0], bgr_data[1])] & LOG_BG_BIT);
+            }
+
+            *seg_data++ = (hue_seg || log_seg) ? 255 : 0;
+          }
+        }
+      });
   }
 
 }
@@ -43,8 +43,12 @@ the use of this software, even if advised of the possibility of such damage.
 
 #pragma once
 
+// own library
+#include "simd.h"
+
 // stl library
 #include <vector>
+#include <algorithm>
 
 // OpenCV library
 #include <opencv2/opencv.hpp>
@@ -56,6 +60,9 @@ the use of this software, even if advised of the possibility of such damage.
 // To segment blue traffic signs
 #define MINLOGBG -0.9
 #define MAXLOGBG 0.8
+// Bits of the log chromatic threshold table
+#define LOG_RG_BIT 1
+#define LOG_BG_BIT 2
 
 /* Definition for ihls segmentation */
 // To segment red traffic signs
@@ -71,10 +78,126 @@ the use of this software, even if advised of the possibility of such damage.
 
 namespace segmentation {
 
+  // Hue and saturation thresholds of seg_norm_hue evaluated without any trigonometry.
+  // The normalised hue is the angle of the chroma vector (2r - g - b, sqrt(3) (g - b)) scaled to [0, 255[,
+  // so a bound h < t is the comparison of this angle with the direction 2 pi t / 255: a half plane test
+  // and the sign of a cross product. The coefficients of the directions are scaled to integers once in
+  // the constructor and the per pixel test is a few integer multiply-adds. The scaling is large enough
+  // to give the same decision as the truncated hue of convert_rgb_to_ihls for every 8-bit colour.
+  class HuePredicate {
+  public:
+    // Constructor -- same colour modes and thresholds as seg_norm_hue
+    HuePredicate(const int& colour = 0, int hue_max = R_HUE_MAX, int hue_min = R_HUE_MIN, int sat_min = R_SAT_MIN);
+
+    // True when the pixel is segmented -- same result as the hue condition of seg_norm_hue on the IHLS pixel
+    inline bool operator()(const int& r, const int& g, const int& b) const {
+      const int s = std::max(r, std::max(g, b)) - std::min(r, std::min(g, b));
+      return (s > sat_min_) && hue_in_range(r, g, b);
+    }
+
+    // Hue part of the condition only, for pixels which already passed the saturation test.
+    // Grey pixels have a null saturation and are never tested.
+    inline bool hue_in_range(const int& r, const int& g, const int& b) const {
+      const int x = 2 * r - g - b;
+      const int y = g - b;
+      const bool below_max = hue_below(hue_max_bound_, x, y);
+      const bool above_min = !hue_below(hue_min_bound_, x, y);
+      return inside_ ? (below_max && above_min) : (below_max || above_min);
+    }
+
+    // Saturation threshold -- s > sat_min
+    int sat_min() const { return sat_min_; }
+
+    // Scaling of the integer coefficients of the directions
+    static const int COEFFICIENT_SCALE = 1 << 21;
+
+  private:
+    // Direction of a hue bound t -- angle alpha = 2 pi t / 255
+    struct HueBound {
+      // Bounds outside ]0, 255[ are always or never satisfied
+      bool always;
+      bool never;
+      // 0 for alpha in [0, pi[, 1 for alpha in [pi, 2 pi[
+      int half;
+      // round(COEFFICIENT_SCALE sin(alpha)) and round(COEFFICIENT_SCALE sqrt(3) cos(alpha))
+      int sin_coef;
+      int cos_coef;
+    };
+
+    // Build the direction of the bound h < t
+    static HueBound make_bound(const int& t);
+
+    // True when the hue of the chroma vector (x, sqrt(3) y) is strictly below the bound
+    static inline bool hue_below(const HueBound& bound, const int& x, const int& y) {
+      if (bound.always)
+        return true;
+      if (bound.never)
+        return false;
+      // 0 for a hue in [0, pi[, 1 for a hue in [pi, 2 pi[
+      const int half = (y > 0 || (y == 0 && x > 0)) ? 0 : 1;
+      if (half != bound.half)
+        return half < bound.half;
+      // The bound is counterclockwise of the pixel -- an equal angle is not strictly below
+      return x * bound.sin_coef - y * bound.cos_coef > 0;
+    }
+
+    // h < hue_max and h > hue_min, i.e. h >= hue_min + 1
+    HueBound hue_max_bound_;
+    HueBound hue_min_bound_;
+    int sat_min_;
+    // Blue segments the inside of [hue_min, hue_max], the other modes its outside
+    bool inside_;
+  };
+
   // Segmentation of logarithmic chromatic images
   void seg_log_chromatic(const std::vector< cv::Mat >& log_image, cv::Mat& log_image_seg);
 
+  // Counters of the cascaded segmentation, accumulated over the calls until reset
+  struct CascadeStats {
+    CascadeStats() { reset(); }
+    void reset() { n_pixels = 0; n_saturation_rejected = 0; n_hue_accepted = 0; }
+
+    // Fraction of the pixels rejected by the saturation test
+    double saturation_rejection_rate() const { return n_pixels ? static_cast<double> (n_saturation_rejected) / n_pixels : 0.0; }
+    // Fraction of the pixels reaching the hue test which are rejected by it
+    double hue_rejection_rate() const { const long long n_hue = n_pixels - n_saturation_rejected; return n_hue ? static_cast<double> (n_hue - n_hue_accepted) / n_hue : 0.0; }
+
+    long long n_pixels;
+    long long n_saturation_rejected;
+    long long n_hue_accepted;
+  };
+
+  // Read-only table of the log chromatic thresholds indexed as the log chromatic table of colorconversion.
+  // LOG_RG_BIT is set when the ratio is within ]MINLOGRG, MAXLOGRG[ and LOG_BG_BIT within ]MINLOGBG, MAXLOGBG[.
+  // The table is padded by three bytes so that it can be read with 32-bit gathers.
+  const uchar* log_chromatic_threshold_table();
+
+  // Segmentation of the log chromatic ratios straight from the BGR image without any float image --
+  // identical to seg_log_chromatic on the output of rgb_to_log_rb
+  void seg_log_chromatic_rgb(const cv::Mat& rgb_image, cv::Mat& log_image_seg, const simd::Level level = simd::LEVEL_AUTO);
+
+  // Log chromatic segmentation of n BGR pixels -- vectorized version used by seg_log_chromatic_rgb
+  void seg_log_chromatic_row_simd(const uchar* bgr, uchar* seg, const int n, const simd::Level level = simd::LEVEL_AUTO);
+
   // Segmentation of normalised hue
   void seg_norm_hue(const cv::Mat& ihls_image, cv::Mat& nhs_image, const int& colour = 0, int hue_max = R_HUE_MAX, int hue_min = R_HUE_MIN, int sat_min = R_SAT_MIN);
 
+  // Segmentation of the normalised hue straight from the BGR image using HuePredicate -- identical to
+  // seg_norm_hue on the output of convert_rgb_to_ihls
+  void seg_norm_hue_rgb(const cv::Mat& rgb_image, cv::Mat& nhs_image, const int& colour = 0, int hue_max = R_HUE_MAX, int hue_min = R_HUE_MIN, int sat_min = R_SAT_MIN);
+
+  // Cascaded segmentation of the normalised hue from the BGR image -- the saturation test runs first on
+  // whole vectors of pixels, the indices of the survivors are compacted and only those reach the hue
+  // test of HuePredicate. Identical to seg_norm_hue on the output of convert_rgb_to_ihls.
+  void seg_norm_hue_cascade(const cv::Mat& rgb_image, cv::Mat& nhs_image, const int& colour = 0, int hue_max = R_HUE_MAX, int hue_min = R_HUE_MIN, int sat_min = R_SAT_MIN,
+                            CascadeStats* stats = NULL, const simd::Level level = simd::LEVEL_AUTO);
+
+  // Indices of the pixels among n BGR pixels with a saturation above sat_min, returns their number.
+  // Vectorized first stage of seg_norm_hue_cascade.
+  int saturation_survivors_row_simd(const uchar* bgr, const int n, const int sat_min, int* survivors, const simd::Level level = simd::LEVEL_AUTO);
+
+  // Fused segmentation reading each BGR pixel once -- equivalent to the union of seg_norm_hue on the
+  // IHLS image and seg_log_chromatic on the log chromatic image, without any intermediate image
+  void seg_fused_rgb(const cv::Mat& rgb_image, cv::Mat& seg_image, const int& colour = 0, int hue_max = R_HUE_MAX, int hue_min = R_HUE_MIN, int sat_min = R_SAT_MIN);
+
 }
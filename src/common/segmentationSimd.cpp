@@ -0,0 +1,187 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+#include "segmentation.h"
+#include "colorConversion.h"
+
+// stl library
+#include <cstring>
+#include <algorithm>
+
+namespace segmentation {
+
+  namespace {
+
+    // Log chromatic segmentation of n BGR pixels
+    typedef void (*seg_log_chromatic_row_kernel)(const uchar* bgr, uchar* seg, const int n);
+
+    void seg_log_chromatic_row_scalar(const uchar* bgr, uchar* seg, const int n) {
+      const uchar* log_thresholds = log_chromatic_threshold_table();
+      for (int j = 0; j < n; ++j, bgr += 3) {
+        // The image in opencv are encoded in BGR and not RGB
+        const bool condR = log_thresholds[colorconversion::log_chromatic_index(bgr[2], bgr[1])] & LOG_RG_BIT;
+        const bool condB = log_thresholds[colorconversion::log_chromatic_index(bgr[0], bgr[1])] & LOG_BG_BIT;
+        seg[j] = (condR && condB) ? 255 : 0;
+      }
+    }
+
+#if SIMD_X86
+
+    SIMD_TARGET_AVX2 void seg_log_chromatic_row_avx2(const uchar* bgr, uchar* seg, const int n) {
+      // The threshold bits are bytes, they are gathered as 32-bit words and the upper bytes are discarded
+      const int* log_thresholds = reinterpret_cast<const int*> (log_chromatic_threshold_table());
+      const __m256i rg_bit = _mm256_set1_epi32(LOG_RG_BIT);
+      const __m256i bg_bit = _mm256_set1_epi32(LOG_BG_BIT);
+      // Low byte of each 32-bit lane packed in the first four bytes of each 128-bit half
+      const __m256i pack = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+      // 8 pixels per iteration -- the deinterleaving reads 24 bytes
+      int j = 0;
+      for (; j + 8 <= n; j += 8, bgr += 24) {
+        __m256i b, g, r;
+        simd::load_bgr8_epi32(bgr, b, g, r);
+        const __m256i g_high = _mm256_slli_epi32(g, 8);
+        const __m256i bits_r = _mm256_i32gather_epi32(log_thresholds, _mm256_or_si256(g_high, r), 1);
+        const __m256i bits_b = _mm256_i32gather_epi32(log_thresholds, _mm256_or_si256(g_high, b), 1);
+        const __m256i condR = _mm256_cmpeq_epi32(_mm256_and_si256(bits_r, rg_bit), rg_bit);
+        const __m256i condB = _mm256_cmpeq_epi32(_mm256_and_si256(bits_b, bg_bit), bg_bit);
+
+        // 0 or -1 in each lane, i.e. 0 or 255 in the low byte
+        const __m256i mask = _mm256_shuffle_epi8(_mm256_and_si256(condR, condB), pack);
+        const int low = _mm_cvtsi128_si32(_mm256_castsi256_si128(mask));
+        const int high = _mm_cvtsi128_si32(_mm256_extracti128_si256(mask, 1));
+        std::memcpy(seg + j, &low, 4);
+        std::memcpy(seg + j + 4, &high, 4);
+      }
+
+      seg_log_chromatic_row_scalar(bgr, seg + j, n - j);
+    }
+
+#endif
+
+    seg_log_chromatic_row_kernel select_seg_log_chromatic_kernel(const simd::Level level) {
+#if SIMD_X86
+      if (simd::select_level(level) == simd::LEVEL_AVX2)
+        return seg_log_chromatic_row_avx2;
+#else
+      (void) level;
+#endif
+      return seg_log_chromatic_row_scalar;
+    }
+
+    // Indices of the pixels with a saturation above sat_min
+    typedef int (*saturation_survivors_row_kernel)(const uchar* bgr, const int n, const int sat_min, int* survivors);
+
+    int saturation_survivors_row_scalar(const uchar* bgr, const int n, const int sat_min, int* survivors) {
+      int n_survivors = 0;
+      for (int j = 0; j < n; ++j, bgr += 3) {
+        const int s = std::max(bgr[0], std::max(bgr[1], bgr[2])) - std::min(bgr[0], std::min(bgr[1], bgr[2]));
+        // Branch free compaction -- the index is always written and kept only for a survivor
+        survivors[n_survivors] = j;
+        n_survivors += (s > sat_min);
+      }
+      return n_survivors;
+    }
+
+#if SIMD_X86
+
+    SIMD_TARGET_SSE41 int saturation_survivors_row_sse41(const uchar* bgr, const int n, const int sat_min, int* survivors) {
+      // s > sat_min is s >= sat_min + 1 on unsigned bytes, nothing survives a threshold of 255
+      if (sat_min >= 255)
+        return 0;
+      const __m128i threshold = _mm_set1_epi8(static_cast<char> (sat_min + 1));
+
+      // 16 pixels per iteration -- the deinterleaving reads 48 bytes
+      int n_survivors = 0;
+      int j = 0;
+      for (; j + 16 <= n; j += 16, bgr += 48) {
+        __m128i b, g, r;
+        simd::load_bgr16_epi8(bgr, b, g, r);
+        const __m128i s = _mm_sub_epi8(_mm_max_epu8(r, _mm_max_epu8(g, b)), _mm_min_epu8(r, _mm_min_epu8(g, b)));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(s, threshold), s));
+
+        // Compaction of the indices of the set bits
+        while (mask) {
+          survivors[n_survivors++] = j + __builtin_ctz(mask);
+          mask &= mask - 1;
+        }
+      }
+
+      const int n_tail = saturation_survivors_row_scalar(bgr, n - j, sat_min, survivors + n_survivors);
+      for (int k = 0; k < n_tail; ++k)
+        survivors[n_survivors + k] += j;
+      return n_survivors + n_tail;
+    }
+
+#endif
+
+    saturation_survivors_row_kernel select_saturation_survivors_kernel(const simd::Level level) {
+#if SIMD_X86
+      // The byte shuffles of the deinterleaving do not cross the 128-bit lanes of AVX2,
+      // the AVX2 level uses the SSE4.1 kernel
+      if (simd::select_level(level) >= simd::LEVEL_SSE41)
+        return saturation_survivors_row_sse41;
+#else
+      (void) level;
+#endif
+      return saturation_survivors_row_scalar;
+    }
+
+  }
+
+  /*
+   * Log chromatic segmentation of n BGR pixels
+   */
+  void seg_log_chromatic_row_simd(const uchar* bgr, uchar* seg, const int n, const simd::Level level) {
+    select_seg_log_chromatic_kernel(level)(bgr, seg, n);
+  }
+
+  /*
+   * Indices of the BGR pixels with a saturation above sat_min
+   */
+  int saturation_survivors_row_simd(const uchar* bgr, const int n, const int sat_min, int* survivors, const simd::Level level) {
+    return select_saturation_survivors_kernel(level)(bgr, n, sat_min, survivors);
+  }
+
+}
@@ -0,0 +1,90 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+#include "simd.h"
+
+namespace simd {
+
+  // Best level supported by the host CPU
+  Level detected_level() {
+
+    // Thread safe initialisation, the cpu features are queried once
+    static const Level level = []() {
+#if SIMD_X86
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2"))
+        return LEVEL_AVX2;
+      if (__builtin_cpu_supports("sse4.1"))
+        return LEVEL_SSE41;
+#endif
+      return LEVEL_SCALAR;
+    }();
+
+    return level;
+  }
+
+  // Level to use for a requested level
+  Level select_level(const Level requested) {
+
+    const Level detected = detected_level();
+    if (requested == LEVEL_AUTO || requested > detected)
+      return detected;
+    return requested;
+  }
+
+  // Name of a level for logging
+  const char* level_name(const Level level) {
+
+    switch (level) {
+    case LEVEL_AVX2:
+      return "avx2";
+    case LEVEL_SSE41:
+      return "sse4.1";
+    case LEVEL_SCALAR:
+      return "scalar";
+    default:
+      return "auto";
+    }
+  }
+
+}
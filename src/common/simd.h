@@ -0,0 +1,115 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+#pragma once
+
+// Runtime selection of the SIMD kernels.
+// The kernels are compiled with a per-function target attribute so that the
+// library does not require any -m flag; the best one is chosen at runtime
+// from the features of the host CPU.
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 1
+#define SIMD_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_X86 0
+#endif
+
+namespace simd {
+
+  // Instruction set used by a kernel, ordered from the least to the most capable
+  enum Level { LEVEL_AUTO = -1, LEVEL_SCALAR = 0, LEVEL_SSE41 = 1, LEVEL_AVX2 = 2 };
+
+  // Best level supported by the host CPU
+  Level detected_level();
+
+  // Level to use for a requested level -- LEVEL_AUTO or a level unsupported by the host fall back to the best supported level
+  Level select_level(const Level requested);
+
+  // Name of a level for logging
+  const char* level_name(const Level level);
+
+}
+
+#if SIMD_X86
+
+#include <immintrin.h>
+
+namespace simd {
+
+  // Deinterleave 16 BGR pixels (48 bytes) into three vectors of bytes
+  SIMD_TARGET_SSE41 inline void load_bgr16_epi8(const unsigned char* bgr, __m128i& b, __m128i& g, __m128i& r) {
+    const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*> (bgr));
+    const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*> (bgr + 16));
+    const __m128i a2 = _mm_loadu_si128(reinterpret_cast<const __m128i*> (bgr + 32));
+    b = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                                  _mm_shuffle_epi8(a1, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1))),
+                     _mm_shuffle_epi8(a2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13)));
+    g = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                                  _mm_shuffle_epi8(a1, _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1))),
+                     _mm_shuffle_epi8(a2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14)));
+    r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                                  _mm_shuffle_epi8(a1, _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1))),
+                     _mm_shuffle_epi8(a2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15)));
+  }
+
+  // Deinterleave 8 BGR pixels (24 bytes) into three vectors of 32-bit integers
+  SIMD_TARGET_AVX2 inline void load_bgr8_epi32(const unsigned char* bgr, __m256i& b, __m256i& g, __m256i& r) {
+    // lo holds the bytes 0 to 15 and hi the bytes 8 to 23 of the pixels
+    const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*> (bgr));
+    const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*> (bgr + 8));
+    const __m128i b8 = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                                    _mm_shuffle_epi8(hi, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1)));
+    const __m128i g8 = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                                    _mm_shuffle_epi8(hi, _mm_setr_epi8(-1, -1, -1, -1, -1, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1)));
+    const __m128i r8 = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                                    _mm_shuffle_epi8(hi, _mm_setr_epi8(-1, -1, -1, -1, -1, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1)));
+    b = _mm256_cvtepu8_epi32(b8);
+    g = _mm256_cvtepu8_epi32(g8);
+    r = _mm256_cvtepu8_epi32(r8);
+  }
+
+}
+
+#endif
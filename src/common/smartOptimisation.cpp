@@ -44,13 +44,21 @@ the use of this software, even if advised of the possibility of such damage.
 // own library
 #include "imageProcessing.h"
 #include "smartOptimisation.h"
+#include "parallel.h"
 #include "timer.h"
+#include "levenbergMarquardt.h"
 
 // stl library
 #include <vector>
 #include <algorithm>
-
-//TODO: probably this should not be static and defined here, is onlye used once in the function
+#include <limits>
+#include <cmath>
+#include <complex>
+#include <cfloat>
+#include <utility>
+
+// Dense derivative kernels of gradient_field_dense -- gradient_field applies them as the outer product of a smoothing
+// and of a derivative kernel, see smartOptimisationSimd.cpp
 static float derivative_x [] = { 0.0041,    0.0104,         0,   -0.0104,   -0.0041,
                  0.0273,    0.0689,         0,   -0.0689,   -0.0273,
                  0.0467,    0.1180,         0,   -0.1180,   -0.0467,
@@ -66,6 +74,18 @@ static float derivative_y [] = { 0.0041,    0.0273,    0.0467,    0.0273,    0.0
 
 namespace initopt {
 
+  namespace {
+
+    // Vote of an edge pixel, added to the accumulators Or, BrX and BrY at index LY * cols + LX
+    struct Vote {
+      int index;
+      float o;
+      float x;
+      float y;
+    };
+
+  }
+
   // Function to find normalisation factor
   double find_normalisation_factor(const std::vector < cv::Point2f >& contour) {
 
@@ -131,13 +151,8 @@ namespace initopt {
   // Function to normalise a vector of contours
   void normalise_all_contours(const std::vector< std::vector < cv::Point2f > >& contours, std::vector< std::vector< cv::Point2f > >& output_contours, std::vector< double >& factor_vector) {
     
-    // Allocate the output contours
-    if(!output_contours.empty()) {
-      output_contours.erase(output_contours.begin(), output_contours.end());
-      output_contours.resize(contours.size());
-    }
-    else
-      output_contours.resize(contours.size());
+    // Allocate the output contours -- resizing keeps the capacity of the contours which are reused
+    output_contours.resize(contours.size());
 
     // For each contour
     for (unsigned int contour_idx = 0; contour_idx < contours.size(); contour_idx++)
@@ -201,33 +216,16 @@ namespace initopt {
     else {
 
       // Create a ROI with the part which is inside the original picture
-      cv::Rect within_roi(roi);
-      if (roi.x < 0) {
-	within_roi.x = 0;
-	within_roi.width -= roi.x;
-      }
-      if (roi.y < 0) {
-	within_roi.y = 0;
-	within_roi.height -= roi.y;
-      }
-      if ((within_roi.x + within_roi.width) >= original_image.cols)
-	within_roi.width = original_image.cols - within_roi.x;
-      if ((within_roi.y + within_roi.height) >= original_image.rows)
-	within_roi.height = original_image.rows - within_roi.y;
+      const cv::Rect within_roi = roi & cv::Rect(0, 0, original_image.cols, original_image.rows);
 
       // Crop the ROI within the image
       cv::Mat within_image = original_image(within_roi);
 
       // Now create pad around the image with replication
-      int top = 0, bottom = 0, left = 0, right = 0;
-      if (roi.x < 0)
-	left = std::abs(roi.x);
-      if (roi.y < 0)
-        top = std::abs(roi.y);
-      if ((roi.x + roi.width) >= original_image.cols)
-	right = roi.width - (original_image.cols - roi.x);
-      if ((roi.y + roi.height) >= original_image.rows)
-	bottom = roi.height - (original_image.rows - roi.y);
+      const int top = within_roi.y - roi.y;
+      const int bottom = (roi.y + roi.height) - (within_roi.y + within_roi.height);
+      const int left = within_roi.x - roi.x;
+      const int right = (roi.x + roi.width) - (within_roi.x + within_roi.width);
 
       // Pad the image
       cv::copyMakeBorder(within_image, output_image, top, bottom, left, right, cv::BORDER_REPLICATE);
@@ -278,20 +276,40 @@ namespace initopt {
     double max_magnitude;
     cv::minMaxLoc(magnitude_image, NULL, &max_magnitude);
     
-    for (int i = 0; i < magnitude_image.rows; i++) {
-      for (int j = 0; j < magnitude_image.cols; j++) {
-	if (magnitude_image.at<float>(i, j) < ((float) max_magnitude * THRESH_GRAD_RAD_DET)) {
-	  gradient_x.at<float>(i, j) = 0.00;
-	  gradient_y.at<float>(i, j) = 0.00;
-	  magnitude_image.at<float>(i, j) = 0.00;
-	}
-      }
-    }
+    parallel::parallel_for_rows(magnitude_image.rows, [&](const int row_begin, const int row_end) {
+        for (int i = row_begin; i < row_end; i++) {
+          float* ptr_magnitude = magnitude_image.ptr<float>(i);
+          float* ptr_gradient_x = gradient_x.ptr<float>(i);
+          float* ptr_gradient_y = gradient_y.ptr<float>(i);
+          for (int j = 0; j < magnitude_image.cols; j++) {
+            if (ptr_magnitude[j] < ((float) max_magnitude * THRESH_GRAD_RAD_DET)) {
+              ptr_gradient_x[j] = 0.00;
+              ptr_gradient_y[j] = 0.00;
+              ptr_magnitude[j] = 0.00;
+            }
+          }
+        }
+      });
 
   }
 
+  // Function to determine the orientations from the gradient images without any angle
+  void orientations_from_gradient(const cv::Mat& gradient_x, const cv::Mat& gradient_y, const int& edges_number, cv::Mat &gradient_vp_x, cv::Mat &gradient_vp_y, cv::Mat &gradient_bar_x, cv::Mat &gradient_bar_y, const simd::Level level) {
+
+    gradient_vp_x.create(gradient_x.size(), CV_32F);
+    gradient_vp_y.create(gradient_x.size(), CV_32F);
+    gradient_bar_x.create(gradient_x.size(), CV_32F);
+    gradient_bar_y.create(gradient_x.size(), CV_32F);
+
+    parallel::parallel_for_rows(gradient_x.rows, [&](const int row_begin, const int row_end) {
+        for (int i = row_begin; i < row_end; i++)
+          orientations_row_simd(gradient_x.ptr<float>(i), gradient_y.ptr<float>(i), gradient_vp_x.ptr<float>(i), gradient_vp_y.ptr<float>(i),
+                                gradient_bar_x.ptr<float>(i), gradient_bar_y.ptr<float>(i), gradient_x.cols, edges_number, level);
+      });
+  }
+
   // Function to determine the angles from the gradient images
-  void orientations_from_gradient(const cv::Mat& gradient_x, const cv::Mat& gradient_y, const int& edges_number, cv::Mat &gradient_vp_x, cv::Mat &gradient_vp_y, cv::Mat &gradient_bar_x, cv::Mat &gradient_bar_y) {
+  void orientations_from_gradient_trig(const cv::Mat& gradient_x, const cv::Mat& gradient_y, const int& edges_number, cv::Mat &gradient_vp_x, cv::Mat &gradient_vp_y, cv::Mat &gradient_bar_x, cv::Mat &gradient_bar_y) {
 
     // Allocation of the diffrent gradients
     cv::Mat gradient_gp_radian = cv::Mat(gradient_x.size(), CV_32F);
@@ -299,20 +317,24 @@ namespace initopt {
     cv::Mat gradient_vp_degree = cv::Mat(gradient_x.size(), CV_32F);
 
     // Compute gradient gp in radian
-    for (int i = 0; i < gradient_gp_radian.rows; i++)
-      for (int j = 0; j < gradient_gp_radian.cols ; j++)
-        gradient_gp_radian.at<float>(i, j) = atan2(gradient_y.at<float>(i, j), gradient_x.at<float>(i, j));
+    parallel::parallel_for_rows(gradient_gp_radian.rows, [&](const int row_begin, const int row_end) {
+        for (int i = row_begin; i < row_end; i++)
+          for (int j = 0; j < gradient_gp_radian.cols ; j++)
+            gradient_gp_radian.at<float>(i, j) = atan2(gradient_y.at<float>(i, j), gradient_x.at<float>(i, j));
+      });
 
     // Convert from gradient gp to degree
     cv::divide((180.0 * gradient_gp_radian), cv::Mat::ones(gradient_gp_radian.size(), CV_32F) * M_PI, gradient_gp_degree);
      
     // Compute the gradient vp in degree
-    for (int i = 0; i < gradient_vp_degree.rows; i++) {
-      for (int j = 0; j < gradient_vp_degree.cols; j++) {
-        gradient_vp_degree.at<float>(i, j) = gradient_gp_degree.at<float>(i, j) * (float) edges_number;
-        gradient_vp_degree.at<float>(i, j) = fmod(gradient_vp_degree.at<float>(i, j), (float) 360.00);
-      }
-    }
+    parallel::parallel_for_rows(gradient_vp_degree.rows, [&](const int row_begin, const int row_end) {
+        for (int i = row_begin; i < row_end; i++) {
+          for (int j = 0; j < gradient_vp_degree.cols; j++) {
+            gradient_vp_degree.at<float>(i, j) = gradient_gp_degree.at<float>(i, j) * (float) edges_number;
+            gradient_vp_degree.at<float>(i, j) = fmod(gradient_vp_degree.at<float>(i, j), (float) 360.00);
+          }
+        }
+      });
     
     // Compute the angle difference between the gradients vp and gp
     cv::Mat theta;
@@ -320,12 +342,14 @@ namespace initopt {
 
     cv::Mat cos_theta = cv::Mat::zeros(theta.size(), CV_32F);
     cv::Mat sin_theta = cv::Mat::zeros(theta.size(), CV_32F);
-    for (int i = 0; i < theta.rows; i++) {
-      for (int j = 0; j < theta.cols; j++) {
-        cos_theta.at<float>(i, j) = cos(theta.at<float>(i, j));
-        sin_theta.at<float>(i, j) = sin(theta.at<float>(i, j));
-      }
-    }
+    parallel::parallel_for_rows(theta.rows, [&](const int row_begin, const int row_end) {
+        for (int i = row_begin; i < row_end; i++) {
+          for (int j = 0; j < theta.cols; j++) {
+            cos_theta.at<float>(i, j) = cos(theta.at<float>(i, j));
+            sin_theta.at<float>(i, j) = sin(theta.at<float>(i, j));
+          }
+        }
+      });
 
     cv::Mat tmp_matrix_1;
     cv::Mat tmp_matrix_2;
@@ -358,20 +382,22 @@ namespace initopt {
     return result;
   }
 
-  // Function to determine mass center by voting
-  cv::Point2f mass_center_by_voting(const cv::Mat& magnitude_image, const cv::Mat& gradient_x, const cv::Mat& gradient_y, const cv::Mat& gradient_bar_x, const cv::Mat& gradient_bar_y, const cv::Mat& gradient_vp_x, const cv::Mat& gradient_vp_y, const float& radius, const int& edges_number) {
+  // Function to determine mass center by voting over full size images
+  cv::Point2f mass_center_by_voting_dense(const cv::Mat& magnitude_image, const cv::Mat& gradient_x, const cv::Mat& gradient_y, const cv::Mat& gradient_bar_x, const cv::Mat& gradient_bar_y, const cv::Mat& gradient_vp_x, const cv::Mat& gradient_vp_y, const float& radius, const int& edges_number) {
 
     // Create all the possible combination of coordinate 
     cv::Mat coord_x = cv::Mat(magnitude_image.size(), CV_32F);
     cv::Mat coord_y = cv::Mat(magnitude_image.size(), CV_32F);
-    for(int i = 0; i < coord_x.rows; i++) {
-      float* ptr_coord_x = coord_x.ptr<float>(i);
-      float* ptr_coord_y = coord_y.ptr<float>(i);
-      for(int j = 0; j < coord_x.cols; j++) {
-	ptr_coord_x[j] = (float) j;
-	ptr_coord_y[j] = (float) i;
-      }
-    }
+    parallel::parallel_for_rows(coord_x.rows, [&](const int row_begin, const int row_end) {
+        for(int i = row_begin; i < row_end; i++) {
+          float* ptr_coord_x = coord_x.ptr<float>(i);
+          float* ptr_coord_y = coord_y.ptr<float>(i);
+          for(int j = 0; j < coord_x.cols; j++) {
+            ptr_coord_x[j] = (float) j;
+            ptr_coord_y[j] = (float) i;
+          }
+        }
+      });
     
     // Allocate the different image needed during the voting process
     cv::Mat pos_vote_x;
@@ -393,117 +419,101 @@ namespace initopt {
     cv::subtract(coord_y, round_matrix(radius * gradient_y), neg_vote_y);
 
     // Check if the values are inside the boundaries
-    for(int i = 0; i < pos_vote_x.rows; i++) {
-      float* ptr_pos_vote_x = pos_vote_x.ptr<float>(i);
-      float* ptr_pos_vote_y = pos_vote_y.ptr<float>(i);
-      float* ptr_neg_vote_x = neg_vote_x.ptr<float>(i);
-      float* ptr_neg_vote_y = neg_vote_y.ptr<float>(i);
-
-      for(int j = 0; j < pos_vote_x.cols; j++) {
-	if(ptr_pos_vote_x[j] < 1) ptr_pos_vote_x[j] = 1;
-	if(ptr_pos_vote_y[j] < 1) ptr_pos_vote_y[j] = 1;
-	if(ptr_neg_vote_x[j] < 1) ptr_neg_vote_x[j] = 1;
-	if(ptr_neg_vote_y[j] < 1) ptr_neg_vote_y[j] = 1;
-	if(ptr_pos_vote_x[j] > pos_vote_x.cols - 1) ptr_pos_vote_x[j] = pos_vote_x.cols - 1;	
-	if(ptr_pos_vote_y[j] > pos_vote_y.rows - 1) ptr_pos_vote_y[j] = pos_vote_y.rows - 1;
-	if(ptr_neg_vote_x[j] > neg_vote_x.cols - 1) ptr_neg_vote_x[j] = neg_vote_x.cols - 1;	
-	if(ptr_neg_vote_y[j] > neg_vote_y.rows - 1) ptr_neg_vote_y[j] = neg_vote_y.rows - 1;
-      }
-    }
+    parallel::parallel_for_rows(pos_vote_x.rows, [&](const int row_begin, const int row_end) {
+        for(int i = row_begin; i < row_end; i++) {
+          float* ptr_pos_vote_x = pos_vote_x.ptr<float>(i);
+          float* ptr_pos_vote_y = pos_vote_y.ptr<float>(i);
+          float* ptr_neg_vote_x = neg_vote_x.ptr<float>(i);
+          float* ptr_neg_vote_y = neg_vote_y.ptr<float>(i);
+
+          for(int j = 0; j < pos_vote_x.cols; j++) {
+            if(ptr_pos_vote_x[j] < 1) ptr_pos_vote_x[j] = 1;
+            if(ptr_pos_vote_y[j] < 1) ptr_pos_vote_y[j] = 1;
+            if(ptr_neg_vote_x[j] < 1) ptr_neg_vote_x[j] = 1;
+            if(ptr_neg_vote_y[j] < 1) ptr_neg_vote_y[j] = 1;
+            if(ptr_pos_vote_x[j] > pos_vote_x.cols - 1) ptr_pos_vote_x[j] = pos_vote_x.cols - 1;
+            if(ptr_pos_vote_y[j] > pos_vote_y.rows - 1) ptr_pos_vote_y[j] = pos_vote_y.rows - 1;
+            if(ptr_neg_vote_x[j] > neg_vote_x.cols - 1) ptr_neg_vote_x[j] = neg_vote_x.cols - 1;
+            if(ptr_neg_vote_y[j] > neg_vote_y.rows - 1) ptr_neg_vote_y[j] = neg_vote_y.rows - 1;
+          }
+        }
+      });
 
     // Calculate W, the unit length of the vote lines in pixel
     int W = (int) ceil(radius * std::tan(M_PI / (float) edges_number));
 
     //Compute Votes
-    for (int i = 0; i < magnitude_image.rows; i++) {
-      for (int j = 0; j < magnitude_image.cols; j++) {
-	if (magnitude_image.at<float>(i, j) != 0.00) {
-	  // Positive votes
-	  for (int m = - W; m <= W; m++) {
-	    int LXpos = (int) pos_vote_x.at<float>(i, j) + (int) ceil((float) m * gradient_bar_x.at<float>(i, j));
-	    int LYpos = (int) pos_vote_y.at<float>(i, j) + (int) ceil((float) m * gradient_bar_y.at<float>(i, j));
-
-	    int LXneg = (int) neg_vote_x.at<float>(i, j) + (int) ceil((float) m * gradient_bar_x.at<float>(i, j));
-	    int LYneg = (int) neg_vote_y.at<float>(i, j) + (int) ceil((float) m * gradient_bar_y.at<float>(i, j));
-
-	    if((LXpos >= 0) && (LXpos < magnitude_image.cols) &&
-	       (LYpos >= 0) && (LYpos < magnitude_image.rows)) {
-	      // Vote for Or image
-	      Or.at<float>(LYpos, LXpos) = Or.at<float>(LYpos, LXpos) + 1.00;
-
-	      // Vote the Br image for X and Y
-	      BrX.at<float>(LYpos, LXpos) = BrX.at<float>(LYpos, LXpos) + gradient_vp_x.at<float>(i, j);
-	      BrY.at<float>(LYpos, LXpos) = BrY.at<float>(LYpos, LXpos) + gradient_vp_y.at<float>(i, j);
-	    }
-	    if((LXneg >= 0) && (LXneg < magnitude_image.cols) && 
-	       (LYneg >= 0) && (LYneg < magnitude_image.rows)) {
-	      // Vote for Or image
-	      Or.at<float>(LYneg, LXneg) = Or.at<float>(LYneg, LXneg) + 1.00;
-
-	      // Vote the Br image for X and Y
-	      BrX.at<float>(LYneg, LXneg) = BrX.at<float>(LYneg, LXneg) + gradient_vp_x.at<float>(i, j);
-	      BrY.at<float>(LYneg, LXneg) = BrY.at<float>(LYneg, LXneg) + gradient_vp_y.at<float>(i, j);
-	    }
-	  }
-
-	  // First negative votes
-	  for (int m = (- 2 * W); m <= (- W - 1); m++) {
-	    int LXpos = (int) pos_vote_x.at<float>(i, j) + (int) ceil((float) m * gradient_bar_x.at<float>(i, j));
-	    int LYpos = (int) pos_vote_y.at<float>(i, j) + (int) ceil((float) m * gradient_bar_y.at<float>(i, j));
-
-	    int LXneg = (int) neg_vote_x.at<float>(i, j) + (int) ceil((float) m * gradient_bar_x.at<float>(i, j));
-	    int LYneg = (int) neg_vote_y.at<float>(i, j) + (int) ceil((float) m * gradient_bar_y.at<float>(i, j));
-
-	    if((LXpos >= 0) && (LXpos < magnitude_image.cols) && 
-	       (LYpos >= 0) && (LYpos < magnitude_image.rows)) {
-	      // Vote for Or image
-	      Or.at<float>(LYpos, LXpos) = Or.at<float>(LYpos, LXpos) - 1.00;
-
-	      // Vote the Br image for X and Y
-	      BrX.at<float>(LYpos, LXpos) = BrX.at<float>(LYpos, LXpos) - gradient_vp_x.at<float>(i, j);
-	      BrY.at<float>(LYpos, LXpos) = BrY.at<float>(LYpos, LXpos) - gradient_vp_y.at<float>(i, j);
-	    }
-	    if((LXneg >= 0) && (LXneg < magnitude_image.cols) && 
-	       (LYneg >= 0) && (LYneg < magnitude_image.rows)) {
-	      // Vote for Or image
-	      Or.at<float>(LYneg, LXneg) = Or.at<float>(LYneg, LXneg) - 1.00;
-
-	      // Vote the Br image for X and Y
-	      BrX.at<float>(LYneg, LXneg) = BrX.at<float>(LYneg, LXneg) - gradient_vp_x.at<float>(i, j);
-	      BrY.at<float>(LYneg, LXneg) = BrY.at<float>(LYneg, LXneg) - gradient_vp_y.at<float>(i, j);
-	    }
-	  }
-
-	  // Second negative votes
-	  for (int m = (W + 1); m <= (2 * W); m++) {
-	    int LXpos = (int) pos_vote_x.at<float>(i, j) + (int) ceil((float) m * gradient_bar_x.at<float>(i, j));
-	    int LYpos = (int) pos_vote_y.at<float>(i, j) + (int) ceil((float) m * gradient_bar_y.at<float>(i, j));
-
-	    int LXneg = (int) neg_vote_x.at<float>(i, j) + (int) ceil((float) m * gradient_bar_x.at<float>(i, j));
-	    int LYneg = (int) neg_vote_y.at<float>(i, j) + (int) ceil((float) m * gradient_bar_y.at<float>(i, j));
-
-	    if((LXpos >= 0) && (LXpos < magnitude_image.cols) &&
-	       (LYpos >= 0) && (LYpos < magnitude_image.rows)) {
-	      // Vote for Or image
-	      Or.at<float>(LYpos, LXpos) = Or.at<float>(LYpos, LXpos) - 1.00;
-
-	      // Vote the Br image for X and Y
-	      BrX.at<float>(LYpos, LXpos) = BrX.at<float>(LYpos, LXpos) - gradient_vp_x.at<float>(i, j);
-	      BrY.at<float>(LYpos, LXpos) = BrY.at<float>(LYpos, LXpos) - gradient_vp_y.at<float>(i, j);
-	    }
-	    if((LXneg >= 0) && (LXneg < magnitude_image.cols) && 
-	       (LYneg >= 0) && (LYneg < magnitude_image.rows)) {
-	      // Vote for Or image
-	      Or.at<float>(LYneg, LXneg) = Or.at<float>(LYneg, LXneg) - 1.00;
-
-	      // Vote the Br image for X and Y
-	      BrX.at<float>(LYneg, LXneg) = BrX.at<float>(LYneg, LXneg) - gradient_vp_x.at<float>(i, j);
-	      BrY.at<float>(LYneg, LXneg) = BrY.at<float>(LYneg, LXneg) - gradient_vp_y.at<float>(i, j);
-	    }
-	  }
-	}
-      }
-    }
+    // The votes are cast in parallel by bands of edge pixels and sorted by band of voted rows. Each band of
+    // voted rows then applies its votes in the order of the edge pixels, which gives the same sums as the
+    // serial loop whatever the number of threads.
+    const std::vector< int > bounds = parallel::row_bands(magnitude_image.rows);
+    const int n_bands = static_cast<int> (bounds.size()) - 1;
+    std::vector< int > band_of_row(magnitude_image.rows);
+    for (int band = 0; band < n_bands; band++)
+      std::fill(band_of_row.begin() + bounds[band], band_of_row.begin() + bounds[band + 1], band);
+
+    // votes[edge_band * n_bands + voted_band]
+    std::vector< std::vector< Vote > > votes(n_bands * n_bands);
+
+    parallel::global_pool().run(n_bands, [&](const int edge_band) {
+        // Add a vote if it is inside the image -- sign is 1 for the positive votes and -1 for the negative ones
+        auto cast_vote = [&](const int LX, const int LY, const float sign, const float vp_x, const float vp_y) {
+          if((LX >= 0) && (LX < magnitude_image.cols) &&
+             (LY >= 0) && (LY < magnitude_image.rows)) {
+            const Vote vote = { LY * magnitude_image.cols + LX, sign, sign * vp_x, sign * vp_y };
+            votes[edge_band * n_bands + band_of_row[LY]].push_back(vote);
+          }
+        };
+
+        for (int i = bounds[edge_band]; i < bounds[edge_band + 1]; i++) {
+          for (int j = 0; j < magnitude_image.cols; j++) {
+            if (magnitude_image.at<float>(i, j) != 0.00) {
+              const float vp_x = gradient_vp_x.at<float>(i, j);
+              const float vp_y = gradient_vp_y.at<float>(i, j);
+              const int pos_x = (int) pos_vote_x.at<float>(i, j);
+              const int pos_y = (int) pos_vote_y.at<float>(i, j);
+              const int neg_x = (int) neg_vote_x.at<float>(i, j);
+              const int neg_y = (int) neg_vote_y.at<float>(i, j);
+              const float bar_x = gradient_bar_x.at<float>(i, j);
+              const float bar_y = gradient_bar_y.at<float>(i, j);
+
+              // Positive votes, then the first and the second negative votes
+              for (int m = - W; m <= W; m++) {
+                const int dx = (int) ceil((float) m * bar_x);
+                const int dy = (int) ceil((float) m * bar_y);
+                cast_vote(pos_x + dx, pos_y + dy, 1.0f, vp_x, vp_y);
+                cast_vote(neg_x + dx, neg_y + dy, 1.0f, vp_x, vp_y);
+              }
+              for (int m = (- 2 * W); m <= (- W - 1); m++) {
+                const int dx = (int) ceil((float) m * bar_x);
+                const int dy = (int) ceil((float) m * bar_y);
+                cast_vote(pos_x + dx, pos_y + dy, -1.0f, vp_x, vp_y);
+                cast_vote(neg_x + dx, neg_y + dy, -1.0f, vp_x, vp_y);
+              }
+              for (int m = (W + 1); m <= (2 * W); m++) {
+                const int dx = (int) ceil((float) m * bar_x);
+                const int dy = (int) ceil((float) m * bar_y);
+                cast_vote(pos_x + dx, pos_y + dy, -1.0f, vp_x, vp_y);
+                cast_vote(neg_x + dx, neg_y + dy, -1.0f, vp_x, vp_y);
+              }
+            }
+          }
+        }
+      });
+
+    // Accumulate the votes -- each band of voted rows is owned by a single task
+    parallel::global_pool().run(n_bands, [&](const int voted_band) {
+        float* ptr_Or = Or.ptr<float>();
+        float* ptr_BrX = BrX.ptr<float>();
+        float* ptr_BrY = BrY.ptr<float>();
+        for (int edge_band = 0; edge_band < n_bands; edge_band++) {
+          for (const Vote& vote : votes[edge_band * n_bands + voted_band]) {
+            ptr_Or[vote.index] += vote.o;
+            ptr_BrX[vote.index] += vote.x;
+            ptr_BrY[vote.index] += vote.y;
+          }
+        }
+      });
 
     // Compute Br
     cv::magnitude(BrX, BrY, Br);
@@ -588,8 +598,534 @@ namespace initopt {
     return(cv::Point2f(ceil(sumX / normalization), ceil(sumY / normalization)));
   }
 
-  // Function to discover the mass center using the radial symmetry detector
-  cv::Point2f radial_symmetry_detector(const cv::Mat& roi_image, const int& radius, const int& edges_number) {
+  namespace {
+
+    // Edge pixels of a gradient field, in the order of the rows, with their gradients
+    struct EdgeList {
+      std::vector< int > x;
+      std::vector< int > y;
+      std::vector< float > gradient_x;
+      std::vector< float > gradient_y;
+    };
+
+    // Hypothesis voted on an EdgeList -- shape and vote directions of each edge pixel
+    struct HypothesisVotes {
+      float radius;
+      int edges_number;
+      const float* vp_x;
+      const float* vp_y;
+      const float* bar_x;
+      const float* bar_y;
+    };
+
+    // Values of an image at the edge pixels
+    void gather_edges(const cv::Mat& image, const EdgeList& edges, std::vector< float >& values) {
+      values.resize(edges.x.size());
+      for (size_t k = 0; k < edges.x.size(); k++)
+        values[k] = image.at<float>(edges.y[k], edges.x[k]);
+    }
+
+    // Function to compact the edge pixels, i.e. the non-null magnitudes, and their gradients
+    void compact_edges(const cv::Mat& magnitude_image, const cv::Mat& gradient_x, const cv::Mat& gradient_y, EdgeList& edges) {
+
+      const int cols = magnitude_image.cols;
+      const std::vector< int > bounds = parallel::row_bands(magnitude_image.rows);
+      const int n_bands = static_cast<int> (bounds.size()) - 1;
+      std::vector< std::vector< int > > band_x(n_bands), band_y(n_bands);
+
+      parallel::global_pool().run(n_bands, [&](const int band) {
+          std::vector< int > columns(cols);
+          for (int i = bounds[band]; i < bounds[band + 1]; i++) {
+            const int n_edges = edge_pixels_row_simd(magnitude_image.ptr<float>(i), cols, columns.data());
+            band_x[band].insert(band_x[band].end(), columns.begin(), columns.begin() + n_edges);
+            band_y[band].insert(band_y[band].end(), n_edges, i);
+          }
+        });
+
+      edges.x.clear();
+      edges.y.clear();
+      for (int band = 0; band < n_bands; band++) {
+        edges.x.insert(edges.x.end(), band_x[band].begin(), band_x[band].end());
+        edges.y.insert(edges.y.end(), band_y[band].begin(), band_y[band].end());
+      }
+      gather_edges(gradient_x, edges, edges.gradient_x);
+      gather_edges(gradient_y, edges, edges.gradient_y);
+    }
+
+    // First pixels of the positive and negative vote lines of an edge pixel, kept inside [1, cols - 1] x [1, rows - 1]
+    inline void vote_line_origins(const EdgeList& edges, const size_t k, const float radius, const int rows, const int cols,
+                                  int& pos_x, int& pos_y, int& neg_x, int& neg_y) {
+      const int shift_x = cvRound(radius * edges.gradient_x[k]);
+      const int shift_y = cvRound(radius * edges.gradient_y[k]);
+      pos_x = std::min(std::max(edges.x[k] + shift_x, 1), cols - 1);
+      pos_y = std::min(std::max(edges.y[k] + shift_y, 1), rows - 1);
+      neg_x = std::min(std::max(edges.x[k] - shift_x, 1), cols - 1);
+      neg_y = std::min(std::max(edges.y[k] - shift_y, 1), rows - 1);
+    }
+
+    // Cast the votes of an edge pixel for a hypothesis of unit length W -- vote(LX, LY, sign) is called for each point
+    // of its vote lines inside the image, in the order of the dense voting. sign is 1 for the positive votes and -1
+    // for the negative ones. offsets_x and offsets_y hold 4 * W + 1 entries.
+    template<typename VoteFunction> inline void cast_votes(const EdgeList& edges, const int k, const HypothesisVotes& hypothesis, const int W,
+                                                           const int rows, const int cols, int* offsets_x, int* offsets_y, VoteFunction vote) {
+      int pos_x, pos_y, neg_x, neg_y;
+      vote_line_origins(edges, k, hypothesis.radius, rows, cols, pos_x, pos_y, neg_x, neg_y);
+      line_offsets_simd(hypothesis.bar_x[k], hypothesis.bar_y[k], 2 * W, offsets_x, offsets_y);
+      const int* dx = offsets_x + 2 * W;
+      const int* dy = offsets_y + 2 * W;
+
+      auto cast_vote = [&](const int LX, const int LY, const float sign) {
+        if((LX >= 0) && (LX < cols) && (LY >= 0) && (LY < rows))
+          vote(LX, LY, sign);
+      };
+
+      // Positive votes, then the first and the second negative votes
+      for (int m = - W; m <= W; m++) {
+        cast_vote(pos_x + dx[m], pos_y + dy[m], 1.0f);
+        cast_vote(neg_x + dx[m], neg_y + dy[m], 1.0f);
+      }
+      for (int m = (- 2 * W); m <= (- W - 1); m++) {
+        cast_vote(pos_x + dx[m], pos_y + dy[m], -1.0f);
+        cast_vote(neg_x + dx[m], neg_y + dy[m], -1.0f);
+      }
+      for (int m = (W + 1); m <= (2 * W); m++) {
+        cast_vote(pos_x + dx[m], pos_y + dy[m], -1.0f);
+        cast_vote(neg_x + dx[m], neg_y + dy[m], -1.0f);
+      }
+    }
+
+    // Function to find the center from the accumulators of a hypothesis, which cover the window of its votes
+    cv::Point2f center_from_accumulators(cv::Mat& Or, const cv::Mat& BrX, const cv::Mat& BrY, const cv::Rect& window,
+                                         const int rows, const int cols, const int W, const float radius, const int edges_number) {
+
+      // Compute Br
+      cv::Mat Br;
+      cv::magnitude(BrX, BrY, Br);
+
+      // To avoid edge effect - remove the votes on the 5 first columns and rows of the image. As in the dense
+      // voting, the last columns and rows are kept.
+      const int border = 5;
+      const int border_cols = std::min(std::max(border - window.x, 0), window.width);
+      const int border_rows = std::min(std::max(border - window.y, 0), window.height);
+      Or(cv::Rect(0, 0, border_cols, window.height)).setTo(0.0);
+      Br(cv::Rect(0, 0, border_cols, window.height)).setTo(0.0);
+      Or(cv::Rect(0, 0, window.width, border_rows)).setTo(0.0);
+      Br(cv::Rect(0, 0, window.width, border_rows)).setTo(0.0);
+
+      /*
+       * Symmetry image, null outside the window
+       */
+
+      cv::Mat Sr;
+      if (edges_number == 12)
+        cv::multiply(Or, Or, Sr);
+      else
+        cv::multiply(Or, Br, Sr);
+
+      const float normalisation_votes = (float) pow(2.00 * (float) W * radius, 2.00);
+      for (int i = 0; i < Sr.rows; i++) {
+        float* ptr_Sr = Sr.ptr<float>(i);
+        for (int j = 0; j < Sr.cols; j++)
+          ptr_Sr[j] = ptr_Sr[j] / normalisation_votes;
+      }
+
+      double sigma = 0.2 * radius;
+      int mask_size = (int) ceil(6 * sigma);
+      if(!(mask_size % 2)) mask_size++;
+      if(mask_size < 1) mask_size = 1;
+
+      // Smooth Sr over the window grown by the half size of the mask, out of which the smoothed image is null
+      const int half_mask = mask_size / 2;
+      const cv::Rect blur_window = cv::Rect(window.x - half_mask, window.y - half_mask, window.width + 2 * half_mask,
+                                            window.height + 2 * half_mask) & cv::Rect(0, 0, cols, rows);
+      cv::Mat Sr_blurred = cv::Mat::zeros(blur_window.size(), CV_32F);
+      Sr.copyTo(Sr_blurred(window - blur_window.tl()));
+      cv::GaussianBlur(Sr_blurred, Sr_blurred, cv::Size(mask_size, mask_size), sigma, sigma, cv::BORDER_CONSTANT);
+
+      // Normalise Sr -- the null pixels out of the window take part to the range, as in cv::normalize
+      const bool has_outside = blur_window.area() < rows * cols;
+      double min_Sr, max_Sr;
+      cv::minMaxLoc(Sr_blurred, &min_Sr, &max_Sr);
+      if (has_outside) {
+        min_Sr = std::min(min_Sr, 0.0);
+        max_Sr = std::max(max_Sr, 0.0);
+      }
+      const double scale = (max_Sr - min_Sr > DBL_EPSILON) ? 1.0 / (max_Sr - min_Sr) : 0.0;
+      const double shift = - min_Sr * scale;
+      cv::Mat S;
+      Sr_blurred.convertTo(S, CV_32F, scale, shift);
+      const float outside_value = cv::saturate_cast<float> (shift);
+
+      // Find the maximum intensity value
+      double max_value;
+      cv::minMaxLoc(S, NULL, &max_value);
+      if (has_outside)
+        max_value = std::max(max_value, (double) outside_value);
+
+      // Choose the threshold as close as possible to the maximum value
+      float thresholdBin = (float) (max_value * THRESH_BINARY);
+
+      // Compute the gravity center of the pixels above the threshold. The pixels out of the window are only
+      // visited if their null symmetry is above it.
+      const bool outside_kept = has_outside && (outside_value > thresholdBin);
+      float sumX = 0, sumY = 0, normalization = 0;
+      for (int i = 0; i < rows; i ++) {
+        const bool row_inside = (i >= blur_window.y) && (i < blur_window.y + blur_window.height);
+        if (!row_inside && !outside_kept)
+          continue;
+        const float* ptr_S = row_inside ? S.ptr<float>(i - blur_window.y) : NULL;
+        const int j_begin = outside_kept ? 0 : blur_window.x;
+        const int j_end = outside_kept ? cols : blur_window.x + blur_window.width;
+        for (int j = j_begin; j < j_end; j++) {
+          const bool inside = row_inside && (j >= blur_window.x) && (j < blur_window.x + blur_window.width);
+          if ((inside ? ptr_S[j - blur_window.x] : outside_value) > thresholdBin) {
+            sumX += (float) j;
+            sumY += (float) i;
+            normalization += 1.00;
+          }
+        }
+      }
+
+      return(cv::Point2f(ceil(sumX / normalization), ceil(sumY / normalization)));
+    }
+
+    // Length of the offsets of the longest vote lines of the hypotheses
+    int max_offsets_length(const std::vector< int >& W) {
+      int max_length = 1;
+      for (size_t h = 0; h < W.size(); h++)
+        max_length = std::max(max_length, 4 * W[h] + 1);
+      return max_length;
+    }
+
+    // The votes are cast in parallel by chunks of edge pixels and sorted by hypothesis and band of voted rows.
+    // Each band of voted rows then applies its votes in the order of the edge pixels, which gives the same sums
+    // as a serial loop whatever the number of threads, and as the voting of each hypothesis alone.
+    void accumulate_ordered_votes(const EdgeList& edges, const int rows, const int cols, const std::vector< HypothesisVotes >& hypotheses,
+                                  const std::vector< int >& W, const std::vector< cv::Rect >& windows,
+                                  std::vector< cv::Mat >& Or, std::vector< cv::Mat >& BrX, std::vector< cv::Mat >& BrY) {
+
+      const int n_hypotheses = static_cast<int> (hypotheses.size());
+      const std::vector< int > chunks = parallel::row_bands(static_cast<int> (edges.x.size()), 64);
+      const int n_chunks = static_cast<int> (chunks.size()) - 1;
+
+      std::vector< std::vector< int > > voted_bounds(n_hypotheses), band_of_row(n_hypotheses);
+      // votes[h][chunk * n_voted_bands[h] + voted_band]
+      std::vector< std::vector< std::vector< Vote > > > votes(n_hypotheses);
+      std::vector< std::pair< int, int > > accumulation_tasks;
+      for (int h = 0; h < n_hypotheses; h++) {
+        voted_bounds[h] = parallel::row_bands(windows[h].height);
+        const int n_voted_bands = static_cast<int> (voted_bounds[h].size()) - 1;
+        band_of_row[h].resize(windows[h].height);
+        for (int band = 0; band < n_voted_bands; band++) {
+          std::fill(band_of_row[h].begin() + voted_bounds[h][band], band_of_row[h].begin() + voted_bounds[h][band + 1], band);
+          accumulation_tasks.push_back(std::make_pair(h, band));
+        }
+        votes[h].resize(n_chunks * n_voted_bands);
+      }
+
+      parallel::global_pool().run(n_chunks, [&](const int chunk) {
+          // Offsets of the points of the lines, shared by the positive and the negative lines
+          std::vector< int > offsets_x(max_offsets_length(W)), offsets_y(max_offsets_length(W));
+
+          for (int k = chunks[chunk]; k < chunks[chunk + 1]; k++) {
+            // Every hypothesis votes for the edge pixel while its data is in cache
+            for (int h = 0; h < n_hypotheses; h++) {
+              const cv::Rect& window = windows[h];
+              const int n_voted_bands = static_cast<int> (voted_bounds[h].size()) - 1;
+              std::vector< Vote >* chunk_votes = &votes[h][chunk * n_voted_bands];
+              const int* row_band = band_of_row[h].data();
+              const float vp_x = hypotheses[h].vp_x[k];
+              const float vp_y = hypotheses[h].vp_y[k];
+
+              cast_votes(edges, k, hypotheses[h], W[h], rows, cols, offsets_x.data(), offsets_y.data(), [&](const int LX, const int LY, const float sign) {
+                  const int row = LY - window.y;
+                  const Vote vote = { row * window.width + LX - window.x, sign, sign * vp_x, sign * vp_y };
+                  chunk_votes[row_band[row]].push_back(vote);
+                });
+            }
+          }
+        });
+
+      // Accumulate the votes -- each band of voted rows of each hypothesis is owned by a single task
+      for (int h = 0; h < n_hypotheses; h++) {
+        Or[h] = cv::Mat::zeros(windows[h].size(), CV_32F);
+        BrX[h] = cv::Mat::zeros(windows[h].size(), CV_32F);
+        BrY[h] = cv::Mat::zeros(windows[h].size(), CV_32F);
+      }
+      parallel::global_pool().run(static_cast<int> (accumulation_tasks.size()), [&](const int task) {
+          const int h = accumulation_tasks[task].first;
+          const int voted_band = accumulation_tasks[task].second;
+          const int n_voted_bands = static_cast<int> (voted_bounds[h].size()) - 1;
+          float* ptr_Or = Or[h].ptr<float>();
+          float* ptr_BrX = BrX[h].ptr<float>();
+          float* ptr_BrY = BrY[h].ptr<float>();
+          for (int chunk = 0; chunk < n_chunks; chunk++) {
+            for (const Vote& vote : votes[h][chunk * n_voted_bands + voted_band]) {
+              ptr_Or[vote.index] += vote.o;
+              ptr_BrX[vote.index] += vote.x;
+              ptr_BrY[vote.index] += vote.y;
+            }
+          }
+        });
+    }
+
+    // Vote direction in the private accumulators -- as is in float, in fixed point in integer
+    template<typename T> T accumulated_direction(const float direction);
+    template<> inline float accumulated_direction<float>(const float direction) { return direction; }
+    template<> inline int accumulated_direction<int>(const float direction) { return cvRound(direction * VOTE_FIXED_POINT_SCALE); }
+
+    // Merge of a row of the private accumulators
+    inline void merge_accumulators_row(const float* const* parts, const int n_parts, const float, float* merged, const int n) {
+      merge_votes_row_simd(parts, n_parts, merged, n);
+    }
+    inline void merge_accumulators_row(const int* const* parts, const int n_parts, const float scale, float* merged, const int n) {
+      merge_votes_row_simd(parts, n_parts, scale, merged, n);
+    }
+
+    // Merge the private copies of an accumulator of a window -- the rows are merged in parallel, each one summing the
+    // copies in the order of the parts
+    template<typename T> void merge_accumulators(const std::vector< cv::Mat >& parts, const float scale, cv::Mat& merged) {
+      merged.create(parts[0].size(), CV_32F);
+      const int n_parts = static_cast<int> (parts.size());
+      parallel::parallel_for_rows(merged.rows, [&](const int row_begin, const int row_end) {
+          std::vector< const T* > part_rows(n_parts);
+          for (int i = row_begin; i < row_end; i++) {
+            for (int part = 0; part < n_parts; part++)
+              part_rows[part] = parts[part].ptr<T>(i);
+            merge_accumulators_row(part_rows.data(), n_parts, scale, merged.ptr<float>(i), merged.cols);
+          }
+        });
+    }
+
+    // The edge pixels are partitioned into contiguous parts, one per thread, and each part votes into its own copy
+    // of the accumulators. The copies are then merged. In integer, the sums are exact so do not depend on the
+    // partition. Called from a task of the pool, the parts would run serially: a single part is used.
+    template<typename T> void accumulate_private_votes(const EdgeList& edges, const int rows, const int cols, const std::vector< HypothesisVotes >& hypotheses,
+                                                       const std::vector< int >& W, const std::vector< cv::Rect >& windows,
+                                                       std::vector< cv::Mat >& Or, std::vector< cv::Mat >& BrX, std::vector< cv::Mat >& BrY) {
+
+      const int n_hypotheses = static_cast<int> (hypotheses.size());
+      const int n_edges = static_cast<int> (edges.x.size());
+      const int n_parts = parallel::in_pool_task() ? 1 : std::max(1, std::min(parallel::get_num_threads(), n_edges));
+
+      // part_Or[h][part]
+      std::vector< std::vector< cv::Mat > > part_Or(n_hypotheses), part_BrX(n_hypotheses), part_BrY(n_hypotheses);
+      for (int h = 0; h < n_hypotheses; h++) {
+        part_Or[h].resize(n_parts);
+        part_BrX[h].resize(n_parts);
+        part_BrY[h].resize(n_parts);
+      }
+
+      parallel::global_pool().run(n_parts, [&](const int part) {
+          // Balanced parts, the first ones get the remaining edge pixels
+          const int k_begin = part * (n_edges / n_parts) + std::min(part, n_edges % n_parts);
+          const int k_end = k_begin + n_edges / n_parts + ((part < n_edges % n_parts) ? 1 : 0);
+
+          std::vector< T* > ptr_Or(n_hypotheses), ptr_BrX(n_hypotheses), ptr_BrY(n_hypotheses);
+          for (int h = 0; h < n_hypotheses; h++) {
+            part_Or[h][part] = cv::Mat::zeros(windows[h].size(), cv::DataType<T>::type);
+            part_BrX[h][part] = cv::Mat::zeros(windows[h].size(), cv::DataType<T>::type);
+            part_BrY[h][part] = cv::Mat::zeros(windows[h].size(), cv::DataType<T>::type);
+            ptr_Or[h] = part_Or[h][part].ptr<T>();
+            ptr_BrX[h] = part_BrX[h][part].ptr<T>();
+            ptr_BrY[h] = part_BrY[h][part].ptr<T>();
+          }
+
+          std::vector< int > offsets_x(max_offsets_length(W)), offsets_y(max_offsets_length(W));
+          for (int k = k_begin; k < k_end; k++) {
+            for (int h = 0; h < n_hypotheses; h++) {
+              const cv::Rect& window = windows[h];
+              T* Or_h = ptr_Or[h];
+              T* BrX_h = ptr_BrX[h];
+              T* BrY_h = ptr_BrY[h];
+              const T vp_x = accumulated_direction<T>(hypotheses[h].vp_x[k]);
+              const T vp_y = accumulated_direction<T>(hypotheses[h].vp_y[k]);
+
+              cast_votes(edges, k, hypotheses[h], W[h], rows, cols, offsets_x.data(), offsets_y.data(), [&](const int LX, const int LY, const float sign) {
+                  const int index = (LY - window.y) * window.width + LX - window.x;
+                  if (sign > 0.0f) {
+                    Or_h[index] += 1;
+                    BrX_h[index] += vp_x;
+                    BrY_h[index] += vp_y;
+                  }
+                  else {
+                    Or_h[index] -= 1;
+                    BrX_h[index] -= vp_x;
+                    BrY_h[index] -= vp_y;
+                  }
+                });
+            }
+          }
+        });
+
+      // Vectorized reduction of the copies -- a single copy in float is the result itself
+      const float direction_scale = 1.0f / accumulated_direction<T>(1.0f);
+      for (int h = 0; h < n_hypotheses; h++) {
+        if (n_parts == 1 && cv::DataType<T>::type == CV_32F) {
+          Or[h] = part_Or[h][0];
+          BrX[h] = part_BrX[h][0];
+          BrY[h] = part_BrY[h][0];
+          continue;
+        }
+        merge_accumulators<T>(part_Or[h], 1.0f, Or[h]);
+        merge_accumulators<T>(part_BrX[h], direction_scale, BrX[h]);
+        merge_accumulators<T>(part_BrY[h], direction_scale, BrY[h]);
+      }
+    }
+
+    // Function to vote for several hypotheses in a single sweep over the edge pixels of an image of rows x cols pixels
+    void vote_hypotheses(const EdgeList& edges, const int rows, const int cols, const std::vector< HypothesisVotes >& hypotheses,
+                         const VoteAccumulation accumulation, std::vector< cv::Point2f >& centers) {
+
+      const int n_hypotheses = static_cast<int> (hypotheses.size());
+      const int n_edges = static_cast<int> (edges.x.size());
+      centers.assign(n_hypotheses, cv::Point2f(std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::quiet_NaN()));
+
+      // Calculate W, the unit length of the vote lines in pixel -- the vote lines span m in [- 2W, 2W]
+      std::vector< int > W(n_hypotheses);
+      for (int h = 0; h < n_hypotheses; h++)
+        W[h] = (int) ceil(hypotheses[h].radius * std::tan(M_PI / (float) hypotheses[h].edges_number));
+
+      // Contiguous chunks of edge pixels, in the order of the list
+      const std::vector< int > chunks = parallel::row_bands(n_edges, 64);
+      const int n_chunks = static_cast<int> (chunks.size()) - 1;
+
+      /*
+       * Window of the accumulators of each hypothesis -- bounding box of its votes inside the image
+       */
+
+      std::vector< cv::Vec4i > chunk_boxes(n_chunks * n_hypotheses, cv::Vec4i(cols, rows, -1, -1));
+      parallel::global_pool().run(n_chunks, [&](const int chunk) {
+          for (int h = 0; h < n_hypotheses; h++) {
+            const HypothesisVotes& hypothesis = hypotheses[h];
+            const int half_length = 2 * W[h];
+            cv::Vec4i& box = chunk_boxes[chunk * n_hypotheses + h];
+            for (int k = chunks[chunk]; k < chunks[chunk + 1]; k++) {
+              int pos_x, pos_y, neg_x, neg_y;
+              vote_line_origins(edges, k, hypothesis.radius, rows, cols, pos_x, pos_y, neg_x, neg_y);
+
+              // ceil(m * bar) is monotonic in m, the ends of the lines bound their votes
+              const int dx_0 = (int) ceil((float) (- half_length) * hypothesis.bar_x[k]), dx_1 = (int) ceil((float) half_length * hypothesis.bar_x[k]);
+              const int dy_0 = (int) ceil((float) (- half_length) * hypothesis.bar_y[k]), dy_1 = (int) ceil((float) half_length * hypothesis.bar_y[k]);
+              box[0] = std::min(box[0], std::min(pos_x, neg_x) + std::min(dx_0, dx_1));
+              box[1] = std::min(box[1], std::min(pos_y, neg_y) + std::min(dy_0, dy_1));
+              box[2] = std::max(box[2], std::max(pos_x, neg_x) + std::max(dx_0, dx_1));
+              box[3] = std::max(box[3], std::max(pos_y, neg_y) + std::max(dy_0, dy_1));
+            }
+          }
+        });
+
+      std::vector< cv::Rect > windows(n_hypotheses);
+      for (int h = 0; h < n_hypotheses; h++) {
+        cv::Vec4i box(cols, rows, -1, -1);
+        for (int chunk = 0; chunk < n_chunks; chunk++) {
+          const cv::Vec4i& chunk_box = chunk_boxes[chunk * n_hypotheses + h];
+          box[0] = std::min(box[0], chunk_box[0]);
+          box[1] = std::min(box[1], chunk_box[1]);
+          box[2] = std::max(box[2], chunk_box[2]);
+          box[3] = std::max(box[3], chunk_box[3]);
+        }
+        windows[h] = cv::Rect(box[0], box[1], box[2] - box[0] + 1, box[3] - box[1] + 1) & cv::Rect(0, 0, cols, rows);
+      }
+
+      // Without any edge pixel there is no vote, no pixel is above the threshold and there is no gravity center
+      if (n_edges == 0)
+        return;
+
+      /*
+       * Votes
+       */
+
+      std::vector< cv::Mat > Or(n_hypotheses), BrX(n_hypotheses), BrY(n_hypotheses);
+      switch (accumulation) {
+      case VOTES_PRIVATE_FLOAT:
+        accumulate_private_votes<float>(edges, rows, cols, hypotheses, W, windows, Or, BrX, BrY);
+        break;
+      case VOTES_PRIVATE_INTEGER:
+        accumulate_private_votes<int>(edges, rows, cols, hypotheses, W, windows, Or, BrX, BrY);
+        break;
+      default:
+        accumulate_ordered_votes(edges, rows, cols, hypotheses, W, windows, Or, BrX, BrY);
+        break;
+      }
+
+      /*
+       * Center of each hypothesis
+       */
+
+      parallel::parallel_for_stealing(n_hypotheses, [&](const int h) {
+          centers[h] = center_from_accumulators(Or[h], BrX[h], BrY[h], windows[h], rows, cols, W[h], hypotheses[h].radius, hypotheses[h].edges_number);
+        });
+    }
+
+  }
+
+  // Function to determine mass center by voting from the list of the edge pixels
+  cv::Point2f mass_center_by_voting(const cv::Mat& magnitude_image, const cv::Mat& gradient_x, const cv::Mat& gradient_y, const cv::Mat& gradient_bar_x, const cv::Mat& gradient_bar_y, const cv::Mat& gradient_vp_x, const cv::Mat& gradient_vp_y, const float& radius, const int& edges_number, const VoteAccumulation accumulation) {
+
+    EdgeList edges;
+    compact_edges(magnitude_image, gradient_x, gradient_y, edges);
+
+    std::vector< float > vp_x, vp_y, bar_x, bar_y;
+    gather_edges(gradient_vp_x, edges, vp_x);
+    gather_edges(gradient_vp_y, edges, vp_y);
+    gather_edges(gradient_bar_x, edges, bar_x);
+    gather_edges(gradient_bar_y, edges, bar_y);
+
+    const HypothesisVotes hypothesis = { radius, edges_number, vp_x.data(), vp_y.data(), bar_x.data(), bar_y.data() };
+    std::vector< cv::Point2f > centers;
+    vote_hypotheses(edges, magnitude_image.rows, magnitude_image.cols, std::vector< HypothesisVotes >(1, hypothesis), accumulation, centers);
+    return centers[0];
+  }
+
+  // Function to compute the gradient field with separable kernels in a single pass
+  void gradient_field(const cv::Mat& roi_image, GradientField& field, const simd::Level level) {
+
+    cv::Mat gray_image_float;
+    rgb_to_float_gray(roi_image, gray_image_float);
+
+    // Border of the folded kernels, as the default border of the dense filters
+    cv::Mat padded_image;
+    cv::copyMakeBorder(gray_image_float, padded_image, GRADIENT_HALF_WIDTH, GRADIENT_HALF_WIDTH,
+                       GRADIENT_HALF_WIDTH, GRADIENT_HALF_WIDTH, cv::BORDER_REFLECT_101);
+
+    field.gradient_x.create(gray_image_float.size(), CV_32F);
+    field.gradient_y.create(gray_image_float.size(), CV_32F);
+    field.magnitude_image.create(gray_image_float.size(), CV_32F);
+    const int cols = gray_image_float.cols;
+
+    parallel::parallel_for_rows(gray_image_float.rows, [&](const int row_begin, const int row_end) {
+        // Ring of the horizontally filtered rows -- the padded row p lands in the slot p % GRADIENT_TAPS
+        std::vector< float > smoothed_rows(GRADIENT_TAPS * cols), derived_rows(GRADIENT_TAPS * cols);
+        for (int p = row_begin; p < row_begin + GRADIENT_TAPS - 1; p++)
+          gradient_h_row_simd(padded_image.ptr<float>(p), &smoothed_rows[(p % GRADIENT_TAPS) * cols],
+                              &derived_rows[(p % GRADIENT_TAPS) * cols], cols, level);
+
+        const float* smoothed[GRADIENT_TAPS];
+        const float* derived[GRADIENT_TAPS];
+        for (int i = row_begin; i < row_end; i++) {
+          // The output row i is centred on the padded row i + GRADIENT_HALF_WIDTH
+          const int p = i + GRADIENT_TAPS - 1;
+          gradient_h_row_simd(padded_image.ptr<float>(p), &smoothed_rows[(p % GRADIENT_TAPS) * cols],
+                              &derived_rows[(p % GRADIENT_TAPS) * cols], cols, level);
+          for (int k = 0; k < GRADIENT_TAPS; k++) {
+            smoothed[k] = &smoothed_rows[((i + k) % GRADIENT_TAPS) * cols];
+            derived[k] = &derived_rows[((i + k) % GRADIENT_TAPS) * cols];
+          }
+          gradient_v_row_simd(smoothed, derived, field.gradient_x.ptr<float>(i), field.gradient_y.ptr<float>(i),
+                              field.magnitude_image.ptr<float>(i), cols, level);
+        }
+      });
+
+    /*
+     * Gradients filtering
+     */
+
+    gradient_thresh(field.magnitude_image, field.gradient_x, field.gradient_y);
+  }
+
+  // Function to compute the gradient field with the pre-blur and the dense derivative filters
+  void gradient_field_dense(const cv::Mat& roi_image, GradientField& field) {
     
     /*
      * Conversion to write data type
@@ -612,91 +1148,306 @@ namespace initopt {
     cv::Mat kernel_y = cv::Mat(5, 5, CV_32F, derivative_y);
 
     // Filter the image to compute the gradient
-    cv::Mat gradient_x, gradient_y;
-    cv::filter2D(blurred_image, gradient_x, CV_32F, - kernel_x);
-    cv::filter2D(blurred_image, gradient_y, CV_32F, - kernel_y);
+    cv::filter2D(blurred_image, field.gradient_x, CV_32F, - kernel_x);
+    cv::filter2D(blurred_image, field.gradient_y, CV_32F, - kernel_y);
 
     // Compute the magnitude
-    cv::Mat magnitude_image;
-    cv::magnitude(gradient_x, gradient_y, magnitude_image);
+    cv::magnitude(field.gradient_x, field.gradient_y, field.magnitude_image);
 
     // Normalise the gradient image using the magnitude
-    cv::divide(gradient_x, magnitude_image, gradient_x);
-    cv::divide(gradient_y, magnitude_image, gradient_y);
+    cv::divide(field.gradient_x, field.magnitude_image, field.gradient_x);
+    cv::divide(field.gradient_y, field.magnitude_image, field.gradient_y);
     
     /*
      * Gradients filtering
      */
 
-    gradient_thresh(magnitude_image, gradient_x, gradient_y);
+    gradient_thresh(field.magnitude_image, field.gradient_x, field.gradient_y);
+  }
+
+  // Function to vote for the mass center of a single hypothesis
+  cv::Point2f radial_symmetry_voting(const GradientField& field, const int& radius, const int& edges_number, const VoteAccumulation accumulation) {
+
+    const SymmetryHypothesis hypothesis = { edges_number, radius };
+    std::vector< cv::Point2f > centers;
+    radial_symmetry_voting(field, std::vector< SymmetryHypothesis >(1, hypothesis), centers, accumulation);
+    return centers[0];
+  }
+
+  // Function to vote for the mass centers of several hypotheses in a single sweep over the edge pixels
+  void radial_symmetry_voting(const GradientField& field, const std::vector< SymmetryHypothesis >& hypotheses, std::vector< cv::Point2f >& centers, const VoteAccumulation accumulation) {
+
+    EdgeList edges;
+    compact_edges(field.magnitude_image, field.gradient_x, field.gradient_y, edges);
+    const int n_edges = static_cast<int> (edges.x.size());
 
     /*
-     * Orientation computation
+     * Orientation computation, on the edge pixels only -- the directions of the vote lines do not depend on the
+     * number of edges and are shared
      */
 
-    cv::Mat gradient_vp_x, gradient_vp_y, gradient_bar_x, gradient_bar_y;
-    orientations_from_gradient(gradient_x, gradient_y, edges_number, gradient_vp_x, gradient_vp_y, gradient_bar_x, gradient_bar_y);
-    
-    float radius_float = (float) radius;
-    return mass_center_by_voting(magnitude_image, gradient_x, gradient_y, gradient_bar_x, gradient_bar_y, gradient_vp_x, gradient_vp_y, radius_float, edges_number);
+    const int n_hypotheses = static_cast<int> (hypotheses.size());
+    std::vector< std::vector< float > > vp_x(n_hypotheses), vp_y(n_hypotheses);
+    std::vector< float > bar_x(n_edges), bar_y(n_edges);
+    std::vector< HypothesisVotes > hypotheses_votes(n_hypotheses);
+    for (int h = 0; h < n_hypotheses; h++) {
+      vp_x[h].resize(n_edges);
+      vp_y[h].resize(n_edges);
+      orientations_row_simd(edges.gradient_x.data(), edges.gradient_y.data(), vp_x[h].data(), vp_y[h].data(), bar_x.data(), bar_y.data(),
+                            n_edges, hypotheses[h].edges_number);
+      const HypothesisVotes hypothesis_votes = { (float) hypotheses[h].radius, hypotheses[h].edges_number,
+                                                 vp_x[h].data(), vp_y[h].data(), bar_x.data(), bar_y.data() };
+      hypotheses_votes[h] = hypothesis_votes;
+    }
+
+    vote_hypotheses(edges, field.magnitude_image.rows, field.magnitude_image.cols, hypotheses_votes, accumulation, centers);
   }
-  
-  // Function to discover an approximation of the mass center for each contour using a voting method for a given contour
-  cv::Point2f mass_center_discovery(const cv::Mat& original_image, const cv::Mat& translation_matrix, const cv::Mat& rotation_matrix, const cv::Mat& scaling_matrix, const std::vector< cv::Point2f >& contour, const double& factor, const int& type_traffic_sign) {
 
-    // Compute the transformation necessary to warp the original image
-    cv::Mat transform_warping = translation_matrix.inv() * rotation_matrix * scaling_matrix * translation_matrix;
-    
-    // Warp the original image
-    cv::Mat warp_image;
-    cv::warpPerspective(original_image, warp_image, transform_warping, original_image.size(), cv::INTER_CUBIC, cv::BORDER_REPLICATE);
+  cv::Point2f radial_symmetry_detector(const cv::Mat& roi_image, const int& radius, const int& edges_number) {
 
-    // We need to denormalise the contour using the normalisation factor
-    std::vector< cv::Point2f > denormalised_contour;
-    denormalise_contour(contour, denormalised_contour, factor);
+    GradientField field;
+    gradient_field(roi_image, field);
+    return radial_symmetry_voting(field, radius, edges_number);
+  }
 
-    // Estimate the radius given a contour
-    int radius_contour = radius_estimation(denormalised_contour);
-    
-    // We need to inverse the translation
-    std::vector< cv::Point2f > denormalised_contour_no_translation;
-    imageprocessing::inverse_transformation_contour(denormalised_contour, denormalised_contour_no_translation, translation_matrix);
+  // Function to correct the distortion of the ROI around a contour only
+  namespace {
 
-    // Find the minimum coordinate around the supposed target
-    double min_y, min_x, max_y, max_x;
-    extract_min_max(denormalised_contour_no_translation, min_y, min_x, max_x, max_y);
+    // Radius of the contour and ROI around it in the corrected image
+    void contour_region_roi(const cv::Mat& translation_matrix, const std::vector< cv::Point2f >& contour, const double& factor, ContourRegion& region) {
+
+      // We need to denormalise the contour using the normalisation factor
+      std::vector< cv::Point2f > denormalised_contour;
+      denormalise_contour(contour, denormalised_contour, factor);
+
+      // Estimate the radius given a contour
+      region.radius = radius_estimation(denormalised_contour);
+
+      // We need to inverse the translation
+      std::vector< cv::Point2f > denormalised_contour_no_translation;
+      imageprocessing::inverse_transformation_contour(denormalised_contour, denormalised_contour_no_translation, translation_matrix);
+
+      // Find the minimum coordinate around the supposed target
+      double min_y, min_x, max_y, max_x;
+      extract_min_max(denormalised_contour_no_translation, min_y, min_x, max_x, max_y);
+
+      // Define a ROI around the supposed target
+      roi_dimension_definition(min_y, min_x, max_x, max_y, 1.5, region.roi);
+    }
+
+    // Affine transformation correcting the distortion, from the original to the corrected image
+    cv::Mat correction_transform(const cv::Mat& translation_matrix, const cv::Mat& rotation_matrix, const cv::Mat& scaling_matrix) {
+      cv::Mat transform;
+      cv::Mat(translation_matrix.inv() * rotation_matrix * scaling_matrix * translation_matrix).convertTo(transform, CV_64F);
+      return transform;
+    }
+
+  }
+
+  void warp_contour_region(const cv::Mat& original_image, const cv::Mat& translation_matrix, const cv::Mat& rotation_matrix, const cv::Mat& scaling_matrix, const std::vector< cv::Point2f >& contour, const double& factor, ContourRegion& region) {
+
+    contour_region_roi(translation_matrix, contour, factor, region);
+
+    // Only the part of the ROI inside the image is warped, the rest replicates its border as the warp of the
+    // whole image did -- keep at least the closest pixel of the image
+    const cv::Rect& roi = region.roi;
+    cv::Rect within_roi = roi & cv::Rect(0, 0, original_image.cols, original_image.rows);
+    if (within_roi.area() == 0) {
+      within_roi.x = std::min(std::max(roi.x, 0), original_image.cols - 1);
+      within_roi.y = std::min(std::max(roi.y, 0), original_image.rows - 1);
+      within_roi.width = 1;
+      within_roi.height = 1;
+    }
+
+    // Compute the transformation necessary to warp the original image, followed by the translation to the ROI
+    cv::Mat transform_warping = correction_transform(translation_matrix, rotation_matrix, scaling_matrix);
+    for (int col = 0; col < 3; col++) {
+      transform_warping.at<double>(0, col) -= within_roi.x * transform_warping.at<double>(2, col);
+      transform_warping.at<double>(1, col) -= within_roi.y * transform_warping.at<double>(2, col);
+    }
+
+    // Warp the ROI
+    cv::Mat within_image;
+    cv::warpPerspective(original_image, within_image, transform_warping, within_roi.size(), cv::INTER_CUBIC, cv::BORDER_REPLICATE);
+
+    const int top = within_roi.y - roi.y;
+    const int left = within_roi.x - roi.x;
+    const int bottom = (roi.y + roi.height) - (within_roi.y + within_roi.height);
+    const int right = (roi.x + roi.width) - (within_roi.x + within_roi.width);
+    if (top == 0 && left == 0 && bottom == 0 && right == 0)
+      region.roi_image = within_image;
+    else
+      cv::copyMakeBorder(within_image, region.roi_image, std::max(top, 0), std::max(bottom, 0), std::max(left, 0), std::max(right, 0), cv::BORDER_REPLICATE);
+  }
+
+  // Function to warp the region of a contour and to compute its gradient field
+  void prepare_contour_region(const cv::Mat& original_image, const cv::Mat& translation_matrix, const cv::Mat& rotation_matrix, const cv::Mat& scaling_matrix, const std::vector< cv::Point2f >& contour, const double& factor, ContourRegion& region) {
 
-    // Define a ROI around the supposed target
-    cv::Rect roi_dimension;
-    roi_dimension_definition(min_y, min_x, max_x, max_y, 1.5, roi_dimension);
+    warp_contour_region(original_image, translation_matrix, rotation_matrix, scaling_matrix, contour, factor, region);
+    gradient_field(region.roi_image, region.gradients);
+    region.voted_sign_types.clear();
+    region.voted_centers.clear();
+  }
+
+  // Function to prepare the region of a contour without resampling the image
+  void prepare_contour_region_warp_free(const cv::Mat& original_image, const cv::Mat& translation_matrix, const cv::Mat& rotation_matrix, const cv::Mat& scaling_matrix, const std::vector< cv::Point2f >& contour, const double& factor, ContourRegion& region) {
+
+    contour_region_roi(translation_matrix, contour, factor, region);
+    const cv::Rect& roi = region.roi;
+
+    // Affine transformation from the original to the corrected image, and its inverse
+    const cv::Mat transform = correction_transform(translation_matrix, rotation_matrix, scaling_matrix);
+    cv::Mat inverse_transform;
+    cv::invertAffineTransform(transform(cv::Rect(0, 0, 3, 2)), inverse_transform);
+
+    // Pixels of the original image covering the ROI, with a pixel of margin for the rounding to the nearest one of the ROI
+    std::vector< cv::Point2f > roi_corners(4), source_corners;
+    roi_corners[0] = cv::Point2f(roi.x, roi.y);
+    roi_corners[1] = cv::Point2f(roi.x + roi.width - 1, roi.y);
+    roi_corners[2] = cv::Point2f(roi.x, roi.y + roi.height - 1);
+    roi_corners[3] = cv::Point2f(roi.x + roi.width - 1, roi.y + roi.height - 1);
+    cv::transform(roi_corners, source_corners, inverse_transform);
+    const cv::Rect corners_box = cv::boundingRect(source_corners);
+    const cv::Rect source_roi(corners_box.x - 1, corners_box.y - 1, corners_box.width + 2, corners_box.height + 2);
+
+    // Gradient field of the original pixels, the part of the ROI out of the image replicating its border
+    cv::Mat source_image;
+    roi_extraction(original_image, source_roi, source_image);
+    GradientField source_field;
+    gradient_field(source_image, source_field);
+
+    // The gradient of the corrected image at A p is L^-T times the gradient of the original image at p, L being the
+    // linear part of the correction A. The directions are normalised again, the magnitudes scaled by the same
+    // factor -- the edge pixels stay the ones of the original image.
+    cv::Mat gradient_transform;
+    cv::Mat(transform(cv::Rect(0, 0, 2, 2)).inv().t()).convertTo(gradient_transform, CV_32F);
+    const float g_00 = gradient_transform.at<float>(0, 0), g_01 = gradient_transform.at<float>(0, 1);
+    const float g_10 = gradient_transform.at<float>(1, 0), g_11 = gradient_transform.at<float>(1, 1);
+
+    // Each edge pixel of the original image is mapped forward through the correction to the nearest pixel of the
+    // ROI, so that none is duplicated or skipped by the sampling of the ROI. The edge pixels landing on the same
+    // pixel are merged: the magnitudes add up and the directions are averaged, weighted by the magnitudes. The
+    // sweep is serial for the merge to be deterministic -- only the edge pixels are mapped.
+    cv::Mat map_transform;
+    transform(cv::Rect(0, 0, 3, 2)).convertTo(map_transform, CV_32F);
+    const float a_00 = map_transform.at<float>(0, 0), a_01 = map_transform.at<float>(0, 1), a_02 = map_transform.at<float>(0, 2);
+    const float a_10 = map_transform.at<float>(1, 0), a_11 = map_transform.at<float>(1, 1), a_12 = map_transform.at<float>(1, 2);
+
+    GradientField& field = region.gradients;
+    field.magnitude_image = cv::Mat::zeros(roi.size(), CV_32F);
+    field.gradient_x = cv::Mat::zeros(roi.size(), CV_32F);
+    field.gradient_y = cv::Mat::zeros(roi.size(), CV_32F);
+    for (int i = 0; i < source_roi.height; i++) {
+      const float* ptr_source_magnitude = source_field.magnitude_image.ptr<float>(i);
+      const float* ptr_source_gradient_x = source_field.gradient_x.ptr<float>(i);
+      const float* ptr_source_gradient_y = source_field.gradient_y.ptr<float>(i);
+      const float y = (float) (source_roi.y + i);
+      for (int j = 0; j < source_roi.width; j++) {
+        if (ptr_source_magnitude[j] == 0.0f)
+          continue;
+        const float x = (float) (source_roi.x + j);
+        const int roi_x = cvRound(a_00 * x + a_01 * y + a_02) - roi.x;
+        const int roi_y = cvRound(a_10 * x + a_11 * y + a_12) - roi.y;
+        if ((roi_x < 0) || (roi_x >= roi.width) || (roi_y < 0) || (roi_y >= roi.height))
+          continue;
+        const float gx = ptr_source_gradient_x[j];
+        const float gy = ptr_source_gradient_y[j];
+        const float mapped_x = g_00 * gx + g_01 * gy;
+        const float mapped_y = g_10 * gx + g_11 * gy;
+        const float norm = std::sqrt(mapped_x * mapped_x + mapped_y * mapped_y);
+        const float magnitude = ptr_source_magnitude[j] * norm;
+        field.magnitude_image.at<float>(roi_y, roi_x) += magnitude;
+        field.gradient_x.at<float>(roi_y, roi_x) += magnitude * mapped_x / norm;
+        field.gradient_y.at<float>(roi_y, roi_x) += magnitude * mapped_y / norm;
+      }
+    }
+
+    // Directions of the merged edge pixels normalised again -- opposite directions cancelling out leave no edge
+    parallel::parallel_for_rows(roi.height, [&](const int row_begin, const int row_end) {
+        for (int i = row_begin; i < row_end; i++) {
+          float* ptr_magnitude = field.magnitude_image.ptr<float>(i);
+          float* ptr_gradient_x = field.gradient_x.ptr<float>(i);
+          float* ptr_gradient_y = field.gradient_y.ptr<float>(i);
+          for (int j = 0; j < roi.width; j++) {
+            if (ptr_magnitude[j] == 0.0f)
+              continue;
+            const float norm = std::sqrt(ptr_gradient_x[j] * ptr_gradient_x[j] + ptr_gradient_y[j] * ptr_gradient_y[j]);
+            if (norm <= ptr_magnitude[j] * 1e-6f) {
+              ptr_magnitude[j] = 0.0f;
+              ptr_gradient_x[j] = 0.0f;
+              ptr_gradient_y[j] = 0.0f;
+              continue;
+            }
+            ptr_gradient_x[j] /= norm;
+            ptr_gradient_y[j] /= norm;
+          }
+        }
+      });
+
+    // The corrected image itself is never computed
+    region.roi_image.release();
+    region.voted_sign_types.clear();
+    region.voted_centers.clear();
+  }
 
-    // ROI extraction
-    cv::Mat roi_image;
-    roi_extraction(warp_image, roi_dimension, roi_image);
+  // Function to vote in a single sweep for the mass centers of some sign types of a contour
+  void vote_mass_centers(ContourRegion& region, const std::vector< int >& sign_types, const VoteAccumulation accumulation) {
+
+    std::vector< SymmetryHypothesis > hypotheses(sign_types.size());
+    for (size_t k = 0; k < sign_types.size(); k++)
+      hypotheses[k] = sign_type_hypothesis(region.radius, sign_types[k]);
+
+    region.voted_sign_types = sign_types;
+    radial_symmetry_voting(region.gradients, hypotheses, region.voted_centers, accumulation);
+  }
+
+  // Function to give the hypothesis of the radial symmetry detector of a sign type
+  SymmetryHypothesis sign_type_hypothesis(const int radius, const int type_traffic_sign) {
 
     // The main function need to know how many edges each traffic sign as
-    int edges_number = 0;
+    SymmetryHypothesis hypothesis = { 0, radius };
     switch (type_traffic_sign) {
     case 0:
-      edges_number = 3;
+      hypothesis.edges_number = 3;
       break;
     case 1:
-      edges_number = 4;
+      hypothesis.edges_number = 4;
       break;
     case 2:
-      edges_number = 12;
+      hypothesis.edges_number = 12;
       break;
     case 3:
-      edges_number = 8;
+      hypothesis.edges_number = 8;
       break;
     case 4:
-      edges_number = 3;
-      radius_contour = (int) ceil((float) radius_contour / 2.00);
+      hypothesis.edges_number = 3;
+      hypothesis.radius = (int) ceil((float) radius / 2.00);
       break;
     }
 
-    cv::Point2f mass_center = radial_symmetry_detector(roi_image, radius_contour, edges_number);
-    cv::Point2f roi_offset(roi_dimension.x, roi_dimension.y);
+    return hypothesis;
+  }
+
+  // Function to discover an approximation of the mass center for each contour using a voting method for a given contour
+  cv::Point2f mass_center_discovery(const cv::Mat& original_image, const cv::Mat& translation_matrix, const cv::Mat& rotation_matrix, const cv::Mat& scaling_matrix, const std::vector< cv::Point2f >& contour, const double& factor, const int& type_traffic_sign) {
+
+    ContourRegion region;
+    prepare_contour_region(original_image, translation_matrix, rotation_matrix, scaling_matrix, contour, factor, region);
+    return mass_center_discovery(region, translation_matrix, factor, type_traffic_sign);
+  }
+
+  cv::Point2f mass_center_discovery(const ContourRegion& region, const cv::Mat& translation_matrix, const double& factor, const int& type_traffic_sign) {
+
+    // Center voted with the other sign types of the contour, if any
+    const std::vector< int >::const_iterator voted = std::find(region.voted_sign_types.begin(), region.voted_sign_types.end(), type_traffic_sign);
+    cv::Point2f mass_center;
+    if (voted != region.voted_sign_types.end())
+      mass_center = region.voted_centers[voted - region.voted_sign_types.begin()];
+    else {
+      const SymmetryHypothesis hypothesis = sign_type_hypothesis(region.radius, type_traffic_sign);
+      mass_center = radial_symmetry_voting(region.gradients, hypothesis.radius, hypothesis.edges_number);
+    }
+    cv::Point2f roi_offset(region.roi.x, region.roi.y);
     mass_center += roi_offset;
 
     // We have to translate back and normalise this coordinates
@@ -756,6 +1507,74 @@ namespace initopt {
 
     return 0.0;
   }
+
+  // Function to compute the Fourier descriptors of a closed contour at the first harmonic of some polygons
+  cv::Vec3d polygon_descriptors(const std::vector< cv::Point2f >& contour) {
+
+    // The boundary of a regular n-gon running counterclockwise only has the harmonics 1 + m * n, of magnitude
+    // 1 / (1 + m * n)^2 relatively to the fundamental. The descriptor of the n-gon is the harmonic 1 - n, and
+    // n - 1 for a contour running clockwise.
+    static const int n_edges[3] = { 3, 4, 8 };
+    const size_t n_points = contour.size();
+    if (n_points < 3)
+      return cv::Vec3d(0.0, 0.0, 0.0);
+
+    double perimeter = 0.0;
+    for (size_t i = 0; i < n_points; i++)
+      perimeter += cv::norm(contour[(i + 1) % n_points] - contour[i]);
+    if (perimeter <= 0.0)
+      return cv::Vec3d(0.0, 0.0, 0.0);
+
+    // Integrate z(s) exp(-2 i pi k s / L) by segments, for k = 1, -1, 1 - n, n - 1
+    std::complex< double > fundamental[2], harmonics[3][2];
+    double arc_length = 0.0;
+    for (size_t i = 0; i < n_points; i++) {
+      const cv::Point2f& next = contour[(i + 1) % n_points];
+      const double length = cv::norm(next - contour[i]);
+      const std::complex< double > z(0.5 * (contour[i].x + next.x), 0.5 * (contour[i].y + next.y));
+      const std::complex< double > rotation = std::polar(1.0, -2.0 * M_PI * (arc_length + 0.5 * length) / perimeter);
+      fundamental[0] += length * z * rotation;
+      fundamental[1] += length * z * std::conj(rotation);
+      for (int n = 0; n < 3; n++) {
+        const std::complex< double > harmonic_rotation = std::pow(rotation, n_edges[n] - 1);
+        harmonics[n][0] += length * z * std::conj(harmonic_rotation);
+        harmonics[n][1] += length * z * harmonic_rotation;
+      }
+      arc_length += length;
+    }
+
+    const int direction = std::abs(fundamental[1]) > std::abs(fundamental[0]) ? 1 : 0;
+    const double magnitude = std::abs(fundamental[direction]);
+    if (magnitude <= 0.0)
+      return cv::Vec3d(0.0, 0.0, 0.0);
+
+    cv::Vec3d descriptors;
+    for (int n = 0; n < 3; n++)
+      descriptors[n] = std::abs(harmonics[n][direction]) / magnitude * (n_edges[n] - 1) * (n_edges[n] - 1);
+    return descriptors;
+  }
+
+  // Function to rank the traffic sign types for a contour
+  void rank_sign_types(const std::vector< cv::Point2f >& contour, std::vector< int >& ranking) {
+
+    // Descriptors of the ideal shape of each sign type -- the square also has the harmonic of the octagon
+    static const cv::Vec3d ideal_descriptors[5] = {
+      cv::Vec3d(1.0, 0.0, 0.0),   // triangle
+      cv::Vec3d(0.0, 1.0, 1.0),   // square
+      cv::Vec3d(0.0, 0.0, 0.0),   // circle
+      cv::Vec3d(0.0, 0.0, 1.0),   // octagon
+      cv::Vec3d(1.0, 0.0, 0.0) }; // triangle, half radius
+
+    const cv::Vec3d descriptors = polygon_descriptors(contour);
+    double distances[5];
+    for (int sign_type = 0; sign_type < 5; sign_type++)
+      distances[sign_type] = cv::norm(descriptors - ideal_descriptors[sign_type]);
+
+    ranking.resize(5);
+    for (int sign_type = 0; sign_type < 5; sign_type++)
+      ranking[sign_type] = sign_type;
+    std::stable_sort(ranking.begin(), ranking.end(), [&](const int lhs, const int rhs) { return distances[lhs] < distances[rhs]; });
+  }
 }
 
 namespace optimisation {
@@ -763,6 +1582,13 @@ namespace optimisation {
  
   // Function to make the optimisation
   void gielis_optimisation(const std::vector< cv::Point2f >& contour, ConfigStruct2d& config_shape, Eigen::Vector4d& mean_err, Eigen::Vector4d& std_err) {
+
+    FitStatistics statistics;
+    gielis_optimisation(contour, config_shape, std::numeric_limits<double>::infinity(), mean_err, std_err, statistics);
+  }
+
+  bool gielis_optimisation(const std::vector< cv::Point2f >& contour, ConfigStruct2d& config_shape, const double upper_bound,
+                           Eigen::Vector4d& mean_err, Eigen::Vector4d& std_err, FitStatistics& statistics) {
    
     // Convert the data into Eigen type for further optimisation
     std::vector < Eigen::Vector2d, Eigen::aligned_allocator< Eigen::Vector2d> > Data;
@@ -778,20 +1604,43 @@ namespace optimisation {
     RS.Init(config_shape.a, config_shape.b, config_shape.n1, config_shape.n2, config_shape.n3, config_shape.p, config_shape.q,
             config_shape.theta_offset, config_shape.phi_offset, config_shape.x_offset, config_shape.y_offset, config_shape.z_offset);
 
+    // The mean error of the first implicit function is the chi-square divided by the number of points
+    const double chi_square_bound = upper_bound * static_cast<double> (Data.size());
+
     Timer tmrRun("\tRS run");
     // Run the optimisation
     double ErrorOfFit;
-    RS.Optimize8D(Data, ErrorOfFit, 1);
+    supershape::BoundFitObserver observer(chi_square_bound, BOUND_MARGIN, BOUND_MIN_ITERATIONS);
+    {
+      Timer tmr("\tOptimize8D");
+      supershape::levenberg_marquardt<8>(RS, Data, ErrorOfFit, 1, observer);
+    }
+    statistics.iterations = observer.iterations();
+    statistics.abandoned = observer.abandoned();
+
+    // The chi-square of the final curve is a lower bound of the error of the fit
+    if (!statistics.abandoned && std::isfinite(chi_square_bound)) {
+      Eigen::Matrix< double, 5, 5 > alpha;
+      Eigen::Matrix< double, 5, 1 > beta;
+      statistics.abandoned = RS.XiSquare<5>(Data, alpha, beta, 1, false) >= chi_square_bound;
+    }
+
+    // Recover the different parameters
+    config_shape = ConfigStruct2d(RS.Get_a(), RS.Get_b(), RS.Get_n1(), RS.Get_n2(), RS.Get_n3(), RS.Get_p(), RS.Get_q(), RS.Get_thtoffset(),
+                                  RS.Get_phioffset(), RS.Get_xoffset(), RS.Get_yoffset(), RS.Get_zoffset());
+
+    if (statistics.abandoned) {
+      mean_err.setConstant(std::numeric_limits<double>::infinity());
+      std_err.setConstant(std::numeric_limits<double>::infinity());
+      return false;
+    }
 
     Timer tmrAftRun("\tRS Afterrun");
 
     // test the Error Metric function
     RS.ErrorMetric (Data, mean_err, std_err);
 
-    // Recover the different parameters
-    config_shape = ConfigStruct2d(RS.Get_a(), RS.Get_b(), RS.Get_n1(), RS.Get_n2(), RS.Get_n3(), RS.Get_p(), RS.Get_q(), RS.Get_thtoffset(),
-                                  RS.Get_phioffset(), RS.Get_xoffset(), RS.Get_yoffset(), RS.Get_zoffset());
-
+    return true;
   }
 
   // Reconstruction using the Gielis formula
@@ -46,6 +46,7 @@ the use of this software, even if advised of the possibility of such damage.
 // own library
 #include "math_utils.h"
 #include "SuperFormula.h"
+#include "simd.h"
 
 // OpenCV library
 #include <opencv2/opencv.hpp>
@@ -56,6 +57,19 @@ the use of this software, even if advised of the possibility of such damage.
 #define THRESH_GRAD_RAD_DET 0.10
 #define THRESH_BINARY 0.80
 
+// A bounded gielis optimisation is abandoned after BOUND_MIN_ITERATIONS iterations if its chi-square is still
+// above BOUND_MARGIN times the chi-square matching the upper bound
+#define BOUND_MIN_ITERATIONS 10
+#define BOUND_MARGIN 2.0
+
+// Half width and number of taps of the separable gradient kernels, the 3x3 pre-blur folded in
+#define GRADIENT_HALF_WIDTH 3
+#define GRADIENT_TAPS (2 * GRADIENT_HALF_WIDTH + 1)
+
+// Scale of the vote directions in the integer accumulators of the voting -- 16 fractional bits, a pixel can take
+// 32767 votes of the same sign before its accumulators overflow
+#define VOTE_FIXED_POINT_SCALE 65536.0f
+
 namespace initopt {
 
   // Function to find normalisation factor
@@ -97,23 +111,140 @@ namespace initopt {
   // Function which threshold the gradient image based on the magnitude image
   void gradient_thresh(cv::Mat &magnitude_image, cv::Mat &gradient_x, cv::Mat& gradient_y);
 
-  // Function to determine the angles from the gradient images
-  void orientations_from_gradient(const cv::Mat& gradient_x, const cv::Mat& gradient_y, const int& edges_number, cv::Mat &gradient_vp_x, cv::Mat &gradient_vp_y, cv::Mat &gradient_bar_x, cv::Mat &gradient_bar_y);
+  // Function to determine the angles from the gradient images. The vote direction of a unit gradient z is z^edges_number
+  // as a complex number, computed by repeated multiplications in one vectorized pass -- kernels are specialised for
+  // 3, 4, 8 and 12 edges.
+  void orientations_from_gradient(const cv::Mat& gradient_x, const cv::Mat& gradient_y, const int& edges_number, cv::Mat &gradient_vp_x, cv::Mat &gradient_vp_y, cv::Mat &gradient_bar_x, cv::Mat &gradient_bar_y, const simd::Level level = simd::LEVEL_AUTO);
+
+  // Reference orientations through the angles of the gradients, with atan2, cos and sin per pixel
+  void orientations_from_gradient_trig(const cv::Mat& gradient_x, const cv::Mat& gradient_y, const int& edges_number, cv::Mat &gradient_vp_x, cv::Mat &gradient_vp_y, cv::Mat &gradient_bar_x, cv::Mat &gradient_bar_y);
+
+  // Vote direction and direction of the vote lines of n pixels of unit gradients
+  void orientations_row_simd(const float* gradient_x, const float* gradient_y, float* vp_x, float* vp_y, float* bar_x, float* bar_y, const int n, const int edges_number, const simd::Level level = simd::LEVEL_AUTO);
 
   // Function to round a matrix
   cv::Mat round_matrix(const cv::Mat& original_matrix);
 
-  // Function to determin mass center by voting
-  cv::Point2f mass_center_by_voting(const cv::Mat& magnitude_image, const cv::Mat& gradient_x, const cv::Mat& gradient_y, const cv::Mat& gradient_bar_x, const cv::Mat& gradient_bar_y, const cv::Mat& gradient_vp_x, const cv::Mat& gradient_vp_y, const float& radius, const int& edges_number);
+  // Accumulation of the votes of the radial symmetry detector
+  enum VoteAccumulation {
+    // Votes applied by bands of voted rows in the order of the edge pixels -- same center as the dense voting,
+    // whatever the number of threads
+    VOTES_ORDERED,
+    // Edge pixels partitioned across the threads, each voting into private float accumulators merged by a
+    // vectorized reduction -- the sums depend on the number of threads in the last bits
+    VOTES_PRIVATE_FLOAT,
+    // Same with private integer accumulators, the vote directions in fixed point of VOTE_FIXED_POINT_SCALE --
+    // the same center whatever the number of threads, within the fixed point precision of the dense voting
+    VOTES_PRIVATE_INTEGER
+  };
+
+  // Function to determin mass center by voting. The edge pixels, i.e. the non-null magnitudes, are first compacted
+  // into a list and their vote lines are cast into accumulators covering only the bounding box of the votes, so the
+  // voting time scales with the number of edge pixels rather than with the area of the image. The votes are summed
+  // as given by accumulation.
+  cv::Point2f mass_center_by_voting(const cv::Mat& magnitude_image, const cv::Mat& gradient_x, const cv::Mat& gradient_y, const cv::Mat& gradient_bar_x, const cv::Mat& gradient_bar_y, const cv::Mat& gradient_vp_x, const cv::Mat& gradient_vp_y, const float& radius, const int& edges_number, const VoteAccumulation accumulation = VOTES_ORDERED);
+
+  // Reference voting over full size images -- same center as mass_center_by_voting
+  cv::Point2f mass_center_by_voting_dense(const cv::Mat& magnitude_image, const cv::Mat& gradient_x, const cv::Mat& gradient_y, const cv::Mat& gradient_bar_x, const cv::Mat& gradient_bar_y, const cv::Mat& gradient_vp_x, const cv::Mat& gradient_vp_y, const float& radius, const int& edges_number);
+
+  // Columns of the edge pixels, i.e. of the non-null magnitudes, among n pixels -- edges must hold n entries
+  int edge_pixels_row_simd(const float* magnitude, const int n, int* edges, const simd::Level level = simd::LEVEL_AUTO);
+
+  // Offsets ceil(m * bar) of a vote line for m in [- half_length, half_length] -- dx and dy hold 2 * half_length + 1 entries
+  void line_offsets_simd(const float bar_x, const float bar_y, const int half_length, int* dx, int* dy, const simd::Level level = simd::LEVEL_AUTO);
+
+  // Sum of n accumulators over n_parts private copies, in the order of the copies -- the integer ones are converted
+  // to float and multiplied by scale
+  void merge_votes_row_simd(const float* const* parts, const int n_parts, float* merged, const int n, const simd::Level level = simd::LEVEL_AUTO);
+  void merge_votes_row_simd(const int* const* parts, const int n_parts, const float scale, float* merged, const int n, const simd::Level level = simd::LEVEL_AUTO);
+
+  // Gradient field voted on by the radial symmetry detector -- gradients normalised by the magnitude, the weak
+  // gradients being zeroed. It does not depend on the number of edges or on the radius of the searched shape.
+  struct GradientField {
+    cv::Mat magnitude_image;
+    cv::Mat gradient_x;
+    cv::Mat gradient_y;
+  };
+
+  // Function to compute the gradient field of an image for the radial symmetry detector. The 3x3 Gaussian pre-blur
+  // and the 5x5 derivative kernels are applied as separable 7-tap kernels in a single vectorized pass by bands of
+  // rows. Away from the 3 pixels of border it matches gradient_field_dense to the precision of the kernel table.
+  void gradient_field(const cv::Mat& roi_image, GradientField& field, const simd::Level level = simd::LEVEL_AUTO);
+
+  // Reference gradient field -- Gaussian pre-blur then two dense 5x5 filters
+  void gradient_field_dense(const cv::Mat& roi_image, GradientField& field);
+
+  // Horizontal smoothing and derivative of n pixels with the separable gradient kernels -- src holds the n pixels
+  // with GRADIENT_HALF_WIDTH pixels of border on each side
+  void gradient_h_row_simd(const float* src, float* smoothed, float* derived, const int n, const simd::Level level = simd::LEVEL_AUTO);
+
+  // Vertical pass of the separable gradient kernels over the GRADIENT_TAPS rows centred on an output row of n pixels,
+  // then magnitude and gradients normalised by the magnitude
+  void gradient_v_row_simd(const float* const* smoothed, const float* const* derived, float* gradient_x, float* gradient_y, float* magnitude, const int n, const simd::Level level = simd::LEVEL_AUTO);
+
+  // Function to vote for the mass center of a shape of edges_number edges and of given radius on a gradient field
+  cv::Point2f radial_symmetry_voting(const GradientField& field, const int& radius, const int& edges_number, const VoteAccumulation accumulation = VOTES_ORDERED);
+
+  // Hypothesis of the radial symmetry detector -- shape of edges_number edges and of given radius
+  struct SymmetryHypothesis {
+    int edges_number;
+    int radius;
+  };
+
+  // Function to vote for the mass centers of several hypotheses on a gradient field in a single sweep over its edge
+  // pixels, each hypothesis voting in its own accumulators. The center of each hypothesis is the one given by
+  // radial_symmetry_voting for it alone.
+  void radial_symmetry_voting(const GradientField& field, const std::vector< SymmetryHypothesis >& hypotheses, std::vector< cv::Point2f >& centers, const VoteAccumulation accumulation = VOTES_ORDERED);
 
   // Function to discover the mass center using the radial symmetry detector
   // RELATED PAPER - Fast shape-based road sign detection for a driver assistance system - xLoy et al.
   cv::Point2f radial_symmetry_detector(const cv::Mat& roi_image, const int& radius, const int& edges_number);
+
   
+  // Region around a contour in the image corrected for the distortion -- shared by the sign types of the contour
+  struct ContourRegion {
+    // ROI of 1.5 times the bounding box of the contour, in the corrected image
+    cv::Rect roi;
+    // Corrected image of the ROI, the pixels out of the image replicating its border -- empty for a region
+    // prepared without warp
+    cv::Mat roi_image;
+    // Radius of the contour, in pixels
+    int radius;
+    // Gradient field of the ROI image
+    GradientField gradients;
+    // Mass centers voted in the ROI for some sign types by vote_mass_centers
+    std::vector< int > voted_sign_types;
+    std::vector< cv::Point2f > voted_centers;
+  };
+
+  // Function to correct the distortion of the ROI around a contour only, instead of the whole image
+  // THE CONTOUR NEED TO BE THE NORMALIZED CONTOUR WHICH ARE CORRECTED FOR THE DISTORTION
+  void warp_contour_region(const cv::Mat& original_image, const cv::Mat& translation_matrix, const cv::Mat& rotation_matrix, const cv::Mat& scaling_matrix, const std::vector< cv::Point2f >& contour, const double& factor, ContourRegion& region);
+
+  // Function to warp the region of a contour and to compute its gradient field, i.e. all the mass center discovery
+  // which does not depend on the sign type
+  void prepare_contour_region(const cv::Mat& original_image, const cv::Mat& translation_matrix, const cv::Mat& rotation_matrix, const cv::Mat& scaling_matrix, const std::vector< cv::Point2f >& contour, const double& factor, ContourRegion& region);
+
+  // Same preparation without resampling the image -- the gradient field is computed on the original pixels around
+  // the contour, and each of their edge pixels is mapped forward through the correction to the nearest pixel of the
+  // ROI, its direction being mapped by the inverse transpose of the 2x2 linear part of the correction
+  void prepare_contour_region_warp_free(const cv::Mat& original_image, const cv::Mat& translation_matrix, const cv::Mat& rotation_matrix, const cv::Mat& scaling_matrix, const std::vector< cv::Point2f >& contour, const double& factor, ContourRegion& region);
+
+  // Function to vote in a single sweep over the gradient field of a prepared region for the mass centers of some sign
+  // types of its contour
+  void vote_mass_centers(ContourRegion& region, const std::vector< int >& sign_types, const VoteAccumulation accumulation = VOTES_ORDERED);
+
+  // Function to give the hypothesis of the radial symmetry detector of a sign type for a contour of given radius
+  SymmetryHypothesis sign_type_hypothesis(const int radius, const int type_traffic_sign);
+
   // Function to discover an approximation of the mass center for each contour using a voting method for a given contour
   // THE CONTOUR NEED TO BE THE NORMALIZED CONTOUR WHICH ARE CORRECTED FOR THE DISTORTION
   cv::Point2f mass_center_discovery(const cv::Mat& original_image, const cv::Mat& translation_matrix, const cv::Mat& rotation_matrix, const cv::Mat& scaling_matrix, const std::vector< cv::Point2f >& contour, const double& factor, const int& type_traffic_sign);
 
+  // Same discovery on the region of the contour prepared once by prepare_contour_region -- uses the center voted by
+  // vote_mass_centers for the sign type if any, otherwise only votes
+  cv::Point2f mass_center_discovery(const ContourRegion& region, const cv::Mat& translation_matrix, const double& factor, const int& type_traffic_sign);
+
   // Function to convert a contour from euclidean to polar coordinates
   void contour_eucl_to_polar(const std::vector< cv::Point2f >& contour_eucl, std::vector< cv::PointPolar2f >& contour_polar);
 
@@ -123,6 +254,15 @@ namespace initopt {
   // Function to discover an approximation of the rotation offset
   double rotation_offset(const std::vector< cv::Point2f >& contour);
 
+  // Function to compute the Fourier descriptors of a closed contour, parametrised by its arc length, at the first
+  // harmonic of the triangle, the square and the octagon -- magnitudes relative to the fundamental and scaled such
+  // that the regular polygon gives 1. Invariant to the translation, rotation, scale and direction of the contour.
+  cv::Vec3d polygon_descriptors(const std::vector< cv::Point2f >& contour);
+
+  // Function to rank the traffic sign types from the most to the least plausible for a contour, by distance of its
+  // polygon descriptors to the ones of the ideal shapes -- ties are broken by increasing sign type
+  void rank_sign_types(const std::vector< cv::Point2f >& contour, std::vector< int >& ranking);
+
 }
 
 namespace optimisation {
@@ -136,6 +276,9 @@ namespace optimisation {
     // constructor with initialisation
     ConfigStruct_(const _Tp& _a, const _Tp& _b, const _Tp& _n1, const _Tp& _n2, const _Tp& _n3, const _Tp& _p, const _Tp& _q, const _Tp& _theta_offset, const _Tp& _phi_offset, const _Tp& _x_offset, const _Tp& _y_offset, const _Tp& _z_offset) { a = _a; b = _b; n1 = _n1; n2 = _n2; n3 = _n3; p = _p; q = _q; theta_offset = _theta_offset; phi_offset = _phi_offset; x_offset = _x_offset; y_offset = _y_offset; z_offset = _z_offset; }
 
+    // copy constructor
+    ConfigStruct_(const ConfigStruct_<_Tp>& cs) { *this = cs; }
+
     // Operator =
     ConfigStruct_<_Tp>& operator=(const ConfigStruct_<_Tp>& cs) { a = cs.a; b = cs.b; n1 = cs.n1; n2 = cs.n2; n3 = cs.n3; p = cs.p; q = cs.q; theta_offset = cs.theta_offset; phi_offset = cs.phi_offset; x_offset = cs.x_offset; y_offset = cs.y_offset; z_offset = cs.z_offset; return *this; }
 
@@ -177,9 +320,24 @@ namespace optimisation {
   typedef ConfigStruct_<float> ConfigStruct2f;
   typedef ConfigStruct_<double> ConfigStruct2d;
 
+  // Statistics of a gielis optimisation
+  struct FitStatistics {
+    // Levenberg-Marquardt iterations run
+    int iterations;
+    // The fit was stopped or rejected as it could not beat the upper bound
+    bool abandoned;
+  };
+
   // Function to make the optimisation
   void gielis_optimisation(const std::vector< cv::Point2f >& contour, ConfigStruct2d& config_shape, Eigen::Vector4d& mean_err, Eigen::Vector4d& std_err);
 
+  // Same optimisation for a fit competing with a fit of error upper_bound, i.e. sum of the absolute mean errors.
+  // The mean of the squared implicit function is a lower bound of that error: the fit is abandoned during the
+  // optimisation on the BOUND_MARGIN heuristic, and after it if it provably cannot go below upper_bound. An
+  // abandoned fit returns false with infinite errors, the errors of the others are computed as usual.
+  bool gielis_optimisation(const std::vector< cv::Point2f >& contour, ConfigStruct2d& config_shape, const double upper_bound,
+                           Eigen::Vector4d& mean_err, Eigen::Vector4d& std_err, FitStatistics& statistics);
+
   // Reconstruction using the Gielis formula
   void gielis_reconstruction(const ConfigStruct2d& config_shape, std::vector< cv::Point2f >& gielis_contour, const int number_points);
 }
@@ -0,0 +1,698 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+#include "smartOptimisation.h"
+
+// stl library
+#include <cmath>
+
+namespace initopt {
+
+  namespace {
+
+    // The 5x5 derivative kernels of the radial symmetry detector are, to the precision of their table, the outer
+    // product of a smoothing and of a derivative kernel. Both are convolved with the 3x3 Gaussian pre-blur
+    // [1 2 1] / 4, which gives 7-tap kernels. The smoothing one is symmetric and sums to 1, the derivative one
+    // is antisymmetric -- only the weights of the offsets 0 to 3, resp. 1 to 3, are stored.
+    const float SMOOTH_0 = 0.33785887f;
+    const float SMOOTH_1 = 0.24060545f;
+    const float SMOOTH_2 = 0.08107057f;
+    const float SMOOTH_3 = 0.00939455f;
+    const float DERIVE_1 = 0.16567570f;
+    const float DERIVE_2 = 0.12390541f;
+    const float DERIVE_3 = 0.02737838f;
+
+    // Horizontal smoothing and derivative of n pixels -- src holds the n pixels with 3 pixels of border on each side
+    typedef void (*gradient_h_row_kernel)(const float* src, float* smoothed, float* derived, const int n);
+
+    void gradient_h_row_scalar(const float* src, float* smoothed, float* derived, const int n) {
+      for (int j = 0; j < n; ++j) {
+        const float* p = src + j + GRADIENT_HALF_WIDTH;
+        smoothed[j] = SMOOTH_0 * p[0] + SMOOTH_1 * (p[-1] + p[1]) + SMOOTH_2 * (p[-2] + p[2]) + SMOOTH_3 * (p[-3] + p[3]);
+        derived[j] = DERIVE_1 * (p[1] - p[-1]) + DERIVE_2 * (p[2] - p[-2]) + DERIVE_3 * (p[3] - p[-3]);
+      }
+    }
+
+    // Vertical pass of n pixels from the 7 rows centred on the output row, then the magnitude and the direction
+    typedef void (*gradient_v_row_kernel)(const float* const* smoothed, const float* const* derived, float* gradient_x, float* gradient_y, float* magnitude, const int n);
+
+    void gradient_v_row_scalar(const float* const* smoothed, const float* const* derived, float* gradient_x, float* gradient_y, float* magnitude, const int n) {
+      for (int j = 0; j < n; ++j) {
+        const float gx = SMOOTH_0 * derived[3][j] + SMOOTH_1 * (derived[2][j] + derived[4][j]) +
+          SMOOTH_2 * (derived[1][j] + derived[5][j]) + SMOOTH_3 * (derived[0][j] + derived[6][j]);
+        const float gy = DERIVE_1 * (smoothed[4][j] - smoothed[2][j]) + DERIVE_2 * (smoothed[5][j] - smoothed[1][j]) +
+          DERIVE_3 * (smoothed[6][j] - smoothed[0][j]);
+        const float mag = std::sqrt(gx * gx + gy * gy);
+        magnitude[j] = mag;
+        gradient_x[j] = (mag > 0.0f) ? gx / mag : 0.0f;
+        gradient_y[j] = (mag > 0.0f) ? gy / mag : 0.0f;
+      }
+    }
+
+
+    // Columns of the edge pixels, i.e. of the non-null magnitudes, among n pixels
+    typedef int (*edge_pixels_row_kernel)(const float* magnitude, const int n, int* edges);
+
+    int edge_pixels_row_scalar(const float* magnitude, const int n, int* edges) {
+      int n_edges = 0;
+      for (int j = 0; j < n; ++j) {
+        // Branch free compaction -- the column is always written and kept only for an edge pixel
+        edges[n_edges] = j;
+        n_edges += (magnitude[j] != 0.0f);
+      }
+      return n_edges;
+    }
+
+    // Offsets ceil(m * bar) of a vote line for m in [- half_length, half_length]
+    typedef void (*line_offsets_kernel)(const float bar_x, const float bar_y, const int half_length, int* dx, int* dy);
+
+    void line_offsets_scalar(const float bar_x, const float bar_y, const int half_length, int* dx, int* dy) {
+      for (int m = - half_length; m <= half_length; ++m) {
+        dx[m + half_length] = static_cast<int> (std::ceil(static_cast<float> (m) * bar_x));
+        dy[m + half_length] = static_cast<int> (std::ceil(static_cast<float> (m) * bar_y));
+      }
+    }
+
+    // Sum of n accumulators over the private copies of the threads, in the order of the copies
+    typedef void (*merge_votes_row_kernel)(const float* const* parts, const int n_parts, float* merged, const int n);
+    typedef void (*merge_fixed_point_votes_row_kernel)(const int* const* parts, const int n_parts, const float scale, float* merged, const int n);
+
+    void merge_votes_row_scalar(const float* const* parts, const int n_parts, float* merged, const int n) {
+      for (int j = 0; j < n; ++j) {
+        float sum = parts[0][j];
+        for (int p = 1; p < n_parts; ++p)
+          sum += parts[p][j];
+        merged[j] = sum;
+      }
+    }
+
+    void merge_fixed_point_votes_row_scalar(const int* const* parts, const int n_parts, const float scale, float* merged, const int n) {
+      for (int j = 0; j < n; ++j) {
+        int sum = parts[0][j];
+        for (int p = 1; p < n_parts; ++p)
+          sum += parts[p][j];
+        merged[j] = static_cast<float> (sum) * scale;
+      }
+    }
+
+
+    // Vote direction of n pixels, i.e. the unit gradient z = gradient_x + i gradient_y raised to the power N
+    // as a complex number, and direction of the vote lines
+    typedef void (*orientations_row_kernel)(const float* gradient_x, const float* gradient_y, float* vp_x, float* vp_y, float* bar_x, float* bar_y, const int n);
+
+    // z^N by squaring -- the complex products are computed as (a c - b d) + i (a d + b c)
+    template<int N> inline void complex_power_scalar(const float x, const float y, float& px, float& py) {
+      float hx, hy;
+      complex_power_scalar<N / 2>(x, y, hx, hy);
+      px = hx * hx - hy * hy;
+      py = hx * hy + hy * hx;
+      if (N % 2) {
+        const float sx = px, sy = py;
+        px = sx * x - sy * y;
+        py = sx * y + sy * x;
+      }
+    }
+
+    template<> inline void complex_power_scalar<1>(const float x, const float y, float& px, float& py) {
+      px = x;
+      py = y;
+    }
+
+    template<int N> void orientations_row_scalar(const float* gradient_x, const float* gradient_y, float* vp_x, float* vp_y, float* bar_x, float* bar_y, const int n) {
+      for (int j = 0; j < n; ++j) {
+        complex_power_scalar<N>(gradient_x[j], gradient_y[j], vp_x[j], vp_y[j]);
+        bar_x[j] = gradient_y[j];
+        bar_y[j] = - gradient_x[j];
+      }
+    }
+
+#if SIMD_X86
+
+    // The vectorized kernels perform the operations of the scalar ones in the same order, without fused
+    // multiply-add, and give the same floats
+
+    SIMD_TARGET_SSE41 void gradient_h_row_sse41(const float* src, float* smoothed, float* derived, const int n) {
+      const __m128 s0 = _mm_set1_ps(SMOOTH_0), s1 = _mm_set1_ps(SMOOTH_1), s2 = _mm_set1_ps(SMOOTH_2), s3 = _mm_set1_ps(SMOOTH_3);
+      const __m128 d1 = _mm_set1_ps(DERIVE_1), d2 = _mm_set1_ps(DERIVE_2), d3 = _mm_set1_ps(DERIVE_3);
+
+      int j = 0;
+      for (; j + 4 <= n; j += 4) {
+        const float* p = src + j + GRADIENT_HALF_WIDTH;
+        const __m128 m3 = _mm_loadu_ps(p - 3), m2 = _mm_loadu_ps(p - 2), m1 = _mm_loadu_ps(p - 1);
+        const __m128 c = _mm_loadu_ps(p);
+        const __m128 p1 = _mm_loadu_ps(p + 1), p2 = _mm_loadu_ps(p + 2), p3 = _mm_loadu_ps(p + 3);
+        __m128 s = _mm_add_ps(_mm_mul_ps(s0, c), _mm_mul_ps(s1, _mm_add_ps(m1, p1)));
+        s = _mm_add_ps(s, _mm_mul_ps(s2, _mm_add_ps(m2, p2)));
+        s = _mm_add_ps(s, _mm_mul_ps(s3, _mm_add_ps(m3, p3)));
+        __m128 d = _mm_add_ps(_mm_mul_ps(d1, _mm_sub_ps(p1, m1)), _mm_mul_ps(d2, _mm_sub_ps(p2, m2)));
+        d = _mm_add_ps(d, _mm_mul_ps(d3, _mm_sub_ps(p3, m3)));
+        _mm_storeu_ps(smoothed + j, s);
+        _mm_storeu_ps(derived + j, d);
+      }
+
+      gradient_h_row_scalar(src + j, smoothed + j, derived + j, n - j);
+    }
+
+    SIMD_TARGET_SSE41 void gradient_v_row_sse41(const float* const* smoothed, const float* const* derived, float* gradient_x, float* gradient_y, float* magnitude, const int n) {
+      const __m128 s0 = _mm_set1_ps(SMOOTH_0), s1 = _mm_set1_ps(SMOOTH_1), s2 = _mm_set1_ps(SMOOTH_2), s3 = _mm_set1_ps(SMOOTH_3);
+      const __m128 d1 = _mm_set1_ps(DERIVE_1), d2 = _mm_set1_ps(DERIVE_2), d3 = _mm_set1_ps(DERIVE_3);
+      const __m128 zero = _mm_setzero_ps();
+
+      int j = 0;
+      for (; j + 4 <= n; j += 4) {
+        __m128 gx = _mm_add_ps(_mm_mul_ps(s0, _mm_loadu_ps(derived[3] + j)),
+                               _mm_mul_ps(s1, _mm_add_ps(_mm_loadu_ps(derived[2] + j), _mm_loadu_ps(derived[4] + j))));
+        gx = _mm_add_ps(gx, _mm_mul_ps(s2, _mm_add_ps(_mm_loadu_ps(derived[1] + j), _mm_loadu_ps(derived[5] + j))));
+        gx = _mm_add_ps(gx, _mm_mul_ps(s3, _mm_add_ps(_mm_loadu_ps(derived[0] + j), _mm_loadu_ps(derived[6] + j))));
+        __m128 gy = _mm_add_ps(_mm_mul_ps(d1, _mm_sub_ps(_mm_loadu_ps(smoothed[4] + j), _mm_loadu_ps(smoothed[2] + j))),
+                               _mm_mul_ps(d2, _mm_sub_ps(_mm_loadu_ps(smoothed[5] + j), _mm_loadu_ps(smoothed[1] + j))));
+        gy = _mm_add_ps(gy, _mm_mul_ps(d3, _mm_sub_ps(_mm_loadu_ps(smoothed[6] + j), _mm_loadu_ps(smoothed[0] + j))));
+
+        const __m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)));
+        // The lanes of null magnitude hold 0 / 0 and are cleared
+        const __m128 nonzero = _mm_cmpgt_ps(mag, zero);
+        _mm_storeu_ps(magnitude + j, mag);
+        _mm_storeu_ps(gradient_x + j, _mm_and_ps(nonzero, _mm_div_ps(gx, mag)));
+        _mm_storeu_ps(gradient_y + j, _mm_and_ps(nonzero, _mm_div_ps(gy, mag)));
+      }
+
+      const float* smoothed_tail[GRADIENT_TAPS];
+      const float* derived_tail[GRADIENT_TAPS];
+      for (int k = 0; k < GRADIENT_TAPS; ++k) {
+        smoothed_tail[k] = smoothed[k] + j;
+        derived_tail[k] = derived[k] + j;
+      }
+      gradient_v_row_scalar(smoothed_tail, derived_tail, gradient_x + j, gradient_y + j, magnitude + j, n - j);
+    }
+
+    SIMD_TARGET_AVX2 void gradient_h_row_avx2(const float* src, float* smoothed, float* derived, const int n) {
+      const __m256 s0 = _mm256_set1_ps(SMOOTH_0), s1 = _mm256_set1_ps(SMOOTH_1), s2 = _mm256_set1_ps(SMOOTH_2), s3 = _mm256_set1_ps(SMOOTH_3);
+      const __m256 d1 = _mm256_set1_ps(DERIVE_1), d2 = _mm256_set1_ps(DERIVE_2), d3 = _mm256_set1_ps(DERIVE_3);
+
+      int j = 0;
+      for (; j + 8 <= n; j += 8) {
+        const float* p = src + j + GRADIENT_HALF_WIDTH;
+        const __m256 m3 = _mm256_loadu_ps(p - 3), m2 = _mm256_loadu_ps(p - 2), m1 = _mm256_loadu_ps(p - 1);
+        const __m256 c = _mm256_loadu_ps(p);
+        const __m256 p1 = _mm256_loadu_ps(p + 1), p2 = _mm256_loadu_ps(p + 2), p3 = _mm256_loadu_ps(p + 3);
+        __m256 s = _mm256_add_ps(_mm256_mul_ps(s0, c), _mm256_mul_ps(s1, _mm256_add_ps(m1, p1)));
+        s = _mm256_add_ps(s, _mm256_mul_ps(s2, _mm256_add_ps(m2, p2)));
+        s = _mm256_add_ps(s, _mm256_mul_ps(s3, _mm256_add_ps(m3, p3)));
+        __m256 d = _mm256_add_ps(_mm256_mul_ps(d1, _mm256_sub_ps(p1, m1)), _mm256_mul_ps(d2, _mm256_sub_ps(p2, m2)));
+        d = _mm256_add_ps(d, _mm256_mul_ps(d3, _mm256_sub_ps(p3, m3)));
+        _mm256_storeu_ps(smoothed + j, s);
+        _mm256_storeu_ps(derived + j, d);
+      }
+
+      gradient_h_row_sse41(src + j, smoothed + j, derived + j, n - j);
+    }
+
+    SIMD_TARGET_AVX2 void gradient_v_row_avx2(const float* const* smoothed, const float* const* derived, float* gradient_x, float* gradient_y, float* magnitude, const int n) {
+      const __m256 s0 = _mm256_set1_ps(SMOOTH_0), s1 = _mm256_set1_ps(SMOOTH_1), s2 = _mm256_set1_ps(SMOOTH_2), s3 = _mm256_set1_ps(SMOOTH_3);
+      const __m256 d1 = _mm256_set1_ps(DERIVE_1), d2 = _mm256_set1_ps(DERIVE_2), d3 = _mm256_set1_ps(DERIVE_3);
+      const __m256 zero = _mm256_setzero_ps();
+
+      int j = 0;
+      for (; j + 8 <= n; j += 8) {
+        __m256 gx = _mm256_add_ps(_mm256_mul_ps(s0, _mm256_loadu_ps(derived[3] + j)),
+                                  _mm256_mul_ps(s1, _mm256_add_ps(_mm256_loadu_ps(derived[2] + j), _mm256_loadu_ps(derived[4] + j))));
+        gx = _mm256_add_ps(gx, _mm256_mul_ps(s2, _mm256_add_ps(_mm256_loadu_ps(derived[1] + j), _mm256_loadu_ps(derived[5] + j))));
+        gx = _mm256_add_ps(gx, _mm256_mul_ps(s3, _mm256_add_ps(_mm256_loadu_ps(derived[0] + j), _mm256_loadu_ps(derived[6] + j))));
+        __m256 gy = _mm256_add_ps(_mm256_mul_ps(d1, _mm256_sub_ps(_mm256_loadu_ps(smoothed[4] + j), _mm256_loadu_ps(smoothed[2] + j))),
+                                  _mm256_mul_ps(d2, _mm256_sub_ps(_mm256_loadu_ps(smoothed[5] + j), _mm256_loadu_ps(smoothed[1] + j))));
+        gy = _mm256_add_ps(gy, _mm256_mul_ps(d3, _mm256_sub_ps(_mm256_loadu_ps(smoothed[6] + j), _mm256_loadu_ps(smoothed[0] + j))));
+
+        const __m256 mag = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gy, gy)));
+        // The lanes of null magnitude hold 0 / 0 and are cleared
+        const __m256 nonzero = _mm256_cmp_ps(mag, zero, _CMP_GT_OQ);
+        _mm256_storeu_ps(magnitude + j, mag);
+        _mm256_storeu_ps(gradient_x + j, _mm256_and_ps(nonzero, _mm256_div_ps(gx, mag)));
+        _mm256_storeu_ps(gradient_y + j, _mm256_and_ps(nonzero, _mm256_div_ps(gy, mag)));
+      }
+
+      const float* smoothed_tail[GRADIENT_TAPS];
+      const float* derived_tail[GRADIENT_TAPS];
+      for (int k = 0; k < GRADIENT_TAPS; ++k) {
+        smoothed_tail[k] = smoothed[k] + j;
+        derived_tail[k] = derived[k] + j;
+      }
+      gradient_v_row_sse41(smoothed_tail, derived_tail, gradient_x + j, gradient_y + j, magnitude + j, n - j);
+    }
+
+
+    SIMD_TARGET_SSE41 int edge_pixels_row_sse41(const float* magnitude, const int n, int* edges) {
+      const __m128 zero = _mm_setzero_ps();
+
+      int n_edges = 0;
+      int j = 0;
+      for (; j + 4 <= n; j += 4) {
+        int mask = _mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(magnitude + j), zero));
+        while (mask) {
+          edges[n_edges++] = j + __builtin_ctz(mask);
+          mask &= mask - 1;
+        }
+      }
+
+      const int n_tail = edge_pixels_row_scalar(magnitude + j, n - j, edges + n_edges);
+      for (int k = 0; k < n_tail; ++k)
+        edges[n_edges + k] += j;
+      return n_edges + n_tail;
+    }
+
+    SIMD_TARGET_SSE41 void line_offsets_sse41(const float bar_x, const float bar_y, const int half_length, int* dx, int* dy) {
+      const __m128 bx = _mm_set1_ps(bar_x), by = _mm_set1_ps(bar_y);
+      const int length = 2 * half_length + 1;
+
+      int k = 0;
+      for (; k + 4 <= length; k += 4) {
+        const __m128 m = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(k - half_length), _mm_setr_epi32(0, 1, 2, 3)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*> (dx + k), _mm_cvttps_epi32(_mm_ceil_ps(_mm_mul_ps(m, bx))));
+        _mm_storeu_si128(reinterpret_cast<__m128i*> (dy + k), _mm_cvttps_epi32(_mm_ceil_ps(_mm_mul_ps(m, by))));
+      }
+
+      for (; k < length; ++k) {
+        const float m = static_cast<float> (k - half_length);
+        dx[k] = static_cast<int> (std::ceil(m * bar_x));
+        dy[k] = static_cast<int> (std::ceil(m * bar_y));
+      }
+    }
+
+    SIMD_TARGET_SSE41 void merge_votes_row_sse41(const float* const* parts, const int n_parts, float* merged, const int n) {
+      int j = 0;
+      for (; j + 4 <= n; j += 4) {
+        __m128 sum = _mm_loadu_ps(parts[0] + j);
+        for (int p = 1; p < n_parts; ++p)
+          sum = _mm_add_ps(sum, _mm_loadu_ps(parts[p] + j));
+        _mm_storeu_ps(merged + j, sum);
+      }
+
+      for (; j < n; ++j) {
+        float sum = parts[0][j];
+        for (int p = 1; p < n_parts; ++p)
+          sum += parts[p][j];
+        merged[j] = sum;
+      }
+    }
+
+    SIMD_TARGET_SSE41 void merge_fixed_point_votes_row_sse41(const int* const* parts, const int n_parts, const float scale, float* merged, const int n) {
+      const __m128 s = _mm_set1_ps(scale);
+
+      int j = 0;
+      for (; j + 4 <= n; j += 4) {
+        __m128i sum = _mm_loadu_si128(reinterpret_cast<const __m128i*> (parts[0] + j));
+        for (int p = 1; p < n_parts; ++p)
+          sum = _mm_add_epi32(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*> (parts[p] + j)));
+        _mm_storeu_ps(merged + j, _mm_mul_ps(_mm_cvtepi32_ps(sum), s));
+      }
+
+      for (; j < n; ++j) {
+        int sum = parts[0][j];
+        for (int p = 1; p < n_parts; ++p)
+          sum += parts[p][j];
+        merged[j] = static_cast<float> (sum) * scale;
+      }
+    }
+
+    SIMD_TARGET_AVX2 int edge_pixels_row_avx2(const float* magnitude, const int n, int* edges) {
+      const __m256 zero = _mm256_setzero_ps();
+
+      int n_edges = 0;
+      int j = 0;
+      for (; j + 8 <= n; j += 8) {
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(magnitude + j), zero, _CMP_NEQ_UQ));
+        while (mask) {
+          edges[n_edges++] = j + __builtin_ctz(mask);
+          mask &= mask - 1;
+        }
+      }
+
+      const int n_tail = edge_pixels_row_sse41(magnitude + j, n - j, edges + n_edges);
+      for (int k = 0; k < n_tail; ++k)
+        edges[n_edges + k] += j;
+      return n_edges + n_tail;
+    }
+
+    SIMD_TARGET_AVX2 void line_offsets_avx2(const float bar_x, const float bar_y, const int half_length, int* dx, int* dy) {
+      const __m256 bx = _mm256_set1_ps(bar_x), by = _mm256_set1_ps(bar_y);
+      const int length = 2 * half_length + 1;
+
+      int k = 0;
+      for (; k + 8 <= length; k += 8) {
+        const __m256 m = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(k - half_length), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*> (dx + k), _mm256_cvttps_epi32(_mm256_ceil_ps(_mm256_mul_ps(m, bx))));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*> (dy + k), _mm256_cvttps_epi32(_mm256_ceil_ps(_mm256_mul_ps(m, by))));
+      }
+
+      for (; k < length; ++k) {
+        const float m = static_cast<float> (k - half_length);
+        dx[k] = static_cast<int> (std::ceil(m * bar_x));
+        dy[k] = static_cast<int> (std::ceil(m * bar_y));
+      }
+    }
+
+    SIMD_TARGET_AVX2 void merge_votes_row_avx2(const float* const* parts, const int n_parts, float* merged, const int n) {
+      int j = 0;
+      for (; j + 8 <= n; j += 8) {
+        __m256 sum = _mm256_loadu_ps(parts[0] + j);
+        for (int p = 1; p < n_parts; ++p)
+          sum = _mm256_add_ps(sum, _mm256_loadu_ps(parts[p] + j));
+        _mm256_storeu_ps(merged + j, sum);
+      }
+
+      for (; j < n; ++j) {
+        float sum = parts[0][j];
+        for (int p = 1; p < n_parts; ++p)
+          sum += parts[p][j];
+        merged[j] = sum;
+      }
+    }
+
+    SIMD_TARGET_AVX2 void merge_fixed_point_votes_row_avx2(const int* const* parts, const int n_parts, const float scale, float* merged, const int n) {
+      const __m256 s = _mm256_set1_ps(scale);
+
+      int j = 0;
+      for (; j + 8 <= n; j += 8) {
+        __m256i sum = _mm256_loadu_si256(reinterpret_cast<const __m256i*> (parts[0] + j));
+        for (int p = 1; p < n_parts; ++p)
+          sum = _mm256_add_epi32(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*> (parts[p] + j)));
+        _mm256_storeu_ps(merged + j, _mm256_mul_ps(_mm256_cvtepi32_ps(sum), s));
+      }
+
+      for (; j < n; ++j) {
+        int sum = parts[0][j];
+        for (int p = 1; p < n_parts; ++p)
+          sum += parts[p][j];
+        merged[j] = static_cast<float> (sum) * scale;
+      }
+    }
+
+    template<int N> SIMD_TARGET_SSE41 inline void complex_power_sse41(const __m128 x, const __m128 y, __m128& px, __m128& py) {
+      __m128 hx, hy;
+      complex_power_sse41<N / 2>(x, y, hx, hy);
+      px = _mm_sub_ps(_mm_mul_ps(hx, hx), _mm_mul_ps(hy, hy));
+      py = _mm_add_ps(_mm_mul_ps(hx, hy), _mm_mul_ps(hy, hx));
+      if (N % 2) {
+        const __m128 sx = px, sy = py;
+        px = _mm_sub_ps(_mm_mul_ps(sx, x), _mm_mul_ps(sy, y));
+        py = _mm_add_ps(_mm_mul_ps(sx, y), _mm_mul_ps(sy, x));
+      }
+    }
+
+    template<> SIMD_TARGET_SSE41 inline void complex_power_sse41<1>(const __m128 x, const __m128 y, __m128& px, __m128& py) {
+      px = x;
+      py = y;
+    }
+
+    template<int N> SIMD_TARGET_SSE41 void orientations_row_sse41(const float* gradient_x, const float* gradient_y, float* vp_x, float* vp_y, float* bar_x, float* bar_y, const int n) {
+      const __m128 sign = _mm_set1_ps(-0.0f);
+
+      int j = 0;
+      for (; j + 4 <= n; j += 4) {
+        const __m128 x = _mm_loadu_ps(gradient_x + j);
+        const __m128 y = _mm_loadu_ps(gradient_y + j);
+        __m128 px, py;
+        complex_power_sse41<N>(x, y, px, py);
+        _mm_storeu_ps(vp_x + j, px);
+        _mm_storeu_ps(vp_y + j, py);
+        _mm_storeu_ps(bar_x + j, y);
+        _mm_storeu_ps(bar_y + j, _mm_xor_ps(x, sign));
+      }
+
+      orientations_row_scalar<N>(gradient_x + j, gradient_y + j, vp_x + j, vp_y + j, bar_x + j, bar_y + j, n - j);
+    }
+
+    template<int N> SIMD_TARGET_AVX2 inline void complex_power_avx2(const __m256 x, const __m256 y, __m256& px, __m256& py) {
+      __m256 hx, hy;
+      complex_power_avx2<N / 2>(x, y, hx, hy);
+      px = _mm256_sub_ps(_mm256_mul_ps(hx, hx), _mm256_mul_ps(hy, hy));
+      py = _mm256_add_ps(_mm256_mul_ps(hx, hy), _mm256_mul_ps(hy, hx));
+      if (N % 2) {
+        const __m256 sx = px, sy = py;
+        px = _mm256_sub_ps(_mm256_mul_ps(sx, x), _mm256_mul_ps(sy, y));
+        py = _mm256_add_ps(_mm256_mul_ps(sx, y), _mm256_mul_ps(sy, x));
+      }
+    }
+
+    template<> SIMD_TARGET_AVX2 inline void complex_power_avx2<1>(const __m256 x, const __m256 y, __m256& px, __m256& py) {
+      px = x;
+      py = y;
+    }
+
+    template<int N> SIMD_TARGET_AVX2 void orientations_row_avx2(const float* gradient_x, const float* gradient_y, float* vp_x, float* vp_y, float* bar_x, float* bar_y, const int n) {
+      const __m256 sign = _mm256_set1_ps(-0.0f);
+
+      int j = 0;
+      for (; j + 8 <= n; j += 8) {
+        const __m256 x = _mm256_loadu_ps(gradient_x + j);
+        const __m256 y = _mm256_loadu_ps(gradient_y + j);
+        __m256 px, py;
+        complex_power_avx2<N>(x, y, px, py);
+        _mm256_storeu_ps(vp_x + j, px);
+        _mm256_storeu_ps(vp_y + j, py);
+        _mm256_storeu_ps(bar_x + j, y);
+        _mm256_storeu_ps(bar_y + j, _mm256_xor_ps(x, sign));
+      }
+
+      orientations_row_sse41<N>(gradient_x + j, gradient_y + j, vp_x + j, vp_y + j, bar_x + j, bar_y + j, n - j);
+    }
+
+#endif
+
+    gradient_h_row_kernel select_gradient_h_kernel(const simd::Level level) {
+#if SIMD_X86
+      switch (simd::select_level(level)) {
+      case simd::LEVEL_AVX2:
+        return gradient_h_row_avx2;
+      case simd::LEVEL_SSE41:
+        return gradient_h_row_sse41;
+      default:
+        break;
+      }
+#else
+      (void) level;
+#endif
+      return gradient_h_row_scalar;
+    }
+
+    gradient_v_row_kernel select_gradient_v_kernel(const simd::Level level) {
+#if SIMD_X86
+      switch (simd::select_level(level)) {
+      case simd::LEVEL_AVX2:
+        return gradient_v_row_avx2;
+      case simd::LEVEL_SSE41:
+        return gradient_v_row_sse41;
+      default:
+        break;
+      }
+#else
+      (void) level;
+#endif
+      return gradient_v_row_scalar;
+    }
+
+    edge_pixels_row_kernel select_edge_pixels_kernel(const simd::Level level) {
+#if SIMD_X86
+      switch (simd::select_level(level)) {
+      case simd::LEVEL_AVX2:
+        return edge_pixels_row_avx2;
+      case simd::LEVEL_SSE41:
+        return edge_pixels_row_sse41;
+      default:
+        break;
+      }
+#else
+      (void) level;
+#endif
+      return edge_pixels_row_scalar;
+    }
+
+    line_offsets_kernel select_line_offsets_kernel(const simd::Level level) {
+#if SIMD_X86
+      switch (simd::select_level(level)) {
+      case simd::LEVEL_AVX2:
+        return line_offsets_avx2;
+      case simd::LEVEL_SSE41:
+        return line_offsets_sse41;
+      default:
+        break;
+      }
+#else
+      (void) level;
+#endif
+      return line_offsets_scalar;
+    }
+
+    merge_votes_row_kernel select_merge_votes_kernel(const simd::Level level) {
+#if SIMD_X86
+      switch (simd::select_level(level)) {
+      case simd::LEVEL_AVX2:
+        return merge_votes_row_avx2;
+      case simd::LEVEL_SSE41:
+        return merge_votes_row_sse41;
+      default:
+        break;
+      }
+#else
+      (void) level;
+#endif
+      return merge_votes_row_scalar;
+    }
+
+    merge_fixed_point_votes_row_kernel select_merge_fixed_point_votes_kernel(const simd::Level level) {
+#if SIMD_X86
+      switch (simd::select_level(level)) {
+      case simd::LEVEL_AVX2:
+        return merge_fixed_point_votes_row_avx2;
+      case simd::LEVEL_SSE41:
+        return merge_fixed_point_votes_row_sse41;
+      default:
+        break;
+      }
+#else
+      (void) level;
+#endif
+      return merge_fixed_point_votes_row_scalar;
+    }
+
+    // Kernel for a number of edges at a level -- NULL if the number of edges has no specialised kernel
+    template<int N> orientations_row_kernel select_orientations_kernel(const simd::Level level) {
+#if SIMD_X86
+      switch (simd::select_level(level)) {
+      case simd::LEVEL_AVX2:
+        return orientations_row_avx2<N>;
+      case simd::LEVEL_SSE41:
+        return orientations_row_sse41<N>;
+      default:
+        break;
+      }
+#else
+      (void) level;
+#endif
+      return orientations_row_scalar<N>;
+    }
+
+    orientations_row_kernel select_orientations_kernel(const int edges_number, const simd::Level level) {
+      switch (edges_number) {
+      case 3:
+        return select_orientations_kernel<3>(level);
+      case 4:
+        return select_orientations_kernel<4>(level);
+      case 8:
+        return select_orientations_kernel<8>(level);
+      case 12:
+        return select_orientations_kernel<12>(level);
+      default:
+        return NULL;
+      }
+    }
+
+    // Any other number of edges -- z^edges_number by repeated multiplication
+    void orientations_row_generic(const float* gradient_x, const float* gradient_y, float* vp_x, float* vp_y, float* bar_x, float* bar_y, const int n, const int edges_number) {
+      for (int j = 0; j < n; ++j) {
+        const float x = gradient_x[j], y = gradient_y[j];
+        float px = x, py = y;
+        for (int k = 1; k < edges_number; ++k) {
+          const float sx = px, sy = py;
+          px = sx * x - sy * y;
+          py = sx * y + sy * x;
+        }
+        vp_x[j] = px;
+        vp_y[j] = py;
+        bar_x[j] = y;
+        bar_y[j] = - x;
+      }
+    }
+
+  }
+
+  /*
+   * Horizontal smoothing and derivative of n pixels
+   */
+  void gradient_h_row_simd(const float* src, float* smoothed, float* derived, const int n, const simd::Level level) {
+    select_gradient_h_kernel(level)(src, smoothed, derived, n);
+  }
+
+  /*
+   * Vertical pass, magnitude and direction of n pixels
+   */
+  void gradient_v_row_simd(const float* const* smoothed, const float* const* derived, float* gradient_x, float* gradient_y, float* magnitude, const int n, const simd::Level level) {
+    select_gradient_v_kernel(level)(smoothed, derived, gradient_x, gradient_y, magnitude, n);
+  }
+
+  /*
+   * Columns of the edge pixels among n pixels
+   */
+  int edge_pixels_row_simd(const float* magnitude, const int n, int* edges, const simd::Level level) {
+    return select_edge_pixels_kernel(level)(magnitude, n, edges);
+  }
+
+  /*
+   * Offsets of a vote line
+   */
+  void line_offsets_simd(const float bar_x, const float bar_y, const int half_length, int* dx, int* dy, const simd::Level level) {
+    select_line_offsets_kernel(level)(bar_x, bar_y, half_length, dx, dy);
+  }
+
+  /*
+   * Merge of n accumulators of the private copies of the threads
+   */
+  void merge_votes_row_simd(const float* const* parts, const int n_parts, float* merged, const int n, const simd::Level level) {
+    select_merge_votes_kernel(level)(parts, n_parts, merged, n);
+  }
+
+  void merge_votes_row_simd(const int* const* parts, const int n_parts, const float scale, float* merged, const int n, const simd::Level level) {
+    select_merge_fixed_point_votes_kernel(level)(parts, n_parts, scale, merged, n);
+  }
+
+  /*
+   * Vote direction and direction of the vote lines of n pixels
+   */
+  void orientations_row_simd(const float* gradient_x, const float* gradient_y, float* vp_x, float* vp_y, float* bar_x, float* bar_y, const int n, const int edges_number, const simd::Level level) {
+    const orientations_row_kernel kernel = select_orientations_kernel(edges_number, level);
+    if (kernel)
+      kernel(gradient_x, gradient_y, vp_x, vp_y, bar_x, bar_y, n);
+    else
+      orientations_row_generic(gradient_x, gradient_y, vp_x, vp_y, bar_x, bar_y, n, edges_number);
+  }
+
+}
@@ -0,0 +1,404 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+// own library
+#include "trafficSignDetector.h"
+#include "segmentation.h"
+#include "imageProcessing.h"
+#include "parallel.h"
+
+// stl library
+#include <limits>
+#include <chrono>
+#include <cmath>
+
+// Eigen library
+#include <Eigen/Core>
+
+namespace detection {
+
+  int gielis_symmetry(const int sign_type) {
+
+    static const int symmetry[NB_SIGN_TYPES] = { 6, 4, 4, 8, 6 };
+    CV_Assert(sign_type >= 0 && sign_type < NB_SIGN_TYPES);
+    return symmetry[sign_type];
+  }
+
+  double intersection_over_union(const cv::Rect& lhs, const cv::Rect& rhs) {
+
+    const double intersection = (lhs & rhs).area();
+    const double union_area = lhs.area() + rhs.area() - intersection;
+    return union_area > 0 ? intersection / union_area : 0.0;
+  }
+
+  TrafficSignDetector::TrafficSignDetector(const int nhs_mode, const int nb_points)
+    : nhs_mode_(nhs_mode), nb_points_(nb_points), video_mode_(false), branch_and_bound_(false),
+      top_k_(NB_SIGN_TYPES), vote_accumulation_(initopt::VOTES_ORDERED), warp_free_regions_(false),
+      frame_size_(0, 0), ranking_ms_(0.0), regions_ms_(0.0) {
+
+    CV_Assert(nb_points > 0);
+  }
+
+  void TrafficSignDetector::set_video_mode(const bool video_mode) {
+
+    video_mode_ = video_mode;
+    if (!video_mode_)
+      tracks_.clear();
+  }
+
+  void TrafficSignDetector::set_top_k(const int top_k) {
+
+    CV_Assert(top_k >= 1 && top_k <= NB_SIGN_TYPES);
+    top_k_ = top_k;
+  }
+
+  void TrafficSignDetector::allocate(const cv::Size& size) {
+
+    seg_image_.create(size, CV_8UC1);
+    bin_image_.create(size, CV_8UC1);
+    work_image_.create(size, CV_8UC1);
+    frame_size_ = size;
+  }
+
+  void TrafficSignDetector::reset_transformations(const size_t n_contours) {
+
+    // Only grow the matrices -- the existing ones are reset in place
+    while (translation_matrix_.size() < n_contours) {
+      translation_matrix_.push_back(cv::Mat::eye(3, 3, CV_32F));
+      rotation_matrix_.push_back(cv::Mat::eye(3, 3, CV_32F));
+      scaling_matrix_.push_back(cv::Mat::eye(3, 3, CV_32F));
+    }
+    for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++) {
+      cv::setIdentity(translation_matrix_[contour_idx]);
+      cv::setIdentity(rotation_matrix_[contour_idx]);
+      cv::setIdentity(scaling_matrix_[contour_idx]);
+    }
+  }
+
+  void TrafficSignDetector::fit_hypothesis(const int hypothesis_idx, const double upper_bound) {
+
+    typedef std::chrono::steady_clock Clock;
+
+    const int contour_idx = hypothesis_idx / NB_SIGN_TYPES;
+    const int sign_type = hypothesis_idx % NB_SIGN_TYPES;
+    const Clock::time_point start = Clock::now();
+
+    // Check the center mass for a contour, voting on the gradient field shared by all its sign types
+    cv::Point2f mass_center = initopt::mass_center_discovery(regions_[contour_idx], translation_matrix_[contour_idx],
+                                                             factor_vector_[contour_idx], sign_type);
+    const Clock::time_point mass_center_end = Clock::now();
+
+    // Declaration of the parameters of the gielis with the default parameters
+    HypothesisFit& fit = fits_[hypothesis_idx];
+    fit.config = optimisation::ConfigStruct2d();
+    fit.config.p = gielis_symmetry(sign_type);
+    fit.config.theta_offset = rotation_offsets_[contour_idx];
+    fit.config.x_offset = mass_center.x;
+    fit.config.y_offset = mass_center.y;
+
+    // Go for the optimisation
+    Eigen::Vector4d mean_err(0,0,0,0), std_err(0,0,0,0);
+    optimisation::FitStatistics statistics;
+    optimisation::gielis_optimisation(normalised_contours_[contour_idx], fit.config, upper_bound, mean_err, std_err, statistics);
+    fit.fit_error = mean_err.cwiseAbs().sum();
+
+    FitTiming& timing = fit_timings_[hypothesis_idx];
+    timing.contour_idx = contour_idx;
+    timing.sign_type = sign_type;
+    timing.mass_center_ms = std::chrono::duration<double, std::milli>(mass_center_end - start).count();
+    timing.optimisation_ms = std::chrono::duration<double, std::milli>(Clock::now() - mass_center_end).count();
+    timing.warm_start = false;
+    timing.iterations = statistics.iterations;
+    timing.abandoned = statistics.abandoned;
+  }
+
+  void TrafficSignDetector::skip_hypothesis(const int hypothesis_idx) {
+
+    fits_[hypothesis_idx].fit_error = std::numeric_limits<double>::infinity();
+    FitTiming& timing = fit_timings_[hypothesis_idx];
+    timing.contour_idx = hypothesis_idx / NB_SIGN_TYPES;
+    timing.sign_type = hypothesis_idx % NB_SIGN_TYPES;
+    timing.mass_center_ms = 0.0;
+    timing.optimisation_ms = 0.0;
+    timing.warm_start = false;
+    timing.iterations = 0;
+    timing.abandoned = false;
+  }
+
+  void TrafficSignDetector::match_tracks(const size_t n_contours) {
+
+    matched_tracks_.assign(n_contours, -1);
+    if (tracks_.empty())
+      return;
+
+    std::vector< cv::Rect > boxes(n_contours);
+    for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++)
+      boxes[contour_idx] = cv::boundingRect(cv::Mat(distorted_contours_[contour_idx]));
+
+    // Greedy association -- a handful of candidates and signs per frame
+    std::vector< bool > claimed(tracks_.size(), false);
+    for (;;) {
+      double best_iou = TRACK_MIN_IOU;
+      int best_contour = -1, best_track = -1;
+      for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++) {
+        if (matched_tracks_[contour_idx] >= 0)
+          continue;
+        for (size_t track_idx = 0; track_idx < tracks_.size(); track_idx++) {
+          if (claimed[track_idx])
+            continue;
+          const double iou = intersection_over_union(boxes[contour_idx], tracks_[track_idx].box);
+          if (iou >= best_iou) {
+            best_iou = iou;
+            best_contour = static_cast<int> (contour_idx);
+            best_track = static_cast<int> (track_idx);
+          }
+        }
+      }
+      if (best_contour < 0)
+        break;
+      matched_tracks_[best_contour] = best_track;
+      claimed[best_track] = true;
+    }
+  }
+
+  bool TrafficSignDetector::fit_warm_start(const int contour_idx) {
+
+    typedef std::chrono::steady_clock Clock;
+
+    const Track& track = tracks_[matched_tracks_[contour_idx]];
+    const int hypothesis_idx = contour_idx * NB_SIGN_TYPES + track.sign_type;
+    const Clock::time_point start = Clock::now();
+
+    // Start from the parameters of the previous frame, only the sign type of the track is fitted
+    for (int sign_type = 0; sign_type < NB_SIGN_TYPES; sign_type++)
+      skip_hypothesis(contour_idx * NB_SIGN_TYPES + sign_type);
+    HypothesisFit& fit = fits_[hypothesis_idx];
+    fit.config = track.config;
+
+    Eigen::Vector4d mean_err(0,0,0,0), std_err(0,0,0,0);
+    optimisation::FitStatistics statistics;
+    optimisation::gielis_optimisation(normalised_contours_[contour_idx], fit.config, std::numeric_limits<double>::infinity(),
+                                      mean_err, std_err, statistics);
+    fit.fit_error = mean_err.cwiseAbs().sum();
+
+    FitTiming& timing = fit_timings_[hypothesis_idx];
+    timing.optimisation_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    timing.warm_start = true;
+    timing.iterations = statistics.iterations;
+
+    // A fit drifting away from the previous frame falls back on the full search
+    return std::isfinite(fit.fit_error) && fit.fit_error <= WARM_START_MAX_ERROR_RATIO * track.fit_error;
+  }
+
+  std::vector< Detection > TrafficSignDetector::detect(const cv::Mat& image) {
+
+    std::vector< Detection > detections;
+    detect(image, detections);
+    return detections;
+  }
+
+  void TrafficSignDetector::detect(const cv::Mat& image, std::vector< Detection >& detections) {
+
+    CV_Assert(image.type() == CV_8UC3);
+
+    detections.clear();
+
+    if (image.size() != frame_size_)
+      allocate(image.size());
+
+    // Segmentation in the IHLS and log chromatic color spaces, merged with an OR operator
+    segmentation::seg_fused_rgb(image, seg_image_, nhs_mode_);
+
+    // Filter the image using median filtering and morpho math
+    imageprocessing::filter_image(seg_image_, bin_image_, work_image_);
+
+    // Extract candidates (i.e., contours) and remove inconsistent candidates
+    imageprocessing::contours_extraction(bin_image_, distorted_contours_);
+
+    // Correct the distortion for each contour
+    reset_transformations(distorted_contours_.size());
+    imageprocessing::correction_distortion(distorted_contours_, undistorted_contours_, translation_matrix_, rotation_matrix_, scaling_matrix_);
+
+    // Normalise the contours to be inside a unit circle
+    if (factor_vector_.size() < undistorted_contours_.size())
+      factor_vector_.resize(undistorted_contours_.size());
+    initopt::normalise_all_contours(undistorted_contours_, normalised_contours_, factor_vector_);
+
+    // The rotation offset only depends on the contour
+    const size_t n_contours = normalised_contours_.size();
+    rotation_offsets_.resize(n_contours);
+    for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++)
+      rotation_offsets_[contour_idx] = initopt::rotation_offset(normalised_contours_[contour_idx]);
+
+    const int n_hypotheses = static_cast<int> (n_contours) * NB_SIGN_TYPES;
+    fits_.resize(n_hypotheses);
+    fit_timings_.resize(n_hypotheses);
+
+    // In video mode, fit first the contours matching a sign of the previous frame from its parameters
+    match_tracks(n_contours);
+    std::vector< char > warm_started(n_contours, 0);
+    parallel::parallel_for_stealing(static_cast<int> (n_contours), [&](const int contour_idx) {
+        if (matched_tracks_[contour_idx] >= 0)
+          warm_started[contour_idx] = fit_warm_start(contour_idx);
+      });
+
+    // Rank the sign types of the other contours with the shape pre-classifier, only the top k are fitted
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point ranking_start = Clock::now();
+    sign_type_rankings_.assign(n_hypotheses, -1);
+    for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++) {
+      if (warm_started[contour_idx])
+        continue;
+      initopt::rank_sign_types(normalised_contours_[contour_idx], ranking_);
+      std::copy(ranking_.begin(), ranking_.end(), sign_type_rankings_.begin() + contour_idx * NB_SIGN_TYPES);
+      for (int rank = top_k_; rank < NB_SIGN_TYPES; rank++)
+        skip_hypothesis(static_cast<int> (contour_idx) * NB_SIGN_TYPES + ranking_[rank]);
+    }
+    ranking_ms_ = std::chrono::duration<double, std::milli>(Clock::now() - ranking_start).count();
+
+    // Correct the distortion of the region around each searched contour and compute its gradient field, once for
+    // all its sign types, then vote for the mass centers of its top k sign types in a single sweep. The ordered
+    // votes of the contours run concurrently. The private accumulators split the votes of a single region across
+    // the threads, each region is voted in turn once all of them are prepared.
+    const Clock::time_point regions_start = Clock::now();
+    if (regions_.size() < n_contours)
+      regions_.resize(n_contours);
+    const bool per_contour_voting = vote_accumulation_ == initopt::VOTES_ORDERED;
+    parallel::parallel_for_stealing(static_cast<int> (n_contours), [&](const int contour_idx) {
+        if (warm_started[contour_idx])
+          return;
+        if (warp_free_regions_)
+          initopt::prepare_contour_region_warp_free(image, translation_matrix_[contour_idx], rotation_matrix_[contour_idx],
+                                                    scaling_matrix_[contour_idx], normalised_contours_[contour_idx],
+                                                    factor_vector_[contour_idx], regions_[contour_idx]);
+        else
+          initopt::prepare_contour_region(image, translation_matrix_[contour_idx], rotation_matrix_[contour_idx],
+                                          scaling_matrix_[contour_idx], normalised_contours_[contour_idx],
+                                          factor_vector_[contour_idx], regions_[contour_idx]);
+        if (per_contour_voting) {
+          const std::vector< int >::const_iterator ranking = sign_type_rankings_.begin() + contour_idx * NB_SIGN_TYPES;
+          initopt::vote_mass_centers(regions_[contour_idx], std::vector< int >(ranking, ranking + top_k_), vote_accumulation_);
+        }
+      });
+    if (!per_contour_voting) {
+      for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++) {
+        if (warm_started[contour_idx])
+          continue;
+        const std::vector< int >::const_iterator ranking = sign_type_rankings_.begin() + contour_idx * NB_SIGN_TYPES;
+        initopt::vote_mass_centers(regions_[contour_idx], std::vector< int >(ranking, ranking + top_k_), vote_accumulation_);
+      }
+    }
+    regions_ms_ = std::chrono::duration<double, std::milli>(Clock::now() - regions_start).count();
+
+    // Fit the kept (contour, sign type) hypotheses as independent tasks. With the branch and bound, the most
+    // plausible sign type of every contour is fitted first and its error bounds the other sign types of the
+    // contour. The bound is the same whatever the order of the tasks, so is the result, but a fit abandoned on the
+    // BOUND_MARGIN heuristic might have won and the detection can then differ from the exhaustive search.
+    const double no_bound = std::numeric_limits<double>::infinity();
+    const int first_round_k = branch_and_bound_ ? 1 : top_k_;
+    searched_hypotheses_.clear();
+    for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++)
+      if (!warm_started[contour_idx])
+        for (int rank = 0; rank < first_round_k; rank++)
+          searched_hypotheses_.push_back(static_cast<int> (contour_idx) * NB_SIGN_TYPES + sign_type_rankings_[contour_idx * NB_SIGN_TYPES + rank]);
+    parallel::parallel_for_stealing(static_cast<int> (searched_hypotheses_.size()),
+                                    [&](const int k) { fit_hypothesis(searched_hypotheses_[k], no_bound); });
+
+    if (branch_and_bound_) {
+      searched_hypotheses_.clear();
+      for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++)
+        if (!warm_started[contour_idx])
+          for (int rank = 1; rank < top_k_; rank++)
+            searched_hypotheses_.push_back(static_cast<int> (contour_idx) * NB_SIGN_TYPES + sign_type_rankings_[contour_idx * NB_SIGN_TYPES + rank]);
+      parallel::parallel_for_stealing(static_cast<int> (searched_hypotheses_.size()), [&](const int k) {
+          const int contour_idx = searched_hypotheses_[k] / NB_SIGN_TYPES;
+          const int best_idx = contour_idx * NB_SIGN_TYPES + sign_type_rankings_[contour_idx * NB_SIGN_TYPES];
+          fit_hypothesis(searched_hypotheses_[k], fits_[best_idx].fit_error);
+        });
+    }
+
+    detections.resize(n_contours);
+
+    // For each contours
+    for (unsigned int contour_idx = 0; contour_idx < n_contours; contour_idx++) {
+
+      // Keep the best sign type -- in increasing sign type order, as the serial loop did
+      Detection& detection = detections[contour_idx];
+      detection.sign_type = 0;
+      detection.fit_error = std::numeric_limits<double>::infinity();
+      detection.warm_started = warm_started[contour_idx] != 0;
+      for (int sign_type = 0; sign_type < NB_SIGN_TYPES; sign_type++) {
+        const HypothesisFit& fit = fits_[contour_idx * NB_SIGN_TYPES + sign_type];
+        if (fit.fit_error < detection.fit_error) {
+          detection.fit_error = fit.fit_error;
+          detection.config = fit.config;
+          detection.sign_type = sign_type;
+        }
+      }
+
+      // Reconstruct the contour in the image coordinates
+      optimisation::gielis_reconstruction(detection.config, gielis_contour_, nb_points_);
+      initopt::denormalise_contour(gielis_contour_, denormalised_contour_, factor_vector_[contour_idx]);
+      imageprocessing::inverse_transformation_contour(denormalised_contour_, detection.contour,
+                                                      translation_matrix_[contour_idx], rotation_matrix_[contour_idx],
+                                                      scaling_matrix_[contour_idx]);
+    }
+
+    // Keep the signs of this frame to warm start the next one
+    if (video_mode_) {
+      tracks_.clear();
+      for (size_t contour_idx = 0; contour_idx < n_contours; contour_idx++) {
+        const Detection& detection = detections[contour_idx];
+        if (!std::isfinite(detection.fit_error))
+          continue;
+        Track track;
+        track.sign_type = detection.sign_type;
+        track.fit_error = detection.fit_error;
+        track.config = detection.config;
+        track.box = cv::boundingRect(cv::Mat(detection.contour));
+        tracks_.push_back(track);
+      }
+    }
+  }
+
+}
@@ -0,0 +1,259 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+#pragma once
+
+// own library
+#include "smartOptimisation.h"
+
+// stl library
+#include <vector>
+
+// OpenCV library
+#include <opencv2/opencv.hpp>
+
+// Number of traffic sign types fitted on each candidate
+/*
+ * sign_type = 0 -> nb_edges = 3;  gielis_sym = 6; radius
+ * sign_type = 1 -> nb_edges = 4;  gielis_sym = 4; radius
+ * sign_type = 2 -> nb_edges = 12; gielis_sym = 4; radius
+ * sign_type = 3 -> nb_edges = 8;  gielis_sym = 8; radius
+ * sign_type = 4 -> nb_edges = 3;  gielis_sym = 6; radius / 2
+ */
+#define NB_SIGN_TYPES 5
+
+// Minimum intersection over union between a candidate and a sign of the previous frame to warm start its fit
+#define TRACK_MIN_IOU 0.5
+// A warm started fit converged if its error is below this ratio of the error of the previous frame
+#define WARM_START_MAX_ERROR_RATIO 2.0
+
+namespace detection {
+
+  // Symmetry of the Gielis curve fitted for a sign type
+  int gielis_symmetry(const int sign_type);
+
+  // Intersection over union of two boxes, 0 when both are empty
+  double intersection_over_union(const cv::Rect& lhs, const cv::Rect& rhs);
+
+  // Traffic sign found on a frame
+  struct Detection {
+    // Sign type giving the best fit
+    int sign_type;
+    // Sum of the absolute mean errors of the best fit
+    double fit_error;
+    // Parameters of the Gielis curve in the normalised frame of the contour
+    optimisation::ConfigStruct2d config;
+    // Reconstructed contour in image coordinates
+    std::vector< cv::Point2f > contour;
+    // Fitted from the parameters of a sign of the previous frame in video mode
+    bool warm_started;
+  };
+
+  // Sign of the previous frame used to warm start the fits in video mode
+  struct Track {
+    int sign_type;
+    double fit_error;
+    optimisation::ConfigStruct2d config;
+    // Bounding box of the reconstructed contour in image coordinates
+    cv::Rect box;
+  };
+
+  // Timing of the fit of one (contour, sign type) hypothesis
+  struct FitTiming {
+    int contour_idx;
+    int sign_type;
+    // Mass center discovery, in ms -- a lookup of the center voted with the other sign types of the contour
+    double mass_center_ms;
+    // Gielis optimisation, in ms
+    double optimisation_ms;
+    // Fitted from the parameters of the previous frame, without mass center discovery
+    bool warm_start;
+    // Levenberg-Marquardt iterations run, 0 for a skipped hypothesis
+    int iterations;
+    // Abandoned as it could not beat the most plausible sign type of the contour
+    bool abandoned;
+  };
+
+  // Full detection pipeline -- segmentation, filtering, contour extraction and Gielis fitting.
+  // The per-frame images and contour containers are members: they are sized on the first frame
+  // and reused by the following frames of the same resolution.
+  class TrafficSignDetector {
+  public:
+    // Constructor -- nhs_mode == 0 -> red segmentation / nhs_mode == 1 -> blue segmentation
+    explicit TrafficSignDetector(const int nhs_mode = 0, const int nb_points = 1000);
+
+    // Detect the traffic signs of a 3 channels BGR image
+    std::vector< Detection > detect(const cv::Mat& image);
+
+    // Same detection filling a caller owned vector
+    void detect(const cv::Mat& image, std::vector< Detection >& detections);
+
+    // Binary image of the last frame after segmentation and filtering, left untouched by the contour extraction
+    const cv::Mat& binary_image() const { return bin_image_; }
+
+    // Video mode -- a candidate overlapping a sign of the previous frame by TRACK_MIN_IOU is fitted from the
+    // parameters and the sign type of that sign only. The other sign types and the mass center discovery are
+    // skipped unless the warm started fit does not converge. Leaving the video mode forgets the previous frame.
+    void set_video_mode(const bool video_mode);
+    bool video_mode() const { return video_mode_; }
+
+    // Number of sign types fitted on each candidate -- the sign types are ranked by a shape pre-classifier on
+    // the normalised contour, see initopt::rank_sign_types, and only the top_k most plausible ones are fitted.
+    // NB_SIGN_TYPES, the default, fits every sign type.
+    void set_top_k(const int top_k);
+    int top_k() const { return top_k_; }
+
+    // Branch and bound across the sign types -- the most plausible sign type of each contour is fitted first and
+    // bounds the fits of the other sign types, which are abandoned once they are unlikely to beat it. Disabled by
+    // default: the abandonment during the fit is a heuristic, see BOUND_MARGIN.
+    void set_branch_and_bound(const bool branch_and_bound) { branch_and_bound_ = branch_and_bound; }
+    bool branch_and_bound() const { return branch_and_bound_; }
+
+    // Accumulation of the votes of the mass center discovery, see initopt::VoteAccumulation -- the private
+    // accumulators suit the large regions of near-field signs: the regions are then voted one after the other,
+    // each over all the threads, instead of concurrently. initopt::VOTES_ORDERED by default.
+    void set_vote_accumulation(const initopt::VoteAccumulation accumulation) { vote_accumulation_ = accumulation; }
+    initopt::VoteAccumulation vote_accumulation() const { return vote_accumulation_; }
+
+    // Regions of the contours prepared without warping the image, see initopt::prepare_contour_region_warp_free.
+    // Disabled by default.
+    void set_warp_free_regions(const bool warp_free_regions) { warp_free_regions_ = warp_free_regions; }
+    bool warp_free_regions() const { return warp_free_regions_; }
+
+    // Sign types of each contour of the last frame from the most to the least plausible, NB_SIGN_TYPES per
+    // contour -- -1 for the contours warm started in video mode
+    const std::vector< int >& sign_type_rankings() const { return sign_type_rankings_; }
+
+    // Time spent ranking the sign types of the last frame, in ms
+    double ranking_ms() const { return ranking_ms_; }
+
+    // Time spent correcting the distortion of the regions of the contours of the last frame, computing their
+    // gradient fields and voting for the mass centers of their sign types, in ms
+    double regions_ms() const { return regions_ms_; }
+
+    // Forget the signs of the previous frame, e.g. on a cut of the video
+    void reset_tracks() { tracks_.clear(); }
+
+    // Signs of the last frame used to warm start the next one -- empty outside of the video mode
+    const std::vector< Track >& tracks() const { return tracks_; }
+
+    // Timings of the hypotheses fitted on the last frame, ordered by contour then by sign type.
+    // The hypotheses skipped thanks to a warm start or out of the top k have an infinite fit error and
+    // null timings, the abandoned ones an infinite fit error.
+    const std::vector< FitTiming >& fit_timings() const { return fit_timings_; }
+
+    // Resolution for which the buffers are currently allocated
+    cv::Size frame_size() const { return frame_size_; }
+
+  private:
+    // Size the frame buffers for a new resolution
+    void allocate(const cv::Size& size);
+
+    // Reset the transformation matrices of the n_contours first contours
+    void reset_transformations(const size_t n_contours);
+
+    // Fit one (contour, sign type) hypothesis, abandoned if it cannot go below upper_bound -- safe to call
+    // concurrently for different hypotheses once the region of the contour is warped
+    void fit_hypothesis(const int hypothesis_idx, const double upper_bound);
+
+    // Mark a hypothesis as not fitted
+    void skip_hypothesis(const int hypothesis_idx);
+
+    // Associate each contour with the unclaimed track of highest IoU, by decreasing IoU -- -1 when none
+    void match_tracks(const size_t n_contours);
+
+    // Fit a contour from the parameters of its track -- returns false if the fit did not converge
+    bool fit_warm_start(const int contour_idx);
+
+    // Result of the fit of one hypothesis
+    struct HypothesisFit {
+      double fit_error;
+      optimisation::ConfigStruct2d config;
+    };
+
+    int nhs_mode_;
+    int nb_points_;
+    bool video_mode_;
+    bool branch_and_bound_;
+    int top_k_;
+    initopt::VoteAccumulation vote_accumulation_;
+    bool warp_free_regions_;
+    cv::Size frame_size_;
+
+    // Frame buffers
+    cv::Mat seg_image_;
+    cv::Mat bin_image_;
+    cv::Mat work_image_;
+
+    // Contour buffers -- their capacity grows with the number of candidates and is kept
+    std::vector< std::vector< cv::Point > > distorted_contours_;
+    std::vector< std::vector< cv::Point2f > > undistorted_contours_;
+    std::vector< std::vector< cv::Point2f > > normalised_contours_;
+    std::vector< cv::Mat > translation_matrix_;
+    std::vector< cv::Mat > rotation_matrix_;
+    std::vector< cv::Mat > scaling_matrix_;
+    std::vector< double > factor_vector_;
+    std::vector< double > rotation_offsets_;
+
+    // Hypothesis buffers -- hypothesis contour_idx * NB_SIGN_TYPES + sign_type
+    std::vector< HypothesisFit > fits_;
+    std::vector< FitTiming > fit_timings_;
+    std::vector< cv::Point2f > gielis_contour_;
+    std::vector< cv::Point2f > denormalised_contour_;
+
+    // Video mode buffers -- track of each contour, or -1, and hypotheses needing the full search
+    std::vector< Track > tracks_;
+    std::vector< int > matched_tracks_;
+    std::vector< int > searched_hypotheses_;
+
+    // Ranking of the sign types of each contour
+    std::vector< int > sign_type_rankings_;
+    std::vector< int > ranking_;
+    double ranking_ms_;
+
+    // Region of each contour corrected for the distortion, its gradient field and the mass centers of its sign types
+    std::vector< initopt::ContourRegion > regions_;
+    double regions_ms_;
+  };
+
+}
@@ -0,0 +1,82 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+// our own code
+#include <common/SuperFormula.h>
+#include <tests/unit/testFixtures.h>
+#include "allocationCounter.h"
+
+// stl library
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(superFormula, xiSquare8DDoesNotAllocate)
+{
+  // Noisy octagon, shifted and rotated
+  std::vector< Vector2d, aligned_allocator< Vector2d> > data;
+  fixtures::noisy_contour(RationalSuperShape2D(0.9, 0.87, 3.0, 5.0, 5.0, 8.0, 1.0).Parameters, 400, data);
+
+  RationalSuperShape2D RS(1.0, 1.0, 2.0, 2.0, 2.0, 8.0, 1.0, 0.15, 0.0, 0.0, 0.0, 0.0);
+  Matrix< double, 8, 8 > alpha;
+  Matrix< double, 8, 1 > beta;
+
+  // Warm up, then count the allocations of the steady state calls. Only operator new is hooked: a direct malloc,
+  // as done by Eigen for its dynamic matrices, would not be seen -- XiSquare<8> only uses fixed size matrices, and
+  // q stays within SUPERSHAPE_MAX_BRANCHES so that the branches of the implicit functions are on the stack.
+  RS.XiSquare< 8 >(data, alpha, beta, 1, true);
+  for (int function_used = 1; function_used <= 3; function_used++) {
+    allocations::count = 0;
+    allocations::counting = true;
+    RS.XiSquare< 8 >(data, alpha, beta, function_used, true);
+    RS.XiSquare< 8 >(data, alpha, beta, function_used, false);
+    allocations::counting = false;
+    EXPECT_EQ(0, allocations::count.load()) << "implicit function " << function_used;
+  }
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
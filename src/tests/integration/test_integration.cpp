@@ -42,26 +42,22 @@ the use of this software, even if advised of the possibility of such damage.
 */
 
 // our own code
+#include <common/trafficSignDetector.h>
+#include <common/parallel.h>
 #include <common/segmentation.h>
-#include <common/colorConversion.h>
 #include <common/imageProcessing.h>
-#include <common/smartOptimisation.h>
-#include <common/math_utils.h>
-
+#include <tests/unit/testFixtures.h>
 
 #include <iostream>
+#include <algorithm>
 
 // OpenCV library
 #include <opencv2/opencv.hpp>
 
-// Eigen library
-#include <Eigen/Core>
-
 #include <gtest/gtest.h>
 
 //TODO: This probably should be just regression tests...
-//TODO: clean up code, a lot of data is not used, also find proper GT no hardcoded values
-//this is a copy of the main app to do automatic testing using the test data of the repository
+//TODO: find proper GT no hardcoded values
 TEST(integration, realDataOctogonal17)
 {
 
@@ -77,185 +73,208 @@ TEST(integration, realDataOctogonal17)
     // Check that the image read is a 3 channels image
     GTEST_ASSERT_EQ(input_image.channels(), 3);
 
-    /*
-     * Conversion of the image in some specific color space
-     */
-
-    // Conversion of the rgb image in ihls color space
-    cv::Mat ihls_image;
-    colorconversion::convert_rgb_to_ihls(input_image, ihls_image);
-    // Conversion from RGB to logarithmic chromatic red and blue
-    std::vector< cv::Mat > log_image;
-    colorconversion::rgb_to_log_rb(input_image, log_image);
-
-    /*
-     * Segmentation of the image using the previous transformation
-     */
-
-    // Segmentation of the IHLS and more precisely of the normalised hue channel
-    // ONE PARAMETER TO CONSIDER - COLOR OF THE TRAFFIC SIGN TO DETECT - RED VS BLUE
-    int nhs_mode = 0; // nhs_mode == 0 -> red segmentation / nhs_mode == 1 -> blue segmentation
-    cv::Mat nhs_image_seg_red;
-    segmentation::seg_norm_hue(ihls_image, nhs_image_seg_red, nhs_mode);
-    //nhs_mode = 1; // nhs_mode == 0 -> red segmentation / nhs_mode == 1 -> blue segmentation
-    //cv::Mat nhs_image_seg_blue;
-    cv::Mat nhs_image_seg_blue = nhs_image_seg_red.clone();
-    //segmentation::seg_norm_hue(ihls_image, nhs_image_seg_blue, nhs_mode);
-    // Segmentation of the log chromatic image
-    // TODO - DEFINE THE THRESHOLD FOR THE BLUE TRAFFIC SIGN. FOR NOW WE AVOID THE PROCESSING FOR BLUE SIGN AND LET ONLY THE OTHER METHOD TO TAKE CARE OF IT.
-    cv::Mat log_image_seg;
-    segmentation::seg_log_chromatic(log_image, log_image_seg);
-
-    /*
-     * Merging and filtering of the previous segmentation
-     */
-
-    // Merge the results of previous segmentation using an OR operator
-    // Pre-allocation of an image by cloning a previous image
-    cv::Mat merge_image_seg_with_red = nhs_image_seg_red.clone();
-    cv::Mat merge_image_seg = nhs_image_seg_blue.clone();
-    cv::bitwise_or(nhs_image_seg_red, log_image_seg, merge_image_seg_with_red);
-    cv::bitwise_or(nhs_image_seg_blue, merge_image_seg_with_red, merge_image_seg);
-
-    // Filter the image using median filtering and morpho math
-    cv::Mat bin_image;
-    imageprocessing::filter_image(merge_image_seg, bin_image);
-    /*
-     * Extract candidates (i.e., contours) and remove inconsistent candidates
-     */
-
-    std::vector< std::vector< cv::Point > > distorted_contours;
-    imageprocessing::contours_extraction(bin_image, distorted_contours);
-
-    /*
-     * Correct the distortion for each contour
-     */
-
-    // Initialisation of the variables which will be returned after the distortion. These variables are linked with the transformation applied to correct the distortion
-    std::vector< cv::Mat > rotation_matrix(distorted_contours.size());
-    std::vector< cv::Mat > scaling_matrix(distorted_contours.size());
-    std::vector< cv::Mat > translation_matrix(distorted_contours.size());
-    for (unsigned int contour_idx = 0; contour_idx < distorted_contours.size(); contour_idx++) {
-        rotation_matrix[contour_idx] = cv::Mat::eye(3, 3, CV_32F);
-        scaling_matrix[contour_idx] = cv::Mat::eye(3, 3, CV_32F);
-        translation_matrix[contour_idx] = cv::Mat::eye(3, 3, CV_32F);
+    detection::TrafficSignDetector detector;
+    std::vector< detection::Detection > detections = detector.detect(input_image);
+
+    //only 1 traffic sign in this image
+    GTEST_ASSERT_EQ(detections.size(), 1);
+
+    const float errThresh = 1e-4;
+    const optimisation::ConfigStruct2d& config = detections[0].config;
+
+    GTEST_ASSERT_LE(std::abs(config.x_offset - 0.0077245), errThresh);
+    GTEST_ASSERT_LE(std::abs(config.y_offset - 0.0f), errThresh);
+    GTEST_ASSERT_LE(std::abs(config.z_offset), errThresh);
+    GTEST_ASSERT_LE(std::abs(config.a - 0.88557), errThresh);
+    GTEST_ASSERT_LE(std::abs(config.b - 0.869246), errThresh);
+    GTEST_ASSERT_LE(std::abs(config.theta_offset - 0.738422), errThresh);
+    GTEST_ASSERT_LE(std::abs(config.phi_offset - 0.0f), errThresh);
+}
+
+TEST(integration, detectorReusesFrameBuffers)
+{
+
+    std::string input_filename(TEST_DATA_DIR);
+    input_filename.append("/octogonal0017.jpg");
+    cv::Mat input_image = cv::imread(input_filename);
+    ASSERT_TRUE( input_image.data != NULL);
+
+    detection::TrafficSignDetector detector;
+    std::vector< detection::Detection > first = detector.detect(input_image);
+    const uchar* bin_data = detector.binary_image().data;
+    GTEST_ASSERT_EQ(detector.frame_size(), input_image.size());
+
+    // A second frame of the same resolution reuses the buffers and gives the same result
+    std::vector< detection::Detection > second = detector.detect(input_image);
+    GTEST_ASSERT_EQ(detector.binary_image().data, bin_data);
+    GTEST_ASSERT_EQ(first.size(), second.size());
+    for (size_t i = 0; i < first.size(); ++i) {
+        GTEST_ASSERT_EQ(first[i].sign_type, second[i].sign_type);
+        GTEST_ASSERT_EQ(first[i].fit_error, second[i].fit_error);
+        GTEST_ASSERT_EQ(first[i].contour.size(), second[i].contour.size());
+    }
+
+    // A new resolution resizes the buffers
+    cv::Mat half_image;
+    cv::resize(input_image, half_image, cv::Size(), 0.5, 0.5);
+    detector.detect(half_image);
+    GTEST_ASSERT_EQ(detector.frame_size(), half_image.size());
+    GTEST_ASSERT_EQ(detector.binary_image().size(), half_image.size());
+}
+
+TEST(integration, detectorKeepsTheFilteredBinaryImage)
+{
+
+    std::string input_filename(TEST_DATA_DIR);
+    input_filename.append("/octogonal0017.jpg");
+    cv::Mat input_image = cv::imread(input_filename);
+    ASSERT_TRUE( input_image.data != NULL);
+
+    detection::TrafficSignDetector detector;
+    detector.detect(input_image);
+
+    // The contour extraction must not write into the exposed binary image
+    cv::Mat seg_image, bin_image;
+    segmentation::seg_fused_rgb(input_image, seg_image, 0);
+    imageprocessing::filter_image(seg_image, bin_image);
+    GTEST_ASSERT_EQ(detector.binary_image().size(), bin_image.size());
+    GTEST_ASSERT_EQ(cv::countNonZero(detector.binary_image() != bin_image), 0);
+}
+
+TEST(integration, detectorMatchesSerialFitting)
+{
+
+    std::string input_filename(TEST_DATA_DIR);
+    input_filename.append("/octogonal0017.jpg");
+    cv::Mat input_image = cv::imread(input_filename);
+    ASSERT_TRUE( input_image.data != NULL);
+
+    fixtures::ThreadCountGuard guard;
+    detection::TrafficSignDetector detector;
+    parallel::set_num_threads(1);
+    std::vector< detection::Detection > serial = detector.detect(input_image);
+
+    // The hypotheses are fitted in any order but the reduction keeps the serial choice
+    parallel::set_num_threads(4);
+    std::vector< detection::Detection > threaded = detector.detect(input_image);
+
+    GTEST_ASSERT_EQ(serial.size(), threaded.size());
+    for (size_t i = 0; i < serial.size(); ++i) {
+        GTEST_ASSERT_EQ(serial[i].sign_type, threaded[i].sign_type);
+        GTEST_ASSERT_EQ(serial[i].fit_error, threaded[i].fit_error);
+        GTEST_ASSERT_EQ(serial[i].config.x_offset, threaded[i].config.x_offset);
+        GTEST_ASSERT_EQ(serial[i].config.y_offset, threaded[i].config.y_offset);
     }
 
-    // Correct the distortion
-    std::vector< std::vector< cv::Point2f > > undistorted_contours;
-    imageprocessing::correction_distortion(distorted_contours, undistorted_contours, translation_matrix, rotation_matrix, scaling_matrix);
-
-    // Normalise the contours to be inside a unit circle
-    std::vector<double> factor_vector(undistorted_contours.size());
-    std::vector< std::vector< cv::Point2f > > normalised_contours;
-    initopt::normalise_all_contours(undistorted_contours, normalised_contours, factor_vector);
-
-    std::vector< std::vector< cv::Point2f > > detected_signs_2f(normalised_contours.size());
-    std::vector< std::vector< cv::Point > > detected_signs(normalised_contours.size());
-
-    std::vector<optimisation::ConfigStruct_<double> > massCenters(normalised_contours.size());
-    // For each contours
-    for (unsigned int contour_idx = 0; contour_idx < normalised_contours.size(); contour_idx++) {
-
-        // For each type of traffic sign
-        /*
-       * sign_type = 0 -> nb_edges = 3;  gielis_sym = 6; radius
-       * sign_type = 1 -> nb_edges = 4;  gielis_sym = 4; radius
-       * sign_type = 2 -> nb_edges = 12; gielis_sym = 4; radius
-       * sign_type = 3 -> nb_edges = 8;  gielis_sym = 8; radius
-       * sign_type = 4 -> nb_edges = 3;  gielis_sym = 6; radius / 2
-       */
-
-        optimisation::ConfigStruct_<double> final_config;
-        double best_fit = std::numeric_limits<double>::infinity();
-        //int type_sign_to_keep = 0;
-        for (int sign_type = 0; sign_type < 5; sign_type++) {
-
-            // Check the center mass for a contour
-            cv::Point2f mass_center = initopt::mass_center_discovery(input_image, translation_matrix[contour_idx],
-                                                                              rotation_matrix[contour_idx], scaling_matrix[contour_idx],
-                                                                              normalised_contours[contour_idx], factor_vector[contour_idx], sign_type);
-
-            // Find the rotation offset
-            double rot_offset = initopt::rotation_offset(normalised_contours[contour_idx]);
-
-            // Declaration of the parameters of the gielis with the default parameters
-            optimisation::ConfigStruct_<double> contour_config;
-            // Set the number of symmetry
-            int gielis_symmetry = 0;
-            switch (sign_type) {
-            case 0:
-                gielis_symmetry = 6;
-                break;
-            case 1:
-                gielis_symmetry = 4;
-                break;
-            case 2:
-                gielis_symmetry = 4;
-                break;
-            case 3:
-                gielis_symmetry = 8;
-                break;
-            case 4:
-                gielis_symmetry = 6;
-                break;
-            }
-            contour_config.p = gielis_symmetry;
-            // Set the rotation matrix
-            contour_config.theta_offset = rot_offset;
-            // Set the mass center
-            contour_config.x_offset = mass_center.x;
-            contour_config.y_offset = mass_center.y;
-
-            // Go for the optimisation
-            Eigen::Vector4d mean_err(0,0,0,0), std_err(0,0,0,0);
-            optimisation::gielis_optimisation(normalised_contours[contour_idx], contour_config, mean_err, std_err);
-
-            mean_err = mean_err.cwiseAbs();
-            double err_fit = mean_err.sum();
-
-            if (err_fit < best_fit) {
-                best_fit = err_fit;
-                final_config = contour_config;
-                //type_sign_to_keep = sign_type;
-            }
-        }
-
-        // Reconstruct the contour
-        std::cout << "Contour #" << contour_idx << ":\n" << final_config << std::endl;
-        std::vector< cv::Point2f > gielis_contour;
-        int nb_points = 1000;
-        optimisation::gielis_reconstruction(final_config, gielis_contour, nb_points);
-        std::vector< cv::Point2f > denormalised_gielis_contour;
-        initopt::denormalise_contour(gielis_contour, denormalised_gielis_contour, factor_vector[contour_idx]);
-        std::vector< cv::Point2f > distorted_gielis_contour;
-        imageprocessing::inverse_transformation_contour(denormalised_gielis_contour, distorted_gielis_contour,
-                                                        translation_matrix[contour_idx], rotation_matrix[contour_idx], scaling_matrix[contour_idx]);
-
-        // Transform to cv::Point to show the results
-        std::vector< cv::Point > distorted_gielis_contour_int(distorted_gielis_contour.size());
-        for (unsigned int i = 0; i < distorted_gielis_contour.size(); i++) {
-            distorted_gielis_contour_int[i].x = (int) std::round(distorted_gielis_contour[i].x);
-            distorted_gielis_contour_int[i].y = (int) std::round(distorted_gielis_contour[i].y);
-        }
-
-        detected_signs_2f[contour_idx] = distorted_gielis_contour;
-        detected_signs[contour_idx] = distorted_gielis_contour_int;
-
-        massCenters[contour_idx] = final_config;
+    // One timing per (contour, sign type) hypothesis
+    const std::vector< detection::FitTiming >& timings = detector.fit_timings();
+    GTEST_ASSERT_EQ(timings.size(), serial.size() * NB_SIGN_TYPES);
+    for (size_t k = 0; k < timings.size(); ++k) {
+        GTEST_ASSERT_EQ(timings[k].contour_idx, int(k / NB_SIGN_TYPES));
+        GTEST_ASSERT_EQ(timings[k].sign_type, int(k % NB_SIGN_TYPES));
+        GTEST_ASSERT_GE(timings[k].optimisation_ms, 0.0);
     }
+}
 
-    //only 1 traffic sign in this image
-    GTEST_ASSERT_EQ(massCenters.size(), 1);
+TEST(integration, videoModeWarmStartsTrackedSigns)
+{
+
+    std::string input_filename(TEST_DATA_DIR);
+    input_filename.append("/octogonal0017.jpg");
+    cv::Mat input_image = cv::imread(input_filename);
+    ASSERT_TRUE( input_image.data != NULL);
+
+    GTEST_ASSERT_EQ(detection::intersection_over_union(cv::Rect(0, 0, 10, 10), cv::Rect(0, 0, 10, 10)), 1.0);
+    GTEST_ASSERT_EQ(detection::intersection_over_union(cv::Rect(0, 0, 10, 10), cv::Rect(5, 0, 10, 10)), 50.0 / 150.0);
+    GTEST_ASSERT_EQ(detection::intersection_over_union(cv::Rect(0, 0, 10, 10), cv::Rect(20, 0, 10, 10)), 0.0);
+
+    detection::TrafficSignDetector detector;
+    const std::vector< detection::Detection > independent = detector.detect(input_image);
+    GTEST_ASSERT_EQ(independent.size(), 1);
+    GTEST_ASSERT_EQ(detector.tracks().size(), 0);
+
+    // The first frame has no previous sign -- full search
+    detector.set_video_mode(true);
+    const std::vector< detection::Detection > first = detector.detect(input_image);
+    GTEST_ASSERT_EQ(first.size(), 1);
+    ASSERT_FALSE(first[0].warm_started);
+    GTEST_ASSERT_EQ(detector.tracks().size(), 1);
+    GTEST_ASSERT_EQ(first[0].fit_error, independent[0].fit_error);
+
+    // The same sign on the next frame is fitted from the previous parameters for its sign type only
+    const std::vector< detection::Detection > second = detector.detect(input_image);
+    GTEST_ASSERT_EQ(second.size(), 1);
+    ASSERT_TRUE(second[0].warm_started);
+    GTEST_ASSERT_EQ(second[0].sign_type, first[0].sign_type);
+    GTEST_ASSERT_LE(second[0].fit_error, WARM_START_MAX_ERROR_RATIO * first[0].fit_error);
+    const std::vector< detection::FitTiming >& timings = detector.fit_timings();
+    GTEST_ASSERT_EQ(timings.size(), NB_SIGN_TYPES);
+    for (int sign_type = 0; sign_type < NB_SIGN_TYPES; sign_type++) {
+        GTEST_ASSERT_EQ(timings[sign_type].warm_start, sign_type == first[0].sign_type);
+        GTEST_ASSERT_EQ(timings[sign_type].mass_center_ms, 0.0);
+    }
+
+    // Leaving the video mode forgets the previous frame
+    detector.set_video_mode(false);
+    GTEST_ASSERT_EQ(detector.tracks().size(), 0);
+    ASSERT_FALSE(detector.detect(input_image)[0].warm_started);
+}
+
+TEST(integration, branchAndBoundKeepsTheBestSignType)
+{
 
-    const float errThresh = 1e10-4;
+    std::string input_filename(TEST_DATA_DIR);
+    input_filename.append("/octogonal0017.jpg");
+    cv::Mat input_image = cv::imread(input_filename);
+    ASSERT_TRUE( input_image.data != NULL);
 
-    GTEST_ASSERT_LE(std::abs(massCenters[0].x_offset - 0.0077245), errThresh);
-    GTEST_ASSERT_LE(std::abs(massCenters[0].y_offset - 0.0f), errThresh);
-    GTEST_ASSERT_LE(std::abs(massCenters[0].z_offset), errThresh);
-    GTEST_ASSERT_LE(std::abs(massCenters[0].a - 0.88557), errThresh);
-    GTEST_ASSERT_LE(std::abs(massCenters[0].b - 0.869246), errThresh);
-    GTEST_ASSERT_LE(std::abs(massCenters[0].theta_offset - 0.738422), errThresh);
-    GTEST_ASSERT_LE(std::abs(massCenters[0].phi_offset - 0.0f), errThresh);
+    detection::TrafficSignDetector exhaustive;
+    exhaustive.set_branch_and_bound(false);
+    const std::vector< detection::Detection > expected = exhaustive.detect(input_image);
+    long exhaustive_iterations = 0;
+    for (const detection::FitTiming& timing : exhaustive.fit_timings()) {
+        ASSERT_FALSE(timing.abandoned);
+        exhaustive_iterations += timing.iterations;
+    }
+
+    detection::TrafficSignDetector bounded;
+    bounded.set_branch_and_bound(true);
+    const std::vector< detection::Detection > detections = bounded.detect(input_image);
+    long bounded_iterations = 0;
+    for (const detection::FitTiming& timing : bounded.fit_timings())
+        bounded_iterations += timing.iterations;
+
+    // The winning hypothesis runs to completion in both cases
+    GTEST_ASSERT_EQ(detections.size(), expected.size());
+    for (size_t i = 0; i < detections.size(); ++i) {
+        GTEST_ASSERT_EQ(detections[i].sign_type, expected[i].sign_type);
+        GTEST_ASSERT_EQ(detections[i].fit_error, expected[i].fit_error);
+    }
+    GTEST_ASSERT_LE(bounded_iterations, exhaustive_iterations);
 }
 
+TEST(integration, topKFitsTheMostPlausibleSignTypes)
+{
+
+    std::string input_filename(TEST_DATA_DIR);
+    input_filename.append("/octogonal0017.jpg");
+    cv::Mat input_image = cv::imread(input_filename);
+    ASSERT_TRUE( input_image.data != NULL);
+
+    for (int top_k = 1; top_k <= NB_SIGN_TYPES; top_k++) {
+        detection::TrafficSignDetector detector;
+        detector.set_top_k(top_k);
+        detector.set_branch_and_bound(false);
+        const std::vector< detection::Detection > detections = detector.detect(input_image);
+        GTEST_ASSERT_EQ(detections.size(), 1);
+
+        // Only the top k ranked sign types are fitted, and the detection is one of them
+        const std::vector< int >& ranking = detector.sign_type_rankings();
+        GTEST_ASSERT_EQ(ranking.size(), NB_SIGN_TYPES);
+        const std::vector< detection::FitTiming >& timings = detector.fit_timings();
+        for (int rank = 0; rank < NB_SIGN_TYPES; rank++)
+            GTEST_ASSERT_EQ(timings[ranking[rank]].iterations > 0, rank < top_k);
+        const int detected_rank = static_cast<int> (std::find(ranking.begin(), ranking.end(), detections[0].sign_type) - ranking.begin());
+        GTEST_ASSERT_LT(detected_rank, top_k);
+    }
+}
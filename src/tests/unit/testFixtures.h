@@ -0,0 +1,98 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+
+#pragma once
+
+// our own code
+#include <common/math_utils.h>
+#include <common/SuperFormula.h>
+#include <common/parallel.h>
+
+// stl library
+#include <vector>
+#include <cmath>
+
+// OpenCV library
+#include <opencv2/opencv.hpp>
+
+// Synthetic data and helpers shared by the tests and the benchmarks
+namespace fixtures {
+
+  // Restore the default thread count at the end of a test, also when an assertion returns early
+  struct ThreadCountGuard {
+    ~ThreadCountGuard() { parallel::set_num_threads(0); }
+  };
+
+  // n_points of the curve with a sinusoidal noise of 1% on the radius, rotated by 0.2 rad and shifted by
+  // (0.05, -0.03)
+  inline void noisy_contour(const SuperShapeParams& params, const int n_points, std::vector< Vector2d, aligned_allocator< Vector2d> > & Data)
+  {
+    Data.clear();
+    for (int i = 0; i < n_points; i++) {
+      const double tht = 2. * PI * i / n_points;
+      const double r = supershape::radius(params, tht) * (1. + 0.01 * std::sin(37. * tht));
+      Data.push_back(Vector2d(r * std::cos(tht + 0.2) + 0.05, r * std::sin(tht + 0.2) - 0.03));
+    }
+  }
+
+  // Red octagon with a vertex at pi / 8, as a stop sign, drawn on a BGR image. The unit octagon is mapped by linear,
+  // scaled by radius and centred on center. The outline receives n_steps points per edge.
+  inline void draw_octagon(cv::Mat& image, const cv::Point2d& center, const double radius, std::vector< cv::Point >& outline,
+                           const int n_steps = 1, const cv::Matx22d& linear = cv::Matx22d::eye())
+  {
+    outline.clear();
+    for (int vertex = 0; vertex < 8; vertex++) {
+      const double angle_0 = M_PI / 8.0 + vertex * M_PI / 4.0;
+      const double angle_1 = angle_0 + M_PI / 4.0;
+      for (int step = 0; step < n_steps; step++) {
+        const double t = static_cast<double> (step) / n_steps;
+        const cv::Vec2d point = linear * cv::Vec2d(radius * ((1.0 - t) * std::cos(angle_0) + t * std::cos(angle_1)),
+                                                   radius * ((1.0 - t) * std::sin(angle_0) + t * std::sin(angle_1)));
+        outline.push_back(cv::Point(cvRound(center.x + point[0]), cvRound(center.y + point[1])));
+      }
+    }
+    cv::fillPoly(image, std::vector< std::vector< cv::Point > >(1, outline), cv::Scalar(30, 30, 200));
+  }
+
+}
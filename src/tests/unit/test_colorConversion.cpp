@@ -0,0 +1,180 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+// our own code
+#include <common/colorConversion.h>
+#include <common/simd.h>
+
+// stl library
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstring>
+
+// OpenCV library
+#include <opencv2/opencv.hpp>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+  const char* test_images[] = { "circular0009.jpg", "different0011.jpg", "different0035.jpg",
+                                "octogonal0010.jpg", "octogonal0017.jpg", "triangular0016.jpg" };
+
+  cv::Mat read_test_image(const std::string& name) {
+    std::string input_filename(TEST_DATA_DIR);
+    input_filename.append("/").append(name);
+    return cv::imread(input_filename);
+  }
+
+  // Compare the vectorized conversion against the reference: saturation and luminance have to be
+  // identical, the hue may differ by one level because of the approximated acos
+  void expect_close_to_reference(const cv::Mat& input_image, const simd::Level level) {
+    cv::Mat reference, converted;
+    colorconversion::convert_rgb_to_ihls(input_image, reference);
+    colorconversion::convert_rgb_to_ihls_simd(input_image, converted, level);
+
+    ASSERT_EQ(reference.size(), converted.size());
+    ASSERT_EQ(reference.type(), converted.type());
+
+    std::vector< cv::Mat > reference_channels, converted_channels;
+    cv::split(reference, reference_channels);
+    cv::split(converted, converted_channels);
+
+    EXPECT_EQ(0, cv::countNonZero(reference_channels[0] != converted_channels[0])) << "saturation, " << simd::level_name(level);
+    EXPECT_EQ(0, cv::countNonZero(reference_channels[1] != converted_channels[1])) << "luminance, " << simd::level_name(level);
+
+    cv::Mat hue_diff;
+    cv::absdiff(reference_channels[2], converted_channels[2], hue_diff);
+    double max_hue_diff = 0.0;
+    cv::minMaxLoc(hue_diff, NULL, &max_hue_diff);
+    EXPECT_LE(max_hue_diff, 1.0) << "hue, " << simd::level_name(level);
+  }
+
+}
+
+TEST(colorConversion, approxAcosErrorIsBounded)
+{
+  // Dense sampling of [-1, 1] including both ends
+  const int n_samples = 2000001;
+  double max_error = 0.0;
+  for (int i = 0; i < n_samples; i++) {
+    const float x = -1.0f + 2.0f * static_cast<float> (i) / static_cast<float> (n_samples - 1);
+    const double error = std::fabs(static_cast<double> (colorconversion::approx_acos(x)) - std::acos(static_cast<double> (x)));
+    if (error > max_error)
+      max_error = error;
+  }
+
+  // 5e-7 rad is below a thousandth of a hue level
+  EXPECT_LT(max_error, 5e-7);
+}
+
+TEST(colorConversion, simdIhlsMatchesReferenceOnTestImages)
+{
+  for (const char* name : test_images) {
+    cv::Mat input_image = read_test_image(name);
+    ASSERT_TRUE(input_image.data != NULL) << name;
+
+    for (int level = simd::LEVEL_SCALAR; level <= simd::detected_level(); level++)
+      expect_close_to_reference(input_image, static_cast<simd::Level> (level));
+  }
+}
+
+TEST(colorConversion, simdIhlsMatchesReferenceOnRandomImage)
+{
+  // Odd width to exercise the tail of the chunks and of the vectors
+  cv::Mat input_image(61, 203, CV_8UC3);
+  cv::randu(input_image, cv::Scalar::all(0), cv::Scalar::all(256));
+
+  // Grey pixels have an undefined hue
+  input_image.row(0).setTo(cv::Scalar::all(128));
+
+  for (int level = simd::LEVEL_SCALAR; level <= simd::detected_level(); level++)
+    expect_close_to_reference(input_image, static_cast<simd::Level> (level));
+}
+
+TEST(colorConversion, simdIhlsInPlace)
+{
+  cv::Mat input_image(17, 45, CV_8UC3);
+  cv::randu(input_image, cv::Scalar::all(0), cv::Scalar::all(256));
+
+  cv::Mat expected;
+  colorconversion::convert_rgb_to_ihls_simd(input_image, expected);
+  cv::Mat in_place = input_image.clone();
+  colorconversion::convert_rgb_to_ihls_simd(in_place, in_place);
+
+  EXPECT_EQ(0, cv::countNonZero((expected != in_place).reshape(1)));
+}
+
+TEST(colorConversion, logChromaticTableMatchesLog)
+{
+  const float* table = colorconversion::log_chromatic_table();
+  for (int g = 0; g < 256; g++) {
+    const float division = 1.0f / static_cast<float> (g == 0 ? 1 : g);
+    for (int c = 0; c < 256; c++) {
+      const float expected = std::log(static_cast<float> (c) * division);
+      // -inf for a null channel, exact otherwise
+      EXPECT_EQ(expected, table[colorconversion::log_chromatic_index(static_cast<uchar> (c), static_cast<uchar> (g))]) << c << " / " << g;
+    }
+  }
+}
+
+TEST(colorConversion, logRbLevelsAreIdentical)
+{
+  // Odd width to exercise the tail of the vectors
+  cv::Mat input_image(37, 211, CV_8UC3);
+  cv::randu(input_image, cv::Scalar::all(0), cv::Scalar::all(256));
+
+  std::vector< cv::Mat > reference;
+  colorconversion::rgb_to_log_rb(input_image, reference, simd::LEVEL_SCALAR);
+  ASSERT_EQ(2u, reference.size());
+
+  for (int level = simd::LEVEL_SCALAR + 1; level <= simd::detected_level(); level++) {
+    std::vector< cv::Mat > converted;
+    colorconversion::rgb_to_log_rb(input_image, converted, static_cast<simd::Level> (level));
+    ASSERT_EQ(2u, converted.size());
+    // Bitwise comparison, the log of a null channel is -inf
+    for (int k = 0; k < 2; k++)
+      EXPECT_EQ(0, std::memcmp(reference[k].data, converted[k].data, reference[k].total() * reference[k].elemSize())) << simd::level_name(static_cast<simd::Level> (level));
+  }
+}
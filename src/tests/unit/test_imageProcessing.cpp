@@ -0,0 +1,192 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+// our own code
+#include <common/imageProcessing.h>
+#include <common/segmentation.h>
+
+// stl library
+#include <string>
+#include <vector>
+
+// OpenCV library
+#include <opencv2/opencv.hpp>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+  const char* test_images[] = { "circular0009.jpg", "different0011.jpg", "different0035.jpg",
+                                "octogonal0010.jpg", "octogonal0017.jpg", "triangular0016.jpg" };
+
+  cv::Mat read_test_image(const std::string& name) {
+    std::string input_filename(TEST_DATA_DIR);
+    input_filename.append("/").append(name);
+    return cv::imread(input_filename);
+  }
+
+  // Compare the labelled extraction with the reference one -- cv::findContours modifies its input
+  void expect_same_extraction(const cv::Mat& bin_image, const std::string& name) {
+    std::vector< std::vector< cv::Point > > reference, contours;
+    cv::Mat reference_input = bin_image.clone();
+    imageprocessing::contours_extraction_traced(reference_input, reference);
+    imageprocessing::contours_extraction(bin_image, contours);
+
+    ASSERT_EQ(reference.size(), contours.size()) << name;
+    for (size_t i = 0; i < reference.size(); i++)
+      EXPECT_TRUE(reference[i] == contours[i]) << name << " contour " << i;
+  }
+
+  // Binary image with objects in the holes of other ones, in their concavities and on the border of the image
+  cv::Mat cluttered_image(const cv::Size& size, const int n_blobs) {
+    cv::Mat bin_image = cv::Mat::zeros(size, CV_8UC1);
+    cv::RNG rng(7);
+    for (int k = 0; k < n_blobs; k++) {
+      const cv::Point center(rng.uniform(0, size.width), rng.uniform(0, size.height));
+      const int radius = rng.uniform(6, 40);
+      switch (k % 4) {
+      case 0:
+        cv::circle(bin_image, center, radius, cv::Scalar(255), -1);
+        break;
+      case 1:
+        // Ring with a smaller object in its hole
+        cv::circle(bin_image, center, radius, cv::Scalar(255), 3);
+        cv::circle(bin_image, center, radius / 3, cv::Scalar(255), -1);
+        break;
+      case 2:
+        // Open ring with an object in its concavity
+        cv::ellipse(bin_image, center, cv::Size(radius, radius), 0, 45, 315, cv::Scalar(255), 3);
+        cv::circle(bin_image, center, radius / 3, cv::Scalar(255), -1);
+        break;
+      default:
+        cv::rectangle(bin_image, center, center + cv::Point(radius, radius), cv::Scalar(255), -1);
+        break;
+      }
+    }
+    return bin_image;
+  }
+
+}
+
+TEST(imageProcessing, pixelRunsMatchOnAllLevels)
+{
+  cv::RNG rng(3);
+  // Odd lengths to exercise the tail of the vectors
+  const int lengths[] = { 1, 15, 16, 33, 97, 640 };
+  for (const int n : lengths) {
+    for (int trial = 0; trial < 50; trial++) {
+      // Runs of random lengths
+      std::vector< uchar > row(n);
+      uchar value = static_cast<uchar> (rng.uniform(0, 2) * 255);
+      for (int j = 0; j < n; j++) {
+        if (rng.uniform(0, 4) == 0)
+          value = 255 - value;
+        row[j] = value;
+      }
+
+      std::vector< int > reference;
+      for (int j = 0; j < n; j++)
+        if ((row[j] != 0) != (j > 0 && row[j - 1] != 0))
+          reference.push_back(j);
+      if (row[n - 1] != 0)
+        reference.push_back(n);
+
+      for (int level = simd::LEVEL_SCALAR; level <= simd::detected_level(); level++) {
+        std::vector< int > bounds(n + 1);
+        const int n_bounds = imageprocessing::pixel_runs_row_simd(row.data(), n, bounds.data(), static_cast<simd::Level> (level));
+        bounds.resize(n_bounds);
+        EXPECT_TRUE(reference == bounds) << "length " << n << ", " << simd::level_name(static_cast<simd::Level> (level));
+      }
+    }
+  }
+}
+
+TEST(imageProcessing, labelStatsMatchFloodFill)
+{
+  const cv::Mat bin_image = cluttered_image(cv::Size(331, 257), 60);
+  imageprocessing::ComponentLabels labels;
+  imageprocessing::label_components(bin_image, labels);
+
+  int total_area = 0;
+  for (size_t label = 0; label < labels.stats.size(); label++) {
+    const imageprocessing::ComponentStats& stats = labels.stats[label];
+    total_area += stats.area;
+
+    // Component grown from its first pixel
+    const imageprocessing::PixelRun& first = labels.runs[stats.first_run];
+    cv::Mat mask = cv::Mat::zeros(bin_image.rows + 2, bin_image.cols + 2, CV_8UC1);
+    cv::Rect bbox;
+    cv::floodFill(bin_image, mask, cv::Point(first.begin, first.row), cv::Scalar(), &bbox, cv::Scalar(), cv::Scalar(),
+                  8 | cv::FLOODFILL_MASK_ONLY | (255 << 8));
+    const cv::Moments moments = cv::moments(mask(cv::Rect(1, 1, bin_image.cols, bin_image.rows)), true);
+
+    EXPECT_EQ(bbox, stats.bbox) << label;
+    EXPECT_EQ(moments.m00, stats.area) << label;
+    EXPECT_NEAR(moments.m10, stats.m10, 1e-6 * moments.m10) << label;
+    EXPECT_NEAR(moments.m01, stats.m01, 1e-6 * moments.m01) << label;
+    EXPECT_NEAR(moments.m20, stats.m20, 1e-6 * moments.m20) << label;
+    EXPECT_NEAR(moments.m11, stats.m11, 1e-6 * moments.m11) << label;
+    EXPECT_NEAR(moments.m02, stats.m02, 1e-6 * moments.m02) << label;
+  }
+  EXPECT_EQ(cv::countNonZero(bin_image), total_area);
+}
+
+TEST(imageProcessing, extractionMatchesTracedOnTestImages)
+{
+  for (const char* name : test_images) {
+    cv::Mat input_image = read_test_image(name);
+    ASSERT_TRUE(input_image.data != NULL) << name;
+
+    cv::Mat seg_image, bin_image;
+    segmentation::seg_fused_rgb(input_image, seg_image, 0);
+    imageprocessing::filter_image(seg_image, bin_image);
+    expect_same_extraction(bin_image, name);
+  }
+}
+
+TEST(imageProcessing, extractionMatchesTracedOnClutteredImage)
+{
+  expect_same_extraction(cluttered_image(cv::Size(640, 480), 400), "cluttered");
+  // Large objects which pass the area check
+  expect_same_extraction(cluttered_image(cv::Size(160, 120), 40), "small cluttered");
+}
@@ -0,0 +1,259 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+#include <common/levenbergMarquardt.h>
+#include <tests/unit/testFixtures.h>
+
+#include <Eigen/Cholesky>
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+  // Noisy octagon, shifted and rotated
+  std::vector< Vector2d, aligned_allocator< Vector2d> > octagon_points()
+  {
+    std::vector< Vector2d, aligned_allocator< Vector2d> > data;
+    fixtures::noisy_contour(RationalSuperShape2D(0.9, 0.87, 3.0, 5.0, 5.0, 8.0, 1.0).Parameters, 400, data);
+    return data;
+  }
+
+  // Optimize5D as it was before the fits were unified: dynamic matrices, damping of the diagonal only
+  void baseline_optimize_5d(RationalSuperShape2D& RS, const std::vector< Vector2d, aligned_allocator< Vector2d> > & Data, double& err)
+  {
+    const double LAMBDA_INCR(10);
+    double lambda(std::pow(LAMBDA_INCR, -6));
+    double NewChiSquare(1e15), ChiSquare(1e15), OldChiSquare(1e15);
+    bool STOP(false);
+    Matrix< double, 5, 5 > alpha_fixed;
+    Matrix< double, 5, 1 > beta_fixed;
+
+    for (int itnum = 0; itnum < 1000 && STOP == false; itnum++) {
+      const SuperShapeParams oldparams(RS.Parameters);
+      ChiSquare = RS.XiSquare< 5 >(Data, alpha_fixed, beta_fixed, 1, true);
+      MatrixXd alpha(alpha_fixed);
+      VectorXd beta(beta_fixed);
+      for (int k = 0; k < 5; k++) {
+        alpha(k, k) *= 1. + lambda;
+        alpha(k, k) += lambda;
+      }
+      alpha.ldlt().solveInPlace(beta);
+
+      const SuperShapeParams& Parameters = RS.Parameters;
+      const bool outofbounds =
+              Parameters[0] + beta[0] < 0.01 || Parameters[0] + beta[0] > 1000 ||
+              Parameters[1] + beta[1] < 0.01 || Parameters[1] + beta[1] > 1000 ||
+              Parameters[2] + beta[2] < 0.1  || Parameters[2] + beta[2] > 1000 ||
+              Parameters[3] + beta[3] < 0.1 || Parameters[3] + beta[3] > 1000 ||
+              Parameters[4] + beta[4] < 0.1 || Parameters[4] + beta[4] > 1000;
+      if (!outofbounds) {
+        RS.Set_a(Parameters[0] + beta[0]);
+        RS.Set_b(Parameters[1] + beta[1]);
+        RS.Set_n1(Parameters[2] + beta[2]);
+        RS.Set_n2(Parameters[3] + beta[3]);
+        RS.Set_n3(Parameters[4] + beta[4]);
+      }
+
+      OldChiSquare = ChiSquare;
+      NewChiSquare = RS.XiSquare< 5 >(Data, alpha_fixed, beta_fixed, 1, false);
+      if (NewChiSquare > 0.999 * OldChiSquare) {
+        lambda *= LAMBDA_INCR;
+        RS.Parameters = oldparams;
+      }
+      else if (NewChiSquare <= 0.01 * OldChiSquare) {
+        lambda *= LAMBDA_INCR;
+        RS.Parameters = oldparams;
+      }
+      else
+        lambda /= LAMBDA_INCR;
+      STOP = lambda > 1e15 || NewChiSquare < 1e-5;
+    }
+    err = ChiSquare;
+  }
+
+}
+
+TEST(levenbergMarquardt, fixedLDLTMatchesEigen)
+{
+  for (int trial = 0; trial < 100; trial++) {
+    // Normal equations as built by the fit: a 5x5 block, damped with lambda everywhere
+    const Matrix< double, 5, 5 > J(Matrix< double, 5, 5 >::Random());
+    const double lambda = std::pow(10.0, trial % 20 - 6);
+    Matrix< double, 8, 8 > A(Matrix< double, 8, 8 >::Zero());
+    A.topLeftCorner< 5, 5 >() = J * J.transpose();
+    A *= 1. + lambda;
+    A.array() += lambda;
+    const Matrix< double, 8, 1 > b(Matrix< double, 8, 1 >::Random());
+
+    Matrix< double, 8, 1 > x(b);
+    supershape::FixedLDLT< 8 >(A).solve_in_place(x);
+
+    const VectorXd expected(MatrixXd(A).ldlt().solve(VectorXd(b)));
+    for (int i = 0; i < 8; i++)
+      EXPECT_NEAR(expected[i], x[i], 1e-12 * (1.0 + std::abs(expected[i]))) << "trial " << trial;
+  }
+}
+
+TEST(levenbergMarquardt, fitsReduceTheError)
+{
+  const std::vector< Vector2d, aligned_allocator< Vector2d> > data(octagon_points());
+
+  RationalSuperShape2D start(1.0, 1.0, 2.0, 2.0, 2.0, 8.0, 1.0, 0.15, 0.0, 0.0, 0.0, 0.0);
+  Matrix< double, 5, 5 > alpha;
+  Matrix< double, 5, 1 > beta;
+  const double initial_error = start.XiSquare< 5 >(data, alpha, beta);
+
+  double errors[3];
+  RationalSuperShape2D RS5(start), RS7(start), RS8(start);
+  RS5.Optimize5D(data, errors[0]);
+  RS7.Optimize7D(data, errors[1]);
+  RS8.Optimize8D(data, errors[2]);
+
+  for (int i = 0; i < 3; i++)
+    EXPECT_LT(errors[i], initial_error);
+}
+
+TEST(levenbergMarquardt, fit5DMatchesTheBaseline)
+{
+  const std::vector< Vector2d, aligned_allocator< Vector2d> > data(octagon_points());
+
+  const RationalSuperShape2D starts[] = {
+    RationalSuperShape2D(1.0, 1.0, 2.0, 2.0, 2.0, 8.0, 1.0, 0.15, 0.0, 0.0, 0.0, 0.0),
+    RationalSuperShape2D(0.8, 1.2, 4.0, 3.0, 6.0, 8.0, 1.0, 0.3, 0.0, 0.01, -0.02, 0.0),
+    RationalSuperShape2D(1.5, 0.6, 1.5, 8.0, 2.5, 8.0, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0)
+  };
+  for (int s = 0; s < 3; s++) {
+    RationalSuperShape2D RS(starts[s]), baseline(starts[s]);
+    double error, baseline_error;
+    RS.Optimize5D(data, error);
+    baseline_optimize_5d(baseline, data, baseline_error);
+
+    // FixedLDLT and Eigen's LDLT may round the last bits differently
+    EXPECT_NEAR(baseline_error, error, 1e-9 * baseline_error) << "start " << s;
+    for (size_t i = 0; i < RS.Parameters.size(); i++)
+      EXPECT_NEAR(baseline.Parameters[i], RS.Parameters[i], 1e-9 * (1.0 + std::abs(baseline.Parameters[i]))) << "start " << s << ", parameter " << i;
+  }
+}
+
+TEST(levenbergMarquardt, observerLogsEveryAcceptedStep)
+{
+  const std::vector< Vector2d, aligned_allocator< Vector2d> > data(octagon_points());
+
+  RationalSuperShape2D RS(1.0, 1.0, 2.0, 2.0, 2.0, 8.0, 1.0, 0.15, 0.0, 0.0, 0.0, 0.0);
+  RationalSuperShape2D silent(RS);
+
+  std::ostringstream log;
+  supershape::StreamFitObserver observer(log);
+  double error, silent_error;
+  supershape::levenberg_marquardt< 8 >(RS, data, error, 1, observer);
+  supershape::levenberg_marquardt< 8 >(silent, data, silent_error, 1);
+
+  // the observer does not change the fit
+  EXPECT_EQ(silent_error, error);
+  for (size_t i = 0; i < RS.Parameters.size(); i++)
+    EXPECT_EQ(silent.Parameters[i], RS.Parameters[i]);
+
+  // initial curve, at least one accepted step, final curve
+  std::istringstream lines(log.str());
+  std::string line;
+  int n_lines = 0;
+  while (std::getline(lines, line))
+    n_lines++;
+  EXPECT_GE(n_lines, 3);
+
+  std::ostringstream last;
+  last << RS;
+  EXPECT_EQ(last.str(), log.str().substr(log.str().size() - last.str().size()));
+}
+
+TEST(levenbergMarquardt, batchedXiSquareMatchesXiSquare)
+{
+  const std::vector< Vector2d, aligned_allocator< Vector2d> > data(octagon_points());
+  supershape::PointBatch batch;
+  batch.assign(data);
+
+  const RationalSuperShape2D RS(0.95, 0.9, 2.5, 4.0, 4.5, 8.0, 1.0, 0.3, 0.0, 0.02, -0.01, 0.0);
+  for (int function_used = 1; function_used <= 3; function_used++) {
+    Matrix< double, 8, 8 > alpha, alpha_batch;
+    Matrix< double, 8, 1 > beta, beta_batch;
+    const double chi = RS.XiSquare< 8 >(data, alpha, beta, function_used, true);
+
+    // the batched evaluation does the same operations
+    const double chi_batch = supershape::xi_square_batch< 8 >(RS.Parameters, batch, alpha_batch, beta_batch, function_used, true);
+    EXPECT_EQ(chi, chi_batch);
+    EXPECT_TRUE(alpha == alpha_batch) << "implicit function " << function_used;
+    EXPECT_TRUE(beta == beta_batch) << "implicit function " << function_used;
+  }
+}
+
+TEST(levenbergMarquardt, boundAbandonsLosingFits)
+{
+  const std::vector< Vector2d, aligned_allocator< Vector2d> > data(octagon_points());
+
+  // an infinite bound only counts the iterations
+  RationalSuperShape2D RS(1.0, 1.0, 2.0, 2.0, 2.0, 8.0, 1.0, 0.15, 0.0, 0.0, 0.0, 0.0);
+  RationalSuperShape2D unbounded(RS);
+  double error, unbounded_error;
+  supershape::BoundFitObserver observer(std::numeric_limits<double>::infinity(), 2.0, 10);
+  supershape::levenberg_marquardt< 8 >(RS, data, error, 1, observer);
+  supershape::levenberg_marquardt< 8 >(unbounded, data, unbounded_error, 1);
+  EXPECT_EQ(unbounded_error, error);
+  for (size_t i = 0; i < RS.Parameters.size(); i++)
+    EXPECT_EQ(unbounded.Parameters[i], RS.Parameters[i]);
+  EXPECT_FALSE(observer.abandoned());
+  EXPECT_GT(observer.iterations(), 10);
+
+  // a bound below the reachable chi-square stops the fit right after the minimum number of iterations
+  RationalSuperShape2D bounded(1.0, 1.0, 2.0, 2.0, 2.0, 8.0, 1.0, 0.15, 0.0, 0.0, 0.0, 0.0);
+  supershape::BoundFitObserver losing(0.1 * error, 2.0, 10);
+  double bounded_error;
+  supershape::levenberg_marquardt< 8 >(bounded, data, bounded_error, 1, losing);
+  EXPECT_TRUE(losing.abandoned());
+  EXPECT_EQ(11, losing.iterations());
+}
@@ -0,0 +1,244 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+// our own code
+#include <common/parallel.h>
+#include <common/colorConversion.h>
+#include <common/segmentation.h>
+#include <common/imageProcessing.h>
+#include <common/smartOptimisation.h>
+#include <tests/unit/testFixtures.h>
+
+// stl library
+#include <string>
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+#include <cstring>
+#include <thread>
+#include <chrono>
+
+// OpenCV library
+#include <opencv2/opencv.hpp>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+  const char* test_images[] = { "circular0009.jpg", "different0011.jpg", "different0035.jpg",
+                                "octogonal0010.jpg", "octogonal0017.jpg", "triangular0016.jpg" };
+
+  cv::Mat read_test_image(const std::string& name) {
+    std::string input_filename(TEST_DATA_DIR);
+    input_filename.append("/").append(name);
+    return cv::imread(input_filename);
+  }
+
+  // Thread counts compared with the serial path
+  const int thread_counts[] = { 2, 3, 8 };
+
+  bool identical(const cv::Mat& a, const cv::Mat& b) {
+    if (a.size() != b.size() || a.type() != b.type())
+      return false;
+    // Bitwise comparison, valid for the float images too
+    for (int i = 0; i < a.rows; i++)
+      if (std::memcmp(a.ptr(i), b.ptr(i), a.cols * a.elemSize()) != 0)
+        return false;
+    return true;
+  }
+
+}
+
+TEST(parallel, poolRunsEachTaskOnce)
+{
+  parallel::ThreadPool pool(3);
+  for (const int n_tasks : { 0, 1, 2, 7, 100 }) {
+    std::vector< std::atomic<int> > counts(n_tasks);
+    for (auto& count : counts)
+      count = 0;
+    pool.run(n_tasks, [&](const int k) { counts[k]++; });
+    for (int k = 0; k < n_tasks; k++)
+      EXPECT_EQ(1, counts[k].load()) << "task " << k << " of " << n_tasks;
+  }
+}
+
+TEST(parallel, poolRethrowsAndNestedRunsSerially)
+{
+  parallel::ThreadPool pool(2);
+  EXPECT_THROW(pool.run(10, [](const int k) { if (k == 5) throw std::runtime_error("task failed"); }), std::runtime_error);
+
+  // The pool is still usable and a nested call does not dead lock
+  std::atomic<int> n_inner(0);
+  pool.run(4, [&](const int) { pool.run(3, [&](const int) { n_inner++; }); });
+  EXPECT_EQ(12, n_inner.load());
+}
+
+TEST(parallel, rowBandsCoverEveryRowOnce)
+{
+  fixtures::ThreadCountGuard guard;
+  for (const int n_threads : { 1, 4, 16 }) {
+    parallel::set_num_threads(n_threads);
+    for (const int n_rows : { 1, 7, 8, 100, 1080, 2160 }) {
+      std::vector< int > counts(n_rows, 0);
+      parallel::parallel_for_rows(n_rows, [&](const int row_begin, const int row_end) {
+          for (int i = row_begin; i < row_end; i++)
+            counts[i]++;
+        });
+      EXPECT_EQ(std::vector< int >(n_rows, 1), counts) << n_threads << " threads, " << n_rows << " rows";
+    }
+  }
+}
+
+TEST(parallel, fullFrameStagesMatchSerial)
+{
+  fixtures::ThreadCountGuard guard;
+  for (const char* name : test_images) {
+    cv::Mat input_image = read_test_image(name);
+    ASSERT_TRUE(input_image.data != NULL) << name;
+
+    // Serial results
+    parallel::set_num_threads(1);
+    cv::Mat ihls_serial, ihls_simd_serial, seg_serial, cascade_serial, bin_serial;
+    std::vector< cv::Mat > log_serial;
+    colorconversion::convert_rgb_to_ihls(input_image, ihls_serial);
+    colorconversion::convert_rgb_to_ihls_simd(input_image, ihls_simd_serial);
+    colorconversion::rgb_to_log_rb(input_image, log_serial);
+    segmentation::seg_fused_rgb(input_image, seg_serial);
+    segmentation::CascadeStats stats_serial;
+    segmentation::seg_norm_hue_cascade(input_image, cascade_serial, 0, R_HUE_MAX, R_HUE_MIN, R_SAT_MIN, &stats_serial);
+    imageprocessing::filter_image(seg_serial, bin_serial);
+
+    for (const int n_threads : thread_counts) {
+      parallel::set_num_threads(n_threads);
+      cv::Mat ihls, ihls_simd, seg, cascade, bin;
+      std::vector< cv::Mat > log_image;
+      colorconversion::convert_rgb_to_ihls(input_image, ihls);
+      colorconversion::convert_rgb_to_ihls_simd(input_image, ihls_simd);
+      colorconversion::rgb_to_log_rb(input_image, log_image);
+      segmentation::seg_fused_rgb(input_image, seg);
+      segmentation::CascadeStats stats;
+      segmentation::seg_norm_hue_cascade(input_image, cascade, 0, R_HUE_MAX, R_HUE_MIN, R_SAT_MIN, &stats);
+      imageprocessing::filter_image(seg, bin);
+
+      EXPECT_TRUE(identical(ihls_serial, ihls)) << name << ", " << n_threads << " threads";
+      EXPECT_TRUE(identical(ihls_simd_serial, ihls_simd)) << name << ", " << n_threads << " threads";
+      EXPECT_TRUE(identical(log_serial[0], log_image[0]) && identical(log_serial[1], log_image[1])) << name << ", " << n_threads << " threads";
+      EXPECT_TRUE(identical(seg_serial, seg)) << name << ", " << n_threads << " threads";
+      EXPECT_TRUE(identical(cascade_serial, cascade)) << name << ", " << n_threads << " threads";
+      EXPECT_EQ(stats_serial.n_saturation_rejected, stats.n_saturation_rejected);
+      EXPECT_EQ(stats_serial.n_hue_accepted, stats.n_hue_accepted);
+      EXPECT_TRUE(identical(bin_serial, bin)) << name << ", " << n_threads << " threads";
+    }
+  }
+}
+
+TEST(parallel, votingMatchesSerial)
+{
+  fixtures::ThreadCountGuard guard;
+  for (const char* name : test_images) {
+    cv::Mat input_image = read_test_image(name);
+    ASSERT_TRUE(input_image.data != NULL) << name;
+
+    // Central part of the image, where the signs are
+    const cv::Rect roi(input_image.cols / 4, input_image.rows / 4, input_image.cols / 2, input_image.rows / 2);
+    const cv::Mat roi_image = input_image(roi).clone();
+
+    for (const int edges_number : { 3, 4, 8, 12 }) {
+      parallel::set_num_threads(1);
+      const cv::Point2f center_serial = initopt::radial_symmetry_detector(roi_image, 20, edges_number);
+
+      for (const int n_threads : thread_counts) {
+        parallel::set_num_threads(n_threads);
+        const cv::Point2f center = initopt::radial_symmetry_detector(roi_image, 20, edges_number);
+        EXPECT_EQ(center_serial.x, center.x) << name << ", " << edges_number << " edges, " << n_threads << " threads";
+        EXPECT_EQ(center_serial.y, center.y) << name << ", " << edges_number << " edges, " << n_threads << " threads";
+      }
+    }
+  }
+}
+
+TEST(parallel, privateIntegerVotingMatchesSerial)
+{
+  fixtures::ThreadCountGuard guard;
+  for (const char* name : test_images) {
+    cv::Mat input_image = read_test_image(name);
+    ASSERT_TRUE(input_image.data != NULL) << name;
+
+    const cv::Rect roi(input_image.cols / 4, input_image.rows / 4, input_image.cols / 2, input_image.rows / 2);
+    initopt::GradientField field;
+    initopt::gradient_field(input_image(roi).clone(), field);
+
+    for (const int edges_number : { 3, 4, 8, 12 }) {
+      parallel::set_num_threads(1);
+      const cv::Point2f center_serial = initopt::radial_symmetry_voting(field, 20, edges_number, initopt::VOTES_PRIVATE_INTEGER);
+
+      for (const int n_threads : thread_counts) {
+        parallel::set_num_threads(n_threads);
+        const cv::Point2f center = initopt::radial_symmetry_voting(field, 20, edges_number, initopt::VOTES_PRIVATE_INTEGER);
+        EXPECT_EQ(center_serial.x, center.x) << name << ", " << edges_number << " edges, " << n_threads << " threads";
+        EXPECT_EQ(center_serial.y, center.y) << name << ", " << edges_number << " edges, " << n_threads << " threads";
+      }
+    }
+  }
+}
+
+TEST(parallel, stealingRunsEachTaskOnce)
+{
+  fixtures::ThreadCountGuard guard;
+  for (const int n_threads : { 1, 2, 3, 8 }) {
+    parallel::set_num_threads(n_threads);
+    for (const int n_tasks : { 0, 1, 5, 13, 100 }) {
+      std::vector< std::atomic<int> > counts(n_tasks);
+      for (auto& count : counts)
+        count = 0;
+      // Uneven costs -- the first block is much slower and gets stolen from
+      parallel::parallel_for_stealing(n_tasks, [&](const int k) {
+          if (k < n_tasks / 4)
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+          counts[k]++;
+        });
+      for (int k = 0; k < n_tasks; k++)
+        EXPECT_EQ(1, counts[k].load()) << "task " << k << " of " << n_tasks << ", " << n_threads << " threads";
+    }
+  }
+}
@@ -0,0 +1,261 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+// our own code
+#include <common/segmentation.h>
+#include <common/colorConversion.h>
+
+// stl library
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// OpenCV library
+#include <opencv2/opencv.hpp>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+  const char* test_images[] = { "circular0009.jpg", "different0011.jpg", "different0035.jpg",
+                                "octogonal0010.jpg", "octogonal0017.jpg", "triangular0016.jpg" };
+
+  cv::Mat read_test_image(const std::string& name) {
+    std::string input_filename(TEST_DATA_DIR);
+    input_filename.append("/").append(name);
+    return cv::imread(input_filename);
+  }
+
+  // Reference segmentation using one pass per color space and per segmentation as in the original pipeline
+  void seg_multi_pass(const cv::Mat& input_image, cv::Mat& merge_image_seg, const int colour) {
+    cv::Mat ihls_image;
+    colorconversion::convert_rgb_to_ihls(input_image, ihls_image);
+    std::vector< cv::Mat > log_image;
+    colorconversion::rgb_to_log_rb(input_image, log_image);
+
+    cv::Mat nhs_image_seg;
+    segmentation::seg_norm_hue(ihls_image, nhs_image_seg, colour);
+    cv::Mat log_image_seg;
+    segmentation::seg_log_chromatic(log_image, log_image_seg);
+
+    cv::bitwise_or(nhs_image_seg, log_image_seg, merge_image_seg);
+  }
+
+  int count_differences(const cv::Mat& a, const cv::Mat& b) {
+    return cv::countNonZero(a != b);
+  }
+
+}
+
+TEST(segmentation, fusedMatchesMultiPassOnTestImages)
+{
+  for (const char* name : test_images) {
+    cv::Mat input_image = read_test_image(name);
+    ASSERT_TRUE(input_image.data != NULL) << name;
+
+    for (int colour = 0; colour < 2; colour++) {
+      cv::Mat reference, fused;
+      seg_multi_pass(input_image, reference, colour);
+      segmentation::seg_fused_rgb(input_image, fused, colour);
+
+      ASSERT_EQ(reference.size(), fused.size());
+      EXPECT_EQ(0, count_differences(reference, fused)) << name << " colour " << colour;
+    }
+  }
+}
+
+TEST(segmentation, fusedMatchesMultiPassOnRandomImage)
+{
+  // Odd size to exercise the tail of the blocked loops
+  cv::Mat input_image(97, 131, CV_8UC3);
+  cv::randu(input_image, cv::Scalar::all(0), cv::Scalar::all(256));
+
+  cv::Mat reference, fused;
+  seg_multi_pass(input_image, reference, 0);
+  segmentation::seg_fused_rgb(input_image, fused, 0);
+
+  EXPECT_EQ(0, count_differences(reference, fused));
+}
+
+TEST(segmentation, logChromaticThresholdTableMatchesThresholds)
+{
+  const float* log_table = colorconversion::log_chromatic_table();
+  const uchar* threshold_table = segmentation::log_chromatic_threshold_table();
+  for (int k = 0; k < colorconversion::LOG_CHROMATIC_TABLE_SIZE; k++) {
+    const bool condR = (log_table[k] > MINLOGRG) && (log_table[k] < MAXLOGRG);
+    const bool condB = (log_table[k] > MINLOGBG) && (log_table[k] < MAXLOGBG);
+    EXPECT_EQ(condR, (threshold_table[k] & LOG_RG_BIT) != 0) << k;
+    EXPECT_EQ(condB, (threshold_table[k] & LOG_BG_BIT) != 0) << k;
+  }
+}
+
+TEST(segmentation, logChromaticFromRgbMatchesFloatImages)
+{
+  std::vector< cv::Mat > input_images;
+  for (const char* name : test_images) {
+    input_images.push_back(read_test_image(name));
+    ASSERT_TRUE(input_images.back().data != NULL) << name;
+  }
+  // Odd width to exercise the tail of the vectors
+  input_images.push_back(cv::Mat(53, 173, CV_8UC3));
+  cv::randu(input_images.back(), cv::Scalar::all(0), cv::Scalar::all(256));
+
+  for (const cv::Mat& input_image : input_images) {
+    std::vector< cv::Mat > log_image;
+    colorconversion::rgb_to_log_rb(input_image, log_image);
+    cv::Mat reference;
+    segmentation::seg_log_chromatic(log_image, reference);
+
+    for (int level = simd::LEVEL_SCALAR; level <= simd::detected_level(); level++) {
+      cv::Mat log_image_seg;
+      segmentation::seg_log_chromatic_rgb(input_image, log_image_seg, static_cast<simd::Level> (level));
+      ASSERT_EQ(reference.size(), log_image_seg.size());
+      EXPECT_EQ(0, count_differences(reference, log_image_seg)) << simd::level_name(static_cast<simd::Level> (level));
+    }
+  }
+}
+
+TEST(segmentation, huePredicateMatchesThresholdsOnAllColours)
+{
+  // Verification corpus: every 8-bit colour, for the red and the blue thresholds
+  for (int colour = 0; colour < 2; colour++) {
+    const segmentation::HuePredicate hue_predicate(colour);
+    const int hue_max = (colour == 1) ? B_HUE_MAX : R_HUE_MAX;
+    const int hue_min = (colour == 1) ? B_HUE_MIN : R_HUE_MIN;
+    const int sat_min = (colour == 1) ? B_SAT_MIN : R_SAT_MIN;
+
+    int n_differences = 0;
+    for (int r = 0; r < 256; r++) {
+      for (int g = 0; g < 256; g++) {
+        for (int b = 0; b < 256; b++) {
+          const uchar s = static_cast<uchar> (colorconversion::retrieve_saturation(r, g, b));
+          // Grey pixels have an undefined hue and are rejected by the saturation
+          const uchar h = (s == 0) ? 0 : static_cast<uchar> (colorconversion::retrieve_normalised_hue(r, g, b));
+          const bool expected = (colour == 1) ? (B_CONDITION) : (R_CONDITION);
+          if (hue_predicate(r, g, b) != expected)
+            n_differences++;
+        }
+      }
+    }
+    EXPECT_EQ(0, n_differences) << "colour " << colour;
+  }
+}
+
+TEST(segmentation, normHueFromRgbMatchesIhls)
+{
+  for (const char* name : test_images) {
+    cv::Mat input_image = read_test_image(name);
+    ASSERT_TRUE(input_image.data != NULL) << name;
+
+    cv::Mat ihls_image;
+    colorconversion::convert_rgb_to_ihls(input_image, ihls_image);
+
+    // Red, blue and custom thresholds
+    const int modes[][4] = { { 0, R_HUE_MAX, R_HUE_MIN, R_SAT_MIN }, { 1, B_HUE_MAX, B_HUE_MIN, B_SAT_MIN }, { 2, 30, 200, 10 } };
+    for (const auto& mode : modes) {
+      cv::Mat reference, nhs_image;
+      segmentation::seg_norm_hue(ihls_image, reference, mode[0], mode[1], mode[2], mode[3]);
+      segmentation::seg_norm_hue_rgb(input_image, nhs_image, mode[0], mode[1], mode[2], mode[3]);
+      EXPECT_EQ(0, count_differences(reference, nhs_image)) << name << " mode " << mode[0];
+    }
+  }
+}
+
+TEST(segmentation, cascadeMatchesIhlsAndCountsStages)
+{
+  for (const char* name : test_images) {
+    cv::Mat input_image = read_test_image(name);
+    ASSERT_TRUE(input_image.data != NULL) << name;
+
+    cv::Mat ihls_image;
+    colorconversion::convert_rgb_to_ihls(input_image, ihls_image);
+
+    for (int colour = 0; colour < 2; colour++) {
+      cv::Mat reference;
+      segmentation::seg_norm_hue(ihls_image, reference, colour);
+
+      for (int level = simd::LEVEL_SCALAR; level <= simd::detected_level(); level++) {
+        segmentation::CascadeStats stats;
+        cv::Mat nhs_image;
+        segmentation::seg_norm_hue_cascade(input_image, nhs_image, colour, R_HUE_MAX, R_HUE_MIN, R_SAT_MIN, &stats, static_cast<simd::Level> (level));
+        EXPECT_EQ(0, count_differences(reference, nhs_image)) << name << " colour " << colour << " " << simd::level_name(static_cast<simd::Level> (level));
+
+        // Counters consistent with the images
+        cv::Mat saturation;
+        cv::extractChannel(ihls_image, saturation, 0);
+        const int sat_min = (colour == 1) ? B_SAT_MIN : R_SAT_MIN;
+        EXPECT_EQ(static_cast<long long> (input_image.total()), stats.n_pixels);
+        EXPECT_EQ(static_cast<long long> (cv::countNonZero(saturation <= sat_min)), stats.n_saturation_rejected);
+        EXPECT_EQ(static_cast<long long> (cv::countNonZero(reference)), stats.n_hue_accepted);
+      }
+    }
+  }
+}
+
+TEST(segmentation, saturationSurvivorsOnRowTails)
+{
+  // Row lengths around the vector width and extreme thresholds
+  const int lengths[] = { 1, 15, 16, 17, 47, 203 };
+  const int thresholds[] = { 0, 25, 254, 255 };
+  for (const int n : lengths) {
+    cv::Mat row(1, n, CV_8UC3);
+    cv::randu(row, cv::Scalar::all(0), cv::Scalar::all(256));
+    const uchar* bgr = row.ptr<uchar>(0);
+
+    for (const int sat_min : thresholds) {
+      std::vector< int > expected;
+      for (int j = 0; j < n; j++) {
+        const int s = std::max(bgr[3 * j], std::max(bgr[3 * j + 1], bgr[3 * j + 2])) - std::min(bgr[3 * j], std::min(bgr[3 * j + 1], bgr[3 * j + 2]));
+        if (s > sat_min)
+          expected.push_back(j);
+      }
+
+      for (int level = simd::LEVEL_SCALAR; level <= simd::detected_level(); level++) {
+        std::vector< int > survivors(n);
+        const int n_survivors = segmentation::saturation_survivors_row_simd(bgr, n, sat_min, survivors.data(), static_cast<simd::Level> (level));
+        survivors.resize(n_survivors);
+        EXPECT_EQ(expected, survivors) << n << " " << sat_min << " " << simd::level_name(static_cast<simd::Level> (level));
+      }
+    }
+  }
+}
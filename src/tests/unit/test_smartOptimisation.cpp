@@ -0,0 +1,473 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+// our own code
+#include <common/smartOptimisation.h>
+#include <common/imageProcessing.h>
+#include <tests/unit/testFixtures.h>
+
+// stl library
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// OpenCV library
+#include <opencv2/opencv.hpp>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+  const char* test_images[] = { "circular0009.jpg", "different0011.jpg", "octogonal0010.jpg", "triangular0016.jpg" };
+
+  cv::Mat read_test_image(const std::string& name) {
+    std::string input_filename(TEST_DATA_DIR);
+    input_filename.append("/").append(name);
+    return cv::imread(input_filename);
+  }
+
+  // Centers voted by the sparse and the dense voting on the same gradient field
+  void voted_centers(const cv::Mat& roi_image, const int radius, const int edges_number, cv::Point2f& sparse_center, cv::Point2f& dense_center) {
+    initopt::GradientField field;
+    initopt::gradient_field(roi_image, field);
+    cv::Mat gradient_vp_x, gradient_vp_y, gradient_bar_x, gradient_bar_y;
+    initopt::orientations_from_gradient(field.gradient_x, field.gradient_y, edges_number, gradient_vp_x, gradient_vp_y, gradient_bar_x, gradient_bar_y);
+    sparse_center = initopt::mass_center_by_voting(field.magnitude_image, field.gradient_x, field.gradient_y, gradient_bar_x, gradient_bar_y,
+                                                   gradient_vp_x, gradient_vp_y, static_cast<float> (radius), edges_number);
+    dense_center = initopt::mass_center_by_voting_dense(field.magnitude_image, field.gradient_x, field.gradient_y, gradient_bar_x, gradient_bar_y,
+                                                        gradient_vp_x, gradient_vp_y, static_cast<float> (radius), edges_number);
+  }
+
+  // Radial symmetry detector as it was before the gradient field was shared by the hypotheses -- dense gradients,
+  // orientations and votes computed again for each hypothesis
+  cv::Point2f detector_before_split(const cv::Mat& roi_image, const int radius, const int edges_number) {
+    initopt::GradientField field;
+    initopt::gradient_field_dense(roi_image, field);
+    cv::Mat gradient_vp_x, gradient_vp_y, gradient_bar_x, gradient_bar_y;
+    initopt::orientations_from_gradient(field.gradient_x, field.gradient_y, edges_number, gradient_vp_x, gradient_vp_y, gradient_bar_x, gradient_bar_y);
+    return initopt::mass_center_by_voting_dense(field.magnitude_image, field.gradient_x, field.gradient_y, gradient_bar_x, gradient_bar_y,
+                                                gradient_vp_x, gradient_vp_y, static_cast<float> (radius), edges_number);
+  }
+
+  // Pixel contour of a regular polygon of radius 40, as given by the contour extraction
+  std::vector< cv::Point2f > polygon_contour(const int n_edges, const double rotation) {
+    std::vector< cv::Point2f > contour;
+    for (int edge = 0; edge < n_edges; edge++) {
+      const double angle_0 = 2.0 * M_PI * edge / n_edges + rotation;
+      const double angle_1 = 2.0 * M_PI * (edge + 1) / n_edges + rotation;
+      for (int step = 0; step < 50; step++) {
+        const double t = step / 50.0;
+        const cv::Point2f point(std::round(100.0 + 40.0 * ((1.0 - t) * std::cos(angle_0) + t * std::cos(angle_1))),
+                                std::round(80.0 + 40.0 * ((1.0 - t) * std::sin(angle_0) + t * std::sin(angle_1))));
+        if (contour.empty() || contour.back() != point)
+          contour.push_back(point);
+      }
+    }
+    return contour;
+  }
+
+}
+
+TEST(smartOptimisation, polygonDescriptorsOfRegularPolygons)
+{
+  // n_edges -> expected most plausible sign type, the circle being approximated by 360 edges
+  const int n_edges[4] = { 3, 4, 8, 360 };
+  const int expected_type[4] = { 0, 1, 3, 2 };
+  const cv::Vec3d expected_descriptors[4] = { cv::Vec3d(1.0, 0.0, 0.0), cv::Vec3d(0.0, 1.0, 1.0),
+                                              cv::Vec3d(0.0, 0.0, 1.0), cv::Vec3d(0.0, 0.0, 0.0) };
+
+  for (int shape = 0; shape < 4; shape++) {
+    for (int direction = 0; direction < 2; direction++) {
+      std::vector< cv::Point2f > contour = polygon_contour(n_edges[shape], 0.3 * shape);
+      if (direction)
+        std::reverse(contour.begin(), contour.end());
+
+      const cv::Vec3d descriptors = initopt::polygon_descriptors(contour);
+      for (int n = 0; n < 3; n++)
+        EXPECT_NEAR(expected_descriptors[shape][n], descriptors[n], 0.2) << n_edges[shape] << " edges";
+
+      // Every sign type is ranked once
+      std::vector< int > ranking;
+      initopt::rank_sign_types(contour, ranking);
+      ASSERT_EQ(5u, ranking.size());
+      EXPECT_EQ(expected_type[shape], ranking[0]) << n_edges[shape] << " edges";
+      std::vector< int > sorted(ranking);
+      std::sort(sorted.begin(), sorted.end());
+      for (int sign_type = 0; sign_type < 5; sign_type++)
+        EXPECT_EQ(sign_type, sorted[sign_type]);
+    }
+  }
+
+  // Both triangular sign types share the same shape
+  std::vector< int > ranking;
+  initopt::rank_sign_types(polygon_contour(3, 0.0), ranking);
+  EXPECT_EQ(4, ranking[1]);
+}
+
+TEST(smartOptimisation, contourRegionMatchesFullFrameWarp)
+{
+  // Textured frame with a tilted ellipse in the middle and an other one across the top left corner
+  cv::Mat image(240, 320, CV_8UC3);
+  cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+  cv::GaussianBlur(image, image, cv::Size(7, 7), 2.0);
+  const cv::Point centers[2] = { cv::Point(160, 120), cv::Point(10, 12) };
+
+  for (int k = 0; k < 2; k++) {
+    std::vector< cv::Point > ellipse;
+    cv::ellipse2Poly(centers[k], cv::Size(40, 25), 30, 0, 360, 2, ellipse);
+    std::vector< std::vector< cv::Point > > distorted_contours(1, ellipse);
+    std::vector< std::vector< cv::Point2f > > undistorted_contours;
+    std::vector< cv::Mat > translation_matrix(1, cv::Mat::eye(3, 3, CV_32F));
+    std::vector< cv::Mat > rotation_matrix(1, cv::Mat::eye(3, 3, CV_32F));
+    std::vector< cv::Mat > scaling_matrix(1, cv::Mat::eye(3, 3, CV_32F));
+    imageprocessing::correction_distortion(distorted_contours, undistorted_contours, translation_matrix, rotation_matrix, scaling_matrix);
+    std::vector< cv::Point2f > normalised_contour;
+    double factor;
+    initopt::normalise_contour(undistorted_contours[0], normalised_contour, factor);
+
+    initopt::ContourRegion region;
+    initopt::warp_contour_region(image, translation_matrix[0], rotation_matrix[0], scaling_matrix[0], normalised_contour, factor, region);
+
+    // Reference -- warp of the whole frame, then extraction of the ROI
+    cv::Mat warp_image, roi_image;
+    cv::warpPerspective(image, warp_image, translation_matrix[0].inv() * rotation_matrix[0] * scaling_matrix[0] * translation_matrix[0],
+                        image.size(), cv::INTER_CUBIC, cv::BORDER_REPLICATE);
+    initopt::roi_extraction(warp_image, region.roi, roi_image);
+
+    ASSERT_EQ(region.roi.size(), region.roi_image.size());
+    ASSERT_EQ(roi_image.size(), region.roi_image.size());
+
+    // The source coordinates only differ by the rounding of the translation to the ROI
+    cv::Mat difference;
+    cv::absdiff(roi_image, region.roi_image, difference);
+    EXPECT_LE(cv::countNonZero(difference.reshape(1) > 2), 0.001 * difference.total() * 3) << "contour " << k;
+  }
+}
+
+TEST(smartOptimisation, warpFreeRegionMatchesWarp)
+{
+  // Red octagon on a grey background, stretched and rotated as by the perspective
+  cv::Mat image(240, 320, CV_8UC3, cv::Scalar(128, 128, 128));
+  const double angle = 25.0 * M_PI / 180.0;
+  const cv::Matx22d linear(1.25 * std::cos(angle), - 0.8 * std::sin(angle), 1.25 * std::sin(angle), 0.8 * std::cos(angle));
+  std::vector< cv::Point > distorted_octagon;
+  fixtures::draw_octagon(image, cv::Point2d(160.0, 120.0), 50.0, distorted_octagon, 20, linear);
+
+  std::vector< std::vector< cv::Point > > distorted_contours(1, distorted_octagon);
+  std::vector< std::vector< cv::Point2f > > undistorted_contours;
+  std::vector< cv::Mat > translation_matrix(1, cv::Mat::eye(3, 3, CV_32F));
+  std::vector< cv::Mat > rotation_matrix(1, cv::Mat::eye(3, 3, CV_32F));
+  std::vector< cv::Mat > scaling_matrix(1, cv::Mat::eye(3, 3, CV_32F));
+  imageprocessing::correction_distortion(distorted_contours, undistorted_contours, translation_matrix, rotation_matrix, scaling_matrix);
+  std::vector< cv::Point2f > normalised_contour;
+  double factor;
+  initopt::normalise_contour(undistorted_contours[0], normalised_contour, factor);
+
+  initopt::ContourRegion warped, warp_free;
+  initopt::prepare_contour_region(image, translation_matrix[0], rotation_matrix[0], scaling_matrix[0], normalised_contour, factor, warped);
+  initopt::prepare_contour_region_warp_free(image, translation_matrix[0], rotation_matrix[0], scaling_matrix[0], normalised_contour, factor, warp_free);
+  ASSERT_EQ(warped.roi, warp_free.roi);
+  ASSERT_EQ(warped.roi.size(), warp_free.gradients.magnitude_image.size());
+  EXPECT_TRUE(warp_free.roi_image.empty());
+
+  // The centers of the octagon voted on both gradient fields agree to the pixel
+  const cv::Point2f warped_center = initopt::radial_symmetry_voting(warped.gradients, warped.radius, 8);
+  const cv::Point2f warp_free_center = initopt::radial_symmetry_voting(warp_free.gradients, warp_free.radius, 8);
+  EXPECT_NEAR(warped_center.x, warp_free_center.x, 1.0);
+  EXPECT_NEAR(warped_center.y, warp_free_center.y, 1.0);
+}
+
+TEST(smartOptimisation, sharedGradientFieldMatchesDetector)
+{
+  // Red octagon on a grey background
+  cv::Mat roi_image(120, 140, CV_8UC3, cv::Scalar(128, 128, 128));
+  std::vector< cv::Point > octagon;
+  fixtures::draw_octagon(roi_image, cv::Point2d(70.0, 60.0), 40.0, octagon);
+
+  initopt::GradientField field;
+  initopt::gradient_field_dense(roi_image, field);
+
+  // The voting does not modify the field, which can be shared by every hypothesis
+  const cv::Mat magnitude_image = field.magnitude_image.clone();
+  const int edges_number[5] = { 3, 4, 12, 8, 3 };
+  const int radius[5] = { 40, 40, 40, 40, 20 };
+  for (int sign_type = 0; sign_type < 5; sign_type++) {
+    const cv::Point2f expected = detector_before_split(roi_image, radius[sign_type], edges_number[sign_type]);
+    const cv::Point2f center = initopt::radial_symmetry_voting(field, radius[sign_type], edges_number[sign_type]);
+    EXPECT_EQ(expected.x, center.x) << edges_number[sign_type] << " edges";
+    EXPECT_EQ(expected.y, center.y) << edges_number[sign_type] << " edges";
+  }
+  EXPECT_EQ(0, cv::countNonZero(magnitude_image != field.magnitude_image));
+}
+
+TEST(smartOptimisation, separableGradientFieldMatchesDense)
+{
+  // Textured image with a red octagon
+  cv::Mat roi_image(150, 170, CV_8UC3);
+  cv::randu(roi_image, cv::Scalar::all(0), cv::Scalar::all(255));
+  cv::GaussianBlur(roi_image, roi_image, cv::Size(9, 9), 3.0);
+  std::vector< cv::Point > octagon;
+  fixtures::draw_octagon(roi_image, cv::Point2d(85.0, 75.0), 50.0, octagon);
+
+  initopt::GradientField dense, separable;
+  initopt::gradient_field_dense(roi_image, dense);
+  initopt::gradient_field(roi_image, separable);
+  ASSERT_EQ(dense.magnitude_image.size(), separable.magnitude_image.size());
+
+  double max_magnitude;
+  cv::minMaxLoc(dense.magnitude_image, NULL, &max_magnitude);
+
+  // The border handling differs on the 3 pixels of border, where the pre-blur is folded in the kernels
+  const cv::Rect interior(3, 3, roi_image.cols - 6, roi_image.rows - 6);
+  int n_kept = 0, n_flipped = 0;
+  for (int i = interior.y; i < interior.y + interior.height; i++) {
+    for (int j = interior.x; j < interior.x + interior.width; j++) {
+      const float dense_magnitude = dense.magnitude_image.at<float>(i, j);
+      const float separable_magnitude = separable.magnitude_image.at<float>(i, j);
+      // A magnitude at the threshold may be kept by only one of the fields
+      if ((dense_magnitude == 0.0f) != (separable_magnitude == 0.0f)) {
+        n_flipped++;
+        continue;
+      }
+      if (dense_magnitude == 0.0f)
+        continue;
+      n_kept++;
+      EXPECT_NEAR(dense_magnitude, separable_magnitude, 2e-3 * max_magnitude) << i << ", " << j;
+      EXPECT_NEAR(dense.gradient_x.at<float>(i, j), separable.gradient_x.at<float>(i, j), 2e-2) << i << ", " << j;
+      EXPECT_NEAR(dense.gradient_y.at<float>(i, j), separable.gradient_y.at<float>(i, j), 2e-2) << i << ", " << j;
+    }
+  }
+  EXPECT_GT(n_kept, 0);
+  EXPECT_LE(n_flipped, 0.005 * interior.area());
+
+  // Same centers voted on both fields
+  const int edges_number[5] = { 3, 4, 12, 8, 3 };
+  const int radius[5] = { 50, 50, 50, 50, 25 };
+  for (int sign_type = 0; sign_type < 5; sign_type++) {
+    const cv::Point2f dense_center = initopt::radial_symmetry_voting(dense, radius[sign_type], edges_number[sign_type]);
+    const cv::Point2f separable_center = initopt::radial_symmetry_voting(separable, radius[sign_type], edges_number[sign_type]);
+    EXPECT_LE(cv::norm(dense_center - separable_center), 1.0) << edges_number[sign_type] << " edges";
+  }
+}
+
+TEST(smartOptimisation, separableGradientFieldLevelsAreIdentical)
+{
+  // Width which is not a multiple of the vector sizes
+  cv::Mat roi_image(61, 83, CV_8UC3);
+  cv::randu(roi_image, cv::Scalar::all(0), cv::Scalar::all(255));
+
+  initopt::GradientField reference;
+  initopt::gradient_field(roi_image, reference, simd::LEVEL_SCALAR);
+  for (int level = simd::LEVEL_SCALAR + 1; level <= simd::detected_level(); level++) {
+    initopt::GradientField field;
+    initopt::gradient_field(roi_image, field, static_cast<simd::Level> (level));
+    EXPECT_EQ(0, std::memcmp(reference.magnitude_image.data, field.magnitude_image.data, reference.magnitude_image.total() * sizeof(float))) << simd::level_name(static_cast<simd::Level> (level));
+    EXPECT_EQ(0, std::memcmp(reference.gradient_x.data, field.gradient_x.data, reference.gradient_x.total() * sizeof(float))) << simd::level_name(static_cast<simd::Level> (level));
+    EXPECT_EQ(0, std::memcmp(reference.gradient_y.data, field.gradient_y.data, reference.gradient_y.total() * sizeof(float))) << simd::level_name(static_cast<simd::Level> (level));
+  }
+}
+
+TEST(smartOptimisation, sparseVotingMatchesDense)
+{
+  for (const char* name : test_images) {
+    cv::Mat input_image = read_test_image(name);
+    ASSERT_TRUE(input_image.data != NULL) << name;
+
+    // Central part of the image, where the signs are
+    const cv::Rect roi(input_image.cols / 4, input_image.rows / 4, input_image.cols / 2, input_image.rows / 2);
+    const cv::Mat roi_image = input_image(roi).clone();
+
+    for (const int edges_number : { 3, 4, 8, 12 }) {
+      for (const int radius : { 10, 20, 40 }) {
+        cv::Point2f sparse_center, dense_center;
+        voted_centers(roi_image, radius, edges_number, sparse_center, dense_center);
+        EXPECT_EQ(dense_center.x, sparse_center.x) << name << ", " << edges_number << " edges, radius " << radius;
+        EXPECT_EQ(dense_center.y, sparse_center.y) << name << ", " << edges_number << " edges, radius " << radius;
+      }
+    }
+  }
+}
+
+TEST(smartOptimisation, sparseVotingOnSmallSymbol)
+{
+  // The votes of a small triangle only cover a corner of a large image
+  cv::Mat roi_image(300, 400, CV_8UC3, cv::Scalar(128, 128, 128));
+  std::vector< cv::Point > triangle;
+  for (int vertex = 0; vertex < 3; vertex++)
+    triangle.push_back(cv::Point(60 + 20 * std::cos(- M_PI / 2.0 + vertex * 2.0 * M_PI / 3.0), 50 + 20 * std::sin(- M_PI / 2.0 + vertex * 2.0 * M_PI / 3.0)));
+  cv::fillConvexPoly(roi_image, triangle, cv::Scalar(30, 30, 200));
+
+  cv::Point2f sparse_center, dense_center;
+  voted_centers(roi_image, 20, 3, sparse_center, dense_center);
+  EXPECT_EQ(dense_center.x, sparse_center.x);
+  EXPECT_EQ(dense_center.y, sparse_center.y);
+}
+
+TEST(smartOptimisation, singleSweepVotingMatchesPerHypothesis)
+{
+  for (const char* name : test_images) {
+    cv::Mat input_image = read_test_image(name);
+    ASSERT_TRUE(input_image.data != NULL) << name;
+
+    const cv::Rect roi(input_image.cols / 4, input_image.rows / 4, input_image.cols / 2, input_image.rows / 2);
+    initopt::GradientField field;
+    initopt::gradient_field(input_image(roi).clone(), field);
+
+    // The hypotheses of the 5 sign types for two radii, voted in a single sweep
+    std::vector< initopt::SymmetryHypothesis > hypotheses;
+    for (const int radius : { 15, 40 })
+      for (int sign_type = 0; sign_type < 5; sign_type++)
+        hypotheses.push_back(initopt::sign_type_hypothesis(radius, sign_type));
+    std::vector< cv::Point2f > centers;
+    initopt::radial_symmetry_voting(field, hypotheses, centers);
+    ASSERT_EQ(hypotheses.size(), centers.size()) << name;
+
+    for (size_t h = 0; h < hypotheses.size(); h++) {
+      const cv::Point2f center = initopt::radial_symmetry_voting(field, hypotheses[h].radius, hypotheses[h].edges_number);
+      EXPECT_EQ(center.x, centers[h].x) << name << ", " << hypotheses[h].edges_number << " edges, radius " << hypotheses[h].radius;
+      EXPECT_EQ(center.y, centers[h].y) << name << ", " << hypotheses[h].edges_number << " edges, radius " << hypotheses[h].radius;
+    }
+  }
+}
+
+TEST(smartOptimisation, privateVotingOnLargeSymbol)
+{
+  // Near-field octagon filling most of a large ROI
+  cv::Mat roi_image(420, 440, CV_8UC3, cv::Scalar(128, 128, 128));
+  std::vector< cv::Point > octagon;
+  fixtures::draw_octagon(roi_image, cv::Point2d(220.0, 210.0), 150.0, octagon);
+
+  initopt::GradientField field;
+  initopt::gradient_field(roi_image, field);
+  const cv::Point2f ordered_center = initopt::radial_symmetry_voting(field, 150, 8);
+  for (const initopt::VoteAccumulation accumulation : { initopt::VOTES_PRIVATE_FLOAT, initopt::VOTES_PRIVATE_INTEGER }) {
+    const cv::Point2f center = initopt::radial_symmetry_voting(field, 150, 8, accumulation);
+    EXPECT_NEAR(ordered_center.x, center.x, 1.0) << accumulation;
+    EXPECT_NEAR(ordered_center.y, center.y, 1.0) << accumulation;
+  }
+}
+
+TEST(smartOptimisation, edgePixelsAndLineOffsetsLevelsAreIdentical)
+{
+  cv::Mat magnitude(1, 103, CV_32F);
+  cv::randu(magnitude, cv::Scalar(0.0), cv::Scalar(1.0));
+  magnitude.setTo(0.0, magnitude < 0.6);
+
+  std::vector< int > reference_edges(magnitude.cols);
+  const int n_reference_edges = initopt::edge_pixels_row_simd(magnitude.ptr<float>(), magnitude.cols, reference_edges.data(), simd::LEVEL_SCALAR);
+  EXPECT_EQ(cv::countNonZero(magnitude), n_reference_edges);
+
+  const int half_length = 37;
+  std::vector< int > reference_dx(2 * half_length + 1), reference_dy(2 * half_length + 1);
+  initopt::line_offsets_simd(0.6f, -0.8f, half_length, reference_dx.data(), reference_dy.data(), simd::LEVEL_SCALAR);
+
+  for (int level = simd::LEVEL_SCALAR + 1; level <= simd::detected_level(); level++) {
+    std::vector< int > edges(magnitude.cols);
+    const int n_edges = initopt::edge_pixels_row_simd(magnitude.ptr<float>(), magnitude.cols, edges.data(), static_cast<simd::Level> (level));
+    ASSERT_EQ(n_reference_edges, n_edges) << simd::level_name(static_cast<simd::Level> (level));
+    for (int k = 0; k < n_edges; k++)
+      EXPECT_EQ(reference_edges[k], edges[k]) << simd::level_name(static_cast<simd::Level> (level));
+
+    std::vector< int > dx(2 * half_length + 1), dy(2 * half_length + 1);
+    initopt::line_offsets_simd(0.6f, -0.8f, half_length, dx.data(), dy.data(), static_cast<simd::Level> (level));
+    EXPECT_TRUE(reference_dx == dx) << simd::level_name(static_cast<simd::Level> (level));
+    EXPECT_TRUE(reference_dy == dy) << simd::level_name(static_cast<simd::Level> (level));
+  }
+}
+
+TEST(smartOptimisation, trigFreeOrientationsMatchAngles)
+{
+  for (const char* name : test_images) {
+    cv::Mat input_image = read_test_image(name);
+    ASSERT_TRUE(input_image.data != NULL) << name;
+
+    initopt::GradientField field;
+    initopt::gradient_field(input_image, field);
+
+    for (const int edges_number : { 3, 4, 8, 12, 6 }) {
+      cv::Mat reference_vp_x, reference_vp_y, reference_bar_x, reference_bar_y;
+      initopt::orientations_from_gradient_trig(field.gradient_x, field.gradient_y, edges_number, reference_vp_x, reference_vp_y, reference_bar_x, reference_bar_y);
+
+      for (int level = simd::LEVEL_SCALAR; level <= simd::detected_level(); level++) {
+        cv::Mat gradient_vp_x, gradient_vp_y, gradient_bar_x, gradient_bar_y;
+        initopt::orientations_from_gradient(field.gradient_x, field.gradient_y, edges_number, gradient_vp_x, gradient_vp_y, gradient_bar_x, gradient_bar_y,
+                                            static_cast<simd::Level> (level));
+
+        // The unit gradient raised to the power edges_number only differs by the rounding of the angles
+        EXPECT_LE(cv::norm(reference_vp_x, gradient_vp_x, cv::NORM_INF), 1e-4) << name << ", " << edges_number << " edges";
+        EXPECT_LE(cv::norm(reference_vp_y, gradient_vp_y, cv::NORM_INF), 1e-4) << name << ", " << edges_number << " edges";
+        EXPECT_EQ(0.0, cv::norm(reference_bar_x, gradient_bar_x, cv::NORM_INF)) << name << ", " << edges_number << " edges";
+        EXPECT_EQ(0.0, cv::norm(reference_bar_y, gradient_bar_y, cv::NORM_INF)) << name << ", " << edges_number << " edges";
+      }
+    }
+  }
+}
+
+TEST(smartOptimisation, trigFreeOrientationsLevelsAreIdentical)
+{
+  // Unit gradients in every direction and null gradients, on a width which is not a multiple of the vector sizes
+  cv::Mat gradient_x(1, 365, CV_32F), gradient_y(1, 365, CV_32F);
+  for (int j = 0; j < gradient_x.cols; j++) {
+    const float angle = static_cast<float> (j * M_PI / 180.0);
+    gradient_x.at<float>(j) = (j % 10 == 0) ? 0.0f : std::cos(angle);
+    gradient_y.at<float>(j) = (j % 10 == 0) ? 0.0f : std::sin(angle);
+  }
+
+  for (const int edges_number : { 3, 4, 8, 12 }) {
+    cv::Mat reference_vp_x, reference_vp_y, reference_bar_x, reference_bar_y;
+    initopt::orientations_from_gradient(gradient_x, gradient_y, edges_number, reference_vp_x, reference_vp_y, reference_bar_x, reference_bar_y, simd::LEVEL_SCALAR);
+    for (int j = 0; j < gradient_x.cols; j += 10) {
+      EXPECT_EQ(0.0f, reference_vp_x.at<float>(j));
+      EXPECT_EQ(0.0f, reference_vp_y.at<float>(j));
+    }
+
+    for (int level = simd::LEVEL_SCALAR + 1; level <= simd::detected_level(); level++) {
+      cv::Mat gradient_vp_x, gradient_vp_y, gradient_bar_x, gradient_bar_y;
+      initopt::orientations_from_gradient(gradient_x, gradient_y, edges_number, gradient_vp_x, gradient_vp_y, gradient_bar_x, gradient_bar_y, static_cast<simd::Level> (level));
+      EXPECT_EQ(0, std::memcmp(reference_vp_x.data, gradient_vp_x.data, gradient_x.total() * sizeof(float))) << edges_number << " edges, " << simd::level_name(static_cast<simd::Level> (level));
+      EXPECT_EQ(0, std::memcmp(reference_vp_y.data, gradient_vp_y.data, gradient_x.total() * sizeof(float))) << edges_number << " edges, " << simd::level_name(static_cast<simd::Level> (level));
+    }
+  }
+}
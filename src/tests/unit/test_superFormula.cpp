@@ -0,0 +1,134 @@
+/*
+By downloading, copying, installing or using the software you agree to this license.
+If you do not agree to this license, do not download, install,
+copy or use the software.
+
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2015, 
+	  Guillaume Lemaitre (g.lemaitre58@gmail.com), 
+	  Johan Massich (mailsik@gmail.com),
+	  Gerard Bahi (zomeck@gmail.com),
+	  Yohan Fougerolle (Yohan.Fougerolle@u-bourgogne.fr).
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are disclaimed.
+In no event shall copyright holders or contributors be liable for any direct,
+indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+// our own code
+#include <common/SuperFormula.h>
+
+// stl library
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+  // Shapes of the traffic signs and some more generic ones -- a, b, n1, n2, n3, p, q
+  const double shapes[][7] = { { 1.0, 1.0, 2.0, 2.0, 2.0, 4.0, 1.0 },
+                               { 0.9, 0.87, 3.0, 5.0, 5.0, 8.0, 1.0 },
+                               { 1.0, 1.0, 1.5, 1.2, 1.7, 6.0, 1.0 },
+                               { 1.2, 0.8, 4.0, 2.5, 3.5, 4.0, 1.0 },
+                               { 0.88557, 0.869246, 7.0, 9.0, 9.0, 8.0, 1.0 } };
+
+}
+
+TEST(superFormula, closedFormDerivativesMatchFiniteDifferences)
+{
+  for (const auto& p : shapes) {
+    RationalSuperShape2D RS(p[0], p[1], p[2], p[3], p[4], p[5], p[6]);
+
+    for (int i = 0; i < 1000; i++) {
+      const double tht = 2.0 * M_PI * (i + 0.37) / 1000.0;
+
+      // |cos| and |sin| are not differentiable at 0, the 4-point stencils cannot be compared there
+      const double u = p[5] * tht * 0.25 / p[6];
+      if (std::min(std::fabs(std::cos(u)), std::fabs(std::sin(u))) < 0.05)
+        continue;
+
+      double D[6];
+      const double r = RS.RadiusAndDerivatives(tht, D[0], D[1], D[2], D[3], D[4], D[5]);
+      EXPECT_EQ(RS.radius(tht), r) << "theta " << tht;
+
+      const double finite_differences[6] = { RS.DrDa(tht), RS.DrDb(tht), RS.DrDn1(tht),
+                                             RS.DrDn2(tht), RS.DrDn3(tht), RS.DrDtheta(tht) };
+      for (int k = 0; k < 6; k++)
+        EXPECT_NEAR(finite_differences[k], D[k], 1e-6 * std::max(1.0, std::fabs(finite_differences[k])))
+          << "derivative " << k << ", theta " << tht;
+    }
+  }
+}
+
+TEST(superFormula, statelessEvaluationMatchesClass)
+{
+  RationalSuperShape2D RS(0.9, 0.87, 3.0, 5.0, 5.0, 8.0, 1.0, 0.1, 0.0, 0.2, -0.1, 0.0);
+  const SuperShapeParams params = RS.Parameters;
+
+  std::vector< double > Df_class, Df_stateless;
+  for (int i = 0; i < 100; i++) {
+    const double tht = 2.0 * M_PI * (i + 0.5) / 100.0;
+    EXPECT_EQ(RS.radius(tht), supershape::radius(params, tht));
+    EXPECT_EQ(RS.DrDtheta(tht), supershape::dr_dtheta(params, tht));
+    EXPECT_EQ(RS.DrDn1(tht), supershape::dr_dparameter(params, 2, tht));
+
+    const Vector2d P(1.1 * std::cos(tht), 0.9 * std::sin(tht));
+    EXPECT_EQ(RS.ImplicitFunction1(P, Df_class), supershape::implicit_function1(params, P, Df_stateless));
+    EXPECT_EQ(Df_class, Df_stateless);
+    EXPECT_EQ(RS.ImplicitFunction3(P, Df_class), supershape::implicit_function3(params, P, Df_stateless));
+    EXPECT_EQ(Df_class, Df_stateless);
+  }
+
+  // The evaluations leave the parameters untouched
+  EXPECT_EQ(0, std::memcmp(&params, &RS.Parameters, sizeof(SuperShapeParams)));
+}
+
+TEST(superFormula, fixedSizeImplicitFunctionsMatchVectorVersions)
+{
+  // q beyond SUPERSHAPE_MAX_BRANCHES exercises the heap buffers of the branches
+  for (const double q : { 2.0, SUPERSHAPE_MAX_BRANCHES + 4.0 }) {
+    RationalSuperShape2D RS(0.9, 0.87, 3.0, 5.0, 5.0, 8.0, q);
+
+    std::vector< double > Df_vector;
+    Vector3d Df_fixed;
+    for (int i = 0; i < 100; i++) {
+      const double tht = 2.0 * M_PI * (i + 0.5) / 100.0;
+      const Vector2d P(1.1 * std::cos(tht), 0.9 * std::sin(tht));
+      EXPECT_EQ(RS.ImplicitFunction1(P, Df_vector), RS.ImplicitFunction1(P, Df_fixed));
+      EXPECT_EQ(Df_vector, std::vector< double >(Df_fixed.data(), Df_fixed.data() + 3));
+      EXPECT_EQ(RS.ImplicitFunction2(P, Df_vector), RS.ImplicitFunction2(P, Df_fixed));
+      EXPECT_EQ(Df_vector, std::vector< double >(Df_fixed.data(), Df_fixed.data() + 3));
+      EXPECT_EQ(RS.ImplicitFunction3(P, Df_vector), RS.ImplicitFunction3(P, Df_fixed));
+      EXPECT_EQ(Df_vector, std::vector< double >(Df_fixed.data(), Df_fixed.data() + 3));
+    }
+  }
+}